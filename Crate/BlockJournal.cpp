@@ -0,0 +1,221 @@
+#include "BlockJournal.h"
+#include "Common/FileUtil.h"
+#include "Common/Hash.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char JournalMagic[4] = { 'C', 'R', 'J', 'N' };
+
+	void Put16(std::uint8_t* p, std::uint32_t v)
+	{
+		p[0] = (std::uint8_t)v;
+		p[1] = (std::uint8_t)(v >> 8);
+	}
+
+	void Put32(std::uint8_t* p, std::uint32_t v)
+	{
+		Put16(p, v);
+		Put16(p + 2, v >> 16);
+	}
+
+	void Put64(std::uint8_t* p, std::uint64_t v)
+	{
+		Put32(p, (std::uint32_t)v);
+		Put32(p + 4, (std::uint32_t)(v >> 32));
+	}
+
+	std::uint32_t Get16(const std::uint8_t* p)
+	{
+		return p[0] | ((std::uint32_t)p[1] << 8);
+	}
+
+	std::uint32_t Get32(const std::uint8_t* p)
+	{
+		return Get16(p) | (Get16(p + 2) << 16);
+	}
+
+	std::uint64_t Get64(const std::uint8_t* p)
+	{
+		return Get32(p) | ((std::uint64_t)Get32(p + 4) << 32);
+	}
+
+	void EncodeFrame(const BlockEdit* edits, std::size_t count, std::vector<std::uint8_t>& frame)
+	{
+		frame.assign(BlockJournal::FrameBytes(count), 0);
+		std::uint8_t* p = frame.data() + BlockJournal::FrameHeaderBytes;
+		for (std::size_t i = 0; i < count; ++i, p += BlockJournal::EditBytes)
+		{
+			Put16(p + 0, (std::uint16_t)(std::int16_t)edits[i].ChunkX);
+			Put16(p + 2, (std::uint16_t)(std::int16_t)edits[i].ChunkY);
+			Put16(p + 4, (std::uint16_t)(std::int16_t)edits[i].ChunkZ);
+			Put16(p + 6, (std::uint32_t)edits[i].Index);
+			p[8] = (std::uint8_t)edits[i].Old;
+			p[9] = (std::uint8_t)edits[i].New;
+		}
+
+		Put32(frame.data(), (std::uint32_t)count);
+		Put64(frame.data() + 8, Hash::Fnv1a(frame.data() + BlockJournal::FrameHeaderBytes, count * BlockJournal::EditBytes));
+	}
+
+	bool DecodeEdit(const std::uint8_t* p, BlockEdit& edit)
+	{
+		edit.ChunkX = (std::int16_t)Get16(p + 0);
+		edit.ChunkY = (std::int16_t)Get16(p + 2);
+		edit.ChunkZ = (std::int16_t)Get16(p + 4);
+		edit.Index = (int)Get16(p + 6);
+		edit.Old = (BlockId)p[8];
+		edit.New = (BlockId)p[9];
+		return edit.Index < ChunkVolume && p[8] < (std::uint8_t)BlockId::Count && p[9] < (std::uint8_t)BlockId::Count;
+	}
+}
+
+BlockEdit BlockEdit::At(const World& world, int x, int y, int z, BlockId newId)
+{
+	BlockEdit edit;
+	int wy = y - world.MinY();
+	edit.ChunkX = x / ChunkSize;
+	edit.ChunkY = wy / ChunkSize;
+	edit.ChunkZ = z / ChunkSize;
+	edit.Index = Chunk::Index(x % ChunkSize, wy % ChunkSize, z % ChunkSize);
+	edit.Old = world.Get(x, y, z);
+	edit.New = newId;
+	return edit;
+}
+
+bool BlockJournal::Open(const std::string& path, std::vector<BlockEdit>& edits)
+{
+	Close();
+	mPath = path;
+	edits.clear();
+
+	// A Reset interrupted between removing the old file and renaming the new one, which
+	// builds that did not replace the file in one step could leave behind.
+	std::string temp = path + ".tmp";
+	if (!FileUtil::FileExists(path) && FileUtil::FileExists(temp))
+		FileUtil::RenameOver(temp, path);
+
+	if (!FileUtil::FileExists(path))
+		return Rewrite(edits);
+
+	std::vector<std::uint8_t> bytes;
+	{
+		std::ifstream fin(path.c_str(), std::ios::binary | std::ios::ate);
+		if (!fin)
+			return false;
+		bytes.resize((std::size_t)fin.tellg());
+		fin.seekg(0);
+		if (!fin.read((char*)bytes.data(), bytes.size()))
+			return false;
+	}
+
+	if (bytes.size() < HeaderBytes || std::memcmp(bytes.data(), JournalMagic, sizeof(JournalMagic)) != 0 ||
+		Get32(bytes.data() + 4) != Version)
+	{
+		return false;
+	}
+
+	std::size_t offset = HeaderBytes;
+	while (bytes.size() - offset >= FrameHeaderBytes)
+	{
+		const std::uint8_t* frame = bytes.data() + offset;
+		std::size_t count = Get32(frame);
+		if (count == 0 || count > (bytes.size() - offset - FrameHeaderBytes) / EditBytes || Get32(frame + 4) != 0)
+			break;
+
+		const std::uint8_t* p = frame + FrameHeaderBytes;
+		if (Hash::Fnv1a(p, count * EditBytes) != Get64(frame + 8))
+			break;
+
+		std::size_t kept = edits.size();
+		edits.resize(kept + count);
+		bool valid = true;
+		for (std::size_t i = 0; i < count && valid; ++i, p += EditBytes)
+			valid = DecodeEdit(p, edits[kept + i]);
+		if (!valid)
+		{
+			edits.resize(kept);
+			break;
+		}
+		offset += FrameBytes(count);
+	}
+
+	// Anything after the last good frame would hide the frames appended after it.
+	if (offset != bytes.size())
+		return Rewrite(edits);
+
+	mFile.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	mFileBytes = bytes.size();
+	if (!mFile)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void BlockJournal::Close()
+{
+	if (mFile.is_open())
+		mFile.close();
+	mFile.clear();
+	mFileBytes = 0;
+}
+
+bool BlockJournal::Append(const BlockEdit* edits, std::size_t count)
+{
+	if (count == 0)
+		return true;
+
+	EncodeFrame(edits, count, mFrame);
+	mFile.clear();
+	mFile.seekp(mFileBytes);
+	mFile.write((const char*)mFrame.data(), mFrame.size());
+	mFile.flush();
+	if (!mFile)
+	{
+		mFile.clear();
+		return false;
+	}
+	mFileBytes += mFrame.size();
+	return true;
+}
+
+bool BlockJournal::Reset()
+{
+	return Rewrite(std::vector<BlockEdit>());
+}
+
+bool BlockJournal::Rewrite(const std::vector<BlockEdit>& edits)
+{
+	std::uint8_t header[HeaderBytes] = {};
+	std::memcpy(header, JournalMagic, sizeof(JournalMagic));
+	Put32(header + 4, Version);
+	if (!edits.empty())
+		EncodeFrame(edits.data(), edits.size(), mFrame);
+
+	std::string path = mPath;
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream fout(temp.c_str(), std::ios::binary | std::ios::trunc);
+		fout.write((const char*)header, sizeof(header));
+		if (!edits.empty())
+			fout.write((const char*)mFrame.data(), mFrame.size());
+		if (!fout)
+		{
+			fout.close();
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+
+	Close();
+	mPath = path;
+	if (!FileUtil::RenameOver(temp, path))
+		return false;
+
+	mFile.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	mFileBytes = sizeof(header) + (edits.empty() ? 0 : mFrame.size());
+	return (bool)mFile;
+}
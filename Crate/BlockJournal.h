@@ -0,0 +1,76 @@
+#pragma once
+
+#include "World.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// One block changed: the chunk position, the cell's Chunk index, and the block before
+// and after.  Replaying only needs New; Old is kept so an edit can be undone.
+struct BlockEdit
+{
+	int ChunkX = 0;
+	int ChunkY = 0;
+	int ChunkZ = 0;
+	int Index = 0;
+	BlockId Old = BlockId::Air;
+	BlockId New = BlockId::Air;
+
+	// The edit setting world block (x, y, z) to newId, with Old read from the world.
+	// The block must be inside the world.
+	static BlockEdit At(const World& world, int x, int y, int z, BlockId newId);
+};
+
+// Append-only log of block edits made since the last checkpoint:
+//
+//   header  "CRJN", Version, 8 reserved bytes
+//   frames  u32 edit count, u32 reserved, FNV-1a hash of the edits, then per edit
+//           i16 chunk x, y, z, u16 index, u8 old block, u8 new block
+//
+// Each Append writes one frame and flushes it.  Open keeps the frames before the first
+// one that is cut short, fails its hash or has a nonzero reserved field, which is where a crash mid-append leaves
+// the file, and drops the rest.
+//
+// Not thread safe; WorldSave serializes access.
+class BlockJournal
+{
+public:
+	static const std::uint32_t Version = 1;
+	static const std::size_t HeaderBytes = 16;
+	static const std::size_t FrameHeaderBytes = 16;
+	static const std::size_t EditBytes = 10;
+
+	BlockJournal() = default;
+	BlockJournal(const BlockJournal& rhs) = delete;
+	BlockJournal& operator=(const BlockJournal& rhs) = delete;
+
+	// Opens the journal, creating an empty one if there is none, and returns the edits
+	// it holds in the order they were made.  Returns false if the file cannot be opened
+	// or written.
+	bool Open(const std::string& path, std::vector<BlockEdit>& edits);
+	void Close();
+	bool IsOpen()const { return mFile.is_open(); }
+
+	// Writes the edits as one frame.  Chunk positions must fit in 16 bits.
+	bool Append(const BlockEdit* edits, std::size_t count);
+
+	// Empties the journal once its edits are checkpointed.  The empty journal is
+	// written aside and renamed over the old one, so a crash leaves one or the other.
+	bool Reset();
+
+	std::uint64_t FileBytes()const { return mFileBytes; }
+
+	static std::size_t FrameBytes(std::size_t edits) { return FrameHeaderBytes + edits * EditBytes; }
+
+private:
+	// Writes a journal holding the edits as one frame over mPath and reopens it.
+	bool Rewrite(const std::vector<BlockEdit>& edits);
+
+private:
+	std::string mPath;
+	std::fstream mFile;
+	std::uint64_t mFileBytes = 0;
+	std::vector<std::uint8_t> mFrame;   // reused by Append
+};
@@ -0,0 +1,78 @@
+#include "BlockRegistry.h"
+#include <fstream>
+#include <sstream>
+
+bool BlockRegistry::Find(const std::string& name, BlockId& id)
+{
+	for (int i = 0; i < (int)BlockId::Count; ++i)
+	{
+		if (name == gBlockProperties[i].Name)
+		{
+			id = (BlockId)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool BlockRegistry::Load(const std::string& path, std::string& error)
+{
+	std::ifstream fin(path.c_str());
+	if (!fin)
+	{
+		error = path + ": cannot be read";
+		return false;
+	}
+
+	BlockAppearance appearance[(int)BlockId::Count];
+	bool defined[(int)BlockId::Count] = {};
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(fin, line); ++lineNumber)
+	{
+		std::istringstream fields(line);
+		std::string name;
+		if (!(fields >> name) || name[0] == '#')
+			continue;
+
+		const std::string where = path + ":" + std::to_string(lineNumber) + ": ";
+		BlockId id;
+		if (!Find(name, id))
+		{
+			error = where + "unknown block " + name;
+			return false;
+		}
+		if (GetBlockLayer(id) == BlockLayer::None)
+		{
+			error = where + name + " is never drawn";
+			return false;
+		}
+		if (defined[(int)id])
+		{
+			error = where + name + " is defined twice";
+			return false;
+		}
+
+		BlockAppearance& a = appearance[(int)id];
+		std::string extra;
+		if (!(fields >> a.Texture >> a.Albedo[0] >> a.Albedo[1] >> a.Albedo[2] >> a.Albedo[3]) || (fields >> extra))
+		{
+			error = where + "expected <block> <texture> <albedo r g b a>";
+			return false;
+		}
+		defined[(int)id] = true;
+	}
+
+	for (int i = 0; i < (int)BlockId::Count; ++i)
+	{
+		if (!defined[i] && gBlockProperties[i].Layer != BlockLayer::None)
+		{
+			error = path + ": " + gBlockProperties[i].Name + " is not defined";
+			return false;
+		}
+	}
+
+	for (int i = 0; i < (int)BlockId::Count; ++i)
+		mAppearance[i] = appearance[i];
+	return true;
+}
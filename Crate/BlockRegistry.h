@@ -0,0 +1,37 @@
+#pragma once
+
+#include "World.h"
+#include <string>
+
+// How one block type is drawn.
+struct BlockAppearance
+{
+	std::string Texture;    // name in TextureManifest.txt
+	float Albedo[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+};
+
+// The block types of the game by BlockId: the compiled properties of World.h, and the
+// appearance read from a definition file (Textures/Blocks.txt) with one line per drawn
+// block:
+//
+//   <block name> <texture> <albedo r g b a>
+//
+// Lines starting with '#' are comments.  Every block that is drawn must be defined
+// exactly once; air must not be.  Lookups by BlockId index dense arrays, so nothing
+// after loading hashes or compares strings.
+class BlockRegistry
+{
+public:
+	// False with a message naming the file and line if the file cannot be read or is
+	// not a valid definition; the registry is then left as it was.
+	bool Load(const std::string& path, std::string& error);
+
+	// False for names that are not a block.
+	static bool Find(const std::string& name, BlockId& id);
+
+	const BlockProperties& Properties(BlockId id)const { return GetBlockProperties(id); }
+	const BlockAppearance& Appearance(BlockId id)const { return mAppearance[(int)id]; }
+
+private:
+	BlockAppearance mAppearance[(int)BlockId::Count];
+};
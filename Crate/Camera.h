@@ -11,7 +11,7 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
-#include "Common\d3dUtil.h"
+#include "Common/MathHelper.h"
 
 class Camera
 {
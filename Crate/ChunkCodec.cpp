@@ -0,0 +1,157 @@
+#include "ChunkCodec.h"
+#include "Common/LzCompression.h"
+
+namespace
+{
+	const int ShortRun = 7;   // run length - 1 that says a varint follows
+
+	void PutVarint(std::size_t v, std::vector<std::uint8_t>& out)
+	{
+		while (v >= 0x80)
+		{
+			out.push_back((std::uint8_t)(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((std::uint8_t)v);
+	}
+
+	bool GetVarint(const std::uint8_t*& in, const std::uint8_t* end, std::size_t& v)
+	{
+		v = 0;
+		for (int shift = 0; shift < 35; shift += 7)
+		{
+			if (in == end)
+				return false;
+			std::uint8_t b = *in++;
+			v |= (std::size_t)(b & 0x7f) << shift;
+			if ((b & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+void ChunkCodec::Encode(const Chunk& chunk, std::vector<std::uint8_t>& out)
+{
+	int paletteIndex[(int)BlockId::Count];
+	for (int& p : paletteIndex)
+		p = -1;
+
+	std::vector<std::uint8_t> palette;
+	for (BlockId b : chunk.Blocks)
+	{
+		if (paletteIndex[(int)b] < 0)
+		{
+			paletteIndex[(int)b] = (int)palette.size();
+			palette.push_back((std::uint8_t)b);
+		}
+	}
+
+	out.push_back(Version);
+	out.push_back((std::uint8_t)palette.size());
+	out.insert(out.end(), palette.begin(), palette.end());
+	if (palette.size() == 1)
+		return;
+
+	std::vector<std::uint8_t> runs;
+	for (int i = 0; i < ChunkVolume;)
+	{
+		int start = i;
+		while (i < ChunkVolume && chunk.Blocks[i] == chunk.Blocks[start])
+			++i;
+
+		int extra = i - start - 1;
+		std::uint8_t entry = (std::uint8_t)paletteIndex[(int)chunk.Blocks[start]];
+		if (extra < ShortRun)
+		{
+			runs.push_back((std::uint8_t)(entry | (extra << 5)));
+		}
+		else
+		{
+			runs.push_back((std::uint8_t)(entry | (ShortRun << 5)));
+			PutVarint(extra - ShortRun, runs);
+		}
+	}
+
+	PutVarint(runs.size(), out);
+	std::size_t methodAt = out.size();
+	out.push_back(1);
+	Lz::Compress(runs.data(), runs.size(), out);
+	if (out.size() - methodAt - 1 >= runs.size())
+	{
+		out.resize(methodAt);
+		out.push_back(0);
+		out.insert(out.end(), runs.begin(), runs.end());
+	}
+}
+
+bool ChunkCodec::Decode(const std::uint8_t* data, std::size_t size, Chunk& chunk)
+{
+	const std::uint8_t* in = data;
+	const std::uint8_t* end = data + size;
+	if (size < 2 || in[0] != Version)
+		return false;
+
+	std::size_t paletteSize = in[1];
+	in += 2;
+	if (paletteSize == 0 || paletteSize > (std::size_t)BlockId::Count || paletteSize > (std::size_t)(end - in))
+		return false;
+
+	BlockId palette[(int)BlockId::Count];
+	for (std::size_t p = 0; p < paletteSize; ++p)
+	{
+		if (in[p] >= (std::uint8_t)BlockId::Count)
+			return false;
+		palette[p] = (BlockId)in[p];
+	}
+	in += paletteSize;
+
+	if (paletteSize == 1)
+	{
+		for (BlockId& b : chunk.Blocks)
+			b = palette[0];
+		return in == end;
+	}
+
+	std::size_t runsSize;
+	if (!GetVarint(in, end, runsSize) || in == end || runsSize > 4 * ChunkVolume)
+		return false;
+
+	std::uint8_t method = *in++;
+	std::vector<std::uint8_t> unpacked;
+	const std::uint8_t* runs = in;
+	if (method == 1)
+	{
+		unpacked.resize(runsSize);
+		if (!Lz::Decompress(in, end - in, unpacked.data(), runsSize))
+			return false;
+		runs = unpacked.data();
+	}
+	else if (method != 0 || (std::size_t)(end - in) != runsSize)
+	{
+		return false;
+	}
+
+	const std::uint8_t* run = runs;
+	const std::uint8_t* runsEnd = runs + runsSize;
+	std::size_t cell = 0;
+	while (run < runsEnd)
+	{
+		std::uint8_t b = *run++;
+		std::size_t entry = b & 31;
+		std::size_t length = (b >> 5) + 1;
+		if ((b >> 5) == ShortRun)
+		{
+			std::size_t more;
+			if (!GetVarint(run, runsEnd, more))
+				return false;
+			length += more;
+		}
+
+		if (entry >= paletteSize || length > ChunkVolume - cell)
+			return false;
+		for (std::size_t k = 0; k < length; ++k)
+			chunk.Blocks[cell++] = palette[entry];
+	}
+	return cell == ChunkVolume;
+}
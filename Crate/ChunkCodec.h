@@ -0,0 +1,29 @@
+#pragma once
+
+#include "World.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compact form of one chunk for saving.  The chunk's distinct blocks are listed in a
+// palette; its cells, in Chunk index order, become runs of palette entries, and the
+// runs are LZ compressed when that helps:
+//
+//   u8      format (Version)
+//   u8      palette size N, then N block ids
+//   varint  size of the runs          (only when N > 1)
+//   u8      0 runs stored as is, 1 LZ compressed, then the bytes to the end
+//
+// Each run is a byte holding the palette entry in its low 5 bits and the run length
+// - 1 in its top 3; 7 there means a varint with the rest of the length follows.  A
+// chunk of one block, such as all air or all stone, takes N + 2 bytes.
+namespace ChunkCodec
+{
+	const std::uint8_t Version = 1;
+
+	// Appends the encoded chunk to out.
+	void Encode(const Chunk& chunk, std::vector<std::uint8_t>& out);
+
+	// Returns false if data is not exactly one valid encoded chunk.
+	bool Decode(const std::uint8_t* data, std::size_t size, Chunk& chunk);
+}
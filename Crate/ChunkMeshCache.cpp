@@ -0,0 +1,397 @@
+#include "ChunkMeshCache.h"
+#include "Common/FileUtil.h"
+#include "Common/Hash.h"
+#include "Common/ParallelFor.h"
+#include "Common/Profiler.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	const char MeshMagic[4] = { 'C', 'R', 'M', 'C' };
+
+	struct Header
+	{
+		char Magic[4];
+		std::uint32_t Version;
+		std::uint64_t Key;
+		std::uint32_t VertexCount;
+		std::uint32_t IndexCount;
+		std::uint32_t SubmeshCount;
+		std::uint32_t Reserved;
+	};
+
+	std::uint64_t PayloadBytes(const ChunkMesh& mesh)
+	{
+		return mesh.Vertices.size() * sizeof(ChunkVertex) + mesh.Indices.size() * sizeof(std::uint32_t);
+	}
+
+	std::uint64_t MemoryBytes(const ChunkMesh& mesh)
+	{
+		return sizeof(ChunkMesh) + PayloadBytes(mesh) + mesh.Submeshes.size() * sizeof(ChunkSubmesh);
+	}
+
+	// Meshes one chunk holding every block next to every other, so any change to how
+	// blocks are meshed or culled changes the result.
+	std::uint64_t MesherFingerprint()
+	{
+		World world(ChunkSize, ChunkSize, ChunkSize, 0);
+		Chunk& chunk = world.GetChunk(0, 0, 0);
+		for (int i = 0; i < ChunkVolume; ++i)
+			chunk.Blocks[i] = (BlockId)((i * 7 + i / 5) % (int)BlockId::Count);
+
+		ChunkMesh mesh;
+		ChunkMesher().Build(world, 0, 0, 0, mesh);
+
+		std::uint64_t h = Hash::Combine(Hash::FnvOffsetBasis, (std::uint32_t)ChunkMeshCache::Version);
+		h = Hash::Combine(h, (int)ChunkMesher::Version);
+		h = Hash::Combine(h, (std::uint32_t)sizeof(ChunkVertex));
+		return ChunkMesher::HashMesh(mesh, h);
+	}
+}
+
+std::string ChunkMeshCacheStats::ToString()const
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1) << "Mesh cache: " << Lookups << " lookups, " << HitRate() * 100.0
+		<< "% hit (" << MemoryHits << " memory, " << DiskHits << " disk), " << BytesSaved / (1024.0 * 1024.0)
+		<< " MB saved, " << DiskBytesRead / (1024.0 * 1024.0) << " MB read, " << DiskBytesWritten / (1024.0 * 1024.0)
+		<< " MB written, " << MemoryBytes / (1024.0 * 1024.0) << " MB held\n";
+	return ss.str();
+}
+
+ChunkMeshCache::ChunkMeshCache(const std::string& directory, std::uint64_t memoryBudgetBytes, std::uint64_t diskBudgetBytes) :
+	mDirectory(directory),
+	mMemoryBudget(memoryBudgetBytes),
+	mDiskBudget(diskBudgetBytes),
+	mSalt(MesherFingerprint()),
+	mTempCounter(0)
+{
+	if (mDirectory.empty())
+		return;
+
+	FileUtil::MakeDirectory(mDirectory);
+
+	// A missing or damaged index starts empty; files it no longer lists are left behind.
+	std::ifstream fin(IndexPath().c_str());
+	std::string name;
+	std::uint64_t bytes;
+	while (fin >> name >> bytes)
+	{
+		std::uint64_t key;
+		std::istringstream hex(name);
+		if (name.size() != 16 || !(hex >> std::hex >> key) || mDiskIndex.count(key) != 0)
+			continue;
+		mDisk.push_back(std::make_pair(key, bytes));
+		mDiskIndex[key] = std::prev(mDisk.end());
+		mDiskBytes += bytes;
+	}
+}
+
+ChunkMeshCache::~ChunkMeshCache()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mIndexDirty)
+		SaveIndex();
+}
+
+std::string ChunkMeshCache::MeshPath(std::uint64_t key)const
+{
+	return mDirectory + "/" + Hash::ToHex(key) + ".mesh";
+}
+
+std::string ChunkMeshCache::IndexPath()const
+{
+	return mDirectory + "/index.txt";
+}
+
+std::uint64_t ChunkMeshCache::ComputeKey(const World& world, int cx, int cy, int cz)const
+{
+	std::uint64_t key = Hash::Fnv1a(world.GetChunk(cx, cy, cz).Blocks, sizeof(Chunk), mSalt);
+
+	// Meshing reads the neighbours only where they share a face with the chunk.
+	BlockId border[6][ChunkSize * ChunkSize];
+	int x0 = cx * ChunkSize;
+	int y0 = world.MinY() + cy * ChunkSize;
+	int z0 = cz * ChunkSize;
+	for (int a = 0; a < ChunkSize; ++a)
+	{
+		for (int b = 0; b < ChunkSize; ++b)
+		{
+			int i = a * ChunkSize + b;
+			border[0][i] = world.Get(x0 - 1, y0 + a, z0 + b);
+			border[1][i] = world.Get(x0 + ChunkSize, y0 + a, z0 + b);
+			border[2][i] = world.Get(x0 + a, y0 - 1, z0 + b);
+			border[3][i] = world.Get(x0 + a, y0 + ChunkSize, z0 + b);
+			border[4][i] = world.Get(x0 + a, y0 + b, z0 - 1);
+			border[5][i] = world.Get(x0 + a, y0 + b, z0 + ChunkSize);
+		}
+	}
+	return Hash::Fnv1a(border, sizeof(border), key);
+}
+
+bool ChunkMeshCache::Get(std::uint64_t key, ChunkMesh& mesh)
+{
+	Payload payload;
+	bool onDisk = false;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mStats.Lookups;
+		auto found = mMemoryIndex.find(key);
+		if (found != mMemoryIndex.end())
+		{
+			mMemory.splice(mMemory.begin(), mMemory, found->second);
+			payload = found->second->second;
+			++mStats.MemoryHits;
+			mStats.BytesSaved += PayloadBytes(*payload);
+		}
+		else
+		{
+			onDisk = mDiskIndex.count(key) != 0;
+		}
+	}
+
+	// Files are read outside the lock, so meshing threads only wait on each other for
+	// the bookkeeping.
+	if (onDisk)
+	{
+		std::shared_ptr<ChunkMesh> loaded = std::make_shared<ChunkMesh>();
+		std::uint64_t fileBytes = 0;
+		bool read = ReadMesh(key, *loaded, fileBytes);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto found = mDiskIndex.find(key);
+		if (read)
+		{
+			payload = loaded;
+			++mStats.DiskHits;
+			mStats.DiskBytesRead += fileBytes;
+			mStats.BytesSaved += PayloadBytes(*payload);
+			if (found != mDiskIndex.end())
+				mDisk.splice(mDisk.end(), mDisk, found->second);
+			InsertMemory(key, payload);
+		}
+		else if (found != mDiskIndex.end())
+		{
+			mDiskBytes -= found->second->second;
+			mDisk.erase(found->second);
+			mDiskIndex.erase(found);
+		}
+		mIndexDirty = true;
+	}
+
+	if (payload == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mStats.Misses;
+		return false;
+	}
+
+	mesh.Vertices = payload->Vertices;
+	mesh.Indices = payload->Indices;
+	mesh.Submeshes = payload->Submeshes;
+	return true;
+}
+
+void ChunkMeshCache::Put(std::uint64_t key, const ChunkMesh& mesh)
+{
+	std::shared_ptr<ChunkMesh> payload = std::make_shared<ChunkMesh>();
+	payload->Vertices = mesh.Vertices;
+	payload->Indices = mesh.Indices;
+	payload->Submeshes = mesh.Submeshes;
+
+	bool write;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		InsertMemory(key, payload);
+		write = !mDirectory.empty() && mDiskIndex.count(key) == 0;
+	}
+
+	std::uint64_t fileBytes = 0;
+	if (!write || !WriteMesh(key, *payload, fileBytes))
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mStats.DiskBytesWritten += fileBytes;
+	if (mDiskIndex.count(key) != 0)
+		return;   // another thread wrote the same mesh meanwhile
+
+	mDisk.push_back(std::make_pair(key, fileBytes));
+	mDiskIndex[key] = std::prev(mDisk.end());
+	mDiskBytes += fileBytes;
+	if (mDiskBytes > mDiskBudget)
+	{
+		EvictDisk();
+	}
+	else
+	{
+		std::ofstream fout(IndexPath().c_str(), std::ios::app);
+		fout << Hash::ToHex(key) << " " << fileBytes << "\n";
+	}
+}
+
+std::vector<ChunkMesh> ChunkMeshCache::BuildAll(const World& world, int threadCount)
+{
+	PROFILE_ZONE("ChunkMeshCache::BuildAll");
+
+	std::vector<ChunkMesh> meshes(world.ChunkCount());
+
+	int columns = world.ChunksX() * world.ChunksZ();
+	ParallelFor(0, columns, threadCount, [&](int column)
+	{
+		ChunkMesher mesher;
+		int cx = column % world.ChunksX();
+		int cz = column / world.ChunksX();
+		for (int cy = 0; cy < world.ChunksY(); ++cy)
+		{
+			ChunkMesh& mesh = meshes[cx + world.ChunksX() * (cz + world.ChunksZ() * cy)];
+			std::uint64_t key = ComputeKey(world, cx, cy, cz);
+			if (Get(key, mesh))
+			{
+				mesh.ChunkX = cx;
+				mesh.ChunkY = cy;
+				mesh.ChunkZ = cz;
+				mesh.Origin[0] = (float)(cx * ChunkSize);
+				mesh.Origin[1] = (float)(world.MinY() + cy * ChunkSize);
+				mesh.Origin[2] = (float)(cz * ChunkSize);
+				continue;
+			}
+
+			mesher.Build(world, cx, cy, cz, mesh);
+			Put(key, mesh);
+		}
+	});
+
+	std::vector<ChunkMesh> result;
+	for (ChunkMesh& mesh : meshes)
+	{
+		if (!mesh.Empty())
+			result.push_back(std::move(mesh));
+	}
+	return result;
+}
+
+ChunkMeshCacheStats ChunkMeshCache::Stats()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mStats;
+}
+
+bool ChunkMeshCache::ReadMesh(std::uint64_t key, ChunkMesh& mesh, std::uint64_t& fileBytes)const
+{
+	std::ifstream fin(MeshPath(key).c_str(), std::ios::binary | std::ios::ate);
+	if (!fin)
+		return false;
+	fileBytes = (std::uint64_t)fin.tellg();
+	fin.seekg(0);
+
+	Header header;
+	if (fileBytes < sizeof(header) || !fin.read((char*)&header, sizeof(header)) ||
+		std::memcmp(header.Magic, MeshMagic, sizeof(MeshMagic)) != 0 || header.Version != Version || header.Key != key ||
+		fileBytes != sizeof(header) + (std::uint64_t)header.VertexCount * sizeof(ChunkVertex) +
+			(std::uint64_t)header.IndexCount * sizeof(std::uint32_t) + (std::uint64_t)header.SubmeshCount * sizeof(ChunkSubmeshRecord))
+	{
+		return false;
+	}
+
+	mesh.Vertices.resize(header.VertexCount);
+	mesh.Indices.resize(header.IndexCount);
+	std::vector<ChunkSubmeshRecord> submeshes(header.SubmeshCount);
+	fin.read((char*)mesh.Vertices.data(), mesh.Vertices.size() * sizeof(ChunkVertex));
+	fin.read((char*)mesh.Indices.data(), mesh.Indices.size() * sizeof(std::uint32_t));
+	fin.read((char*)submeshes.data(), submeshes.size() * sizeof(ChunkSubmeshRecord));
+	if (!fin)
+		return false;
+
+	mesh.Submeshes.resize(submeshes.size());
+	for (std::size_t i = 0; i < submeshes.size(); ++i)
+	{
+		if (!submeshes[i].To(header.VertexCount, header.IndexCount, mesh.Submeshes[i]))
+			return false;
+	}
+	return true;
+}
+
+bool ChunkMeshCache::WriteMesh(std::uint64_t key, const ChunkMesh& mesh, std::uint64_t& fileBytes)
+{
+	Header header = {};
+	std::memcpy(header.Magic, MeshMagic, sizeof(MeshMagic));
+	header.Version = Version;
+	header.Key = key;
+	header.VertexCount = (std::uint32_t)mesh.Vertices.size();
+	header.IndexCount = (std::uint32_t)mesh.Indices.size();
+	header.SubmeshCount = (std::uint32_t)mesh.Submeshes.size();
+
+	std::vector<ChunkSubmeshRecord> submeshes;
+	for (const ChunkSubmesh& s : mesh.Submeshes)
+		submeshes.push_back(ChunkSubmeshRecord::From(s));
+
+	// Chunks with the same content can miss on two threads at once, so each write has a
+	// temporary name of its own.
+	std::string path = MeshPath(key);
+	std::string temp = path + "." + std::to_string(mTempCounter.fetch_add(1)) + ".tmp";
+	{
+		std::ofstream fout(temp.c_str(), std::ios::binary | std::ios::trunc);
+		fout.write((const char*)&header, sizeof(header));
+		fout.write((const char*)mesh.Vertices.data(), mesh.Vertices.size() * sizeof(ChunkVertex));
+		fout.write((const char*)mesh.Indices.data(), mesh.Indices.size() * sizeof(std::uint32_t));
+		fout.write((const char*)submeshes.data(), submeshes.size() * sizeof(ChunkSubmeshRecord));
+		if (!fout)
+		{
+			fout.close();
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+
+	fileBytes = sizeof(header) + PayloadBytes(mesh) + submeshes.size() * sizeof(ChunkSubmeshRecord);
+	if (!FileUtil::RenameOver(temp, path))
+	{
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+void ChunkMeshCache::InsertMemory(std::uint64_t key, const Payload& payload)
+{
+	std::uint64_t bytes = MemoryBytes(*payload);
+	if (mMemoryIndex.count(key) != 0 || bytes > mMemoryBudget)
+		return;
+
+	mMemory.push_front(std::make_pair(key, payload));
+	mMemoryIndex[key] = mMemory.begin();
+	mStats.MemoryBytes += bytes;
+
+	while (mStats.MemoryBytes > mMemoryBudget)
+	{
+		mStats.MemoryBytes -= MemoryBytes(*mMemory.back().second);
+		mMemoryIndex.erase(mMemory.back().first);
+		mMemory.pop_back();
+		++mStats.MemoryEvictions;
+	}
+}
+
+void ChunkMeshCache::EvictDisk()
+{
+	while (mDiskBytes > mDiskBudget && !mDisk.empty())
+	{
+		std::remove(MeshPath(mDisk.front().first).c_str());
+		mDiskBytes -= mDisk.front().second;
+		mDiskIndex.erase(mDisk.front().first);
+		mDisk.pop_front();
+		++mStats.DiskEvictions;
+	}
+	SaveIndex();
+}
+
+void ChunkMeshCache::SaveIndex()
+{
+	std::ofstream fout(IndexPath().c_str(), std::ios::trunc);
+	for (const auto& e : mDisk)
+		fout << Hash::ToHex(e.first) << " " << e.second << "\n";
+	mIndexDirty = false;
+}
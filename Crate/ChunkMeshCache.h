@@ -0,0 +1,110 @@
+#pragma once
+
+#include "World.h"
+#include "ChunkMesher.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ChunkMeshCacheStats
+{
+	std::uint64_t Lookups = 0;
+	std::uint64_t MemoryHits = 0;
+	std::uint64_t DiskHits = 0;
+	std::uint64_t Misses = 0;
+	std::uint64_t BytesSaved = 0;          // vertex and index bytes served instead of meshed
+	std::uint64_t DiskBytesRead = 0;
+	std::uint64_t DiskBytesWritten = 0;
+	std::uint64_t MemoryBytes = 0;         // held by the memory tier now
+	std::uint64_t MemoryEvictions = 0;
+	std::uint64_t DiskEvictions = 0;
+
+	double HitRate()const { return (Lookups > 0) ? (double)(MemoryHits + DiskHits) / Lookups : 0.0; }
+	std::string ToString()const;
+};
+
+// Finished chunk meshes, looked up by a hash of everything meshing reads: the chunk's
+// blocks and the cells of its six neighbours that touch it.  Mesh positions are
+// relative to the chunk's origin, so equal content meshes the same anywhere, and a
+// chunk only misses again once it or a neighbour's border changes.
+//
+// The memory tier is an LRU bounded by MemoryBudgetBytes.  The disk tier, when given a
+// directory, keeps one <key>.mesh file per mesh in upload order:
+//
+//   header     "CRMC", Version, key, vertex, index and submesh counts
+//   vertices   ChunkVertex, from byte 32
+//   indices    u32, straight after the vertices
+//   submeshes  block, index count, start index, base vertex
+//
+// so the vertex and index bytes copy into an upload buffer in one piece.  The disk tier
+// evicts the oldest used files past DiskBudgetBytes and lists its files in index.txt.
+// Keys are salted with ChunkMesher::Version and a fingerprint of a test chunk meshed by
+// the running code, so mesher changes never serve stale meshes.
+//
+// Thread safe; meshing threads share one cache.
+class ChunkMeshCache
+{
+public:
+	static const std::uint32_t Version = 1;
+	static const std::uint64_t DefaultMemoryBudgetBytes = 64ull * 1024 * 1024;
+	static const std::uint64_t DefaultDiskBudgetBytes = 256ull * 1024 * 1024;
+
+	// An empty directory keeps the cache in memory only.
+	explicit ChunkMeshCache(const std::string& directory = "",
+		std::uint64_t memoryBudgetBytes = DefaultMemoryBudgetBytes, std::uint64_t diskBudgetBytes = DefaultDiskBudgetBytes);
+	ChunkMeshCache(const ChunkMeshCache& rhs) = delete;
+	ChunkMeshCache& operator=(const ChunkMeshCache& rhs) = delete;
+
+	// Writes the disk index.
+	~ChunkMeshCache();
+
+	std::uint64_t ComputeKey(const World& world, int cx, int cy, int cz)const;
+
+	// Fills the mesh's vertices, indices and submeshes; its position is left alone.
+	bool Get(std::uint64_t key, ChunkMesh& mesh);
+	void Put(std::uint64_t key, const ChunkMesh& mesh);
+
+	// ChunkMesher::BuildAll, taking what it can from the cache and adding the rest.
+	std::vector<ChunkMesh> BuildAll(const World& world, int threadCount = 0);
+
+	std::string MeshPath(std::uint64_t key)const;
+	ChunkMeshCacheStats Stats();
+
+private:
+	typedef std::shared_ptr<const ChunkMesh> Payload;
+	typedef std::list<std::pair<std::uint64_t, Payload>> MemoryList;
+	typedef std::list<std::pair<std::uint64_t, std::uint64_t>> DiskList;   // key, file bytes
+
+	std::string IndexPath()const;
+
+	bool ReadMesh(std::uint64_t key, ChunkMesh& mesh, std::uint64_t& fileBytes)const;
+	bool WriteMesh(std::uint64_t key, const ChunkMesh& mesh, std::uint64_t& fileBytes);
+
+	// Need mMutex.
+	void InsertMemory(std::uint64_t key, const Payload& payload);
+	void EvictDisk();
+	void SaveIndex();
+
+private:
+	std::string mDirectory;
+	std::uint64_t mMemoryBudget;
+	std::uint64_t mDiskBudget;
+	std::uint64_t mSalt;
+
+	std::mutex mMutex;
+	MemoryList mMemory;                      // most recently used first
+	std::unordered_map<std::uint64_t, MemoryList::iterator> mMemoryIndex;
+	DiskList mDisk;                          // least recently used first
+	std::unordered_map<std::uint64_t, DiskList::iterator> mDiskIndex;
+	std::uint64_t mDiskBytes = 0;
+	bool mIndexDirty = false;
+	ChunkMeshCacheStats mStats;
+
+	std::atomic<std::uint32_t> mTempCounter;
+};
@@ -0,0 +1,262 @@
+#include "ChunkMesher.h"
+#include "Common/Hash.h"
+#include "Common/ParallelFor.h"
+#include "Common/Profiler.h"
+
+namespace
+{
+	struct FaceDesc
+	{
+		int Dir[3];
+		float Corners[4][3];
+		float TexC[4][2];
+	};
+
+	// Same corners, UVs and clockwise winding as GeometryGenerator::CreateBoxGrass.
+	const FaceDesc gFaces[6] =
+	{
+		// front (-z)
+		{ { 0, 0, -1 }, { { -0.5f, -0.5f, -0.5f }, { -0.5f, +0.5f, -0.5f }, { +0.5f, +0.5f, -0.5f }, { +0.5f, -0.5f, -0.5f } },
+		  { { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f } } },
+		// back (+z)
+		{ { 0, 0, +1 }, { { -0.5f, -0.5f, +0.5f }, { +0.5f, -0.5f, +0.5f }, { +0.5f, +0.5f, +0.5f }, { -0.5f, +0.5f, +0.5f } },
+		  { { 1.0f, 1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f } } },
+		// top (+y)
+		{ { 0, +1, 0 }, { { -0.5f, +0.5f, -0.5f }, { -0.5f, +0.5f, +0.5f }, { +0.5f, +0.5f, +0.5f }, { +0.5f, +0.5f, -0.5f } },
+		  { { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f } } },
+		// bottom (-y)
+		{ { 0, -1, 0 }, { { -0.5f, -0.5f, -0.5f }, { +0.5f, -0.5f, -0.5f }, { +0.5f, -0.5f, +0.5f }, { -0.5f, -0.5f, +0.5f } },
+		  { { 1.0f, 1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f } } },
+		// left (-x)
+		{ { -1, 0, 0 }, { { -0.5f, -0.5f, +0.5f }, { -0.5f, +0.5f, +0.5f }, { -0.5f, +0.5f, -0.5f }, { -0.5f, -0.5f, -0.5f } },
+		  { { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f } } },
+		// right (+x)
+		{ { +1, 0, 0 }, { { +0.5f, -0.5f, -0.5f }, { +0.5f, +0.5f, -0.5f }, { +0.5f, +0.5f, +0.5f }, { +0.5f, -0.5f, +0.5f } },
+		  { { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f } } },
+	};
+
+	bool FaceVisible(BlockId block, BlockId neighbour)
+	{
+		if (IsOpaqueBlock(neighbour))
+			return false;
+
+		return !(neighbour == block && GetBlockLayer(block) == BlockLayer::Transparent);
+	}
+}
+
+ChunkSubmeshRecord ChunkSubmeshRecord::From(const ChunkSubmesh& submesh)
+{
+	ChunkSubmeshRecord record = { (std::uint32_t)submesh.Block, submesh.IndexCount, submesh.StartIndex, submesh.BaseVertex };
+	return record;
+}
+
+bool ChunkSubmeshRecord::To(std::uint32_t vertexCount, std::uint32_t indexCount, ChunkSubmesh& submesh)const
+{
+	if (Block >= (std::uint32_t)BlockId::Count || StartIndex > indexCount ||
+		IndexCount > indexCount - StartIndex || BaseVertex > vertexCount)
+	{
+		return false;
+	}
+
+	submesh.Block = (BlockId)Block;
+	submesh.IndexCount = IndexCount;
+	submesh.StartIndex = StartIndex;
+	submesh.BaseVertex = BaseVertex;
+	return true;
+}
+
+void ChunkMesher::Build(const World& world, int cx, int cy, int cz, ChunkMesh& mesh)
+{
+	PROFILE_ZONE("ChunkMesher::Build");
+
+	for (int b = 0; b < (int)BlockId::Count; ++b)
+	{
+		mVertices[b].clear();
+		mIndices[b].clear();
+	}
+
+	const Chunk& chunk = world.GetChunk(cx, cy, cz);
+	int x0 = cx * ChunkSize;
+	int y0 = world.MinY() + cy * ChunkSize;
+	int z0 = cz * ChunkSize;
+
+	for (int y = 0; y < ChunkSize; ++y)
+	{
+		for (int z = 0; z < ChunkSize; ++z)
+		{
+			for (int x = 0; x < ChunkSize; ++x)
+			{
+				BlockId block = chunk.Get(x, y, z);
+				BlockShape shape = GetBlockShape(block);
+				if (shape == BlockShape::None)
+					continue;
+
+				if (shape == BlockShape::Cross)
+				{
+					AddCross((float)x, (float)y, (float)z, block);
+					continue;
+				}
+
+				for (int f = 0; f < 6; ++f)
+				{
+					const int* d = gFaces[f].Dir;
+					int nx = x + d[0], ny = y + d[1], nz = z + d[2];
+
+					// Neighbours inside the chunk are read directly; the rest go through
+					// the world so faces on chunk borders are culled too.
+					BlockId neighbour;
+					if (nx >= 0 && nx < ChunkSize && ny >= 0 && ny < ChunkSize && nz >= 0 && nz < ChunkSize)
+						neighbour = chunk.Get(nx, ny, nz);
+					else
+						neighbour = world.Get(x0 + nx, y0 + ny, z0 + nz);
+
+					if (FaceVisible(block, neighbour))
+						AddFace(f, (float)x, (float)y, (float)z, block);
+				}
+			}
+		}
+	}
+
+	mesh.ChunkX = cx;
+	mesh.ChunkY = cy;
+	mesh.ChunkZ = cz;
+	mesh.Origin[0] = (float)x0;
+	mesh.Origin[1] = (float)y0;
+	mesh.Origin[2] = (float)z0;
+	mesh.Vertices.clear();
+	mesh.Indices.clear();
+	mesh.Submeshes.clear();
+
+	for (int b = 0; b < (int)BlockId::Count; ++b)
+	{
+		if (mIndices[b].empty())
+			continue;
+
+		ChunkSubmesh submesh;
+		submesh.Block = (BlockId)b;
+		submesh.IndexCount = (std::uint32_t)mIndices[b].size();
+		submesh.StartIndex = (std::uint32_t)mesh.Indices.size();
+		submesh.BaseVertex = (std::uint32_t)mesh.Vertices.size();
+		mesh.Submeshes.push_back(submesh);
+
+		mesh.Vertices.insert(mesh.Vertices.end(), mVertices[b].begin(), mVertices[b].end());
+		mesh.Indices.insert(mesh.Indices.end(), mIndices[b].begin(), mIndices[b].end());
+	}
+}
+
+std::vector<ChunkMesh> ChunkMesher::BuildAll(const World& world, int threadCount)
+{
+	PROFILE_ZONE("ChunkMesher::BuildAll");
+
+	std::vector<ChunkMesh> meshes(world.ChunkCount());
+
+	// A mesher per column of chunks reuses its scratch buffers for the whole column.
+	int columns = world.ChunksX() * world.ChunksZ();
+	ParallelFor(0, columns, threadCount, [&](int column)
+	{
+		ChunkMesher mesher;
+		int cx = column % world.ChunksX();
+		int cz = column / world.ChunksX();
+		for (int cy = 0; cy < world.ChunksY(); ++cy)
+			mesher.Build(world, cx, cy, cz, meshes[cx + world.ChunksX() * (cz + world.ChunksZ() * cy)]);
+	});
+
+	std::vector<ChunkMesh> result;
+	for (ChunkMesh& mesh : meshes)
+	{
+		if (!mesh.Empty())
+			result.push_back(std::move(mesh));
+	}
+	return result;
+}
+
+std::uint64_t ChunkMesher::HashMesh(const ChunkMesh& mesh, std::uint64_t h)
+{
+	h = Hash::Combine(h, mesh.ChunkX);
+	h = Hash::Combine(h, mesh.ChunkY);
+	h = Hash::Combine(h, mesh.ChunkZ);
+	h = Hash::Fnv1a(mesh.Origin, sizeof(mesh.Origin), h);
+	h = Hash::Fnv1a(mesh.Vertices.data(), mesh.Vertices.size() * sizeof(ChunkVertex), h);
+	h = Hash::Fnv1a(mesh.Indices.data(), mesh.Indices.size() * sizeof(std::uint32_t), h);
+	for (const ChunkSubmesh& s : mesh.Submeshes)
+	{
+		h = Hash::Combine(h, s.Block);
+		h = Hash::Combine(h, s.IndexCount);
+		h = Hash::Combine(h, s.StartIndex);
+		h = Hash::Combine(h, s.BaseVertex);
+	}
+	return h;
+}
+
+void ChunkMesher::AddFace(int face, float x, float y, float z, BlockId block)
+{
+	const FaceDesc& f = gFaces[face];
+	std::vector<ChunkVertex>& vertices = mVertices[(int)block];
+	std::vector<std::uint32_t>& indices = mIndices[(int)block];
+
+	std::uint32_t base = (std::uint32_t)vertices.size();
+	for (int i = 0; i < 4; ++i)
+	{
+		ChunkVertex v;
+		v.Pos[0] = x + f.Corners[i][0];
+		v.Pos[1] = y + f.Corners[i][1];
+		v.Pos[2] = z + f.Corners[i][2];
+		v.Normal[0] = (float)f.Dir[0];
+		v.Normal[1] = (float)f.Dir[1];
+		v.Normal[2] = (float)f.Dir[2];
+		v.TexC[0] = f.TexC[i][0];
+		v.TexC[1] = f.TexC[i][1];
+		vertices.push_back(v);
+	}
+
+	const std::uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+	for (std::uint32_t i : quad)
+		indices.push_back(base + i);
+}
+
+void ChunkMesher::AddCross(float x, float y, float z, BlockId block)
+{
+	// Two quads along the block's diagonals.  Plants are drawn without culling, so one
+	// side each is enough.
+	const float n = 0.70710678f;
+	const float planes[2][2][2] =
+	{
+		{ { -0.5f, -0.5f }, { +0.5f, +0.5f } },   // (x, z) start and end
+		{ { -0.5f, +0.5f }, { +0.5f, -0.5f } },
+	};
+	const float normals[2][2] = { { n, -n }, { -n, -n } };
+
+	std::vector<ChunkVertex>& vertices = mVertices[(int)block];
+	std::vector<std::uint32_t>& indices = mIndices[(int)block];
+
+	for (int p = 0; p < 2; ++p)
+	{
+		std::uint32_t base = (std::uint32_t)vertices.size();
+		const float corners[4][3] =
+		{
+			{ planes[p][0][0], -0.5f, planes[p][0][1] },
+			{ planes[p][0][0], +0.5f, planes[p][0][1] },
+			{ planes[p][1][0], +0.5f, planes[p][1][1] },
+			{ planes[p][1][0], -0.5f, planes[p][1][1] },
+		};
+		const float texC[4][2] = { { 0.0f, 1.0f }, { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f } };
+
+		for (int i = 0; i < 4; ++i)
+		{
+			ChunkVertex v;
+			v.Pos[0] = x + corners[i][0];
+			v.Pos[1] = y + corners[i][1];
+			v.Pos[2] = z + corners[i][2];
+			v.Normal[0] = normals[p][0];
+			v.Normal[1] = 0.0f;
+			v.Normal[2] = normals[p][1];
+			v.TexC[0] = texC[i][0];
+			v.TexC[1] = texC[i][1];
+			vertices.push_back(v);
+		}
+
+		const std::uint32_t quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (std::uint32_t i : quad)
+			indices.push_back(base + i);
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "World.h"
+#include <cstdint>
+#include <vector>
+
+// Same layout as Vertex in FrameResource.h, without pulling in DirectX.
+struct ChunkVertex
+{
+	float Pos[3];
+	float Normal[3];
+	float TexC[2];
+};
+
+// The faces of one block type.  Indices are relative to BaseVertex.
+struct ChunkSubmesh
+{
+	BlockId Block = BlockId::Air;
+	std::uint32_t IndexCount = 0;
+	std::uint32_t StartIndex = 0;
+	std::uint32_t BaseVertex = 0;
+};
+
+// Geometry of one chunk.  Positions are relative to Origin, the world position of the
+// chunk's first block; block centres sit on integer coordinates like the old boxes did.
+struct ChunkMesh
+{
+	int ChunkX = 0, ChunkY = 0, ChunkZ = 0;
+	float Origin[3] = { 0.0f, 0.0f, 0.0f };
+
+	std::vector<ChunkVertex> Vertices;
+	std::vector<std::uint32_t> Indices;
+	std::vector<ChunkSubmesh> Submeshes;
+
+	std::size_t TriangleCount()const { return Indices.size() / 3; }
+	bool Empty()const { return Indices.empty(); }
+};
+
+// ChunkSubmesh as WorldCache and ChunkMeshCache store it: without its padding, so the
+// file's bytes are all defined.
+struct ChunkSubmeshRecord
+{
+	std::uint32_t Block;
+	std::uint32_t IndexCount;
+	std::uint32_t StartIndex;
+	std::uint32_t BaseVertex;
+
+	static ChunkSubmeshRecord From(const ChunkSubmesh& submesh);
+
+	// False if the record names no block or reaches past a mesh of the given size.
+	bool To(std::uint32_t vertexCount, std::uint32_t indexCount, ChunkSubmesh& submesh)const;
+};
+
+// Turns chunks into one mesh each, emitting only the cube faces that can be seen: a
+// face is skipped when the neighbour is opaque, or is the same transparent block
+// (water next to water).  Plants become two crossed quads.  Keeps scratch buffers
+// between calls, so use one mesher per thread.
+class ChunkMesher
+{
+public:
+	// Bump whenever a change makes the same chunks produce different meshes.
+	static const int Version = 1;
+
+	void Build(const World& world, int cx, int cy, int cz, ChunkMesh& mesh);
+
+	// Meshes every chunk of the world; empty chunks are left out.  threadCount 0 uses
+	// every hardware thread.
+	static std::vector<ChunkMesh> BuildAll(const World& world, int threadCount = 0);
+
+	// Folds a mesh's position, geometry and submeshes into h.  The mesh caches key on
+	// this, so both see a change to the mesher the same way.
+	static std::uint64_t HashMesh(const ChunkMesh& mesh, std::uint64_t h);
+
+private:
+	void AddFace(int face, float x, float y, float z, BlockId block);
+	void AddCross(float x, float y, float z, BlockId block);
+
+private:
+	std::vector<ChunkVertex> mVertices[(int)BlockId::Count];
+	std::vector<std::uint32_t> mIndices[(int)BlockId::Count];
+};
@@ -0,0 +1,294 @@
+#include "AssetArchive.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static_assert(sizeof(ArchiveHeader) == 32, "ArchiveHeader is part of the file format");
+static_assert(sizeof(ArchiveEntry) == 80, "ArchiveEntry is part of the file format");
+static_assert(sizeof(ArchiveSubresource) == 32, "ArchiveSubresource is part of the file format");
+
+namespace
+{
+	const char Magic[4] = { 'C', 'R', 'P', 'K' };
+
+	std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// True if [offset, offset + length) lies within [0, size), without overflowing.
+	bool InRange(std::uint64_t offset, std::uint64_t length, std::uint64_t size)
+	{
+		return offset <= size && length <= size - offset;
+	}
+
+	bool SetError(std::string* error, const std::string& message)
+	{
+		if (error != nullptr)
+			*error = message;
+		return false;
+	}
+}
+
+bool AssetArchive::Open(const std::wstring& path)
+{
+	Close();
+	if (!mFile.Open(path))
+		return false;
+	if (!Load(mFile.Data(), mFile.Size()))
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool AssetArchive::Open(const std::string& path)
+{
+	return Open(std::wstring(path.begin(), path.end()));
+}
+
+bool AssetArchive::Load(const std::uint8_t* data, std::size_t size)
+{
+	mData = data;
+	mSize = size;
+	if (!Validate())
+	{
+		mData = nullptr;
+		mSize = 0;
+		mHeader = nullptr;
+		mEntries = nullptr;
+		mSubresources = nullptr;
+		mNames = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void AssetArchive::Close()
+{
+	Load(nullptr, 0);
+	mFile.Close();
+}
+
+bool AssetArchive::Validate()
+{
+	if (mData == nullptr || mSize < sizeof(ArchiveHeader))
+		return false;
+
+	mHeader = reinterpret_cast<const ArchiveHeader*>(mData);
+	if (std::memcmp(mHeader->Magic, Magic, 4) != 0 || mHeader->Version != Version)
+		return false;
+
+	const std::uint64_t entriesOffset = sizeof(ArchiveHeader);
+	const std::uint64_t entriesSize = (std::uint64_t)mHeader->EntryCount * sizeof(ArchiveEntry);
+	const std::uint64_t subresourcesOffset = entriesOffset + entriesSize;
+	const std::uint64_t subresourcesSize = (std::uint64_t)mHeader->SubresourceCount * sizeof(ArchiveSubresource);
+	if (!InRange(entriesOffset, entriesSize, mSize) ||
+		!InRange(subresourcesOffset, subresourcesSize, mSize) ||
+		!InRange(mHeader->NamesOffset, mHeader->NamesSize, mSize))
+	{
+		return false;
+	}
+
+	mEntries = reinterpret_cast<const ArchiveEntry*>(mData + entriesOffset);
+	mSubresources = reinterpret_cast<const ArchiveSubresource*>(mData + subresourcesOffset);
+	mNames = reinterpret_cast<const char*>(mData + mHeader->NamesOffset);
+
+	for (std::uint32_t i = 0; i < mHeader->EntryCount; ++i)
+	{
+		const ArchiveEntry& entry = mEntries[i];
+		if (i > 0 && entry.NameHash < mEntries[i - 1].NameHash)
+			return false;
+
+		if (!InRange(entry.NameOffset, entry.NameLength, mHeader->NamesSize) ||
+			!InRange(entry.PayloadOffset, entry.PayloadSize, mSize) ||
+			!InRange(entry.FirstSubresource, entry.SubresourceCount, mHeader->SubresourceCount))
+		{
+			return false;
+		}
+
+		if (entry.Kind != ArchiveEntryKind::Texture)
+			continue;
+
+		if (entry.SubresourceCount == 0 || entry.PayloadOffset % PlacementAlignment != 0)
+			return false;
+
+		for (std::uint32_t s = 0; s < entry.SubresourceCount; ++s)
+		{
+			const ArchiveSubresource& sub = mSubresources[entry.FirstSubresource + s];
+			if (sub.RowSize > sub.RowPitch || sub.RowPitch % PitchAlignment != 0 || sub.Offset % PlacementAlignment != 0 ||
+				!InRange(sub.Offset, (std::uint64_t)sub.RowPitch * sub.NumRows * sub.Depth, entry.PayloadSize))
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+const ArchiveEntry* AssetArchive::Find(const std::string& name)const
+{
+	const ArchiveEntry* end = mEntries + EntryCount();
+	const std::uint64_t hash = Hash::Fnv1a(name);
+	const ArchiveEntry* it = std::lower_bound(mEntries, end, hash,
+		[](const ArchiveEntry& entry, std::uint64_t h) { return entry.NameHash < h; });
+
+	for (; it != end && it->NameHash == hash; ++it)
+	{
+		if (it->NameLength == name.size() && std::memcmp(mNames + it->NameOffset, name.data(), name.size()) == 0)
+			return it;
+	}
+	return nullptr;
+}
+
+std::string AssetArchive::Name(const ArchiveEntry& entry)const
+{
+	return std::string(mNames + entry.NameOffset, entry.NameLength);
+}
+
+void AssetArchiveWriter::AddRaw(const std::string& name, const std::uint8_t* data, std::size_t size)
+{
+	PendingEntry pending;
+	pending.Name = name;
+	pending.Entry = ArchiveEntry();
+	pending.Entry.Kind = ArchiveEntryKind::Raw;
+	pending.Payload.assign(data, data + size);
+	mEntries.push_back(std::move(pending));
+}
+
+void AssetArchiveWriter::AddTextureMips(const std::string& name, const ArchiveEntry& entry, const std::vector<SourceMip>& mips)
+{
+	PendingEntry pending;
+	pending.Name = name;
+	pending.Entry = entry;
+	pending.Entry.Kind = ArchiveEntryKind::Texture;
+
+	// Lay the subresources out the way D3D12 copies from an upload buffer.
+	std::uint64_t payloadSize = 0;
+	for (const SourceMip& src : mips)
+	{
+		ArchiveSubresource sub = {};
+		sub.Offset = AlignUp(payloadSize, AssetArchive::PlacementAlignment);
+		sub.RowSize = (std::uint32_t)src.RowPitch;
+		sub.RowPitch = (std::uint32_t)AlignUp(src.RowPitch, AssetArchive::PitchAlignment);
+		sub.NumRows = (std::uint32_t)src.NumRows;
+		sub.Width = (std::uint32_t)src.Width;
+		sub.Height = (std::uint32_t)src.Height;
+		sub.Depth = (std::uint32_t)src.Depth;
+
+		// Block-compressed rows hold four pixel rows; footprints cover whole blocks.
+		if (src.NumRows != src.Height)
+		{
+			sub.Width = (std::uint32_t)AlignUp(src.Width, 4);
+			sub.Height = (std::uint32_t)AlignUp(src.Height, 4);
+		}
+
+		payloadSize = sub.Offset + (std::uint64_t)sub.RowPitch * sub.NumRows * sub.Depth;
+		pending.Subresources.push_back(sub);
+	}
+
+	pending.Payload.assign((std::size_t)payloadSize, 0);
+	for (std::size_t s = 0; s < mips.size(); ++s)
+	{
+		const SourceMip& src = mips[s];
+		const ArchiveSubresource& dst = pending.Subresources[s];
+		const std::uint8_t* srcBits = src.Bits;
+		std::uint8_t* dstBits = pending.Payload.data() + dst.Offset;
+
+		for (std::size_t z = 0; z < src.Depth; ++z)
+		{
+			for (std::size_t y = 0; y < src.NumRows; ++y)
+			{
+				std::memcpy(dstBits + (z * dst.NumRows + y) * dst.RowPitch,
+					srcBits + z * src.SlicePitch + y * src.RowPitch, src.RowPitch);
+			}
+		}
+	}
+
+	mEntries.push_back(std::move(pending));
+}
+
+bool AssetArchiveWriter::Serialize(std::vector<std::uint8_t>& data, std::string* error)const
+{
+	data.clear();
+
+	// The index is sorted by hash so readers can binary search it.
+	std::vector<const PendingEntry*> sorted;
+	for (const PendingEntry& e : mEntries)
+		sorted.push_back(&e);
+	std::sort(sorted.begin(), sorted.end(), [](const PendingEntry* a, const PendingEntry* b)
+	{
+		std::uint64_t ha = Hash::Fnv1a(a->Name);
+		std::uint64_t hb = Hash::Fnv1a(b->Name);
+		return (ha != hb) ? ha < hb : a->Name < b->Name;
+	});
+
+	std::string names;
+	std::uint32_t subresourceCount = 0;
+	for (std::size_t i = 0; i < sorted.size(); ++i)
+	{
+		if (i > 0 && sorted[i]->Name == sorted[i - 1]->Name)
+			return SetError(error, "duplicate entry " + sorted[i]->Name);
+		names += sorted[i]->Name;
+		subresourceCount += (std::uint32_t)sorted[i]->Subresources.size();
+	}
+
+	ArchiveHeader header = {};
+	std::memcpy(header.Magic, Magic, 4);
+	header.Version = AssetArchive::Version;
+	header.EntryCount = (std::uint32_t)sorted.size();
+	header.SubresourceCount = subresourceCount;
+	header.NamesOffset = sizeof(ArchiveHeader) + sorted.size() * sizeof(ArchiveEntry) + subresourceCount * sizeof(ArchiveSubresource);
+	header.NamesSize = (std::uint32_t)names.size();
+
+	std::vector<ArchiveEntry> entries;
+	std::vector<ArchiveSubresource> subresources;
+	std::uint64_t offset = header.NamesOffset + names.size();
+	std::uint32_t nameOffset = 0;
+	for (const PendingEntry* e : sorted)
+	{
+		ArchiveEntry entry = e->Entry;
+		entry.NameHash = Hash::Fnv1a(e->Name);
+		entry.NameOffset = nameOffset;
+		entry.NameLength = (std::uint32_t)e->Name.size();
+		entry.PayloadOffset = AlignUp(offset, AssetArchive::PlacementAlignment);
+		entry.PayloadSize = e->Payload.size();
+		entry.FirstSubresource = (std::uint32_t)subresources.size();
+		entry.SubresourceCount = (std::uint32_t)e->Subresources.size();
+		entries.push_back(entry);
+		subresources.insert(subresources.end(), e->Subresources.begin(), e->Subresources.end());
+
+		nameOffset += entry.NameLength;
+		offset = entry.PayloadOffset + entry.PayloadSize;
+	}
+
+	data.assign((std::size_t)offset, 0);
+	std::memcpy(data.data(), &header, sizeof(header));
+	if (!entries.empty())
+		std::memcpy(data.data() + sizeof(header), entries.data(), entries.size() * sizeof(ArchiveEntry));
+	if (!subresources.empty())
+		std::memcpy(data.data() + sizeof(header) + entries.size() * sizeof(ArchiveEntry),
+			subresources.data(), subresources.size() * sizeof(ArchiveSubresource));
+	std::memcpy(data.data() + header.NamesOffset, names.data(), names.size());
+
+	for (std::size_t i = 0; i < sorted.size(); ++i)
+	{
+		if (!sorted[i]->Payload.empty())
+			std::memcpy(data.data() + entries[i].PayloadOffset, sorted[i]->Payload.data(), sorted[i]->Payload.size());
+	}
+	return true;
+}
+
+bool AssetArchiveWriter::Save(const std::string& path, std::string* error)const
+{
+	std::vector<std::uint8_t> data;
+	if (!Serialize(data, error))
+		return false;
+
+	std::ofstream fout(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!fout.write(reinterpret_cast<const char*>(data.data()), data.size()))
+		return SetError(error, "could not write " + path);
+	return true;
+}
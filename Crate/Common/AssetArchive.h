@@ -0,0 +1,186 @@
+//***************************************************************************************
+// AssetArchive.h
+//
+// A single file packing many assets, read through a memory mapping.  The layout is
+//
+//   ArchiveHeader
+//   ArchiveEntry[EntryCount]             sorted by NameHash, then name
+//   ArchiveSubresource[SubresourceCount]
+//   names                                not null-terminated
+//   payloads                             each starting on a PlacementAlignment boundary
+//
+// A texture payload is already in the layout D3D12 copies from: every subresource
+// starts on a PlacementAlignment boundary and its rows are PitchAlignment apart, so
+// the whole payload can be copied into an upload buffer with one memcpy and each
+// subresource copied to the GPU with CopyTextureRegion from its stored footprint.
+//
+// All values are little-endian.  Tools/AssetPacker.cpp builds archives from a
+// manifest.
+//
+// AssetArchiveWriter::AddTexture lives in AssetArchiveTexture.cpp, the only part that
+// needs DDSLayout and so dxgiformat.h; the rest builds anywhere.
+//***************************************************************************************
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class ArchiveEntryKind : std::uint32_t
+{
+	Raw = 0,
+	Texture = 1,
+};
+
+// Same values as D3D12_RESOURCE_DIMENSION.
+enum class ArchiveDimension : std::uint32_t
+{
+	Texture1D = 2,
+	Texture2D = 3,
+	Texture3D = 4,
+};
+
+struct ArchiveHeader
+{
+	char Magic[4];
+	std::uint32_t Version;
+	std::uint32_t EntryCount;
+	std::uint32_t SubresourceCount;
+	std::uint64_t NamesOffset;
+	std::uint32_t NamesSize;
+	std::uint32_t Reserved;
+};
+
+struct ArchiveEntry
+{
+	std::uint64_t NameHash;       // Hash::Fnv1a of the name
+	std::uint64_t PayloadOffset;  // from the start of the archive
+	std::uint64_t PayloadSize;
+	std::uint32_t NameOffset;     // from ArchiveHeader::NamesOffset
+	std::uint32_t NameLength;
+	ArchiveEntryKind Kind;
+
+	// Textures only; zero for raw entries.
+	std::uint32_t FirstSubresource;
+	std::uint32_t SubresourceCount;
+	ArchiveDimension Dimension;
+	std::uint32_t Format;         // DXGI_FORMAT
+	std::uint32_t Width;
+	std::uint32_t Height;
+	std::uint32_t Depth;
+	std::uint32_t ArraySize;
+	std::uint32_t MipCount;
+	std::uint32_t IsCubeMap;
+	std::uint32_t Reserved;
+};
+
+// A D3D12_SUBRESOURCE_FOOTPRINT plus where it lives in the entry's payload.
+struct ArchiveSubresource
+{
+	std::uint64_t Offset;    // from the start of the payload
+	std::uint32_t RowPitch;  // multiple of PitchAlignment
+	std::uint32_t RowSize;   // bytes of data in each row
+	std::uint32_t NumRows;
+	std::uint32_t Width;     // rounded up to whole blocks for block-compressed formats
+	std::uint32_t Height;
+	std::uint32_t Depth;
+};
+
+class AssetArchive
+{
+public:
+	static const std::uint32_t Version = 1;
+
+	// D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT and D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
+	static const std::uint32_t PlacementAlignment = 512;
+	static const std::uint32_t PitchAlignment = 256;
+
+	AssetArchive() = default;
+	AssetArchive(const AssetArchive& rhs) = delete;
+	AssetArchive& operator=(const AssetArchive& rhs) = delete;
+
+	// Maps the archive.  Returns false if it is missing, of another version, or any
+	// table, name or payload would run past the end of the file.
+	bool Open(const std::wstring& path);
+	bool Open(const std::string& path);
+
+	// The same checks on an archive already in memory, which must outlive this object.
+	bool Load(const std::uint8_t* data, std::size_t size);
+
+	void Close();
+
+	std::uint32_t EntryCount()const { return mHeader != nullptr ? mHeader->EntryCount : 0; }
+	const ArchiveEntry& Entry(std::uint32_t index)const { return mEntries[index]; }
+
+	// Null if there is no entry with this name.
+	const ArchiveEntry* Find(const std::string& name)const;
+
+	std::string Name(const ArchiveEntry& entry)const;
+	const std::uint8_t* Payload(const ArchiveEntry& entry)const { return mData + entry.PayloadOffset; }
+	const ArchiveSubresource* Subresources(const ArchiveEntry& entry)const { return mSubresources + entry.FirstSubresource; }
+
+private:
+	bool Validate();
+
+private:
+	MappedFile mFile;
+	const std::uint8_t* mData = nullptr;
+	std::size_t mSize = 0;
+
+	const ArchiveHeader* mHeader = nullptr;
+	const ArchiveEntry* mEntries = nullptr;
+	const ArchiveSubresource* mSubresources = nullptr;
+	const char* mNames = nullptr;
+};
+
+class AssetArchiveWriter
+{
+public:
+	void AddRaw(const std::string& name, const std::uint8_t* data, std::size_t size);
+
+	// Parses a DDS file and stores its mips in the uploadable layout.  With generateMips,
+	// a single-mip 2D texture of four 8-bit channels gets a full mip chain, box filtered.
+	// Returns false, adding nothing, if the file is not a DDS texture DDSLayout understands.
+	bool AddTexture(const std::string& name, const std::uint8_t* dds, std::size_t size, bool generateMips,
+		std::string* error = nullptr);
+
+	// Returns false if two entries have the same name.
+	bool Serialize(std::vector<std::uint8_t>& data, std::string* error = nullptr)const;
+	bool Save(const std::string& path, std::string* error = nullptr)const;
+
+	std::size_t EntryCount()const { return mEntries.size(); }
+
+private:
+	// One mip to be stored, from the DDS file or generated.
+	struct SourceMip
+	{
+		const std::uint8_t* Bits;
+		std::size_t RowPitch;
+		std::size_t SlicePitch;
+		std::size_t NumRows;
+		std::size_t Width;
+		std::size_t Height;
+		std::size_t Depth;
+	};
+
+	// Lays the mips out the way D3D12 copies from an upload buffer and adds the entry.
+	// The texture fields of entry are kept; Kind is set to Texture.
+	void AddTextureMips(const std::string& name, const ArchiveEntry& entry, const std::vector<SourceMip>& mips);
+
+	// Appends the rest of the mip chain below mips[0], keeping the new levels in storage.
+	static void GenerateMips(std::vector<SourceMip>& mips, std::vector<std::vector<std::uint8_t>>& storage);
+
+private:
+	struct PendingEntry
+	{
+		std::string Name;
+		ArchiveEntry Entry;
+		std::vector<ArchiveSubresource> Subresources;
+		std::vector<std::uint8_t> Payload;
+	};
+
+	std::vector<PendingEntry> mEntries;
+};
@@ -0,0 +1,110 @@
+#include "AssetArchive.h"
+#include "DDSLayout.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Formats GenerateMips can filter: four 8-bit channels, filtered alike.
+	bool CanGenerateMips(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			return true;
+		default:
+			return false;
+		}
+	}
+}
+
+// Appends the rest of the mip chain below mips[0] with a 2x2 box filter.  Odd edges
+// repeat their last texel.  sRGB data is averaged as stored.
+void AssetArchiveWriter::GenerateMips(std::vector<SourceMip>& mips, std::vector<std::vector<std::uint8_t>>& storage)
+{
+	std::size_t width = mips[0].Width;
+	std::size_t height = mips[0].Height;
+	std::size_t levels = 1;
+	for (std::size_t w = width, h = height; w > 1 || h > 1; w = (std::max)(w / 2, (std::size_t)1), h = (std::max)(h / 2, (std::size_t)1))
+		++levels;
+
+	// Reserved up front so the pointers in mips stay valid.
+	storage.reserve(storage.size() + levels - 1);
+	for (std::size_t level = 1; level < levels; ++level)
+	{
+		const SourceMip src = mips.back();
+		std::size_t w = (std::max)(src.Width / 2, (std::size_t)1);
+		std::size_t h = (std::max)(src.Height / 2, (std::size_t)1);
+
+		storage.emplace_back(w * h * 4);
+		std::uint8_t* dst = storage.back().data();
+		for (std::size_t y = 0; y < h; ++y)
+		{
+			const std::uint8_t* row0 = src.Bits + (std::min)(2 * y, src.Height - 1) * src.RowPitch;
+			const std::uint8_t* row1 = src.Bits + (std::min)(2 * y + 1, src.Height - 1) * src.RowPitch;
+			for (std::size_t x = 0; x < w; ++x)
+			{
+				std::size_t x0 = (std::min)(2 * x, src.Width - 1) * 4;
+				std::size_t x1 = (std::min)(2 * x + 1, src.Width - 1) * 4;
+				for (std::size_t c = 0; c < 4; ++c)
+					dst[(y * w + x) * 4 + c] = (std::uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+
+		SourceMip mip = { dst, w * 4, w * h * 4, h, w, h, 1 };
+		mips.push_back(mip);
+	}
+}
+
+bool AssetArchiveWriter::AddTexture(const std::string& name, const std::uint8_t* dds, std::size_t size, bool generateMips, std::string* error)
+{
+	DDSFile file;
+	DDSTextureDesc desc;
+	DDSLayout layout;
+	const char* problem = nullptr;
+	if (ParseDDSFile(dds, size, file) != DDSStatus::Ok)
+		problem = ": not a DDS file";
+	else if (GetDDSTextureDesc(file, desc) != DDSStatus::Ok)
+		problem = ": unsupported DDS format or dimension";
+	else if (ComputeDDSLayout(desc, file.BitSize, 0, layout) != DDSStatus::Ok)
+		problem = ": DDS pixel data is truncated";
+	if (problem != nullptr)
+	{
+		if (error != nullptr)
+			*error = name + problem;
+		return false;
+	}
+
+	std::vector<SourceMip> mips;
+	for (const DDSSubresource& src : layout.Subresources)
+	{
+		SourceMip mip = { file.BitData + src.Offset, src.RowPitch, src.SlicePitch, src.NumRows, src.Width, src.Height, src.Depth };
+		mips.push_back(mip);
+	}
+
+	std::vector<std::vector<std::uint8_t>> generated;
+	if (generateMips && desc.Dimension == DDSDimension::Texture2D && desc.ArraySize == 1 &&
+		layout.MipCount == 1 && CanGenerateMips(desc.Format))
+	{
+		GenerateMips(mips, generated);
+	}
+
+	ArchiveEntry entry = ArchiveEntry();
+	entry.Dimension = (desc.Dimension == DDSDimension::Texture1D) ? ArchiveDimension::Texture1D :
+		(desc.Dimension == DDSDimension::Texture3D) ? ArchiveDimension::Texture3D : ArchiveDimension::Texture2D;
+	entry.Format = (std::uint32_t)desc.Format;
+	entry.Width = (std::uint32_t)layout.Width;
+	entry.Height = (std::uint32_t)layout.Height;
+	entry.Depth = (std::uint32_t)layout.Depth;
+	entry.ArraySize = (std::uint32_t)desc.ArraySize;
+	entry.MipCount = generated.empty() ? (std::uint32_t)layout.MipCount : (std::uint32_t)mips.size();
+	entry.IsCubeMap = desc.IsCubeMap ? 1 : 0;
+	AddTextureMips(name, entry, mips);
+	return true;
+}
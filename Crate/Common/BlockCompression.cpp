@@ -0,0 +1,821 @@
+#include "BlockCompression.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if !defined(BLOCK_COMPRESSION_NO_SIMD) && \
+	(defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define BLOCK_COMPRESSION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// A block's texels channel by channel, so four texels load at once.
+	struct BlockTexels
+	{
+		alignas(16) float C[4][16];
+	};
+
+	void LoadTexels(const std::uint8_t rgba[64], BlockTexels& texels)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+				texels.C[c][i] = rgba[i * 4 + c];
+		}
+	}
+
+	bool sUseSimd = true;
+
+	// For every texel, the palette entry nearest over channels [firstChannel,
+	// firstChannel + channelCount).  Ties go to the lower entry.  Returns the summed
+	// squared distance.
+	float NearestEntriesScalar(const BlockTexels& texels, const float palette[][4], int entries,
+		int firstChannel, int channelCount, std::uint8_t indices[16])
+	{
+		float total = 0.0f;
+		int lastChannel = firstChannel + channelCount;
+		for (int i = 0; i < 16; ++i)
+		{
+			float best = (std::numeric_limits<float>::max)();
+			int bestEntry = 0;
+			for (int e = 0; e < entries; ++e)
+			{
+				float distance = 0.0f;
+				for (int c = firstChannel; c < lastChannel; ++c)
+				{
+					float diff = texels.C[c][i] - palette[e][c];
+					distance = distance + diff * diff;
+				}
+				if (distance < best)
+				{
+					best = distance;
+					bestEntry = e;
+				}
+			}
+			indices[i] = (std::uint8_t)bestEntry;
+			total += best;
+		}
+		return total;
+	}
+
+#if defined(BLOCK_COMPRESSION_SSE2)
+	// NearestEntriesScalar four texels at a time, with the same operations in the same
+	// order so the results match bit for bit.
+	float NearestEntriesSse2(const BlockTexels& texels, const float palette[][4], int entries,
+		int firstChannel, int channelCount, std::uint8_t indices[16])
+	{
+		float total = 0.0f;
+		int lastChannel = firstChannel + channelCount;
+		for (int g = 0; g < 16; g += 4)
+		{
+			__m128 best = _mm_set1_ps((std::numeric_limits<float>::max)());
+			__m128i bestEntry = _mm_setzero_si128();
+			for (int e = 0; e < entries; ++e)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (int c = firstChannel; c < lastChannel; ++c)
+				{
+					__m128 diff = _mm_sub_ps(_mm_load_ps(&texels.C[c][g]), _mm_set1_ps(palette[e][c]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(diff, diff));
+				}
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				best = _mm_min_ps(distance, best);
+				bestEntry = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(e)), _mm_andnot_si128(closer, bestEntry));
+			}
+
+			alignas(16) float errors[4];
+			alignas(16) std::int32_t chosen[4];
+			_mm_store_ps(errors, best);
+			_mm_store_si128((__m128i*)chosen, bestEntry);
+			for (int k = 0; k < 4; ++k)
+			{
+				indices[g + k] = (std::uint8_t)chosen[k];
+				total += errors[k];
+			}
+		}
+		return total;
+	}
+#endif
+
+	float NearestEntries(const BlockTexels& texels, const float palette[][4], int entries,
+		int firstChannel, int channelCount, std::uint8_t indices[16])
+	{
+#if defined(BLOCK_COMPRESSION_SSE2)
+		if (sUseSimd)
+			return NearestEntriesSse2(texels, palette, entries, firstChannel, channelCount, indices);
+#endif
+		return NearestEntriesScalar(texels, palette, entries, firstChannel, channelCount, indices);
+	}
+
+	float Clamp255(float v)
+	{
+		return (std::min)((std::max)(v, 0.0f), 255.0f);
+	}
+
+	// The line through the texels over their first channelCount channels: the mean and
+	// the two ends of the principal axis, found by power iteration on the covariance.
+	// A flat block gives both ends at the mean.
+	void FitLine(const BlockTexels& texels, int channelCount, float end0[4], float end1[4])
+	{
+		float mean[4] = {};
+		for (int c = 0; c < channelCount; ++c)
+		{
+			for (int i = 0; i < 16; ++i)
+				mean[c] += texels.C[c][i];
+			mean[c] /= 16.0f;
+		}
+
+		float cov[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int a = 0; a < channelCount; ++a)
+			{
+				for (int b = a; b < channelCount; ++b)
+					cov[a][b] += (texels.C[a][i] - mean[a]) * (texels.C[b][i] - mean[b]);
+			}
+		}
+		for (int a = 0; a < channelCount; ++a)
+		{
+			for (int b = 0; b < a; ++b)
+				cov[a][b] = cov[b][a];
+		}
+
+		// Start from the row of the channel that varies most.
+		int widest = 0;
+		for (int c = 1; c < channelCount; ++c)
+		{
+			if (cov[c][c] > cov[widest][widest])
+				widest = c;
+		}
+		float axis[4] = {};
+		for (int c = 0; c < channelCount; ++c)
+			axis[c] = cov[widest][c];
+
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = {};
+			float largest = 0.0f;
+			for (int a = 0; a < channelCount; ++a)
+			{
+				for (int b = 0; b < channelCount; ++b)
+					next[a] += cov[a][b] * axis[b];
+				largest = (std::max)(largest, std::fabs(next[a]));
+			}
+			if (largest == 0.0f)
+				break;
+			for (int c = 0; c < channelCount; ++c)
+				axis[c] = next[c] / largest;
+		}
+
+		float length = 0.0f;
+		for (int c = 0; c < channelCount; ++c)
+			length += axis[c] * axis[c];
+		length = std::sqrt(length);
+
+		float lo = 0.0f;
+		float hi = 0.0f;
+		if (length > 0.0f)
+		{
+			for (int c = 0; c < channelCount; ++c)
+				axis[c] /= length;
+
+			lo = (std::numeric_limits<float>::max)();
+			hi = -lo;
+			for (int i = 0; i < 16; ++i)
+			{
+				float t = 0.0f;
+				for (int c = 0; c < channelCount; ++c)
+					t += (texels.C[c][i] - mean[c]) * axis[c];
+				lo = (std::min)(lo, t);
+				hi = (std::max)(hi, t);
+			}
+		}
+
+		for (int c = 0; c < channelCount; ++c)
+		{
+			end0[c] = Clamp255(mean[c] + axis[c] * lo);
+			end1[c] = Clamp255(mean[c] + axis[c] * hi);
+		}
+	}
+
+	// The endpoints that best reproduce the texels when texel i is end0 + weights[indices[i]]
+	// * (end1 - end0).  Returns false, leaving them alone, when the indices do not pin
+	// both ends down.
+	bool RefineLine(const BlockTexels& texels, int firstChannel, int channelCount, const std::uint8_t indices[16],
+		const float* weights, float end0[4], float end1[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float x[4] = {}, y[4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			float w = weights[indices[i]];
+			aa += (1.0f - w) * (1.0f - w);
+			ab += (1.0f - w) * w;
+			bb += w * w;
+			for (int c = firstChannel; c < firstChannel + channelCount; ++c)
+			{
+				x[c] += (1.0f - w) * texels.C[c][i];
+				y[c] += w * texels.C[c][i];
+			}
+		}
+
+		float det = aa * bb - ab * ab;
+		if (std::fabs(det) < 1e-6f)
+			return false;
+
+		for (int c = firstChannel; c < firstChannel + channelCount; ++c)
+		{
+			end0[c] = Clamp255((bb * x[c] - ab * y[c]) / det);
+			end1[c] = Clamp255((aa * y[c] - ab * x[c]) / det);
+		}
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC1 colour
+	//-----------------------------------------------------------------------------------
+
+	std::uint16_t Pack565(const float color[4])
+	{
+		int r = (int)std::floor(color[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)std::floor(color[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)std::floor(color[2] * 31.0f / 255.0f + 0.5f);
+		return (std::uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(std::uint16_t packed, int color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// Four-colour mode: entries 2 and 3 lie a third and two thirds of the way to C1.
+	void ColorPalette(std::uint16_t c0, std::uint16_t c1, bool fourColor, int palette[4][4])
+	{
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			if (fourColor)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+		palette[0][3] = palette[1][3] = palette[2][3] = 255;
+		palette[3][3] = fourColor ? 255 : 0;
+	}
+
+	const float ColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	struct ColorFit
+	{
+		std::uint16_t C0 = 0;
+		std::uint16_t C1 = 0;
+		std::uint8_t Indices[16] = {};
+		float Error = 0.0f;
+	};
+
+	// Quantizes the endpoints and picks indices, keeping C0 > C1 so the block decodes in
+	// four-colour mode.
+	ColorFit EvaluateColor(const BlockTexels& texels, const float end0[4], const float end1[4])
+	{
+		ColorFit fit;
+		fit.C0 = Pack565(end0);
+		fit.C1 = Pack565(end1);
+		if (fit.C0 < fit.C1)
+			std::swap(fit.C0, fit.C1);
+
+		int ints[4][4];
+		ColorPalette(fit.C0, fit.C1, true, ints);
+		float palette[4][4];
+		for (int e = 0; e < 4; ++e)
+		{
+			for (int c = 0; c < 4; ++c)
+				palette[e][c] = (float)ints[e][c];
+		}
+
+		// Equal endpoints decode in three-colour mode; only entry 0 is safe to use.
+		fit.Error = NearestEntries(texels, palette, (fit.C0 == fit.C1) ? 1 : 4, 0, 3, fit.Indices);
+		return fit;
+	}
+
+	ColorFit FitColor(const BlockTexels& texels)
+	{
+		float end0[4], end1[4];
+		FitLine(texels, 3, end0, end1);
+
+		ColorFit best = EvaluateColor(texels, end0, end1);
+		for (int iteration = 0; iteration < 2 && best.Error > 0.0f; ++iteration)
+		{
+			int c0[3], c1[3];
+			Unpack565(best.C0, c0);
+			Unpack565(best.C1, c1);
+			for (int c = 0; c < 3; ++c)
+			{
+				end0[c] = (float)c0[c];
+				end1[c] = (float)c1[c];
+			}
+			if (!RefineLine(texels, 0, 3, best.Indices, ColorWeights, end0, end1))
+				break;
+
+			ColorFit fit = EvaluateColor(texels, end0, end1);
+			if (fit.Error >= best.Error)
+				break;
+			best = fit;
+		}
+		return best;
+	}
+
+	void WriteColor(const ColorFit& fit, std::uint8_t* block)
+	{
+		std::uint32_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= (std::uint32_t)fit.Indices[i] << (2 * i);
+
+		block[0] = (std::uint8_t)fit.C0;
+		block[1] = (std::uint8_t)(fit.C0 >> 8);
+		block[2] = (std::uint8_t)fit.C1;
+		block[3] = (std::uint8_t)(fit.C1 >> 8);
+		for (int b = 0; b < 4; ++b)
+			block[4 + b] = (std::uint8_t)(bits >> (8 * b));
+	}
+
+	void DecodeColor(const std::uint8_t* block, bool alwaysFourColor, std::uint8_t rgba[64])
+	{
+		std::uint16_t c0 = (std::uint16_t)(block[0] | (block[1] << 8));
+		std::uint16_t c1 = (std::uint16_t)(block[2] | (block[3] << 8));
+		std::uint32_t bits = block[4] | (block[5] << 8) | (block[6] << 16) | ((std::uint32_t)block[7] << 24);
+
+		int palette[4][4];
+		ColorPalette(c0, c1, alwaysFourColor || c0 > c1, palette);
+		for (int i = 0; i < 16; ++i)
+		{
+			const int* entry = palette[(bits >> (2 * i)) & 3];
+			for (int c = 0; c < 4; ++c)
+				rgba[i * 4 + c] = (std::uint8_t)entry[c];
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC3 alpha
+	//-----------------------------------------------------------------------------------
+
+	// a0 > a1 interpolates six values between them; otherwise four, plus 0 and 255.
+	void AlphaPalette(int a0, int a1, int palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if (a0 > a1)
+		{
+			for (int i = 1; i < 7; ++i)
+				palette[1 + i] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+		else
+		{
+			for (int i = 1; i < 5; ++i)
+				palette[1 + i] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	struct AlphaFit
+	{
+		int A0 = 0;
+		int A1 = 0;
+		std::uint8_t Indices[16] = {};
+		float Error = 0.0f;
+	};
+
+	AlphaFit EvaluateAlpha(const BlockTexels& texels, int a0, int a1)
+	{
+		AlphaFit fit;
+		fit.A0 = a0;
+		fit.A1 = a1;
+
+		int ints[8];
+		AlphaPalette(a0, a1, ints);
+		float palette[8][4] = {};
+		for (int e = 0; e < 8; ++e)
+			palette[e][3] = (float)ints[e];
+
+		fit.Error = NearestEntries(texels, palette, 8, 3, 1, fit.Indices);
+		return fit;
+	}
+
+	// Tries six interpolated values spanning the block, then four spanning what is not
+	// already 0 or 255, which suits alpha-tested cut-outs.
+	AlphaFit FitAlpha(const BlockTexels& texels)
+	{
+		int lo = 255, hi = 0;
+		int innerLo = 255, innerHi = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			int a = (int)texels.C[3][i];
+			lo = (std::min)(lo, a);
+			hi = (std::max)(hi, a);
+			if (a != 0 && a != 255)
+			{
+				innerLo = (std::min)(innerLo, a);
+				innerHi = (std::max)(innerHi, a);
+			}
+		}
+
+		AlphaFit best = EvaluateAlpha(texels, hi, lo);
+		if (best.Error > 0.0f && hi > lo)
+		{
+			static const float weights[8] = { 0.0f, 1.0f, 1 / 7.0f, 2 / 7.0f, 3 / 7.0f, 4 / 7.0f, 5 / 7.0f, 6 / 7.0f };
+			float end0[4] = { 0, 0, 0, (float)hi };
+			float end1[4] = { 0, 0, 0, (float)lo };
+			if (RefineLine(texels, 3, 1, best.Indices, weights, end0, end1))
+			{
+				int a0 = (int)std::floor(end0[3] + 0.5f);
+				int a1 = (int)std::floor(end1[3] + 0.5f);
+				if (a0 > a1)
+				{
+					AlphaFit fit = EvaluateAlpha(texels, a0, a1);
+					if (fit.Error < best.Error)
+						best = fit;
+				}
+			}
+		}
+
+		if (best.Error > 0.0f)
+		{
+			if (innerLo > innerHi)
+				innerLo = innerHi = 0;
+			AlphaFit fit = EvaluateAlpha(texels, innerLo, innerHi);
+			if (fit.Error < best.Error)
+				best = fit;
+		}
+		return best;
+	}
+
+	void WriteAlpha(const AlphaFit& fit, std::uint8_t* block)
+	{
+		std::uint64_t bits = 0;
+		for (int i = 0; i < 16; ++i)
+			bits |= (std::uint64_t)fit.Indices[i] << (3 * i);
+
+		block[0] = (std::uint8_t)fit.A0;
+		block[1] = (std::uint8_t)fit.A1;
+		for (int b = 0; b < 6; ++b)
+			block[2 + b] = (std::uint8_t)(bits >> (8 * b));
+	}
+
+	void DecodeAlpha(const std::uint8_t* block, std::uint8_t rgba[64])
+	{
+		std::uint64_t bits = 0;
+		for (int b = 0; b < 6; ++b)
+			bits |= (std::uint64_t)block[2 + b] << (8 * b);
+
+		int palette[8];
+		AlphaPalette(block[0], block[1], palette);
+		for (int i = 0; i < 16; ++i)
+			rgba[i * 4 + 3] = (std::uint8_t)palette[(bits >> (3 * i)) & 7];
+	}
+
+	//-----------------------------------------------------------------------------------
+	// BC7 mode 6
+	//-----------------------------------------------------------------------------------
+
+	const int Mode6Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	const float Mode6Fractions[16] =
+	{
+		0 / 64.0f, 4 / 64.0f, 9 / 64.0f, 13 / 64.0f, 17 / 64.0f, 21 / 64.0f, 26 / 64.0f, 30 / 64.0f,
+		34 / 64.0f, 38 / 64.0f, 43 / 64.0f, 47 / 64.0f, 51 / 64.0f, 55 / 64.0f, 60 / 64.0f, 64 / 64.0f,
+	};
+
+	struct Mode6Fit
+	{
+		int Q0[4] = {};   // 7-bit endpoints
+		int Q1[4] = {};
+		int P0 = 0;
+		int P1 = 0;
+		std::uint8_t Indices[16] = {};
+		float Error = 0.0f;
+	};
+
+	void Mode6Palette(const int q0[4], int p0, const int q1[4], int p1, int palette[16][4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			int v0 = (q0[c] << 1) | p0;
+			int v1 = (q1[c] << 1) | p1;
+			for (int e = 0; e < 16; ++e)
+				palette[e][c] = ((64 - Mode6Weights[e]) * v0 + Mode6Weights[e] * v1 + 32) >> 6;
+		}
+	}
+
+	// Quantizes the endpoints with each choice of p-bits and keeps the closest.
+	Mode6Fit EvaluateMode6(const BlockTexels& texels, const float end0[4], const float end1[4])
+	{
+		Mode6Fit best;
+		best.Error = (std::numeric_limits<float>::max)();
+		for (int pbits = 0; pbits < 4; ++pbits)
+		{
+			Mode6Fit fit;
+			fit.P0 = pbits & 1;
+			fit.P1 = pbits >> 1;
+			for (int c = 0; c < 4; ++c)
+			{
+				fit.Q0[c] = (std::min)((std::max)((int)std::floor((end0[c] - fit.P0) / 2.0f + 0.5f), 0), 127);
+				fit.Q1[c] = (std::min)((std::max)((int)std::floor((end1[c] - fit.P1) / 2.0f + 0.5f), 0), 127);
+			}
+
+			int ints[16][4];
+			Mode6Palette(fit.Q0, fit.P0, fit.Q1, fit.P1, ints);
+			float palette[16][4];
+			for (int e = 0; e < 16; ++e)
+			{
+				for (int c = 0; c < 4; ++c)
+					palette[e][c] = (float)ints[e][c];
+			}
+
+			fit.Error = NearestEntries(texels, palette, 16, 0, 4, fit.Indices);
+			if (fit.Error < best.Error)
+				best = fit;
+		}
+		return best;
+	}
+
+	Mode6Fit FitMode6(const BlockTexels& texels)
+	{
+		float end0[4], end1[4];
+		FitLine(texels, 4, end0, end1);
+
+		Mode6Fit best = EvaluateMode6(texels, end0, end1);
+		for (int iteration = 0; iteration < 2 && best.Error > 0.0f; ++iteration)
+		{
+			if (!RefineLine(texels, 0, 4, best.Indices, Mode6Fractions, end0, end1))
+				break;
+
+			Mode6Fit fit = EvaluateMode6(texels, end0, end1);
+			if (fit.Error >= best.Error)
+				break;
+			best = fit;
+		}
+		return best;
+	}
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::uint8_t* bytes) : mBytes(bytes) { std::memset(mBytes, 0, 16); }
+
+		void Put(std::uint32_t value, int bits)
+		{
+			for (int b = 0; b < bits; ++b, ++mPosition)
+			{
+				if ((value >> b) & 1)
+					mBytes[mPosition / 8] |= (std::uint8_t)(1 << (mPosition % 8));
+			}
+		}
+
+	private:
+		std::uint8_t* mBytes;
+		int mPosition = 0;
+	};
+
+	class BitReader
+	{
+	public:
+		explicit BitReader(const std::uint8_t* bytes) : mBytes(bytes) {}
+
+		std::uint32_t Get(int bits)
+		{
+			std::uint32_t value = 0;
+			for (int b = 0; b < bits; ++b, ++mPosition)
+				value |= (std::uint32_t)((mBytes[mPosition / 8] >> (mPosition % 8)) & 1) << b;
+			return value;
+		}
+
+	private:
+		const std::uint8_t* mBytes;
+		int mPosition = 0;
+	};
+
+	// The first index is stored without its top bit, so it must be below 8; swapping the
+	// endpoints mirrors every index.
+	void WriteMode6(Mode6Fit fit, std::uint8_t* block)
+	{
+		if (fit.Indices[0] >= 8)
+		{
+			for (int c = 0; c < 4; ++c)
+				std::swap(fit.Q0[c], fit.Q1[c]);
+			std::swap(fit.P0, fit.P1);
+			for (int i = 0; i < 16; ++i)
+				fit.Indices[i] = (std::uint8_t)(15 - fit.Indices[i]);
+		}
+
+		BitWriter bits(block);
+		bits.Put(1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			bits.Put(fit.Q0[c], 7);
+			bits.Put(fit.Q1[c], 7);
+		}
+		bits.Put(fit.P0, 1);
+		bits.Put(fit.P1, 1);
+		bits.Put(fit.Indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			bits.Put(fit.Indices[i], 4);
+	}
+
+	void DecodeMode6(const std::uint8_t* block, std::uint8_t rgba[64])
+	{
+		BitReader bits(block);
+		if (bits.Get(7) != (1 << 6))
+		{
+			std::memset(rgba, 0, 64);
+			return;
+		}
+
+		int q0[4], q1[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			q0[c] = (int)bits.Get(7);
+			q1[c] = (int)bits.Get(7);
+		}
+		int p0 = (int)bits.Get(1);
+		int p1 = (int)bits.Get(1);
+
+		int palette[16][4];
+		Mode6Palette(q0, p0, q1, p1, palette);
+		for (int i = 0; i < 16; ++i)
+		{
+			const int* entry = palette[bits.Get(i == 0 ? 3 : 4)];
+			for (int c = 0; c < 4; ++c)
+				rgba[i * 4 + c] = (std::uint8_t)entry[c];
+		}
+	}
+}
+
+bool BlockCompressionHasSimd()
+{
+#if defined(BLOCK_COMPRESSION_SSE2)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void SetBlockCompressionSimd(bool enable)
+{
+	sUseSimd = enable;
+}
+
+const char* BlockFormatName(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1: return "BC1";
+	case BlockFormat::BC3: return "BC3";
+	default:               return "BC7";
+	}
+}
+
+std::size_t BlockBytes(BlockFormat format)
+{
+	return (format == BlockFormat::BC1) ? 8 : 16;
+}
+
+std::size_t CompressedSize(BlockFormat format, std::size_t width, std::size_t height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+void CompressBlock(BlockFormat format, const std::uint8_t rgba[64], std::uint8_t* block)
+{
+	BlockTexels texels;
+	LoadTexels(rgba, texels);
+
+	switch (format)
+	{
+	case BlockFormat::BC1:
+		WriteColor(FitColor(texels), block);
+		break;
+	case BlockFormat::BC3:
+		WriteAlpha(FitAlpha(texels), block);
+		WriteColor(FitColor(texels), block + 8);
+		break;
+	case BlockFormat::BC7:
+		WriteMode6(FitMode6(texels), block);
+		break;
+	}
+}
+
+void DecompressBlock(BlockFormat format, const std::uint8_t* block, std::uint8_t rgba[64])
+{
+	switch (format)
+	{
+	case BlockFormat::BC1:
+		DecodeColor(block, false, rgba);
+		break;
+	case BlockFormat::BC3:
+		DecodeColor(block + 8, true, rgba);
+		DecodeAlpha(block, rgba);
+		break;
+	case BlockFormat::BC7:
+		DecodeMode6(block, rgba);
+		break;
+	}
+}
+
+std::vector<std::uint8_t> CompressImage(BlockFormat format, const RgbaImage& image, int threadCount)
+{
+	std::size_t blocksX = (image.Width + 3) / 4;
+	std::size_t blocksY = (image.Height + 3) / 4;
+	std::size_t blockBytes = BlockBytes(format);
+	std::vector<std::uint8_t> blocks(blocksX * blocksY * blockBytes);
+
+	ParallelFor(0, (int)blocksY, threadCount, [&](int by)
+	{
+		std::uint8_t rgba[64];
+		for (std::size_t bx = 0; bx < blocksX; ++bx)
+		{
+			for (std::size_t i = 0; i < 16; ++i)
+			{
+				std::size_t x = (std::min)(bx * 4 + i % 4, image.Width - 1);
+				std::size_t y = (std::min)(by * 4 + i / 4, image.Height - 1);
+				std::memcpy(rgba + i * 4, &image.Pixels[(y * image.Width + x) * 4], 4);
+			}
+			CompressBlock(format, rgba, &blocks[(by * blocksX + bx) * blockBytes]);
+		}
+	});
+	return blocks;
+}
+
+RgbaImage DecompressImage(BlockFormat format, const std::uint8_t* blocks, std::size_t width, std::size_t height)
+{
+	RgbaImage image;
+	image.Width = width;
+	image.Height = height;
+	image.Pixels.resize(width * height * 4);
+
+	std::size_t blocksX = (width + 3) / 4;
+	std::size_t blocksY = (height + 3) / 4;
+	std::uint8_t rgba[64];
+	for (std::size_t by = 0; by < blocksY; ++by)
+	{
+		for (std::size_t bx = 0; bx < blocksX; ++bx)
+		{
+			DecompressBlock(format, blocks + (by * blocksX + bx) * BlockBytes(format), rgba);
+			for (std::size_t i = 0; i < 16; ++i)
+			{
+				std::size_t x = bx * 4 + i % 4;
+				std::size_t y = by * 4 + i / 4;
+				if (x < width && y < height)
+					std::memcpy(&image.Pixels[(y * width + x) * 4], rgba + i * 4, 4);
+			}
+		}
+	}
+	return image;
+}
+
+double PsnrFromMse(double mse)
+{
+	if (mse <= 0.0)
+		return std::numeric_limits<double>::infinity();
+	return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+ImageError CompareImages(const RgbaImage& a, const RgbaImage& b)
+{
+	double rgb = 0.0;
+	double alpha = 0.0;
+	std::size_t texels = a.Width * a.Height;
+	for (std::size_t i = 0; i < texels; ++i)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			double diff = (double)a.Pixels[i * 4 + c] - (double)b.Pixels[i * 4 + c];
+			(c < 3 ? rgb : alpha) += diff * diff;
+		}
+	}
+
+	ImageError error;
+	if (texels > 0)
+	{
+		error.RgbMse = rgb / (texels * 3.0);
+		error.AlphaMse = alpha / texels;
+	}
+	error.RgbPsnr = PsnrFromMse(error.RgbMse);
+	error.AlphaPsnr = PsnrFromMse(error.AlphaMse);
+	return error;
+}
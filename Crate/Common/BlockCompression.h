@@ -0,0 +1,70 @@
+//***************************************************************************************
+// BlockCompression.h
+//
+// CPU encoders and decoders for the block-compressed formats the block textures use:
+//
+//   BC1  opaque colour, 8 bytes per 4x4 block, always in four-colour mode
+//   BC3  BC1 colour plus an interpolated alpha block, 16 bytes per block
+//   BC7  mode 6 only: one RGBA line with 7.7.7.7 endpoints, a p-bit per endpoint and
+//        4-bit indices, 16 bytes per block
+//
+// Each block fits its endpoints along the principal axis of its texels, then refines
+// them by least squares against the chosen indices.  Picking the nearest palette entry
+// for every texel is the hot loop; it runs four texels at a time with SSE2 where the
+// compiler targets it, and in plain C++ otherwise (or when
+// BLOCK_COMPRESSION_NO_SIMD is defined).  Both paths give identical output, which
+// Tools/BlockCompressionCheck checks.
+//
+// Images are RGBA, 8 bits per channel, tightly packed.  Decoding only handles what the
+// encoders write; a BC7 block in any mode but 6 decodes to zero.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class BlockFormat
+{
+	BC1,
+	BC3,
+	BC7,
+};
+
+struct RgbaImage
+{
+	std::size_t Width = 0;
+	std::size_t Height = 0;
+	std::vector<std::uint8_t> Pixels;   // Width * Height * 4
+};
+
+struct ImageError
+{
+	double RgbPsnr = 0.0;     // dB over the three colour channels; infinite when exact
+	double AlphaPsnr = 0.0;
+	double RgbMse = 0.0;
+	double AlphaMse = 0.0;
+};
+
+// True if the SSE2 path is compiled in.  SetBlockCompressionSimd(false) runs the plain
+// C++ path instead, to compare the two; call it only while nothing is compressing.
+bool BlockCompressionHasSimd();
+void SetBlockCompressionSimd(bool enable);
+
+const char* BlockFormatName(BlockFormat format);
+std::size_t BlockBytes(BlockFormat format);
+std::size_t CompressedSize(BlockFormat format, std::size_t width, std::size_t height);
+
+// rgba is one 4x4 block, row by row.
+void CompressBlock(BlockFormat format, const std::uint8_t rgba[64], std::uint8_t* block);
+void DecompressBlock(BlockFormat format, const std::uint8_t* block, std::uint8_t rgba[64]);
+
+// Blocks row by row.  Edge blocks of sizes not a multiple of 4 repeat the last row and
+// column.  threadCount is as for ParallelFor; 0 uses every core.
+std::vector<std::uint8_t> CompressImage(BlockFormat format, const RgbaImage& image, int threadCount);
+RgbaImage DecompressImage(BlockFormat format, const std::uint8_t* blocks, std::size_t width, std::size_t height);
+
+// a and b must be the same size.
+ImageError CompareImages(const RgbaImage& a, const RgbaImage& b);
+double PsnrFromMse(double mse);
@@ -0,0 +1,376 @@
+#include "BuddyAllocator.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	const std::uint32_t InvalidNode = ~0u;
+
+	std::uint32_t Log2Floor(std::uint64_t v)
+	{
+		std::uint32_t r = 0;
+		while (v >>= 1)
+			++r;
+		return r;
+	}
+
+	std::uint32_t Log2Ceil(std::uint64_t v)
+	{
+		std::uint32_t r = Log2Floor(v);
+		return ((1ull << r) < v) ? r + 1 : r;
+	}
+}
+
+BuddyAllocator::BuddyAllocator(std::uint64_t capacity, std::uint64_t minBlockSize)
+{
+	assert(minBlockSize != 0 && (minBlockSize & (minBlockSize - 1)) == 0);
+
+	mMinBlockSize = minBlockSize;
+
+	// Keep the tree to a sane size; 2^20 leaves is already 2 million nodes.
+	std::uint64_t leaves = capacity / minBlockSize;
+	mMaxOrder = leaves ? std::min<std::uint32_t>(Log2Floor(leaves), 20) : 0;
+	mCapacity = leaves ? (minBlockSize << mMaxOrder) : 0;
+
+	std::size_t nodeCount = (std::size_t(2) << mMaxOrder) - 1;
+	mState.assign(nodeCount, NodeUnused);
+	mCategory.assign(nodeCount, 0);
+	mRequested.assign(nodeCount, 0);
+	mFreePos.assign(nodeCount, InvalidNode);
+	mFreeLists.resize(mMaxOrder + 1);
+
+	if (mCapacity != 0)
+	{
+		mState[0] = NodeFree;
+		PushFree(mMaxOrder, 0);
+	}
+}
+
+std::uint32_t BuddyAllocator::OrderOf(std::uint32_t node)const
+{
+	return mMaxOrder - Log2Floor(std::uint64_t(node) + 1);
+}
+
+std::uint64_t BuddyAllocator::OffsetOf(std::uint32_t node)const
+{
+	std::uint32_t depth = Log2Floor(std::uint64_t(node) + 1);
+	std::uint64_t indexInLevel = (std::uint64_t(node) + 1) - (1ull << depth);
+	return indexInLevel * (mMinBlockSize << (mMaxOrder - depth));
+}
+
+std::uint32_t BuddyAllocator::FindAllocatedNode(std::uint64_t offset)const
+{
+	if (offset >= mCapacity || (offset % mMinBlockSize) != 0)
+		return InvalidNode;
+
+	// Start at the leaf covering offset and walk up while the node still begins at offset.
+	std::uint32_t node = (1u << mMaxOrder) - 1 + std::uint32_t(offset / mMinBlockSize);
+	for (;;)
+	{
+		if (mState[node] == NodeAllocated)
+			return node;
+
+		// Only a left child shares its parent's start offset.
+		if (node == 0 || (node & 1) == 0)
+			return InvalidNode;
+
+		node = (node - 1) / 2;
+	}
+}
+
+void BuddyAllocator::PushFree(std::uint32_t order, std::uint32_t node)
+{
+	mFreePos[node] = (std::uint32_t)mFreeLists[order].size();
+	mFreeLists[order].push_back(node);
+}
+
+void BuddyAllocator::RemoveFree(std::uint32_t order, std::uint32_t node)
+{
+	auto& list = mFreeLists[order];
+	std::uint32_t pos = mFreePos[node];
+	assert(pos < list.size() && list[pos] == node);
+
+	// Swap-remove so the unlink stays O(1).
+	list[pos] = list.back();
+	mFreePos[list[pos]] = pos;
+	list.pop_back();
+	mFreePos[node] = InvalidNode;
+}
+
+std::uint32_t BuddyAllocator::PopFree(std::uint32_t order)
+{
+	auto& list = mFreeLists[order];
+	std::uint32_t node = list.back();
+	list.pop_back();
+	mFreePos[node] = InvalidNode;
+	return node;
+}
+
+std::uint64_t BuddyAllocator::Allocate(std::uint64_t size, std::uint64_t alignment, std::uint32_t category)
+{
+	if (size == 0 || mCapacity == 0)
+		return InvalidOffset;
+
+	// Blocks are aligned to their own size, so a large alignment simply means a larger block.
+	std::uint64_t need = std::max(std::max(size, alignment), mMinBlockSize);
+	std::uint32_t order = Log2Ceil((need + mMinBlockSize - 1) / mMinBlockSize);
+	if (order > mMaxOrder)
+		return InvalidOffset;
+
+	return AllocateOrder(order, size, category < MaxCategories ? category : 0);
+}
+
+std::uint64_t BuddyAllocator::AllocateOrder(std::uint32_t order, std::uint64_t requested, std::uint32_t category)
+{
+	std::uint32_t o = order;
+	while (o <= mMaxOrder && mFreeLists[o].empty())
+		++o;
+
+	if (o > mMaxOrder)
+		return InvalidOffset;
+
+	std::uint32_t node = PopFree(o);
+
+	// Split down to the requested order, keeping the left half and freeing the right.
+	while (o > order)
+	{
+		mState[node] = NodeSplit;
+		std::uint32_t left = 2 * node + 1;
+		std::uint32_t right = 2 * node + 2;
+		--o;
+		mState[right] = NodeFree;
+		PushFree(o, right);
+		node = left;
+	}
+
+	mState[node] = NodeAllocated;
+	mCategory[node] = (std::uint8_t)category;
+	mRequested[node] = requested;
+
+	std::uint64_t blockSize = mMinBlockSize << order;
+	mBytesReserved += blockSize;
+
+	CategoryStats& stats = mStats[category];
+	stats.Allocations++;
+	stats.BytesRequested += requested;
+	stats.BytesReserved += blockSize;
+	stats.PeakBytesReserved = std::max(stats.PeakBytesReserved, stats.BytesReserved);
+
+	return OffsetOf(node);
+}
+
+void BuddyAllocator::Free(std::uint64_t offset)
+{
+	std::uint32_t node = FindAllocatedNode(offset);
+	assert(node != InvalidNode && "BuddyAllocator::Free called with an offset that is not allocated");
+	if (node == InvalidNode)
+		return;
+
+	FreeNode(node);
+}
+
+void BuddyAllocator::FreeNode(std::uint32_t node)
+{
+	std::uint32_t order = OrderOf(node);
+	std::uint64_t blockSize = mMinBlockSize << order;
+
+	CategoryStats& stats = mStats[mCategory[node]];
+	stats.Allocations--;
+	stats.BytesRequested -= mRequested[node];
+	stats.BytesReserved -= blockSize;
+	mBytesReserved -= blockSize;
+
+	ReleaseNode(node);
+}
+
+void BuddyAllocator::ReleaseNode(std::uint32_t node)
+{
+	std::uint32_t order = OrderOf(node);
+
+	mRequested[node] = 0;
+	mCategory[node] = 0;
+
+	// Merge with the buddy for as long as the buddy is free as a whole.
+	while (node != 0)
+	{
+		std::uint32_t buddy = (node & 1) ? node + 1 : node - 1;
+		if (mState[buddy] != NodeFree)
+			break;
+
+		RemoveFree(order, buddy);
+		mState[buddy] = NodeUnused;
+		mState[node] = NodeUnused;
+
+		node = (node - 1) / 2;
+		++order;
+	}
+
+	mState[node] = NodeFree;
+	PushFree(order, node);
+}
+
+std::uint64_t BuddyAllocator::BlockSize(std::uint64_t offset)const
+{
+	std::uint32_t node = FindAllocatedNode(offset);
+	return (node == InvalidNode) ? 0 : (mMinBlockSize << OrderOf(node));
+}
+
+std::uint64_t BuddyAllocator::LargestFreeBlock()const
+{
+	for (std::uint32_t o = mMaxOrder + 1; o-- > 0;)
+	{
+		if (!mFreeLists[o].empty())
+			return mMinBlockSize << o;
+	}
+	return 0;
+}
+
+std::uint32_t BuddyAllocator::Defragment(const MoveCallback& move, std::uint32_t maxMoves)
+{
+	if (!move || maxMoves == 0 || !mMoved.empty())
+		return 0;
+
+	// Visit allocations from the top of the range down; each one is moved into the
+	// lowest free block of its size if that block sits below it.
+	std::vector<std::uint32_t> allocated;
+	for (std::uint32_t n = 0; n < (std::uint32_t)mState.size(); ++n)
+	{
+		if (mState[n] == NodeAllocated)
+			allocated.push_back(n);
+	}
+	std::sort(allocated.begin(), allocated.end(), [this](std::uint32_t a, std::uint32_t b)
+	{
+		return OffsetOf(a) > OffsetOf(b);
+	});
+
+	std::uint32_t moves = 0;
+	for (std::uint32_t src : allocated)
+	{
+		if (moves >= maxMoves)
+			break;
+
+		std::uint32_t order = OrderOf(src);
+		std::uint64_t srcOffset = OffsetOf(src);
+
+		// Lowest free block of at least this order.
+		std::uint32_t best = InvalidNode;
+		std::uint32_t bestOrder = 0;
+		for (std::uint32_t o = order; o <= mMaxOrder; ++o)
+		{
+			for (std::uint32_t n : mFreeLists[o])
+			{
+				if (best == InvalidNode || OffsetOf(n) < OffsetOf(best))
+				{
+					best = n;
+					bestOrder = o;
+				}
+			}
+		}
+
+		if (best == InvalidNode || OffsetOf(best) >= srcOffset)
+			continue;
+
+		std::uint64_t size = mMinBlockSize << order;
+		std::uint64_t dstOffset = OffsetOf(best);
+		std::uint32_t category = mCategory[src];
+		if (!move(srcOffset, dstOffset, size, category))
+			continue;
+
+		// Claim the destination, descending through left children so it stays lowest.
+		RemoveFree(bestOrder, best);
+		std::uint32_t node = best;
+		for (std::uint32_t o = bestOrder; o > order; --o)
+		{
+			mState[node] = NodeSplit;
+			mState[2 * node + 2] = NodeFree;
+			PushFree(o - 1, 2 * node + 2);
+			node = 2 * node + 1;
+		}
+		mState[node] = NodeAllocated;
+		mCategory[node] = mCategory[src];
+		mRequested[node] = mRequested[src];
+
+		// A move keeps the allocation and its size, so the statistics stay as they are.
+		// The old block is held until ReleaseMoved(), since its copy has not run yet.
+		mState[src] = NodeMoved;
+		mRequested[src] = 0;
+		mCategory[src] = 0;
+		mMoved.push_back(src);
+		mBytesMoved += size;
+
+		++moves;
+	}
+
+	return moves;
+}
+
+void BuddyAllocator::ReleaseMoved()
+{
+	for (std::uint32_t node : mMoved)
+		ReleaseNode(node);
+
+	mMoved.clear();
+	mBytesMoved = 0;
+}
+
+bool BuddyAllocator::CheckConsistency()const
+{
+	std::uint64_t reserved = 0;
+	std::uint64_t free = 0;
+	std::uint64_t moved = 0;
+
+	for (std::uint32_t n = 0; n < (std::uint32_t)mState.size(); ++n)
+	{
+		std::uint64_t size = mMinBlockSize << OrderOf(n);
+		bool parentSplit = (n == 0) ? true : (mState[(n - 1) / 2] == NodeSplit);
+
+		switch (mState[n])
+		{
+		case NodeUnused:
+			if (n == 0 && mCapacity != 0)
+				return false;
+			if (n != 0 && parentSplit)
+				return false;
+			break;
+		case NodeFree:
+		{
+			if (!parentSplit)
+				return false;
+			std::uint32_t order = OrderOf(n);
+			std::uint32_t pos = mFreePos[n];
+			if (pos >= mFreeLists[order].size() || mFreeLists[order][pos] != n)
+				return false;
+			// Two free buddies should always have been merged.
+			if (n != 0)
+			{
+				std::uint32_t buddy = (n & 1) ? n + 1 : n - 1;
+				if (mState[buddy] == NodeFree)
+					return false;
+			}
+			free += size;
+			break;
+		}
+		case NodeAllocated:
+			if (!parentSplit)
+				return false;
+			reserved += size;
+			break;
+		case NodeSplit:
+			if (!parentSplit || OrderOf(n) == 0)
+				return false;
+			break;
+		case NodeMoved:
+			if (!parentSplit)
+				return false;
+			moved += size;
+			break;
+		}
+	}
+
+	std::uint64_t listed = 0;
+	for (std::uint32_t o = 0; o <= mMaxOrder; ++o)
+		listed += mFreeLists[o].size() * (mMinBlockSize << o);
+
+	return reserved == mBytesReserved && moved == mBytesMoved && free == listed &&
+		reserved + free + moved == mCapacity;
+}
@@ -0,0 +1,116 @@
+//***************************************************************************************
+// BuddyAllocator.h
+//
+// Power-of-two buddy allocator that hands out offsets into an externally owned range
+// of memory (an ID3D12Heap, a big buffer, ...).  It knows nothing about Direct3D so it
+// can be built and exercised on any platform.
+//
+// Blocks are always aligned to their own size, so any alignment up to the block size
+// is satisfied for free.  Allocations are tagged with a small category index so the
+// owner can keep per-category statistics.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class BuddyAllocator
+{
+public:
+	static const std::uint64_t InvalidOffset = ~0ull;
+	static const std::uint32_t MaxCategories = 8;
+
+	struct CategoryStats
+	{
+		std::uint32_t Allocations = 0;     // live allocations
+		std::uint64_t BytesRequested = 0;  // sum of the sizes callers asked for
+		std::uint64_t BytesReserved = 0;   // sum of the block sizes actually handed out
+		std::uint64_t PeakBytesReserved = 0;
+	};
+
+	// Called by Defragment() for every block it wants to relocate.  Return false to
+	// veto the move (the block then stays where it is).
+	typedef std::function<bool(std::uint64_t srcOffset, std::uint64_t dstOffset,
+		std::uint64_t size, std::uint32_t category)> MoveCallback;
+
+	// capacity is rounded down to minBlockSize * 2^n.  minBlockSize must be a power of two.
+	BuddyAllocator(std::uint64_t capacity, std::uint64_t minBlockSize);
+	BuddyAllocator(const BuddyAllocator& rhs) = delete;
+	BuddyAllocator& operator=(const BuddyAllocator& rhs) = delete;
+
+	// Returns InvalidOffset when no block large enough is free.
+	std::uint64_t Allocate(std::uint64_t size, std::uint64_t alignment = 0, std::uint32_t category = 0);
+	void Free(std::uint64_t offset);
+
+	// Size of the block that starts at offset, or 0 if offset is not an allocation.
+	std::uint64_t BlockSize(std::uint64_t offset)const;
+
+	// Moves up to maxMoves allocations towards the start of the range so that the free
+	// space coalesces into larger blocks.  Returns the number of moves performed.
+	//
+	// The blocks moved out of are not free yet: until ReleaseMoved() they are neither
+	// allocated nor used as a destination, so nothing is placed over a block whose copy
+	// has not run.  A pass does nothing while the previous pass's blocks are held.
+	std::uint32_t Defragment(const MoveCallback& move, std::uint32_t maxMoves);
+
+	// Frees the blocks Defragment() moved out of.  Call once the copies have executed.
+	void ReleaseMoved();
+
+	std::uint64_t Capacity()const      { return mCapacity; }
+	std::uint64_t MinBlockSize()const  { return mMinBlockSize; }
+	std::uint64_t BytesReserved()const { return mBytesReserved; }
+	std::uint64_t BytesMoved()const    { return mBytesMoved; }   // held until ReleaseMoved()
+	std::uint64_t BytesFree()const     { return mCapacity - mBytesReserved - mBytesMoved; }
+
+	// Largest block that could currently be allocated.
+	std::uint64_t LargestFreeBlock()const;
+
+	const CategoryStats& Stats(std::uint32_t category)const { return mStats[category < MaxCategories ? category : 0]; }
+
+	// Validates the internal tree/free-list invariants; used when fuzzing the allocator.
+	bool CheckConsistency()const;
+
+private:
+	enum NodeState : std::uint8_t
+	{
+		NodeUnused = 0, // part of a larger free or allocated block
+		NodeFree,
+		NodeSplit,
+		NodeAllocated,
+		NodeMoved       // moved out of by Defragment, waiting for ReleaseMoved
+	};
+
+	std::uint32_t OrderOf(std::uint32_t node)const;
+	std::uint64_t OffsetOf(std::uint32_t node)const;
+	std::uint32_t FindAllocatedNode(std::uint64_t offset)const;
+
+	void PushFree(std::uint32_t order, std::uint32_t node);
+	void RemoveFree(std::uint32_t order, std::uint32_t node);
+	std::uint32_t PopFree(std::uint32_t order);
+
+	std::uint64_t AllocateOrder(std::uint32_t order, std::uint64_t requested, std::uint32_t category);
+	void FreeNode(std::uint32_t node);
+	void ReleaseNode(std::uint32_t node);   // FreeNode without the statistics
+
+private:
+	std::uint64_t mCapacity = 0;
+	std::uint64_t mMinBlockSize = 0;
+	std::uint32_t mMaxOrder = 0;
+	std::uint64_t mBytesReserved = 0;
+	std::uint64_t mBytesMoved = 0;
+	std::vector<std::uint32_t> mMoved;
+
+	// Implicit binary tree: node 0 is the whole range, children of n are 2n+1 and 2n+2.
+	std::vector<std::uint8_t> mState;
+	std::vector<std::uint8_t> mCategory;
+	std::vector<std::uint64_t> mRequested;
+
+	// One free list per order, plus each free node's position in its list so that a
+	// buddy can be unlinked in O(1) when it is merged.
+	std::vector<std::vector<std::uint32_t>> mFreeLists;
+	std::vector<std::uint32_t> mFreePos;
+
+	CategoryStats mStats[MaxCategories];
+};
@@ -0,0 +1,184 @@
+//***************************************************************************************
+// DDSLayout.h
+//
+// The platform-independent half of DDSTextureLoader: validates a DDS file's headers in
+// place and works out where each subresource lives in its pixel data, without
+// touching D3D.  The loader turns the layout into D3D12_SUBRESOURCE_DATA pointing
+// straight into the file's bytes, whether those were read into memory or mapped.
+//
+// The DDS structures and the format helpers come from DDSTextureLoader.cpp unchanged.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+//--------------------------------------------------------------------------------------
+// Macros
+//--------------------------------------------------------------------------------------
+#ifndef MAKEFOURCC
+    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24 ))
+#endif /* defined(MAKEFOURCC) */
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#pragma pack(push,1)
+
+const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t    size;
+    uint32_t    flags;
+    uint32_t    fourCC;
+    uint32_t    RGBBitCount;
+    uint32_t    RBitMask;
+    uint32_t    GBitMask;
+    uint32_t    BBitMask;
+    uint32_t    ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES ( DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                               DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                               DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ )
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+enum DDS_MISC_FLAGS2
+{
+    DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+};
+
+struct DDS_HEADER
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t        caps;
+    uint32_t        caps2;
+    uint32_t        caps3;
+    uint32_t        caps4;
+    uint32_t        reserved2;
+};
+
+struct DDS_HEADER_DXT10
+{
+    DXGI_FORMAT     dxgiFormat;
+    uint32_t        resourceDimension;
+    uint32_t        miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+    uint32_t        arraySize;
+    uint32_t        miscFlags2;
+};
+
+#pragma pack(pop)
+
+namespace DirectX
+{
+	enum class DDSStatus
+	{
+		Ok,
+		InvalidData,    // not a DDS file, or its headers contradict each other
+		NotSupported,   // a valid file in a format or shape the loader does not handle
+		Truncated,      // the pixel data is shorter than the headers say
+	};
+
+	// Pointers into the caller's copy of the file, valid for as long as it is.
+	struct DDSFile
+	{
+		const DDS_HEADER* Header = nullptr;
+		const DDS_HEADER_DXT10* HeaderDXT10 = nullptr;   // null without the DX10 extension
+		const uint8_t* BitData = nullptr;
+		size_t BitSize = 0;
+	};
+
+	enum class DDSDimension
+	{
+		Texture1D,
+		Texture2D,
+		Texture3D,
+	};
+
+	struct DDSTextureDesc
+	{
+		DDSDimension Dimension = DDSDimension::Texture2D;
+		size_t Width = 0;
+		size_t Height = 0;
+		size_t Depth = 1;
+		size_t MipCount = 1;
+		size_t ArraySize = 1;   // six per cube
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		bool IsCubeMap = false;
+	};
+
+	// One mip of one array slice.  Offset is from DDSFile::BitData; SlicePitch is the
+	// size of one depth slice, as in D3D12_SUBRESOURCE_DATA.
+	struct DDSSubresource
+	{
+		size_t Offset = 0;
+		size_t RowPitch = 0;
+		size_t SlicePitch = 0;
+		size_t NumRows = 0;
+		size_t Width = 0;
+		size_t Height = 0;
+		size_t Depth = 0;
+	};
+
+	// The subresources that will be uploaded, in D3D subresource order (array slice
+	// major, mip minor).  Mips larger than maxsize are skipped, so Width/Height/Depth
+	// are those of the first mip kept and MipCount counts only kept mips.
+	struct DDSLayout
+	{
+		size_t Width = 0;
+		size_t Height = 0;
+		size_t Depth = 0;
+		size_t MipCount = 0;
+		size_t SkipMip = 0;
+		std::vector<DDSSubresource> Subresources;
+	};
+
+	size_t BitsPerPixel(DXGI_FORMAT fmt);
+	void GetSurfaceInfo(size_t width, size_t height, DXGI_FORMAT fmt,
+		size_t* outNumBytes, size_t* outRowBytes, size_t* outNumRows);
+	DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf);
+
+	// Checks the magic number and both headers fit and are sized correctly.
+	DDSStatus ParseDDSFile(const uint8_t* data, size_t size, DDSFile& file);
+
+	// Dimension, size and format from the headers.  Limits of a particular API are
+	// left to the caller.
+	DDSStatus GetDDSTextureDesc(const DDSFile& file, DDSTextureDesc& desc);
+
+	// maxsize 0 keeps every mip.
+	DDSStatus ComputeDDSLayout(const DDSTextureDesc& desc, size_t bitSize, size_t maxsize, DDSLayout& layout);
+}
@@ -25,6 +25,7 @@
 #include <wrl.h>
 #include <d3d11_1.h>
 #include "d3dx12.h"
+#include "DDSLayout.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -92,6 +93,26 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	HRESULT DDSStatusToHResult(_In_ DDSStatus status);
+
+	// Validates a parsed DDS file against the D3D12 limits and describes the texture that
+	// holds its kept mips, for callers that create the resource and upload it themselves.
+	HRESULT GetDDSResourceDesc12(_In_ const DDSFile& file,
+		                         _In_ size_t maxsize,
+		                         _Out_ D3D12_RESOURCE_DESC& resourceDesc,
+		                         _Out_ DDSLayout& layout);
+
+	// Same as CreateDDSTextureFromFile12, but maps the file instead of reading it into a
+	// heap buffer, so the pixel data is copied once, from the mapping into the upload heap.
+	HRESULT CreateDDSTextureFromFileMapped12(_In_ ID3D12Device* device,
+		                                     _In_ ID3D12GraphicsCommandList* cmdList,
+		                                     _In_z_ const wchar_t* szFileName,
+		                                     _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		                                     _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& textureUploadHeap,
+		                                     _In_ size_t maxsize = 0,
+		                                     _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+		                                     );
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
@@ -0,0 +1,139 @@
+#include "DescriptorHeapAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+DescriptorHeapAllocator::DescriptorHeapAllocator(ID3D12Device* device, UINT persistentCapacity, UINT transientPerFrame, UINT frameCount) :
+	md3dDevice(device),
+	mIndices(persistentCapacity, transientPerFrame, frameCount)
+{
+	mDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	EnsureCapacity();
+}
+
+void DescriptorHeapAllocator::EnsureCapacity()
+{
+	if (mIndices.Capacity() <= mHeapCapacity)
+		return;
+
+	UINT capacity = mIndices.Capacity();
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = capacity;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+
+	ComPtr<ID3D12DescriptorHeap> cpuHeap;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(cpuHeap.GetAddressOf())));
+
+	ComPtr<ID3D12DescriptorHeap> gpuHeap;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(gpuHeap.GetAddressOf())));
+
+	// The staging copy lives in system memory, the shader-visible heap on the GPU.
+	UINT64 heapBytes = (UINT64)capacity * mDescriptorSize;
+	mCpuHeapMemory.Reset(MemoryDomain::Cpu, MemoryCategory::Descriptors, heapBytes);
+	mGpuHeapMemory.Reset(MemoryDomain::Gpu, MemoryCategory::Descriptors, heapBytes);
+
+	// Carry the persistent descriptors over.  Their indices do not change, only the
+	// transient ranges after them move.
+	if (mCpuHeap != nullptr && mHeapPersistentCapacity > 0)
+	{
+		md3dDevice->CopyDescriptorsSimple(mHeapPersistentCapacity,
+			cpuHeap->GetCPUDescriptorHandleForHeapStart(),
+			mCpuHeap->GetCPUDescriptorHandleForHeapStart(),
+			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		md3dDevice->CopyDescriptorsSimple(mHeapPersistentCapacity,
+			gpuHeap->GetCPUDescriptorHandleForHeapStart(),
+			mCpuHeap->GetCPUDescriptorHandleForHeapStart(),
+			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	}
+
+	// Frames already submitted may still reference the old shader-visible heap.
+	if (mGpuHeap != nullptr)
+	{
+		RetiredHeap retired;
+		retired.Heap = mGpuHeap;
+		retired.Fence = mLastSubmittedFence;
+		mRetired.push_back(retired);
+	}
+
+	mCpuHeap = cpuHeap;
+	mGpuHeap = gpuHeap;
+	mHeapCapacity = capacity;
+	mHeapPersistentCapacity = mIndices.PersistentCapacity();
+}
+
+UINT DescriptorHeapAllocator::CreateSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
+{
+	UINT index = mIndices.AllocatePersistent();
+	EnsureCapacity();
+
+	WriteSrv(index, resource, desc);
+	return index;
+}
+
+UINT DescriptorHeapAllocator::ReplaceSrv(UINT index, ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
+{
+	// A shader-visible descriptor must not change while submitted frames can read it, so
+	// the new view goes to another slot and the old one is recycled at the fence.
+	UINT replacement = CreateSrv(resource, desc);
+	Free(index, mLastSubmittedFence);
+	return replacement;
+}
+
+void DescriptorHeapAllocator::WriteSrv(UINT index, ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc)
+{
+	CD3DX12_CPU_DESCRIPTOR_HANDLE cpuHandle(mCpuHeap->GetCPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+	md3dDevice->CreateShaderResourceView(resource, desc, cpuHandle);
+
+	// Shader-visible heaps are write-combined, so write once on the CPU side and copy.
+	md3dDevice->CopyDescriptorsSimple(1, CpuHandle(index), cpuHandle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void DescriptorHeapAllocator::Free(UINT index, UINT64 fence)
+{
+	mIndices.FreePersistent(index, fence);
+}
+
+void DescriptorHeapAllocator::BeginFrame(UINT frameIndex, UINT64 completedFence)
+{
+	mIndices.CompletedFence(completedFence);
+	mIndices.BeginFrame(frameIndex);
+
+	for (size_t i = 0; i < mRetired.size();)
+	{
+		if (mRetired[i].Fence <= completedFence)
+		{
+			mRetired[i] = mRetired.back();
+			mRetired.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void DescriptorHeapAllocator::EndFrame(UINT64 fence)
+{
+	mLastSubmittedFence = fence;
+}
+
+UINT DescriptorHeapAllocator::AllocateTransient(UINT count, CD3DX12_CPU_DESCRIPTOR_HANDLE& cpuHandle)
+{
+	UINT index = mIndices.AllocateTransient(count);
+	if (index != DescriptorIndexAllocator::InvalidIndex)
+		cpuHandle = CpuHandle(index);
+
+	return index;
+}
+
+CD3DX12_GPU_DESCRIPTOR_HANDLE DescriptorHeapAllocator::GpuHandle(UINT index)const
+{
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(mGpuHeap->GetGPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+}
+
+CD3DX12_CPU_DESCRIPTOR_HANDLE DescriptorHeapAllocator::CpuHandle(UINT index)const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(mGpuHeap->GetCPUDescriptorHandleForHeapStart(), index, mDescriptorSize);
+}
@@ -0,0 +1,76 @@
+//***************************************************************************************
+// DescriptorHeapAllocator.h
+//
+// Shader-visible CBV/SRV/UAV heap driven by a DescriptorIndexAllocator.  Persistent
+// descriptors are written to a CPU-only heap first and copied to the shader-visible
+// heap, so that when the persistent range fills up both heaps can be recreated at
+// twice the size without losing what was already there.
+//
+// Persistent descriptors must be created or replaced before the frame's command list
+// binds Heap(): growing the heap swaps the heap that Heap() returns.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "DescriptorIndexAllocator.h"
+
+class DescriptorHeapAllocator
+{
+public:
+	DescriptorHeapAllocator(ID3D12Device* device, UINT persistentCapacity, UINT transientPerFrame, UINT frameCount);
+	DescriptorHeapAllocator(const DescriptorHeapAllocator& rhs) = delete;
+	DescriptorHeapAllocator& operator=(const DescriptorHeapAllocator& rhs) = delete;
+
+	// Creates a persistent SRV and returns its stable heap index.  A null desc uses the
+	// resource's default view, like ID3D12Device::CreateShaderResourceView.
+	UINT CreateSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc);
+
+	// Writes a changed view (e.g. a new MinLOD) to a fresh persistent index, and frees
+	// index behind the frames already submitted, which may still be reading it.  Returns
+	// the new index; bind that from the next recorded draw on.
+	UINT ReplaceSrv(UINT index, ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc);
+
+	// The index can be reused once the GPU has passed fence.
+	void Free(UINT index, UINT64 fence);
+
+	// Call once the current frame resource's fence has been waited on.
+	void BeginFrame(UINT frameIndex, UINT64 completedFence);
+	// Call after the frame's commands were submitted with their fence value.
+	void EndFrame(UINT64 fence);
+
+	// Allocates count contiguous descriptors valid for the current frame only.  The CPU
+	// handle can be written directly with CreateShaderResourceView and friends.
+	UINT AllocateTransient(UINT count, CD3DX12_CPU_DESCRIPTOR_HANDLE& cpuHandle);
+
+	ID3D12DescriptorHeap* Heap()const { return mGpuHeap.Get(); }
+	CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index)const;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index)const;
+
+	const DescriptorIndexAllocator& Indices()const { return mIndices; }
+
+private:
+	void EnsureCapacity();
+	void WriteSrv(UINT index, ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc);
+
+private:
+	struct RetiredHeap
+	{
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Heap;
+		UINT64 Fence;
+	};
+
+	ID3D12Device* md3dDevice = nullptr;
+	UINT mDescriptorSize = 0;
+	UINT mHeapCapacity = 0;
+	UINT mHeapPersistentCapacity = 0;
+	UINT64 mLastSubmittedFence = 0;
+
+	DescriptorIndexAllocator mIndices;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mCpuHeap;
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mGpuHeap;
+	TrackedMemory mCpuHeapMemory;
+	TrackedMemory mGpuHeapMemory;
+	std::vector<RetiredHeap> mRetired;
+};
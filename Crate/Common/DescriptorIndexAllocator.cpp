@@ -0,0 +1,69 @@
+#include "DescriptorIndexAllocator.h"
+#include <cassert>
+
+DescriptorIndexAllocator::DescriptorIndexAllocator(std::uint32_t persistentCapacity, std::uint32_t transientPerFrame, std::uint32_t frameCount) :
+	mPersistentCapacity(persistentCapacity ? persistentCapacity : 1),
+	mTransientPerFrame(transientPerFrame),
+	mFrameCount(frameCount ? frameCount : 1)
+{
+}
+
+std::uint32_t DescriptorIndexAllocator::AllocatePersistent()
+{
+	if (!mFree.empty())
+	{
+		std::uint32_t index = mFree.back();
+		mFree.pop_back();
+		return index;
+	}
+
+	if (mPersistentHighWater == mPersistentCapacity)
+		mPersistentCapacity *= 2;
+
+	return mPersistentHighWater++;
+}
+
+void DescriptorIndexAllocator::FreePersistent(std::uint32_t index, std::uint64_t fence)
+{
+	assert(index < mPersistentHighWater);
+
+	PendingFree pending;
+	pending.Index = index;
+	pending.Fence = fence;
+	mPendingFree.push_back(pending);
+}
+
+void DescriptorIndexAllocator::CompletedFence(std::uint64_t completedFence)
+{
+	for (std::size_t i = 0; i < mPendingFree.size();)
+	{
+		if (mPendingFree[i].Fence <= completedFence)
+		{
+			mFree.push_back(mPendingFree[i].Index);
+			mPendingFree[i] = mPendingFree.back();
+			mPendingFree.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+void DescriptorIndexAllocator::BeginFrame(std::uint32_t frameIndex)
+{
+	assert(frameIndex < mFrameCount);
+
+	mCurrentFrame = frameIndex;
+	mTransientCursor = 0;
+}
+
+std::uint32_t DescriptorIndexAllocator::AllocateTransient(std::uint32_t count)
+{
+	if (count == 0 || mTransientCursor + count > mTransientPerFrame)
+		return InvalidIndex;
+
+	std::uint32_t index = mPersistentCapacity + mCurrentFrame * mTransientPerFrame + mTransientCursor;
+	mTransientCursor += count;
+	return index;
+}
@@ -0,0 +1,68 @@
+//***************************************************************************************
+// DescriptorIndexAllocator.h
+//
+// Index bookkeeping for a CBV/SRV/UAV descriptor heap, kept free of Direct3D so it can
+// be tested without a device.  The heap is laid out as
+//
+//   [ persistent descriptors | frame 0 transient | frame 1 transient | ... ]
+//
+// Persistent indices come from a free list and never move once handed out.  Freed
+// persistent indices are only recycled after the GPU has passed the fence they were
+// retired on.  Each frame resource owns a linear transient range that is rewound when
+// that frame resource comes round again.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class DescriptorIndexAllocator
+{
+public:
+	static const std::uint32_t InvalidIndex = ~0u;
+
+	DescriptorIndexAllocator(std::uint32_t persistentCapacity, std::uint32_t transientPerFrame, std::uint32_t frameCount);
+
+	// Never fails; the persistent range doubles when it is full.  Check Capacity()
+	// afterwards to see whether the backing heap has to grow.
+	std::uint32_t AllocatePersistent();
+
+	// The index becomes reusable once CompletedFence(fence) has been called.
+	void FreePersistent(std::uint32_t index, std::uint64_t fence);
+	void CompletedFence(std::uint64_t completedFence);
+
+	// Rewinds frameIndex's transient range.  Only call once the GPU is done with the
+	// commands that last used this frame resource.
+	void BeginFrame(std::uint32_t frameIndex);
+
+	// Returns the first of count contiguous indices in the current frame's range, or
+	// InvalidIndex if the range is exhausted.
+	std::uint32_t AllocateTransient(std::uint32_t count = 1);
+
+	bool IsPersistent(std::uint32_t index)const { return index < mPersistentCapacity; }
+
+	std::uint32_t Capacity()const            { return mPersistentCapacity + mFrameCount * mTransientPerFrame; }
+	std::uint32_t PersistentCapacity()const  { return mPersistentCapacity; }
+	std::uint32_t PersistentInUse()const     { return mPersistentHighWater - (std::uint32_t)mFree.size() - (std::uint32_t)mPendingFree.size(); }
+	std::uint32_t TransientInUse()const      { return mTransientCursor; }
+	std::uint32_t TransientPerFrame()const   { return mTransientPerFrame; }
+	std::uint32_t CurrentFrame()const        { return mCurrentFrame; }
+
+private:
+	struct PendingFree
+	{
+		std::uint32_t Index;
+		std::uint64_t Fence;
+	};
+
+	std::uint32_t mPersistentCapacity = 0;
+	std::uint32_t mPersistentHighWater = 0; // indices below this have been handed out at least once
+	std::vector<std::uint32_t> mFree;
+	std::vector<PendingFree> mPendingFree;
+
+	std::uint32_t mTransientPerFrame = 0;
+	std::uint32_t mFrameCount = 0;
+	std::uint32_t mCurrentFrame = 0;
+	std::uint32_t mTransientCursor = 0;
+};
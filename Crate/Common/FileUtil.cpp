@@ -0,0 +1,36 @@
+#include "FileUtil.h"
+#include <cstdio>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+bool FileUtil::FileExists(const std::string& path)
+{
+	std::ifstream fin(path.c_str(), std::ios::binary);
+	return (bool)fin;
+}
+
+void FileUtil::MakeDirectory(const std::string& path)
+{
+#if defined(_WIN32)
+	_mkdir(path.c_str());
+#else
+	mkdir(path.c_str(), 0755);
+#endif
+}
+
+bool FileUtil::RenameOver(const std::string& from, const std::string& to)
+{
+#if defined(_WIN32)
+	// std::rename fails if to exists, and removing it first would leave a window in
+	// which neither file is there.
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
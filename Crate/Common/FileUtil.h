@@ -0,0 +1,24 @@
+//***************************************************************************************
+// FileUtil.h
+//
+// File system helpers shared by the save, journal and cache code.
+//***************************************************************************************
+
+#pragma once
+
+#include <string>
+
+namespace FileUtil
+{
+	// True if path names a file that can be opened for reading.
+	bool FileExists(const std::string& path);
+
+	// Creates one directory level; an existing directory is left as it is.
+	void MakeDirectory(const std::string& path);
+
+	// Renames from over to, replacing to if it exists.  Used to publish a file written
+	// under a temporary name, so to is either the old file or the new one, never neither.
+	// Uses MoveFileExA with MOVEFILE_WRITE_THROUGH on Windows and std::rename elsewhere.
+	// Not called ReplaceFile, which Windows.h defines as a macro.
+	bool RenameOver(const std::string& from, const std::string& to);
+}
@@ -0,0 +1,200 @@
+//***************************************************************************************
+// FramePipeline.h
+//
+// Runs the simulation one frame ahead of rendering on its own thread.  While the render
+// thread records frame N from snapshot N, the simulation thread builds snapshot N+1 from
+// the input the render thread handed over when frame N began.
+//
+// Snapshots are double-buffered and handed over through two atomic frame counters, so
+// when the other thread is already done neither thread takes a lock.  The simulation
+// only ever writes slot (N+1)%2 while the render thread reads slot N%2, and the render
+// thread does not start frame N+1 until snapshot N+1 is published.  A thread that has to
+// wait spins briefly, then sleeps on a condition variable until the counter it waits
+// for moves, so a GPU- or vsync-bound frame does not keep the simulation thread busy.
+//***************************************************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct FramePipelineStats
+{
+	std::uint64_t Frames = 0;
+	double SimulationMs = 0.0;   // time the simulation thread spent simulating
+	double RenderMs = 0.0;       // BeginFrame to EndFrame on the render thread
+	double OverlapMs = 0.0;      // time both were running at once
+	double WaitMs = 0.0;         // render thread stalled waiting for a snapshot
+};
+
+template<typename Input, typename Snapshot>
+class FramePipeline
+{
+public:
+	// Called on the simulation thread.  Everything the function touches other than its
+	// arguments must be owned by the simulation for as long as the pipeline runs.
+	typedef std::function<void(const Input& input, Snapshot& snapshot)> SimulateFunc;
+
+	FramePipeline(SimulateFunc simulate) :
+		mSimulate(simulate),
+		mEpoch(Clock::now())
+	{
+		mThread = std::thread([this]() { SimulationLoop(); });
+	}
+
+	FramePipeline(const FramePipeline& rhs) = delete;
+	FramePipeline& operator=(const FramePipeline& rhs) = delete;
+
+	~FramePipeline()
+	{
+		mStop.store(true);
+		Wake();
+		mThread.join();
+	}
+
+	// Render thread.  Waits for this frame's snapshot, hands input to the simulation of
+	// the next frame and returns the snapshot, which stays valid until the next call.
+	// The very first call simulates frame 0 from the same input before returning.
+	const Snapshot& BeginFrame(const Input& input)
+	{
+		if (mRequested.load(std::memory_order_relaxed) == 0)
+			Request(input);
+
+		double waitStart = Now();
+		std::uint64_t frame = mRequested.load(std::memory_order_relaxed) - 1;
+		Wait([this, frame]() { return mPublished.load() > frame; });
+
+		// The render interval of the previous frame overlapped this frame's simulation.
+		double renderStart = Now();
+		if (frame > 0)
+		{
+			const Timing& sim = mSimTiming[frame % 2];
+			double overlap = (std::min)(mRenderEnd, sim.End) - (std::max)(mRenderStart, sim.Start);
+			mStats.OverlapMs += (overlap > 0.0) ? overlap : 0.0;
+			mStats.WaitMs += renderStart - waitStart;
+		}
+		mStats.SimulationMs += mSimTiming[frame % 2].End - mSimTiming[frame % 2].Start;
+
+		mRenderStart = renderStart;
+		Request(input);
+		return mSnapshots[frame % 2];
+	}
+
+	void EndFrame()
+	{
+		mRenderEnd = Now();
+		mStats.RenderMs += mRenderEnd - mRenderStart;
+		++mStats.Frames;
+	}
+
+	// Render thread only.
+	const FramePipelineStats& Stats()const { return mStats; }
+	void ResetStats() { mStats = FramePipelineStats(); }
+
+private:
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// Yields before a waiting thread goes to sleep; a hand-off usually lands within a
+	// few of them when both threads are busy.
+	static const int SpinCount = 64;
+
+	struct Timing
+	{
+		double Start = 0.0;
+		double End = 0.0;
+	};
+
+	double Now()const
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - mEpoch).count();
+	}
+
+	// The simulation thread is idle whenever the render thread gets here, so the input
+	// can be written without synchronization; the release store publishes it.
+	void Request(const Input& input)
+	{
+		mInput = input;
+		mRequested.fetch_add(1);
+		Wake();
+	}
+
+	// The counters and mSleepers are sequentially consistent, so either a waiter sees the
+	// counter move before it sleeps or Wake sees the waiter and notifies it.
+	template<typename Ready>
+	void Wait(Ready ready)
+	{
+		for (int i = 0; i < SpinCount; ++i)
+		{
+			if (ready())
+				return;
+			std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mSleepers.fetch_add(1);
+		mWake.wait(lock, ready);
+		mSleepers.fetch_sub(1);
+	}
+
+	void Wake()
+	{
+		if (mSleepers.load() == 0)
+			return;
+
+		// Taking the mutex orders the notify after a sleeper's last check of its predicate.
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+		}
+		mWake.notify_all();
+	}
+
+	void SimulationLoop()
+	{
+		std::uint64_t frame = 0;
+		for (;;)
+		{
+			Wait([this, frame]() { return mRequested.load() > frame || mStop.load(); });
+			if (mRequested.load() <= frame)
+				return;
+
+			Timing& timing = mSimTiming[frame % 2];
+			timing.Start = Now();
+			mSimulate(mInput, mSnapshots[frame % 2]);
+			timing.End = Now();
+
+			++frame;
+			mPublished.store(frame);
+			Wake();
+		}
+	}
+
+private:
+	SimulateFunc mSimulate;
+	Clock::time_point mEpoch;
+
+	Input mInput;
+	Snapshot mSnapshots[2];
+	Timing mSimTiming[2];
+
+	// Frames requested by the render thread and frames published by the simulation.
+	std::atomic<std::uint64_t> mRequested{ 0 };
+	std::atomic<std::uint64_t> mPublished{ 0 };
+	std::atomic<bool> mStop{ false };
+
+	// Threads asleep in Wait.
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::atomic<int> mSleepers{ 0 };
+
+	double mRenderStart = 0.0;
+	double mRenderEnd = 0.0;
+	FramePipelineStats mStats;
+
+	std::thread mThread;
+};
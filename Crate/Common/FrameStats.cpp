@@ -0,0 +1,200 @@
+#include "FrameStats.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+const char* FrameMetricName(FrameMetric metric)
+{
+	switch (metric)
+	{
+	case FrameMetric::Frame:     return "frame";
+	case FrameMetric::Update:    return "update";
+	case FrameMetric::Draw:      return "draw";
+	case FrameMetric::FenceWait: return "fenceWait";
+	default:                     return "unknown";
+	}
+}
+
+RollingHistogram::RollingHistogram()
+{
+	Clear();
+}
+
+void RollingHistogram::Clear()
+{
+	for (float& v : mWindow)
+		v = 0.0f;
+	for (std::uint32_t& b : mBins)
+		b = 0;
+
+	mCount = 0;
+	mNext = 0;
+	mSum = 0.0;
+}
+
+std::uint32_t RollingHistogram::BinOf(float milliseconds)const
+{
+	if (!(milliseconds > 0.0f))
+		return 0;
+
+	double bin = milliseconds / BinWidthMs();
+	return (bin >= BinCount) ? BinCount : (std::uint32_t)bin;
+}
+
+void RollingHistogram::Add(double milliseconds)
+{
+	float value = (float)milliseconds;
+
+	// Evict the oldest sample once the window is full.
+	if (mCount == WindowSize)
+	{
+		float old = mWindow[mNext];
+		--mBins[BinOf(old)];
+		mSum -= old;
+	}
+	else
+	{
+		++mCount;
+	}
+
+	mWindow[mNext] = value;
+	mNext = (mNext + 1) % WindowSize;
+	++mBins[BinOf(value)];
+	mSum += value;
+}
+
+double RollingHistogram::Percentile(double p)const
+{
+	if (mCount == 0)
+		return 0.0;
+
+	// Rank of the sample we want, 1-based, and the bin it falls in.  Within the bin the
+	// samples are assumed to be spread evenly.
+	double rank = std::ceil(p * mCount);
+	rank = (rank < 1.0) ? 1.0 : rank;
+
+	std::uint32_t below = 0;
+	for (std::uint32_t bin = 0; bin < BinCount; ++bin)
+	{
+		if (below + mBins[bin] >= rank)
+		{
+			double fraction = (rank - below) / mBins[bin];
+			double value = (bin + fraction) * BinWidthMs();
+			double max = Max();
+			return (value < max) ? value : max;
+		}
+		below += mBins[bin];
+	}
+	return Max();
+}
+
+double RollingHistogram::Mean()const
+{
+	return (mCount == 0) ? 0.0 : mSum / mCount;
+}
+
+double RollingHistogram::Max()const
+{
+	float result = 0.0f;
+	for (std::uint32_t i = 0; i < mCount; ++i)
+		result = (mWindow[i] > result) ? mWindow[i] : result;
+	return result;
+}
+
+std::uint32_t RollingHistogram::CountAbove(double thresholdMs)const
+{
+	std::uint32_t n = 0;
+	for (std::uint32_t i = 0; i < mCount; ++i)
+	{
+		if (mWindow[i] > thresholdMs)
+			++n;
+	}
+	return n;
+}
+
+FrameStats::FrameStats(double hitchThresholdMs) :
+	mHitchThresholdMs(hitchThresholdMs)
+{
+}
+
+void FrameStats::AddFrame(const FrameSample& sample)
+{
+	for (int i = 0; i < (int)FrameMetric::Count; ++i)
+		mMetrics[i].Add(sample.Milliseconds[i]);
+
+	++mFrames;
+	if (sample.Milliseconds[(int)FrameMetric::Frame] > mHitchThresholdMs)
+		++mHitches;
+}
+
+FrameMetricSummary FrameStats::Summarize(FrameMetric metric)const
+{
+	const RollingHistogram& h = mMetrics[(int)metric];
+
+	FrameMetricSummary summary;
+	summary.Mean = h.Mean();
+	summary.P50 = h.Percentile(0.50);
+	summary.P95 = h.Percentile(0.95);
+	summary.P99 = h.Percentile(0.99);
+	summary.Max = h.Max();
+	return summary;
+}
+
+std::uint32_t FrameStats::WindowHitches()const
+{
+	return mMetrics[(int)FrameMetric::Frame].CountAbove(mHitchThresholdMs);
+}
+
+std::string FrameStats::SummaryString()const
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(2);
+	for (int i = 0; i < (int)FrameMetric::Count; ++i)
+	{
+		FrameMetricSummary s = Summarize((FrameMetric)i);
+		ss << FrameMetricName((FrameMetric)i) << " p50 " << s.P50 << " p95 " << s.P95
+			<< " p99 " << s.P99 << " max " << s.Max << " ms | ";
+	}
+	ss << "hitches " << WindowHitches() << " (" << mHitches << " total)";
+	return ss.str();
+}
+
+void FrameStats::WriteCsvHeader(std::ostream& out)const
+{
+	out << "time,frames,hitches";
+	for (int i = 0; i < (int)FrameMetric::Count; ++i)
+	{
+		const char* name = FrameMetricName((FrameMetric)i);
+		out << ',' << name << "_mean," << name << "_p50," << name << "_p95,"
+			<< name << "_p99," << name << "_max";
+	}
+	out << '\n';
+}
+
+void FrameStats::WriteCsvRow(std::ostream& out, double timeSeconds)const
+{
+	out << std::fixed << std::setprecision(3) << timeSeconds << ',' << mFrames << ',' << mHitches;
+	for (int i = 0; i < (int)FrameMetric::Count; ++i)
+	{
+		FrameMetricSummary s = Summarize((FrameMetric)i);
+		out << ',' << s.Mean << ',' << s.P50 << ',' << s.P95 << ',' << s.P99 << ',' << s.Max;
+	}
+	out << '\n';
+}
+
+void FrameStats::WriteJson(std::ostream& out)const
+{
+	out << std::fixed << std::setprecision(3);
+	out << "{\n  \"frames\": " << mFrames << ",\n  \"hitches\": " << mHitches
+		<< ",\n  \"hitch_threshold_ms\": " << mHitchThresholdMs
+		<< ",\n  \"window_frames\": " << mMetrics[(int)FrameMetric::Frame].Count();
+
+	for (int i = 0; i < (int)FrameMetric::Count; ++i)
+	{
+		FrameMetricSummary s = Summarize((FrameMetric)i);
+		out << ",\n  \"" << FrameMetricName((FrameMetric)i) << "\": { \"mean\": " << s.Mean
+			<< ", \"p50\": " << s.P50 << ", \"p95\": " << s.P95 << ", \"p99\": " << s.P99
+			<< ", \"max\": " << s.Max << " }";
+	}
+	out << "\n}\n";
+}
@@ -0,0 +1,110 @@
+//***************************************************************************************
+// FrameStats.h
+//
+// Frame-time statistics over a rolling window of recent frames.  Each metric keeps the
+// last WindowSize samples and a histogram of them, both in fixed arrays, so adding a
+// frame and computing percentiles never allocate.  Frames slower than the hitch
+// threshold are counted so runs can be compared by stutter as well as by average.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+enum class FrameMetric : int
+{
+	Frame = 0,    // full frame, from the game timer
+	Update,       // CPU time in Update
+	Draw,         // CPU time in Draw
+	FenceWait,    // CPU time blocked on the GPU fence
+	Count
+};
+
+const char* FrameMetricName(FrameMetric metric);
+
+struct FrameSample
+{
+	double Milliseconds[(int)FrameMetric::Count] = {};
+};
+
+struct FrameMetricSummary
+{
+	double Mean = 0.0;
+	double P50 = 0.0;
+	double P95 = 0.0;
+	double P99 = 0.0;
+	double Max = 0.0;
+};
+
+// The last WindowSize samples of one metric.  Percentiles are read off a histogram of
+// BinWidthMs wide bins and are accurate to within one bin; anything past the last bin
+// is reported as the window maximum.
+class RollingHistogram
+{
+public:
+	static const std::uint32_t WindowSize = 1024;
+	static const std::uint32_t BinCount = 2000;
+	static double BinWidthMs() { return 0.05; }
+
+	RollingHistogram();
+
+	void Add(double milliseconds);
+	void Clear();
+
+	std::uint32_t Count()const { return mCount; }
+
+	// p in [0, 1].
+	double Percentile(double p)const;
+	double Mean()const;
+	double Max()const;
+
+	// Samples in the window above thresholdMs.
+	std::uint32_t CountAbove(double thresholdMs)const;
+
+private:
+	std::uint32_t BinOf(float milliseconds)const;
+
+private:
+	float mWindow[WindowSize];
+	std::uint32_t mBins[BinCount + 1];   // the last bin collects everything past the range
+	std::uint32_t mCount = 0;
+	std::uint32_t mNext = 0;
+	double mSum = 0.0;
+};
+
+class FrameStats
+{
+public:
+	explicit FrameStats(double hitchThresholdMs = 33.3);
+
+	// Frames longer than this count as hitches.
+	void SetHitchThreshold(double milliseconds) { mHitchThresholdMs = milliseconds; }
+	double HitchThreshold()const { return mHitchThresholdMs; }
+
+	void AddFrame(const FrameSample& sample);
+
+	FrameMetricSummary Summarize(FrameMetric metric)const;
+
+	std::uint64_t Frames()const { return mFrames; }
+	std::uint64_t Hitches()const { return mHitches; }
+	std::uint32_t WindowHitches()const;
+	const RollingHistogram& Histogram(FrameMetric metric)const { return mMetrics[(int)metric]; }
+
+	// "frame p50 16.6 p99 18.2 max 21.0 ms | update ... | hitches 3"
+	std::string SummaryString()const;
+
+	// One CSV row per call, summarizing the current window.
+	void WriteCsvHeader(std::ostream& out)const;
+	void WriteCsvRow(std::ostream& out, double timeSeconds)const;
+
+	// Summary of the window plus the run's totals.
+	void WriteJson(std::ostream& out)const;
+
+private:
+	RollingHistogram mMetrics[(int)FrameMetric::Count];
+	double mHitchThresholdMs;
+	std::uint64_t mFrames = 0;
+	std::uint64_t mHitches = 0;
+};
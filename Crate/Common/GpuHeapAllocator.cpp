@@ -0,0 +1,373 @@
+#include "GpuHeapAllocator.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Small enough that a chunk's buffers waste little, large enough that the buddy tree
+	// of a 64MB page stays small.
+	const UINT64 RangeBlockSize = 1024;
+
+	const char* CategoryName(GpuMemoryCategory category)
+	{
+		switch (category)
+		{
+		case GpuMemoryCategory::Geometry:  return "geometry";
+		case GpuMemoryCategory::Textures:  return "textures";
+		case GpuMemoryCategory::Upload:    return "upload";
+		case GpuMemoryCategory::Constants: return "constants";
+		default:                           return "unknown";
+		}
+	}
+
+	MemoryCategory TrackerCategory(GpuMemoryCategory category)
+	{
+		switch (category)
+		{
+		case GpuMemoryCategory::Geometry:  return MemoryCategory::Meshes;
+		case GpuMemoryCategory::Textures:  return MemoryCategory::Textures;
+		case GpuMemoryCategory::Upload:    return MemoryCategory::Staging;
+		default:                           return MemoryCategory::Constants;
+		}
+	}
+}
+
+GpuHeapAllocator::GpuHeapAllocator(ID3D12Device* device, UINT64 heapSize) :
+	md3dDevice(device),
+	mHeapSize(heapSize)
+{
+}
+
+GpuHeapAllocator::~GpuHeapAllocator()
+{
+	// Placed resources must be released before the heaps that back them.
+	mRetired.clear();
+	mPlacements.clear();
+	mRanges.clear();
+	mPages.clear();
+}
+
+ComPtr<ID3D12Resource> GpuHeapAllocator::CreateBuffer(
+	UINT64 byteSize,
+	D3D12_HEAP_TYPE heapType,
+	D3D12_RESOURCE_STATES initialState,
+	GpuMemoryCategory category)
+{
+	return Place(CD3DX12_RESOURCE_DESC::Buffer(byteSize), heapType, ResourceClass::Buffer, initialState, category);
+}
+
+ComPtr<ID3D12Resource> GpuHeapAllocator::CreateTexture(
+	const D3D12_RESOURCE_DESC& desc,
+	D3D12_RESOURCE_STATES initialState,
+	GpuMemoryCategory category)
+{
+	return Place(desc, D3D12_HEAP_TYPE_DEFAULT, ResourceClass::Texture, initialState, category);
+}
+
+ComPtr<ID3D12Resource> GpuHeapAllocator::Place(
+	const D3D12_RESOURCE_DESC& desc,
+	D3D12_HEAP_TYPE heapType,
+	ResourceClass resourceClass,
+	D3D12_RESOURCE_STATES initialState,
+	GpuMemoryCategory category)
+{
+	D3D12_RESOURCE_ALLOCATION_INFO info = md3dDevice->GetResourceAllocationInfo(0, 1, &desc);
+
+	// Try the existing pages first, then grow by one page large enough for the request.
+	UINT pageIndex = UINT(-1);
+	UINT64 offset = BuddyAllocator::InvalidOffset;
+	for (UINT i = 0; i < (UINT)mPages.size() && offset == BuddyAllocator::InvalidOffset; ++i)
+	{
+		if (mPages[i].Type != heapType || mPages[i].Class != resourceClass)
+			continue;
+
+		offset = mPages[i].Allocator->Allocate(info.SizeInBytes, info.Alignment, (UINT)category);
+		pageIndex = i;
+	}
+
+	if (offset == BuddyAllocator::InvalidOffset)
+	{
+		pageIndex = AddPage(heapType, resourceClass, info.SizeInBytes);
+		offset = mPages[pageIndex].Allocator->Allocate(info.SizeInBytes, info.Alignment, (UINT)category);
+	}
+
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(md3dDevice->CreatePlacedResource(
+		mPages[pageIndex].Heap.Get(),
+		offset,
+		&desc,
+		initialState,
+		nullptr,
+		IID_PPV_ARGS(resource.GetAddressOf())));
+
+	Placement placement;
+	placement.PageIndex = pageIndex;
+	placement.Offset = offset;
+	placement.State = initialState;
+	placement.Category = category;
+	placement.Memory.Reset(MemoryDomain::Gpu, TrackerCategory(category), info.SizeInBytes);
+	mPlacements[resource.Get()] = std::move(placement);
+
+	return resource;
+}
+
+UINT GpuHeapAllocator::AddPage(D3D12_HEAP_TYPE heapType, ResourceClass resourceClass, UINT64 minSize)
+{
+	// Pages are a power-of-two number of 64KB blocks so the buddy tree covers them exactly.
+	UINT64 size = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	while (size < (std::max)(mHeapSize, minSize))
+		size <<= 1;
+
+	D3D12_HEAP_DESC heapDesc = {};
+	heapDesc.SizeInBytes = size;
+	heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(heapType);
+	heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	heapDesc.Flags = (resourceClass == ResourceClass::Buffer) ?
+		D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS : D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+
+	Page page;
+	ThrowIfFailed(md3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(page.Heap.GetAddressOf())));
+	page.Type = heapType;
+	page.Class = resourceClass;
+
+	if (resourceClass == ResourceClass::Ranges)
+	{
+		// Upload heap resources must start in GENERIC_READ; default buffers are used from
+		// COMMON through implicit promotion.
+		D3D12_RESOURCE_STATES state = (heapType == D3D12_HEAP_TYPE_UPLOAD) ?
+			D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COMMON;
+		ThrowIfFailed(md3dDevice->CreatePlacedResource(page.Heap.Get(), 0, &CD3DX12_RESOURCE_DESC::Buffer(size),
+			state, nullptr, IID_PPV_ARGS(page.Buffer.GetAddressOf())));
+		if (heapType == D3D12_HEAP_TYPE_UPLOAD)
+			ThrowIfFailed(page.Buffer->Map(0, nullptr, reinterpret_cast<void**>(&page.Mapped)));
+
+		page.Allocator = std::make_unique<BuddyAllocator>(size, RangeBlockSize);
+	}
+	else
+	{
+		page.Allocator = std::make_unique<BuddyAllocator>(size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	}
+
+	mPages.push_back(std::move(page));
+	return (UINT)mPages.size() - 1;
+}
+
+void GpuHeapAllocator::Free(ID3D12Resource* resource)
+{
+	auto it = mPlacements.find(resource);
+	if (it == mPlacements.end())
+		return;
+
+	mPages[it->second.PageIndex].Allocator->Free(it->second.Offset);
+	mPlacements.erase(it);
+}
+
+UINT GpuHeapAllocator::FindRangePage(ID3D12Resource* buffer)const
+{
+	for (UINT i = 0; i < (UINT)mPages.size(); ++i)
+	{
+		if (mPages[i].Buffer.Get() == buffer && buffer != nullptr)
+			return i;
+	}
+	return UINT(-1);
+}
+
+ComPtr<ID3D12Resource> GpuHeapAllocator::CreateBufferRange(
+	UINT64 byteSize,
+	D3D12_HEAP_TYPE heapType,
+	GpuMemoryCategory category,
+	UINT64& offset)
+{
+	UINT pageIndex = UINT(-1);
+	offset = BuddyAllocator::InvalidOffset;
+	for (UINT i = 0; i < (UINT)mPages.size() && offset == BuddyAllocator::InvalidOffset; ++i)
+	{
+		if (mPages[i].Type != heapType || mPages[i].Class != ResourceClass::Ranges)
+			continue;
+
+		offset = mPages[i].Allocator->Allocate(byteSize, 0, (UINT)category);
+		pageIndex = i;
+	}
+
+	if (offset == BuddyAllocator::InvalidOffset)
+	{
+		pageIndex = AddPage(heapType, ResourceClass::Ranges, byteSize);
+		offset = mPages[pageIndex].Allocator->Allocate(byteSize, 0, (UINT)category);
+	}
+
+	RangeKey key = { pageIndex, offset };
+	mRanges[key].Reset(MemoryDomain::Gpu, TrackerCategory(category), mPages[pageIndex].Allocator->BlockSize(offset));
+	return mPages[pageIndex].Buffer;
+}
+
+void* GpuHeapAllocator::MappedRange(ID3D12Resource* buffer, UINT64 offset)const
+{
+	UINT pageIndex = FindRangePage(buffer);
+	if (pageIndex == UINT(-1) || mPages[pageIndex].Mapped == nullptr)
+		return nullptr;
+
+	return mPages[pageIndex].Mapped + offset;
+}
+
+void GpuHeapAllocator::Free(ID3D12Resource* buffer, UINT64 offset)
+{
+	UINT pageIndex = FindRangePage(buffer);
+	if (pageIndex == UINT(-1))
+		return;
+
+	RangeKey key = { pageIndex, offset };
+	auto it = mRanges.find(key);
+	if (it == mRanges.end())
+		return;
+
+	mPages[pageIndex].Allocator->Free(offset);
+	mRanges.erase(it);
+}
+
+void GpuHeapAllocator::CopyRange(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* dst, UINT64 dstOffset,
+	ID3D12Resource* src, UINT64 srcOffset, UINT64 size)
+{
+	UINT pageIndex = FindRangePage(dst);
+	if (pageIndex != UINT(-1) && mPages[pageIndex].Type == D3D12_HEAP_TYPE_DEFAULT && !mPages[pageIndex].Copying)
+	{
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(dst,
+			D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+		mPages[pageIndex].Copying = true;
+	}
+
+	cmdList->CopyBufferRegion(dst, dstOffset, src, srcOffset, size);
+}
+
+void GpuHeapAllocator::FinishCopies(ID3D12GraphicsCommandList* cmdList)
+{
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	for (auto& page : mPages)
+	{
+		if (!page.Copying)
+			continue;
+
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(page.Buffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ));
+		page.Copying = false;
+	}
+
+	if (!barriers.empty())
+		cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+}
+
+UINT GpuHeapAllocator::Defragment(ID3D12GraphicsCommandList* cmdList, const RelocateCallback& relocate, UINT maxMoves)
+{
+	// Without an owner to take the new resources there is nothing to move them to.
+	if (!relocate)
+		return 0;
+
+	UINT moves = 0;
+
+	for (UINT pageIndex = 0; pageIndex < (UINT)mPages.size() && moves < maxMoves; ++pageIndex)
+	{
+		Page& page = mPages[pageIndex];
+
+		// Upload heap resources cannot be copy destinations, so only default pages move.
+		// Ranges are not resources of their own, so range pages stay as they are.
+		if (page.Type != D3D12_HEAP_TYPE_DEFAULT || page.Class == ResourceClass::Ranges)
+			continue;
+
+		moves += page.Allocator->Defragment(
+			[&](UINT64 srcOffset, UINT64 dstOffset, UINT64 /*size*/, std::uint32_t /*category*/)
+		{
+			ID3D12Resource* oldResource = nullptr;
+			for (auto& e : mPlacements)
+			{
+				if (e.second.PageIndex == pageIndex && e.second.Offset == srcOffset)
+				{
+					oldResource = e.first;
+					break;
+				}
+			}
+			if (oldResource == nullptr)
+				return false;
+
+			// The placement stays in the map until the new resource exists, so a failed
+			// move leaves it counted and in its state.
+			D3D12_RESOURCE_STATES state = mPlacements[oldResource].State;
+			D3D12_RESOURCE_DESC desc = oldResource->GetDesc();
+
+			ComPtr<ID3D12Resource> newResource;
+			if (FAILED(md3dDevice->CreatePlacedResource(page.Heap.Get(), dstOffset, &desc,
+				D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(newResource.GetAddressOf()))))
+				return false;
+
+			// The destination range may have held another resource before; make the new
+			// one the active alias before copying into it.
+			D3D12_RESOURCE_BARRIER barriers[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::Aliasing(nullptr, newResource.Get()),
+				CD3DX12_RESOURCE_BARRIER::Transition(oldResource, state, D3D12_RESOURCE_STATE_COPY_SOURCE)
+			};
+			cmdList->ResourceBarrier(_countof(barriers), barriers);
+			cmdList->CopyResource(newResource.Get(), oldResource);
+			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(newResource.Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, state));
+
+			relocate(oldResource, newResource);
+
+			auto it = mPlacements.find(oldResource);
+			Placement placement = std::move(it->second);
+			mPlacements.erase(it);
+			placement.Offset = dstOffset;
+			mPlacements[newResource.Get()] = std::move(placement);
+
+			// Keep the old resource alive until the copy has executed on the GPU.
+			mRetired.push_back(oldResource);
+			return true;
+		}, maxMoves - moves);
+	}
+
+	return moves;
+}
+
+void GpuHeapAllocator::ReleaseRetired()
+{
+	mRetired.clear();
+	for (auto& page : mPages)
+		page.Allocator->ReleaseMoved();
+}
+
+UINT64 GpuHeapAllocator::BytesReserved(GpuMemoryCategory category)const
+{
+	UINT64 bytes = 0;
+	for (auto& page : mPages)
+		bytes += page.Allocator->Stats((UINT)category).BytesReserved;
+	return bytes;
+}
+
+UINT64 GpuHeapAllocator::BytesRequested(GpuMemoryCategory category)const
+{
+	UINT64 bytes = 0;
+	for (auto& page : mPages)
+		bytes += page.Allocator->Stats((UINT)category).BytesRequested;
+	return bytes;
+}
+
+UINT GpuHeapAllocator::AllocationCount(GpuMemoryCategory category)const
+{
+	UINT count = 0;
+	for (auto& page : mPages)
+		count += page.Allocator->Stats((UINT)category).Allocations;
+	return count;
+}
+
+std::string GpuHeapAllocator::StatsString()const
+{
+	std::ostringstream ss;
+	ss << "GPU heaps: " << mPages.size() << " page(s)\n";
+	for (UINT c = 0; c < (UINT)GpuMemoryCategory::Count; ++c)
+	{
+		GpuMemoryCategory category = (GpuMemoryCategory)c;
+		ss << "  " << CategoryName(category)
+			<< ": " << AllocationCount(category) << " allocations, "
+			<< BytesRequested(category) / 1024 << " KB requested, "
+			<< BytesReserved(category) / 1024 << " KB reserved\n";
+	}
+	return ss.str();
+}
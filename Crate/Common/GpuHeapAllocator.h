@@ -0,0 +1,150 @@
+//***************************************************************************************
+// GpuHeapAllocator.h
+//
+// Reserves large ID3D12Heaps and places buffers and textures inside them instead of
+// creating one committed resource (and one kernel allocation) per object.  The
+// offset bookkeeping inside each heap is done by BuddyAllocator.
+//
+// A placed resource takes at least 64KB, which is mostly padding for a small vertex or
+// index buffer.  Those are byte ranges instead: some pages hold one buffer covering the
+// whole heap, and hand out ranges of it in 1KB blocks.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "BuddyAllocator.h"
+#include <map>
+
+enum class GpuMemoryCategory : UINT
+{
+	Geometry = 0,
+	Textures,
+	Upload,
+	Constants,
+	Count
+};
+
+class GpuHeapAllocator
+{
+public:
+	// Called when Defragment() has moved a resource.  The owner must swap its reference
+	// from oldResource to newResource before the next frame records commands.
+	typedef std::function<void(ID3D12Resource* oldResource,
+		const Microsoft::WRL::ComPtr<ID3D12Resource>& newResource)> RelocateCallback;
+
+	GpuHeapAllocator(ID3D12Device* device, UINT64 heapSize = 64ull * 1024 * 1024);
+	GpuHeapAllocator(const GpuHeapAllocator& rhs) = delete;
+	GpuHeapAllocator& operator=(const GpuHeapAllocator& rhs) = delete;
+	~GpuHeapAllocator();
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(
+		UINT64 byteSize,
+		D3D12_HEAP_TYPE heapType,
+		D3D12_RESOURCE_STATES initialState,
+		GpuMemoryCategory category);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateTexture(
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_RESOURCE_STATES initialState,
+		GpuMemoryCategory category);
+
+	// Returns the range the resource occupies to its heap.  The caller must be sure the
+	// GPU is no longer using it.
+	void Free(ID3D12Resource* resource);
+
+	// Sub-allocates byteSize bytes of a page's shared buffer.  Returns that buffer and
+	// sets offset to where the range starts in it; views use the buffer's GPU address
+	// plus offset.  Upload buffers stay mapped, see MappedRange.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBufferRange(
+		UINT64 byteSize,
+		D3D12_HEAP_TYPE heapType,
+		GpuMemoryCategory category,
+		UINT64& offset);
+
+	// CPU address of a range of an upload buffer.
+	void* MappedRange(ID3D12Resource* buffer, UINT64 offset)const;
+
+	// Returns a range to its buffer.  The caller must be sure the GPU is no longer using it.
+	void Free(ID3D12Resource* buffer, UINT64 offset);
+
+	// Records a copy of size bytes between two ranges.  Shared default buffers are in the
+	// COMMON state when a command list starts, since buffers decay to it after each
+	// ExecuteCommandLists; the first copy into one moves it to COPY_DEST, and
+	// FinishCopies moves each such buffer on to GENERIC_READ.  Record the copies before
+	// anything in the same command list reads the buffers, and FinishCopies after them.
+	void CopyRange(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* dst, UINT64 dstOffset,
+		ID3D12Resource* src, UINT64 srcOffset, UINT64 size);
+	void FinishCopies(ID3D12GraphicsCommandList* cmdList);
+
+	// Compacts default-heap pages by recording copies into cmdList.  The old resources,
+	// and the heap ranges they occupy, are held until ReleaseRetired() is called once the
+	// copies have executed, so no move or new placement lands on a copy's source.
+	UINT Defragment(ID3D12GraphicsCommandList* cmdList, const RelocateCallback& relocate, UINT maxMoves);
+	void ReleaseRetired();
+
+	UINT HeapCount()const { return (UINT)mPages.size(); }
+	UINT64 BytesReserved(GpuMemoryCategory category)const;
+	UINT64 BytesRequested(GpuMemoryCategory category)const;
+	UINT AllocationCount(GpuMemoryCategory category)const;
+
+	// One line per category, suitable for OutputDebugString.
+	std::string StatsString()const;
+
+private:
+	// Resource heap tier 1 hardware cannot mix buffers and textures in one heap, so the
+	// pages are kept apart by heap type and resource class.  Range pages hold a single
+	// buffer that their allocator hands out byte ranges of.
+	enum class ResourceClass { Buffer, Texture, Ranges };
+
+	struct Page
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+		D3D12_HEAP_TYPE Type;
+		ResourceClass Class;
+		std::unique_ptr<BuddyAllocator> Allocator;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;   // range pages only
+		std::uint8_t* Mapped = nullptr;                 // range pages in upload heaps
+		bool Copying = false;                           // in COPY_DEST until FinishCopies
+	};
+
+	struct RangeKey
+	{
+		UINT PageIndex;
+		UINT64 Offset;
+
+		bool operator<(const RangeKey& rhs)const
+		{
+			return PageIndex < rhs.PageIndex || (PageIndex == rhs.PageIndex && Offset < rhs.Offset);
+		}
+	};
+
+	struct Placement
+	{
+		UINT PageIndex;
+		UINT64 Offset;
+		D3D12_RESOURCE_STATES State;
+		GpuMemoryCategory Category;
+		TrackedMemory Memory;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> Place(
+		const D3D12_RESOURCE_DESC& desc,
+		D3D12_HEAP_TYPE heapType,
+		ResourceClass resourceClass,
+		D3D12_RESOURCE_STATES initialState,
+		GpuMemoryCategory category);
+
+	UINT AddPage(D3D12_HEAP_TYPE heapType, ResourceClass resourceClass, UINT64 minSize);
+	UINT FindRangePage(ID3D12Resource* buffer)const;
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	UINT64 mHeapSize = 0;
+
+	std::vector<Page> mPages;
+	std::unordered_map<ID3D12Resource*, Placement> mPlacements;
+	std::map<RangeKey, TrackedMemory> mRanges;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mRetired;
+};
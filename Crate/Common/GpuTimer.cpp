@@ -0,0 +1,116 @@
+#include "GpuTimer.h"
+#include "Profiler.h"
+
+using Microsoft::WRL::ComPtr;
+
+GpuTimer::GpuTimer(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameCount, UINT maxTimersPerFrame) :
+	mQueue(queue),
+	mTracker(frameCount, maxTimersPerFrame)
+{
+	ThrowIfFailed(queue->GetTimestampFrequency(&mFrequency));
+
+	D3D12_QUERY_HEAP_DESC heapDesc = {};
+	heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	heapDesc.Count = mTracker.QueriesPerFrame();
+
+	UINT64 readbackSize = sizeof(UINT64) * mTracker.QueriesPerFrame();
+
+	for (UINT i = 0; i < frameCount; ++i)
+	{
+		ComPtr<ID3D12QueryHeap> heap;
+		ThrowIfFailed(device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&heap)));
+		mQueryHeaps.push_back(heap);
+
+		ComPtr<ID3D12Resource> readback;
+		ThrowIfFailed(device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(readbackSize),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(&readback)));
+		mReadbackBuffers.push_back(readback);
+	}
+}
+
+void GpuTimer::BeginFrame(UINT frameIndex, UINT64 completedFence)
+{
+	std::uint32_t ready;
+	while (mTracker.NextReady(completedFence, ready))
+		ReadBack(ready);
+
+	mTracker.BeginFrame(frameIndex);
+	mFrameIndex = frameIndex;
+}
+
+void GpuTimer::Begin(ID3D12GraphicsCommandList* cmdList, const char* name)
+{
+	std::uint32_t query = mTracker.BeginTimer(name);
+	if (query != GpuTimerTracker::Invalid)
+		cmdList->EndQuery(mQueryHeaps[mFrameIndex].Get(), D3D12_QUERY_TYPE_TIMESTAMP, query);
+}
+
+void GpuTimer::End(ID3D12GraphicsCommandList* cmdList, const char* name)
+{
+	std::uint32_t query = mTracker.EndTimer(name);
+	if (query != GpuTimerTracker::Invalid)
+		cmdList->EndQuery(mQueryHeaps[mFrameIndex].Get(), D3D12_QUERY_TYPE_TIMESTAMP, query);
+}
+
+void GpuTimer::Resolve(ID3D12GraphicsCommandList* cmdList)
+{
+	UINT used = mTracker.UsedQueries();
+	if (used > 0)
+	{
+		cmdList->ResolveQueryData(mQueryHeaps[mFrameIndex].Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+			0, used, mReadbackBuffers[mFrameIndex].Get(), 0);
+	}
+}
+
+void GpuTimer::EndFrame(UINT64 fence)
+{
+	mTracker.EndFrame(fence);
+}
+
+void GpuTimer::ReadBack(UINT frame)
+{
+	D3D12_RANGE readRange = { 0, sizeof(UINT64) * mTracker.QueriesPerFrame() };
+	D3D12_RANGE writtenRange = { 0, 0 };
+
+	void* data = nullptr;
+	ThrowIfFailed(mReadbackBuffers[frame]->Map(0, &readRange, &data));
+	mTracker.Resolve(frame, static_cast<const std::uint64_t*>(data), mFrequency, mSamples);
+	mReadbackBuffers[frame]->Unmap(0, &writtenRange);
+
+	if (Profiler::Enabled())
+		AddToTrace();
+}
+
+void GpuTimer::AddToTrace()
+{
+	if (mTraceTrack == 0)
+		mTraceTrack = Profiler::CreateTrack("GPU");
+
+	// Pair a GPU timestamp with the CPU time it was taken at.  The calibration's CPU
+	// side is a QPC value, which is converted to the profiler's clock by taking both
+	// clocks back to back now.
+	UINT64 gpuCalibration = 0, qpcCalibration = 0;
+	if (FAILED(mQueue->GetClockCalibration(&gpuCalibration, &qpcCalibration)))
+		return;
+
+	LARGE_INTEGER qpcNow, qpcFrequency;
+	QueryPerformanceCounter(&qpcNow);
+	std::uint64_t profilerNow = Profiler::Now();
+	QueryPerformanceFrequency(&qpcFrequency);
+
+	double calibrationNs = (double)profilerNow -
+		(double)(qpcNow.QuadPart - (LONGLONG)qpcCalibration) * 1.0e9 / (double)qpcFrequency.QuadPart;
+
+	for (const GpuTimerSample& sample : mSamples)
+	{
+		double beginNs = calibrationNs - ((double)gpuCalibration - (double)sample.Begin) * 1.0e9 / (double)mFrequency;
+		double endNs = beginNs + sample.Milliseconds * 1.0e6;
+		if (beginNs >= 0.0)
+			Profiler::Record(sample.Name, (std::uint64_t)beginNs, (std::uint64_t)endNs, mTraceTrack);
+	}
+}
@@ -0,0 +1,59 @@
+//***************************************************************************************
+// GpuTimer.h
+//
+// Times sections of a frame on the GPU with timestamp queries.  Each frame resource has
+// its own query heap and readback buffer; a frame's timestamps are resolved into the
+// readback buffer at the end of its command list and read once its fence completes, so
+// the CPU never waits on the GPU for them.
+//
+// While the CPU profiler is capturing, the timings also go into its trace on a "GPU" row.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "GpuTimerTracker.h"
+
+class GpuTimer
+{
+public:
+	GpuTimer(ID3D12Device* device, ID3D12CommandQueue* queue, UINT frameCount, UINT maxTimersPerFrame = 16);
+	GpuTimer(const GpuTimer& rhs) = delete;
+	GpuTimer& operator=(const GpuTimer& rhs) = delete;
+
+	// Reads back every frame the GPU has finished, then starts recording into frameIndex.
+	// The frame resource must be free, i.e. its fence has completed.
+	void BeginFrame(UINT frameIndex, UINT64 completedFence);
+
+	// Timers may nest.  Names must be string literals.
+	void Begin(ID3D12GraphicsCommandList* cmdList, const char* name);
+	void End(ID3D12GraphicsCommandList* cmdList, const char* name);
+
+	// Records the copy of this frame's timestamps into its readback buffer.  Call after
+	// the last End and before closing the command list.
+	void Resolve(ID3D12GraphicsCommandList* cmdList);
+
+	void EndFrame(UINT64 fence);
+
+	const GpuTimingHistory& History()const { return mTracker.History(); }
+
+	// Samples of the most recently read back frame.
+	const std::vector<GpuTimerSample>& LastSamples()const { return mSamples; }
+
+private:
+	void ReadBack(UINT frame);
+	void AddToTrace();
+
+private:
+	ID3D12CommandQueue* mQueue = nullptr;
+	UINT64 mFrequency = 0;
+
+	GpuTimerTracker mTracker;
+	UINT mFrameIndex = 0;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D12QueryHeap>> mQueryHeaps;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mReadbackBuffers;
+
+	std::vector<GpuTimerSample> mSamples;
+	std::uint32_t mTraceTrack = 0;
+};
@@ -0,0 +1,174 @@
+#include "GpuTimerTracker.h"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+void GpuTimingHistory::Add(const char* name, double milliseconds)
+{
+	Series* series = nullptr;
+	for (Series& s : mSeries)
+	{
+		if (s.Name == name || std::strcmp(s.Name, name) == 0)
+		{
+			series = &s;
+			break;
+		}
+	}
+
+	if (!series)
+	{
+		mSeries.push_back(Series());
+		series = &mSeries.back();
+		series->Name = name;
+	}
+
+	series->Values[series->Next] = milliseconds;
+	series->Next = (series->Next + 1) % HistoryLength;
+	if (series->Count < HistoryLength)
+		++series->Count;
+}
+
+double GpuTimingHistory::Latest(std::size_t series)const
+{
+	const Series& s = mSeries[series];
+	return (s.Count == 0) ? 0.0 : s.Values[(s.Next + HistoryLength - 1) % HistoryLength];
+}
+
+double GpuTimingHistory::Average(std::size_t series)const
+{
+	const Series& s = mSeries[series];
+	if (s.Count == 0)
+		return 0.0;
+
+	double sum = 0.0;
+	for (std::uint32_t i = 0; i < s.Count; ++i)
+		sum += s.Values[i];
+	return sum / s.Count;
+}
+
+double GpuTimingHistory::Max(std::size_t series)const
+{
+	const Series& s = mSeries[series];
+	double result = 0.0;
+	for (std::uint32_t i = 0; i < s.Count; ++i)
+		result = (s.Values[i] > result) ? s.Values[i] : result;
+	return result;
+}
+
+std::string GpuTimingHistory::Summary()const
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3);
+	for (std::size_t i = 0; i < mSeries.size(); ++i)
+		ss << (i == 0 ? "" : ", ") << mSeries[i].Name << ' ' << Average(i) << " ms";
+	return ss.str();
+}
+
+GpuTimerTracker::GpuTimerTracker(std::uint32_t frameCount, std::uint32_t maxTimersPerFrame) :
+	mMaxTimers(maxTimersPerFrame),
+	mFrames(frameCount)
+{
+}
+
+void GpuTimerTracker::BeginFrame(std::uint32_t frame)
+{
+	Frame& f = mFrames[frame];
+	if (f.State == FrameState::Pending)
+		mDropped += f.Timers.size();
+
+	f.State = FrameState::Recording;
+	f.Fence = 0;
+	f.Timers.clear();
+	mRecording = frame;
+}
+
+std::uint32_t GpuTimerTracker::BeginTimer(const char* name)
+{
+	Frame& f = mFrames[mRecording];
+	if (f.Timers.size() == mMaxTimers)
+	{
+		++mDropped;
+		return Invalid;
+	}
+
+	f.Timers.push_back(Timer{ name, false });
+	return 2 * (std::uint32_t)(f.Timers.size() - 1);
+}
+
+std::uint32_t GpuTimerTracker::EndTimer(const char* name)
+{
+	// Timers nest, so the one ending is the most recent open one with this name.
+	Frame& f = mFrames[mRecording];
+	for (std::size_t i = f.Timers.size(); i-- > 0;)
+	{
+		Timer& t = f.Timers[i];
+		if (!t.Ended && (t.Name == name || std::strcmp(t.Name, name) == 0))
+		{
+			t.Ended = true;
+			return 2 * (std::uint32_t)i + 1;
+		}
+	}
+	return Invalid;
+}
+
+std::uint32_t GpuTimerTracker::UsedQueries()const
+{
+	return 2 * (std::uint32_t)mFrames[mRecording].Timers.size();
+}
+
+void GpuTimerTracker::EndFrame(std::uint64_t fence)
+{
+	Frame& f = mFrames[mRecording];
+	f.State = FrameState::Pending;
+	f.Fence = fence;
+	mRecording = Invalid;
+}
+
+bool GpuTimerTracker::NextReady(std::uint64_t completedFence, std::uint32_t& frame)const
+{
+	bool found = false;
+	for (std::uint32_t i = 0; i < (std::uint32_t)mFrames.size(); ++i)
+	{
+		const Frame& f = mFrames[i];
+		if (f.State == FrameState::Pending && f.Fence <= completedFence &&
+			(!found || f.Fence < mFrames[frame].Fence))
+		{
+			frame = i;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void GpuTimerTracker::Resolve(std::uint32_t frame, const std::uint64_t* timestamps, std::uint64_t frequency,
+	std::vector<GpuTimerSample>& samples)
+{
+	Frame& f = mFrames[frame];
+	samples.clear();
+
+	for (std::size_t i = 0; i < f.Timers.size(); ++i)
+	{
+		const Timer& t = f.Timers[i];
+		if (!t.Ended)
+		{
+			++mDropped;
+			continue;
+		}
+
+		GpuTimerSample sample;
+		sample.Name = t.Name;
+		sample.Begin = timestamps[2 * i];
+		sample.End = timestamps[2 * i + 1];
+
+		// A timer can straddle a timestamp counter reset (e.g. a GPU power-state change);
+		// such a sample is meaningless, so it is reported as zero.
+		std::uint64_t ticks = (sample.End > sample.Begin) ? sample.End - sample.Begin : 0;
+		sample.Milliseconds = (frequency == 0) ? 0.0 : 1000.0 * (double)ticks / (double)frequency;
+
+		samples.push_back(sample);
+		mHistory.Add(t.Name, sample.Milliseconds);
+	}
+
+	f.State = FrameState::Free;
+	f.Timers.clear();
+}
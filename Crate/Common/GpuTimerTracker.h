@@ -0,0 +1,119 @@
+//***************************************************************************************
+// GpuTimerTracker.h
+//
+// Platform-independent bookkeeping for GPU timestamp queries.  Each frame slot (one per
+// FrameResource) owns 2 * MaxTimers queries: timer i writes query 2i when it begins and
+// 2i+1 when it ends.  Once the frame's fence completes its resolved timestamps are
+// turned into milliseconds and appended to a rolling history per timer name.
+//
+// GpuTimer issues the actual queries and readbacks.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct GpuTimerSample
+{
+	const char* Name = nullptr;
+	std::uint64_t Begin = 0;   // raw GPU ticks
+	std::uint64_t End = 0;
+	double Milliseconds = 0.0;
+};
+
+// Last HistoryLength values of each named timer.
+class GpuTimingHistory
+{
+public:
+	static const std::uint32_t HistoryLength = 128;
+
+	void Add(const char* name, double milliseconds);
+
+	std::size_t SeriesCount()const { return mSeries.size(); }
+	const char* Name(std::size_t series)const { return mSeries[series].Name; }
+
+	double Latest(std::size_t series)const;
+	double Average(std::size_t series)const;
+	double Max(std::size_t series)const;
+
+	// "opaque 1.20 ms, transparent 0.31 ms" using the averages.
+	std::string Summary()const;
+
+private:
+	struct Series
+	{
+		const char* Name = nullptr;
+		double Values[HistoryLength];
+		std::uint32_t Count = 0;   // values written, saturating at HistoryLength
+		std::uint32_t Next = 0;
+	};
+
+	std::vector<Series> mSeries;
+};
+
+class GpuTimerTracker
+{
+public:
+	static const std::uint32_t Invalid = 0xffffffff;
+
+	GpuTimerTracker(std::uint32_t frameCount, std::uint32_t maxTimersPerFrame);
+
+	std::uint32_t FrameCount()const { return (std::uint32_t)mFrames.size(); }
+	std::uint32_t QueriesPerFrame()const { return 2 * mMaxTimers; }
+
+	// Starts recording into a frame slot.  Anything still pending in it is dropped.
+	void BeginFrame(std::uint32_t frame);
+
+	// Return the query index to write, or Invalid once the frame is out of timers.
+	std::uint32_t BeginTimer(const char* name);
+	std::uint32_t EndTimer(const char* name);
+
+	// Queries [0, UsedQueries()) of the recording frame need resolving.
+	std::uint32_t UsedQueries()const;
+
+	// The recording frame was submitted and is done once fence completes.
+	void EndFrame(std::uint64_t fence);
+
+	// Oldest pending frame whose fence has completed.
+	bool NextReady(std::uint64_t completedFence, std::uint32_t& frame)const;
+
+	// Converts a ready frame's timestamps into samples, adds them to the history and
+	// frees the slot.  timestamps holds at least UsedQueries() values for that frame.
+	void Resolve(std::uint32_t frame, const std::uint64_t* timestamps, std::uint64_t frequency,
+		std::vector<GpuTimerSample>& samples);
+
+	const GpuTimingHistory& History()const { return mHistory; }
+
+	// Timers that did not fit in a frame, or were never ended.
+	std::uint64_t DroppedTimers()const { return mDropped; }
+
+private:
+	enum class FrameState
+	{
+		Free,
+		Recording,
+		Pending
+	};
+
+	struct Timer
+	{
+		const char* Name;
+		bool Ended;
+	};
+
+	struct Frame
+	{
+		FrameState State = FrameState::Free;
+		std::uint64_t Fence = 0;
+		std::vector<Timer> Timers;
+	};
+
+private:
+	std::uint32_t mMaxTimers;
+	std::vector<Frame> mFrames;
+	std::uint32_t mRecording = Invalid;
+	std::uint64_t mDropped = 0;
+	GpuTimingHistory mHistory;
+};
@@ -0,0 +1,51 @@
+//***************************************************************************************
+// Hash.h
+//
+// 64-bit FNV-1a hashing used for cache keys.  Not cryptographic; it only needs to be
+// stable across runs and platforms so keys written to disk stay valid.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace Hash
+{
+	const std::uint64_t FnvOffsetBasis = 14695981039346656037ull;
+	const std::uint64_t FnvPrime = 1099511628211ull;
+
+	inline std::uint64_t Fnv1a(const void* data, std::size_t size, std::uint64_t seed = FnvOffsetBasis)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		std::uint64_t h = seed;
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			h ^= bytes[i];
+			h *= FnvPrime;
+		}
+		return h;
+	}
+
+	inline std::uint64_t Fnv1a(const std::string& s, std::uint64_t seed = FnvOffsetBasis)
+	{
+		// Hash the length too so that ("ab","c") and ("a","bc") differ when chained.
+		std::uint64_t len = s.size();
+		return Fnv1a(s.data(), s.size(), Fnv1a(&len, sizeof(len), seed));
+	}
+
+	template<typename T>
+	inline std::uint64_t Combine(std::uint64_t seed, const T& value)
+	{
+		return Fnv1a(&value, sizeof(T), seed);
+	}
+
+	inline std::string ToHex(std::uint64_t h)
+	{
+		char buffer[17];
+		std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)h);
+		return std::string(buffer);
+	}
+}
@@ -0,0 +1,239 @@
+#include "InputRecording.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+	const char Magic[4] = { 'C', 'R', 'I', 'N' };
+	const std::size_t HeaderSize = 20;
+
+	enum StepFlags : std::uint8_t
+	{
+		ChangedKeys = 0x1,
+		MouseMoved = 0x2,
+		ChangedCamera = 0x4
+	};
+
+	static_assert((std::uint32_t)InputKey::Count <= 16, "key bits are stored in 16 bits");
+
+	void WriteU32(std::vector<std::uint8_t>& data, std::uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+			data.push_back((std::uint8_t)(value >> (8 * i)));
+	}
+
+	void WriteF32(std::vector<std::uint8_t>& data, float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		WriteU32(data, bits);
+	}
+
+	// Bounds-checked little-endian reads.  Once a read runs past the end every later
+	// read fails too, so callers only need to check Ok() at the end.
+	class Reader
+	{
+	public:
+		Reader(const std::uint8_t* data, std::size_t size) : mData(data), mSize(size) {}
+
+		std::uint32_t ReadBytes(int count)
+		{
+			if (mOffset + count > mSize)
+			{
+				mOffset = mSize + 1;
+				return 0;
+			}
+
+			std::uint32_t value = 0;
+			for (int i = 0; i < count; ++i)
+				value |= (std::uint32_t)mData[mOffset++] << (8 * i);
+			return value;
+		}
+
+		std::uint8_t U8() { return (std::uint8_t)ReadBytes(1); }
+		std::uint16_t U16() { return (std::uint16_t)ReadBytes(2); }
+		std::uint32_t U32() { return ReadBytes(4); }
+
+		float F32()
+		{
+			std::uint32_t bits = U32();
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+		bool Ok()const { return mOffset <= mSize; }
+		bool AtEnd()const { return mOffset == mSize; }
+
+	private:
+		const std::uint8_t* mData;
+		std::size_t mSize;
+		std::size_t mOffset = 0;
+	};
+}
+
+void InputFrame::SetDown(InputKey key, bool down)
+{
+	std::uint32_t bit = 1u << (std::uint32_t)key;
+	Keys = down ? (Keys | bit) : (Keys & ~bit);
+}
+
+bool InputFrame::operator==(const InputFrame& rhs)const
+{
+	return Keys == rhs.Keys && MouseDx == rhs.MouseDx && MouseDy == rhs.MouseDy && Camera == rhs.Camera;
+}
+
+void InputRecording::Serialize(std::vector<std::uint8_t>& data)const
+{
+	data.clear();
+	data.reserve(HeaderSize + Frames.size());
+	data.insert(data.end(), Magic, Magic + 4);
+	WriteU32(data, Version);
+	WriteU32(data, Seed);
+	WriteF32(data, TimeStep);
+	WriteU32(data, (std::uint32_t)Frames.size());
+
+	// Deltas start from a default frame, so the first step records whatever differs.
+	InputFrame previous;
+	for (const InputFrame& frame : Frames)
+	{
+		std::uint8_t flags = 0;
+		if (frame.Keys != previous.Keys)
+			flags |= ChangedKeys;
+		if (frame.MouseDx != 0.0f || frame.MouseDy != 0.0f)
+			flags |= MouseMoved;
+		if (frame.Camera != previous.Camera)
+			flags |= ChangedCamera;
+
+		data.push_back(flags);
+		if (flags & ChangedKeys)
+		{
+			data.push_back((std::uint8_t)frame.Keys);
+			data.push_back((std::uint8_t)(frame.Keys >> 8));
+		}
+		if (flags & MouseMoved)
+		{
+			WriteF32(data, frame.MouseDx);
+			WriteF32(data, frame.MouseDy);
+		}
+		if (flags & ChangedCamera)
+			data.push_back((std::uint8_t)frame.Camera);
+
+		previous = frame;
+	}
+}
+
+bool InputRecording::Deserialize(const std::uint8_t* data, std::size_t size)
+{
+	Frames.clear();
+	if (size < HeaderSize || std::memcmp(data, Magic, 4) != 0)
+		return false;
+
+	Reader reader(data + 4, size - 4);
+	if (reader.U32() != Version)
+		return false;
+
+	Seed = reader.U32();
+	TimeStep = reader.F32();
+	std::uint32_t count = reader.U32();
+
+	// Every step takes at least one byte, which bounds a corrupt count.
+	if (!(TimeStep > 0.0f) || count > size - HeaderSize)
+		return false;
+
+	Frames.resize(count);
+	InputFrame previous;
+	bool valid = true;
+	for (InputFrame& frame : Frames)
+	{
+		std::uint8_t flags = reader.U8();
+		frame.Keys = (flags & ChangedKeys) ? reader.U16() : previous.Keys;
+		if (flags & MouseMoved)
+		{
+			frame.MouseDx = reader.F32();
+			frame.MouseDy = reader.F32();
+		}
+		frame.Camera = (flags & ChangedCamera) ? (CameraMode)reader.U8() : previous.Camera;
+
+		// The last step's camera byte can be bad with the reader exactly at the end.
+		if (!reader.Ok() || frame.Camera >= CameraMode::Count)
+		{
+			valid = false;
+			break;
+		}
+		previous = frame;
+	}
+
+	if (!valid || !reader.AtEnd())
+	{
+		Frames.clear();
+		return false;
+	}
+	return true;
+}
+
+bool InputRecording::Save(const std::string& path)const
+{
+	std::vector<std::uint8_t> data;
+	Serialize(data);
+
+	std::ofstream fout(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!fout)
+		return false;
+
+	fout.write((const char*)data.data(), data.size());
+	return (bool)fout;
+}
+
+bool InputRecording::Load(const std::string& path)
+{
+	std::ifstream fin(path.c_str(), std::ios::binary);
+	if (!fin)
+	{
+		Frames.clear();
+		return false;
+	}
+
+	std::vector<std::uint8_t> data((std::istreambuf_iterator<char>(fin)), std::istreambuf_iterator<char>());
+	return Deserialize(data.data(), data.size());
+}
+
+bool InputPlayer::Next(InputFrame& frame)
+{
+	if (Finished())
+		return false;
+
+	frame = mRecording.Frames[mPosition++];
+	return true;
+}
+
+FixedTimestep::FixedTimestep(float step, int maxSteps) :
+	mStep(step),
+	mMaxSteps(maxSteps)
+{
+}
+
+int FixedTimestep::Advance(double seconds)
+{
+	mAccumulator += seconds;
+
+	int steps = (int)(mAccumulator / mStep);
+	mAccumulator -= steps * (double)mStep;
+
+	if (steps > mMaxSteps)
+	{
+		mDroppedSteps += steps - mMaxSteps;
+		steps = mMaxSteps;
+	}
+
+	mSteps += steps;
+	return steps;
+}
+
+void FixedTimestep::Reset()
+{
+	mAccumulator = 0.0;
+	mSteps = 0;
+	mDroppedSteps = 0;
+}
@@ -0,0 +1,138 @@
+//***************************************************************************************
+// InputRecording.h
+//
+// Per-step input (keys, mouse-look, camera mode) and the world seed, recorded to a
+// compact binary file so a session can be played back exactly.  Playback is only
+// deterministic if the simulation is stepped with the recording's fixed time step,
+// which FixedTimestep provides from variable frame times.
+//
+// File layout, little-endian:
+//
+//   "CRIN"  u32 version  u32 seed  f32 time step  u32 step count
+//   per step: u8 flags, then the fields the flags say changed:
+//     ChangedKeys   u16 key bits
+//     MouseMoved    f32 dx, f32 dy
+//     ChangedCamera u8 camera mode
+//
+// A step whose keys and camera match the previous one and has no mouse-look is one
+// byte.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class InputKey : std::uint32_t
+{
+	Forward = 0,    // W
+	Back,           // S
+	StrafeLeft,     // A
+	StrafeRight,    // D
+	FlyUp,          // E
+	FlyDown,        // Q
+	WireframeOn,    // F
+	WireframeOff,   // G
+	CharForward,    // up arrow
+	CharBack,       // down arrow
+	CharLeft,       // left arrow
+	CharRight,      // right arrow
+	FirstPerson,    // 1
+	ThirdPerson,    // 2
+	FreeCamera,     // 3
+	Dig,            // X
+	Count
+};
+
+enum class CameraMode : std::uint8_t
+{
+	FirstPerson = 0,
+	ThirdPerson,
+	Free,
+	Count
+};
+
+struct InputFrame
+{
+	std::uint32_t Keys = 0;
+
+	// Mouse-look during the step, in radians.
+	float MouseDx = 0.0f;
+	float MouseDy = 0.0f;
+
+	// Camera mode when the step started, before its keys are applied.
+	CameraMode Camera = CameraMode::ThirdPerson;
+
+	bool Down(InputKey key)const { return (Keys & (1u << (std::uint32_t)key)) != 0; }
+	void SetDown(InputKey key, bool down);
+
+	bool operator==(const InputFrame& rhs)const;
+	bool operator!=(const InputFrame& rhs)const { return !(*this == rhs); }
+};
+
+struct InputRecording
+{
+	static const std::uint32_t Version = 1;
+	static float DefaultTimeStep() { return 1.0f / 60.0f; }
+
+	std::uint32_t Seed = 0;
+	float TimeStep = DefaultTimeStep();
+	std::vector<InputFrame> Frames;
+
+	void Serialize(std::vector<std::uint8_t>& data)const;
+
+	// Returns false, leaving the recording empty, if the data is not a complete
+	// recording of this version.
+	bool Deserialize(const std::uint8_t* data, std::size_t size);
+
+	bool Save(const std::string& path)const;
+	bool Load(const std::string& path);
+
+	double Duration()const { return Frames.size() * (double)TimeStep; }
+};
+
+// Hands out the frames of a recording one step at a time.
+class InputPlayer
+{
+public:
+	explicit InputPlayer(const InputRecording& recording) : mRecording(recording) {}
+
+	// Returns false once every frame has been played.
+	bool Next(InputFrame& frame);
+
+	bool Finished()const { return mPosition >= mRecording.Frames.size(); }
+	std::size_t Position()const { return mPosition; }
+	const InputRecording& Recording()const { return mRecording; }
+
+private:
+	const InputRecording& mRecording;
+	std::size_t mPosition = 0;
+};
+
+// Turns variable frame times into a whole number of fixed steps.  Time left over is
+// carried into the next frame; a frame that would need more than maxSteps steps (a
+// hitch, a breakpoint) runs maxSteps and drops the rest, so the simulation never
+// spirals trying to catch up.
+class FixedTimestep
+{
+public:
+	explicit FixedTimestep(float step = InputRecording::DefaultTimeStep(), int maxSteps = 8);
+
+	// Adds a frame's worth of time and returns how many steps to simulate.
+	int Advance(double seconds);
+
+	void Reset();
+
+	float Step()const { return mStep; }
+	std::uint64_t Steps()const { return mSteps; }
+	std::uint64_t DroppedSteps()const { return mDroppedSteps; }
+
+private:
+	float mStep;
+	int mMaxSteps;
+	double mAccumulator = 0.0;
+	std::uint64_t mSteps = 0;
+	std::uint64_t mDroppedSteps = 0;
+};
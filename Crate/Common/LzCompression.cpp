@@ -0,0 +1,139 @@
+#include "LzCompression.h"
+#include <cstring>
+
+namespace
+{
+	const int HashBits = 12;
+	const std::size_t MinMatch = 4;
+	const std::size_t MaxOffset = 65535;
+
+	std::uint32_t Read32(const std::uint8_t* p)
+	{
+		std::uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	std::uint32_t HashOf(std::uint32_t v)
+	{
+		return (v * 2654435761u) >> (32 - HashBits);
+	}
+
+	void PutLength(std::size_t length, std::vector<std::uint8_t>& out)
+	{
+		while (length >= 255)
+		{
+			out.push_back(255);
+			length -= 255;
+		}
+		out.push_back((std::uint8_t)length);
+	}
+
+	void PutSequence(const std::uint8_t* literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength,
+		std::vector<std::uint8_t>& out)
+	{
+		std::size_t matchCode = (matchLength >= MinMatch) ? matchLength - MinMatch : 0;
+		std::uint8_t token = (std::uint8_t)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+		out.push_back(token);
+		if (literalCount >= 15)
+			PutLength(literalCount - 15, out);
+		out.insert(out.end(), literals, literals + literalCount);
+
+		if (matchLength == 0)
+			return;
+		out.push_back((std::uint8_t)offset);
+		out.push_back((std::uint8_t)(offset >> 8));
+		if (matchCode >= 15)
+			PutLength(matchCode - 15, out);
+	}
+
+	bool GetLength(const std::uint8_t*& in, const std::uint8_t* end, std::size_t& length)
+	{
+		std::uint8_t b;
+		do
+		{
+			if (in == end)
+				return false;
+			b = *in++;
+			length += b;
+		} while (b == 255);
+		return true;
+	}
+}
+
+void Lz::Compress(const std::uint8_t* src, std::size_t size, std::vector<std::uint8_t>& out)
+{
+	// Positions + 1, so 0 means empty.
+	std::uint32_t table[1 << HashBits] = {};
+
+	std::size_t anchor = 0;
+	std::size_t i = 0;
+	while (size >= MinMatch && i + MinMatch <= size)
+	{
+		std::uint32_t v = Read32(src + i);
+		std::uint32_t h = HashOf(v);
+		std::size_t candidate = table[h];
+		table[h] = (std::uint32_t)(i + 1);
+
+		if (candidate == 0 || i - (candidate - 1) > MaxOffset || Read32(src + candidate - 1) != v)
+		{
+			++i;
+			continue;
+		}
+
+		std::size_t from = candidate - 1;
+		std::size_t length = MinMatch;
+		while (i + length < size && src[from + length] == src[i + length])
+			++length;
+
+		PutSequence(src + anchor, i - anchor, i - from, length, out);
+		i += length;
+		anchor = i;
+	}
+
+	PutSequence(src + anchor, size - anchor, 0, 0, out);
+}
+
+bool Lz::Decompress(const std::uint8_t* src, std::size_t size, std::uint8_t* dst, std::size_t dstSize)
+{
+	const std::uint8_t* in = src;
+	const std::uint8_t* end = src + size;
+	std::size_t written = 0;
+
+	while (in < end)
+	{
+		std::uint8_t token = *in++;
+
+		std::size_t literals = token >> 4;
+		if (literals == 15 && !GetLength(in, end, literals))
+			return false;
+		if (literals > (std::size_t)(end - in) || literals > dstSize - written)
+			return false;
+		std::memcpy(dst + written, in, literals);
+		in += literals;
+		written += literals;
+
+		// The literal-only sequence at the end.
+		if (in == end)
+			break;
+
+		if (end - in < 2)
+			return false;
+		std::size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+		std::size_t length = token & 15;
+		if (length == 15 && !GetLength(in, end, length))
+			return false;
+		length += MinMatch;
+
+		if (offset == 0 || offset > written || length > dstSize - written)
+			return false;
+
+		// Byte by byte: a match may overlap the bytes it produces.
+		const std::uint8_t* from = dst + written - offset;
+		for (std::size_t k = 0; k < length; ++k)
+			dst[written + k] = from[k];
+		written += length;
+	}
+	return written == dstSize;
+}
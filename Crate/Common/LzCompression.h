@@ -0,0 +1,32 @@
+//***************************************************************************************
+// LzCompression.h
+//
+// Small LZ77 byte compressor in the style of LZ4: greedy matches found through a hash
+// of the next four bytes, stored as sequences of
+//
+//   token      high nibble literal count, low nibble match length - 4 (15 = more follow)
+//   [length]   extra literal count bytes, 255 each until one below 255
+//   literals
+//   offset     2 bytes, little endian, 1..65535 back from the current position
+//   [length]   extra match length bytes
+//
+// The last sequence has literals only.  Fast rather than tight; the decoder checks
+// every length and offset against its buffers, so corrupt input fails instead of
+// overrunning.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Lz
+{
+	// Appends the compressed form of src to out.
+	void Compress(const std::uint8_t* src, std::size_t size, std::vector<std::uint8_t>& out);
+
+	// Decodes exactly dstSize bytes into dst.  Returns false if src is malformed or does
+	// not decode to exactly dstSize bytes.
+	bool Decompress(const std::uint8_t* src, std::size_t size, std::uint8_t* dst, std::size_t dstSize);
+}
@@ -0,0 +1,115 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::wstring& path)
+{
+	Close();
+
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	mFile = file;
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (std::uint64_t)size.QuadPart > (std::size_t)-1)
+	{
+		DWORD error = GetLastError();
+		Close();
+		SetLastError(error != ERROR_SUCCESS ? error : ERROR_HANDLE_EOF);
+		return false;
+	}
+
+	mMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mMapping != nullptr)
+		mData = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (mData == nullptr)
+	{
+		DWORD error = GetLastError();
+		Close();
+		SetLastError(error);
+		return false;
+	}
+
+	mSize = (std::size_t)size.QuadPart;
+	return true;
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	return Open(std::wstring(path.begin(), path.end()));
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+		UnmapViewOfFile(mData);
+	if (mMapping != nullptr)
+		CloseHandle(mMapping);
+	if (mFile != nullptr)
+		CloseHandle(mFile);
+
+	mData = nullptr;
+	mSize = 0;
+	mMapping = nullptr;
+	mFile = nullptr;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) == 0 && info.st_size > 0)
+	{
+		void* data = mmap(nullptr, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			mData = static_cast<const std::uint8_t*>(data);
+			mSize = (std::size_t)info.st_size;
+		}
+	}
+
+	// The mapping keeps the file alive on its own.
+	close(fd);
+	return mData != nullptr;
+}
+
+bool MappedFile::Open(const std::wstring& path)
+{
+	// Asset paths are ASCII.
+	return Open(std::string(path.begin(), path.end()));
+}
+
+void MappedFile::Close()
+{
+	if (mData != nullptr)
+		munmap(const_cast<std::uint8_t*>(mData), mSize);
+
+	mData = nullptr;
+	mSize = 0;
+}
+
+#endif
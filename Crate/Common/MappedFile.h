@@ -0,0 +1,43 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file.  The contents are paged in by the OS as
+// they are touched, so a loader can parse a file in place and copy from it straight
+// into its destination without reading it into a heap buffer first.
+//
+// Uses CreateFileMapping/MapViewOfFile on Windows and mmap elsewhere.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	// Maps the file, closing any file mapped before.  Empty files fail to map.  On
+	// Windows a failure leaves the reason in GetLastError.
+	bool Open(const std::wstring& path);
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen()const { return mData != nullptr; }
+	const std::uint8_t* Data()const { return mData; }
+	std::size_t Size()const { return mSize; }
+
+private:
+	const std::uint8_t* mData = nullptr;
+	std::size_t mSize = 0;
+
+#if defined(_WIN32)
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#endif
+};
@@ -0,0 +1,203 @@
+#include "MemoryTracker.h"
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	struct AtomicCounters
+	{
+		std::atomic<std::uint64_t> LiveBytes{ 0 };
+		std::atomic<std::uint64_t> PeakBytes{ 0 };
+		std::atomic<std::uint64_t> LiveAllocations{ 0 };
+		std::atomic<std::uint64_t> TotalAllocations{ 0 };
+	};
+
+	const int DomainCount = (int)MemoryDomain::Count;
+	const int CategoryCount = (int)MemoryCategory::Count;
+
+	AtomicCounters gCounters[DomainCount][CategoryCount];
+	AtomicCounters gTotals[DomainCount];
+
+	void RaisePeak(std::atomic<std::uint64_t>& peak, std::uint64_t value)
+	{
+		std::uint64_t current = peak.load(std::memory_order_relaxed);
+		while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	void Add(AtomicCounters& c, std::uint64_t bytes)
+	{
+		std::uint64_t live = c.LiveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		RaisePeak(c.PeakBytes, live);
+		c.LiveAllocations.fetch_add(1, std::memory_order_relaxed);
+		c.TotalAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Remove(AtomicCounters& c, std::uint64_t bytes)
+	{
+		c.LiveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+		c.LiveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	MemoryCounters Load(const AtomicCounters& c)
+	{
+		MemoryCounters result;
+		result.LiveBytes = c.LiveBytes.load(std::memory_order_relaxed);
+		result.PeakBytes = c.PeakBytes.load(std::memory_order_relaxed);
+		result.LiveAllocations = c.LiveAllocations.load(std::memory_order_relaxed);
+		result.TotalAllocations = c.TotalAllocations.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	double Megabytes(std::uint64_t bytes)
+	{
+		return bytes / (1024.0 * 1024.0);
+	}
+}
+
+void MemoryTracker::Allocate(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes)
+{
+	Add(gCounters[(int)domain][(int)category], bytes);
+	Add(gTotals[(int)domain], bytes);
+}
+
+void MemoryTracker::Free(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes)
+{
+	Remove(gCounters[(int)domain][(int)category], bytes);
+	Remove(gTotals[(int)domain], bytes);
+}
+
+MemoryCounters MemoryTracker::Counters(MemoryDomain domain, MemoryCategory category)
+{
+	return Load(gCounters[(int)domain][(int)category]);
+}
+
+std::uint64_t MemoryTracker::LiveBytes(MemoryDomain domain)
+{
+	return gTotals[(int)domain].LiveBytes.load(std::memory_order_relaxed);
+}
+
+std::uint64_t MemoryTracker::PeakBytes(MemoryDomain domain)
+{
+	return gTotals[(int)domain].PeakBytes.load(std::memory_order_relaxed);
+}
+
+const char* MemoryTracker::CategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::World:       return "world";
+	case MemoryCategory::Meshes:      return "meshes";
+	case MemoryCategory::Textures:    return "textures";
+	case MemoryCategory::Constants:   return "constants";
+	case MemoryCategory::Staging:     return "staging";
+	case MemoryCategory::Descriptors: return "descriptors";
+	case MemoryCategory::RenderItems: return "renderItems";
+	default:                          return "unknown";
+	}
+}
+
+const char* MemoryTracker::DomainName(MemoryDomain domain)
+{
+	return (domain == MemoryDomain::Cpu) ? "cpu" : "gpu";
+}
+
+std::string MemoryTracker::Report()
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(2);
+	for (int d = 0; d < DomainCount; ++d)
+	{
+		MemoryDomain domain = (MemoryDomain)d;
+		ss << "Memory (" << DomainName(domain) << "): " << Megabytes(LiveBytes(domain)) << " MB live, "
+			<< Megabytes(PeakBytes(domain)) << " MB peak\n";
+
+		for (int c = 0; c < CategoryCount; ++c)
+		{
+			MemoryCounters counters = Counters(domain, (MemoryCategory)c);
+			if (counters.TotalAllocations == 0)
+				continue;
+
+			ss << "  " << std::left << std::setw(12) << CategoryName((MemoryCategory)c) << std::right
+				<< Megabytes(counters.LiveBytes) << " MB live, " << Megabytes(counters.PeakBytes) << " MB peak, "
+				<< counters.LiveAllocations << " live / " << counters.TotalAllocations << " total allocations\n";
+		}
+	}
+	return ss.str();
+}
+
+std::string MemoryTracker::Summary()
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1) << "Memory:";
+	for (int d = 0; d < DomainCount; ++d)
+	{
+		MemoryDomain domain = (MemoryDomain)d;
+		ss << (d == 0 ? " " : " | ") << DomainName(domain) << ' ' << Megabytes(LiveBytes(domain))
+			<< " MB (peak " << Megabytes(PeakBytes(domain)) << ")";
+
+		for (int c = 0; c < CategoryCount; ++c)
+		{
+			std::uint64_t live = Counters(domain, (MemoryCategory)c).LiveBytes;
+			if (live > 0)
+				ss << ", " << CategoryName((MemoryCategory)c) << ' ' << Megabytes(live);
+		}
+	}
+	return ss.str();
+}
+
+TrackedMemory::TrackedMemory(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes)
+{
+	Reset(domain, category, bytes);
+}
+
+TrackedMemory::TrackedMemory(TrackedMemory&& rhs) :
+	mDomain(rhs.mDomain),
+	mCategory(rhs.mCategory),
+	mBytes(rhs.mBytes),
+	mActive(rhs.mActive)
+{
+	rhs.mActive = false;
+	rhs.mBytes = 0;
+}
+
+TrackedMemory& TrackedMemory::operator=(TrackedMemory&& rhs)
+{
+	if (this != &rhs)
+	{
+		Reset();
+		mDomain = rhs.mDomain;
+		mCategory = rhs.mCategory;
+		mBytes = rhs.mBytes;
+		mActive = rhs.mActive;
+		rhs.mActive = false;
+		rhs.mBytes = 0;
+	}
+	return *this;
+}
+
+TrackedMemory::~TrackedMemory()
+{
+	Reset();
+}
+
+void TrackedMemory::Reset(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes)
+{
+	Reset();
+	mDomain = domain;
+	mCategory = category;
+	mBytes = bytes;
+	mActive = true;
+	MemoryTracker::Allocate(domain, category, bytes);
+}
+
+void TrackedMemory::Reset()
+{
+	if (mActive)
+		MemoryTracker::Free(mDomain, mCategory, mBytes);
+
+	mActive = false;
+	mBytes = 0;
+}
@@ -0,0 +1,89 @@
+//***************************************************************************************
+// MemoryTracker.h
+//
+// Counts memory by category.  The code that owns each block of memory reports its size.
+// This does not hook malloc.  CPU and GPU memory are counted separately.  GPU sizes are
+// what GetResourceAllocationInfo says a resource occupies, not the size that was
+// requested.
+//
+// Owners normally hold a TrackedMemory, which gives its bytes back when it is destroyed
+// and so cannot leak a count.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+enum class MemoryDomain : int
+{
+	Cpu = 0,
+	Gpu,
+	Count
+};
+
+enum class MemoryCategory : int
+{
+	World = 0,     // block data
+	Meshes,        // vertex and index buffers and their system memory copies
+	Textures,
+	Constants,     // per-frame constant buffers
+	Staging,       // upload heaps
+	Descriptors,
+	RenderItems,
+	Count
+};
+
+struct MemoryCounters
+{
+	std::uint64_t LiveBytes = 0;
+	std::uint64_t PeakBytes = 0;
+	std::uint64_t LiveAllocations = 0;
+	std::uint64_t TotalAllocations = 0;
+};
+
+class MemoryTracker
+{
+public:
+	static void Allocate(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes);
+	static void Free(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes);
+
+	static MemoryCounters Counters(MemoryDomain domain, MemoryCategory category);
+
+	// Across all categories.  The peak is of the total, not the sum of category peaks.
+	static std::uint64_t LiveBytes(MemoryDomain domain);
+	static std::uint64_t PeakBytes(MemoryDomain domain);
+
+	static const char* CategoryName(MemoryCategory category);
+	static const char* DomainName(MemoryDomain domain);
+
+	// One line per domain and category with live, peak and allocation counts.
+	static std::string Report();
+
+	// "Memory: cpu 12.3 MB (peak 40.1), world 1.0, ... | gpu 80.2 MB (peak 96.0), ..."
+	static std::string Summary();
+};
+
+class TrackedMemory
+{
+public:
+	TrackedMemory() = default;
+	TrackedMemory(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes);
+	TrackedMemory(TrackedMemory&& rhs);
+	TrackedMemory& operator=(TrackedMemory&& rhs);
+	TrackedMemory(const TrackedMemory& rhs) = delete;
+	TrackedMemory& operator=(const TrackedMemory& rhs) = delete;
+	~TrackedMemory();
+
+	// Replaces whatever was counted before.
+	void Reset(MemoryDomain domain, MemoryCategory category, std::uint64_t bytes);
+	void Reset();
+
+	std::uint64_t Bytes()const { return mBytes; }
+
+private:
+	MemoryDomain mDomain = MemoryDomain::Cpu;
+	MemoryCategory mCategory = MemoryCategory::World;
+	std::uint64_t mBytes = 0;
+	bool mActive = false;
+};
@@ -0,0 +1,214 @@
+#include "MipResidency.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// A resident mip that could be dropped.  Tier 0 was not wanted in the last KeepFrames
+	// frames, tier 1 was but not this frame, tier 2 is wanted now.
+	struct Droppable
+	{
+		std::uint32_t Tier;
+		std::uint64_t LastUsedFrame;
+		std::uint32_t Texture;
+		std::uint32_t Mip;
+		std::uint64_t Bytes;
+	};
+
+	// Oldest and least wanted first.  A texture's mips share LastUsedFrame and their tier
+	// never decreases towards the tail, so its finer mips always come before its coarser.
+	bool DropsFirst(const Droppable& a, const Droppable& b)
+	{
+		if (a.Tier != b.Tier)
+			return a.Tier < b.Tier;
+		if (a.LastUsedFrame != b.LastUsedFrame)
+			return a.LastUsedFrame < b.LastUsedFrame;
+		if (a.Texture != b.Texture)
+			return a.Texture < b.Texture;
+		return a.Mip < b.Mip;
+	}
+}
+
+std::uint32_t MipForDistance(float texelsPerUnit, float distance, float pixelsPerUnit)
+{
+	if (distance <= 0.0f || pixelsPerUnit <= 0.0f)
+		return 0;
+
+	// Past one texel per pixel, each halving of the screen size skips a mip.
+	float texelsPerPixel = texelsPerUnit * distance / pixelsPerUnit;
+	if (texelsPerPixel <= 1.0f)
+		return 0;
+	return (std::uint32_t)(std::min)(std::floor(std::log2(texelsPerPixel)), 31.0f);
+}
+
+MipResidency::MipResidency(const MipResidencyParams& params) :
+	mParams(params)
+{
+	if (mParams.MaxLoadsInFlight == 0)
+		mParams.MaxLoadsInFlight = 1;
+}
+
+std::uint32_t MipResidency::AddTexture(const std::vector<std::uint64_t>& mipBytes, std::uint32_t tailMip)
+{
+	assert(!mipBytes.empty());
+
+	TextureState texture;
+	texture.MipBytes = mipBytes;
+	texture.TailMip = (std::min)(tailMip, (std::uint32_t)mipBytes.size() - 1);
+	texture.Resident = texture.TailMip;
+	texture.Wanted = texture.TailMip;
+	texture.Held = texture.TailMip;
+	texture.HeldFrame = mFrame;
+
+	for (std::uint32_t m = texture.TailMip; m < (std::uint32_t)mipBytes.size(); ++m)
+	{
+		mTailBytes += mipBytes[m];
+		mResidentBytes += mipBytes[m];
+	}
+
+	mTextures.push_back(texture);
+	return (std::uint32_t)mTextures.size() - 1;
+}
+
+void MipResidency::BeginFrame()
+{
+	++mFrame;
+	for (TextureState& t : mTextures)
+	{
+		t.Wanted = t.TailMip;
+		t.Uses = 0;
+	}
+}
+
+void MipResidency::Request(std::uint32_t texture, std::uint32_t mip)
+{
+	TextureState& t = mTextures[texture];
+	t.Wanted = (std::min)(t.Wanted, (std::min)(mip, t.TailMip));
+	t.LastUsedFrame = mFrame;
+	++t.Uses;
+}
+
+void MipResidency::Update(MipResidencyUpdate& changes)
+{
+	changes.Clear();
+
+	for (TextureState& t : mTextures)
+	{
+		if (t.Wanted <= t.Held || mFrame - t.HeldFrame >= mParams.KeepFrames)
+		{
+			t.Held = t.Wanted;
+			t.HeldFrame = mFrame;
+		}
+	}
+
+	// The budget may have shrunk below what is already resident.
+	std::uint64_t used = mResidentBytes + mLoadingBytes;
+	if (used > mParams.BudgetBytes)
+		DropMips(used - mParams.BudgetBytes, NoMip, true, changes);
+
+	// The textures furthest from what they want go first, then the most used.
+	std::vector<std::uint32_t> order;
+	for (std::uint32_t i = 0; i < (std::uint32_t)mTextures.size(); ++i)
+	{
+		const TextureState& t = mTextures[i];
+		if (t.Loading == NoMip && t.Wanted < t.Resident)
+			order.push_back(i);
+	}
+	std::sort(order.begin(), order.end(), [this](std::uint32_t a, std::uint32_t b)
+	{
+		const TextureState& ta = mTextures[a];
+		const TextureState& tb = mTextures[b];
+		std::uint32_t deficitA = ta.Resident - ta.Wanted;
+		std::uint32_t deficitB = tb.Resident - tb.Wanted;
+		if (deficitA != deficitB)
+			return deficitA > deficitB;
+		if (ta.Uses != tb.Uses)
+			return ta.Uses > tb.Uses;
+		return a < b;
+	});
+
+	std::uint64_t started = 0;
+	for (std::uint32_t i : order)
+	{
+		if (mLoadsInFlight >= mParams.MaxLoadsInFlight)
+			break;
+
+		TextureState& t = mTextures[i];
+		std::uint32_t mip = t.Resident - 1;
+		std::uint64_t bytes = t.MipBytes[mip];
+		if (started > 0 && started + bytes > mParams.MaxLoadBytesPerUpdate)
+			continue;
+
+		used = mResidentBytes + mLoadingBytes + bytes;
+		if (used > mParams.BudgetBytes && !DropMips(used - mParams.BudgetBytes, i, false, changes))
+		{
+			++mStats.DeferredLoads;
+			continue;
+		}
+
+		t.Loading = mip;
+		mLoadingBytes += bytes;
+		++mLoadsInFlight;
+		started += bytes;
+		changes.Loads.push_back({ i, mip });
+
+		++mStats.Loads;
+		if (mip < 64 && (t.DroppedMips & (1ull << mip)) != 0)
+			++mStats.Reloads;
+	}
+}
+
+bool MipResidency::DropMips(std::uint64_t bytes, std::uint32_t exclude, bool takeWanted, MipResidencyUpdate& changes)
+{
+	std::vector<Droppable> candidates;
+	for (std::uint32_t i = 0; i < (std::uint32_t)mTextures.size(); ++i)
+	{
+		const TextureState& t = mTextures[i];
+		if (i == exclude || t.Loading != NoMip)
+			continue;
+
+		for (std::uint32_t m = t.Resident; m < t.TailMip; ++m)
+		{
+			std::uint32_t tier = (m < t.Held) ? 0 : (m < t.Wanted) ? 1 : 2;
+			if (tier == 2 && !takeWanted)
+				break;
+			candidates.push_back({ tier, t.LastUsedFrame, i, m, t.MipBytes[m] });
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), DropsFirst);
+
+	size_t count = 0;
+	std::uint64_t freed = 0;
+	while (count < candidates.size() && freed < bytes)
+		freed += candidates[count++].Bytes;
+
+	// Making room for a load is all or nothing; shrinking to the budget takes what it can.
+	if (freed < bytes && !takeWanted)
+		return false;
+
+	for (size_t c = 0; c < count; ++c)
+	{
+		TextureState& t = mTextures[candidates[c].Texture];
+		assert(t.Resident == candidates[c].Mip);
+		t.Resident = candidates[c].Mip + 1;
+		t.DroppedMips |= (candidates[c].Mip < 64) ? (1ull << candidates[c].Mip) : 0;
+		mResidentBytes -= candidates[c].Bytes;
+		changes.Drops.push_back({ candidates[c].Texture, candidates[c].Mip });
+		++mStats.Drops;
+	}
+	return freed >= bytes;
+}
+
+void MipResidency::FinishLoad(std::uint32_t texture)
+{
+	TextureState& t = mTextures[texture];
+	assert(t.Loading != NoMip);
+
+	std::uint64_t bytes = t.MipBytes[t.Loading];
+	t.Resident = t.Loading;
+	t.Loading = NoMip;
+	mLoadingBytes -= bytes;
+	mResidentBytes += bytes;
+	--mLoadsInFlight;
+}
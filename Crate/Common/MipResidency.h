@@ -0,0 +1,133 @@
+//***************************************************************************************
+// MipResidency.h
+//
+// Decides which mips of streamed textures are resident, kept free of Direct3D so that
+// camera paths can be simulated without a device (Tools/MipStreamingSim.cpp).  Mip 0 is
+// the most detailed.  Each texture's tail, the mips from its TailMip on, is resident
+// for good; finer mips are loaded one at a time, coarse to fine, while something on
+// screen wants them, and dropped one at a time, fine to coarse, when the budget needs
+// the room.
+//
+// Every frame the renderer calls BeginFrame, then Request for each use of a texture
+// with the finest mip that use can show, then Update for the loads to start and the
+// mips to drop.  A load counts against the budget from the moment it starts and only
+// becomes resident when FinishLoad is called.  A dropped mip leaves the budget at once;
+// the caller must stop sampling it before the memory is reused.
+//
+// Room for a load is only taken from mips nothing wanted this frame, oldest use first,
+// so two textures in view never evict each other.  Mips wanted in the last KeepFrames
+// frames go after those wanted longer ago.  Mips in use are only dropped when the
+// budget itself shrinks below what is resident.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct MipResidencyParams
+{
+	std::uint64_t BudgetBytes = 32ull * 1024 * 1024;
+
+	// The loads one Update starts add up to at most MaxLoadBytesPerUpdate, except that
+	// the first always starts, however large.
+	std::uint32_t MaxLoadsInFlight = 4;
+	std::uint64_t MaxLoadBytesPerUpdate = 4ull * 1024 * 1024;
+
+	// How long a texture's finest requested mip counts as recently wanted.
+	std::uint32_t KeepFrames = 60;
+};
+
+struct MipChange
+{
+	std::uint32_t Texture;
+	std::uint32_t Mip;
+};
+
+struct MipResidencyUpdate
+{
+	std::vector<MipChange> Loads;   // start loading Mip
+	std::vector<MipChange> Drops;   // stop sampling Mip, then free it; finest first
+
+	void Clear() { Loads.clear(); Drops.clear(); }
+};
+
+struct MipResidencyStats
+{
+	std::uint64_t Loads = 0;
+	std::uint64_t Drops = 0;
+	std::uint64_t Reloads = 0;        // loads of a mip that had been dropped before
+	std::uint64_t DeferredLoads = 0;  // wanted loads that found no room in the budget
+};
+
+// The finest mip worth sampling on a surface covered by texelsPerUnit texels per world
+// unit, seen from distance world units away.  pixelsPerUnit is the screen size of one
+// world unit at distance 1: half the viewport height times the projection's y scale.
+std::uint32_t MipForDistance(float texelsPerUnit, float distance, float pixelsPerUnit);
+
+class MipResidency
+{
+public:
+	static const std::uint32_t NoMip = ~0u;
+
+	explicit MipResidency(const MipResidencyParams& params = MipResidencyParams());
+
+	// mipBytes[m] is what mip m takes once resident.  Mips tailMip and coarser are
+	// resident from the start and never dropped.  Returns the texture's index.
+	std::uint32_t AddTexture(const std::vector<std::uint64_t>& mipBytes, std::uint32_t tailMip);
+
+	void SetBudget(std::uint64_t bytes) { mParams.BudgetBytes = bytes; }
+
+	void BeginFrame();
+	void Request(std::uint32_t texture, std::uint32_t mip);
+	void Update(MipResidencyUpdate& changes);
+	void FinishLoad(std::uint32_t texture);
+
+	std::uint32_t TextureCount()const           { return (std::uint32_t)mTextures.size(); }
+	std::uint32_t MipCount(std::uint32_t t)const    { return (std::uint32_t)mTextures[t].MipBytes.size(); }
+	std::uint32_t TailMip(std::uint32_t t)const     { return mTextures[t].TailMip; }
+	std::uint32_t ResidentMip(std::uint32_t t)const { return mTextures[t].Resident; }
+	std::uint32_t LoadingMip(std::uint32_t t)const  { return mTextures[t].Loading; }
+	std::uint32_t WantedMip(std::uint32_t t)const   { return mTextures[t].Wanted; }
+
+	std::uint64_t ResidentBytes()const { return mResidentBytes; }
+	std::uint64_t LoadingBytes()const  { return mLoadingBytes; }
+	std::uint64_t TailBytes()const     { return mTailBytes; }
+	std::uint64_t BudgetBytes()const   { return mParams.BudgetBytes; }
+	std::uint32_t LoadsInFlight()const { return mLoadsInFlight; }
+	std::uint64_t Frame()const         { return mFrame; }
+
+	const MipResidencyStats& Stats()const { return mStats; }
+
+private:
+	struct TextureState
+	{
+		std::vector<std::uint64_t> MipBytes;
+		std::uint32_t TailMip = 0;
+		std::uint32_t Resident = 0;       // finest resident mip
+		std::uint32_t Loading = NoMip;
+		std::uint32_t Wanted = 0;         // finest mip requested this frame
+		std::uint32_t Uses = 0;           // requests this frame
+		std::uint32_t Held = 0;           // finest mip requested in the last KeepFrames frames
+		std::uint64_t HeldFrame = 0;
+		std::uint64_t LastUsedFrame = 0;
+		std::uint64_t DroppedMips = 0;    // bit m set once mip m has been dropped
+	};
+
+	// Drops mips of textures other than exclude, least wanted first, until bytes have
+	// been freed.  Without takeWanted only mips not wanted this frame are taken, and
+	// nothing is dropped if they are not enough.  Returns whether bytes were freed.
+	bool DropMips(std::uint64_t bytes, std::uint32_t exclude, bool takeWanted, MipResidencyUpdate& changes);
+
+private:
+	MipResidencyParams mParams;
+	std::vector<TextureState> mTextures;
+
+	std::uint64_t mFrame = 0;
+	std::uint64_t mResidentBytes = 0;
+	std::uint64_t mLoadingBytes = 0;
+	std::uint64_t mTailBytes = 0;
+	std::uint32_t mLoadsInFlight = 0;
+
+	MipResidencyStats mStats;
+};
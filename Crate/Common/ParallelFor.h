@@ -0,0 +1,52 @@
+//***************************************************************************************
+// ParallelFor.h
+//
+// Runs body(i) for every i in [begin, end) on up to threadCount threads, the calling
+// thread included.  Indices are handed out one at a time from a shared counter, so
+// uneven work per index still balances.  Returns once every index has run.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Number of threads to use when the caller asks for "all of them" (0).
+inline int DefaultThreadCount()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return (n == 0) ? 1 : (int)n;
+}
+
+template<typename Func>
+void ParallelFor(int begin, int end, int threadCount, Func body)
+{
+	if (threadCount <= 0)
+		threadCount = DefaultThreadCount();
+	if (threadCount > end - begin)
+		threadCount = end - begin;
+
+	if (threadCount <= 1)
+	{
+		for (int i = begin; i < end; ++i)
+			body(i);
+		return;
+	}
+
+	std::atomic<int> next(begin);
+	auto worker = [&]()
+	{
+		for (int i = next.fetch_add(1); i < end; i = next.fetch_add(1))
+			body(i);
+	};
+
+	std::vector<std::thread> threads;
+	for (int t = 1; t < threadCount; ++t)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (std::thread& t : threads)
+		t.join();
+}
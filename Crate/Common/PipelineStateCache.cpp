@@ -0,0 +1,262 @@
+#include "PipelineStateCache.h"
+#include "Hash.h"
+#include <chrono>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	std::uint64_t HashBytecode(const D3D12_SHADER_BYTECODE& bytecode, std::uint64_t h)
+	{
+		h = Hash::Combine(h, (std::uint64_t)bytecode.BytecodeLength);
+		return Hash::Fnv1a(bytecode.pShaderBytecode, bytecode.BytecodeLength, h);
+	}
+
+	std::uint64_t HashBlend(const D3D12_BLEND_DESC& blend, std::uint64_t h)
+	{
+		h = Hash::Combine(h, blend.AlphaToCoverageEnable);
+		h = Hash::Combine(h, blend.IndependentBlendEnable);
+		for (const D3D12_RENDER_TARGET_BLEND_DESC& rt : blend.RenderTarget)
+		{
+			h = Hash::Combine(h, rt.BlendEnable);
+			h = Hash::Combine(h, rt.LogicOpEnable);
+			h = Hash::Combine(h, rt.SrcBlend);
+			h = Hash::Combine(h, rt.DestBlend);
+			h = Hash::Combine(h, rt.BlendOp);
+			h = Hash::Combine(h, rt.SrcBlendAlpha);
+			h = Hash::Combine(h, rt.DestBlendAlpha);
+			h = Hash::Combine(h, rt.BlendOpAlpha);
+			h = Hash::Combine(h, rt.LogicOp);
+			h = Hash::Combine(h, rt.RenderTargetWriteMask);
+		}
+		return h;
+	}
+
+	std::uint64_t HashStencilOp(const D3D12_DEPTH_STENCILOP_DESC& op, std::uint64_t h)
+	{
+		h = Hash::Combine(h, op.StencilFailOp);
+		h = Hash::Combine(h, op.StencilDepthFailOp);
+		h = Hash::Combine(h, op.StencilPassOp);
+		return Hash::Combine(h, op.StencilFunc);
+	}
+
+	std::uint64_t HashDepthStencil(const D3D12_DEPTH_STENCIL_DESC& ds, std::uint64_t h)
+	{
+		h = Hash::Combine(h, ds.DepthEnable);
+		h = Hash::Combine(h, ds.DepthWriteMask);
+		h = Hash::Combine(h, ds.DepthFunc);
+		h = Hash::Combine(h, ds.StencilEnable);
+		h = Hash::Combine(h, ds.StencilReadMask);
+		h = Hash::Combine(h, ds.StencilWriteMask);
+		h = HashStencilOp(ds.FrontFace, h);
+		return HashStencilOp(ds.BackFace, h);
+	}
+}
+
+PipelineStateCache::PipelineStateCache(ID3D12Device* device, const std::wstring& filename) :
+	md3dDevice(device),
+	mFilename(filename)
+{
+	// Pipeline libraries need the Anniversary Update runtime.  Without it every
+	// request simply goes through CreateGraphicsPipelineState.
+	if (SUCCEEDED(md3dDevice->QueryInterface(IID_PPV_ARGS(md3dDevice1.GetAddressOf()))))
+		OpenLibrary();
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+	Save();
+}
+
+void PipelineStateCache::OpenLibrary()
+{
+	std::ifstream fin(mFilename, std::ios::binary);
+	if (fin)
+	{
+		fin.seekg(0, std::ios_base::end);
+		mLibraryData.resize((size_t)fin.tellg());
+		fin.seekg(0, std::ios_base::beg);
+		fin.read(mLibraryData.data(), mLibraryData.size());
+	}
+
+	if (!mLibraryData.empty())
+	{
+		// A library written by a different driver or adapter is rejected; start over.
+		HRESULT hr = md3dDevice1->CreatePipelineLibrary(mLibraryData.data(), mLibraryData.size(),
+			IID_PPV_ARGS(mLibrary.GetAddressOf()));
+		if (SUCCEEDED(hr))
+			return;
+
+		mLibrary = nullptr;
+		mLibraryData.clear();
+		::OutputDebugStringA("Pipeline library on disk is out of date, rebuilding.\n");
+	}
+
+	if (FAILED(md3dDevice1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(mLibrary.GetAddressOf()))))
+		mLibrary = nullptr;
+}
+
+std::uint64_t PipelineStateCache::HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t rootSignatureHash)
+{
+	std::uint64_t h = Hash::Combine(Hash::FnvOffsetBasis, rootSignatureHash);
+	h = HashBytecode(desc.VS, h);
+	h = HashBytecode(desc.PS, h);
+	h = HashBytecode(desc.DS, h);
+	h = HashBytecode(desc.HS, h);
+	h = HashBytecode(desc.GS, h);
+
+	// Stream output is not used by this renderer; hash its size so it still counts.
+	h = Hash::Combine(h, desc.StreamOutput.NumEntries);
+	h = Hash::Combine(h, desc.StreamOutput.NumStrides);
+	h = Hash::Combine(h, desc.StreamOutput.RasterizedStream);
+
+	// The rasterizer desc is made only of 4-byte members.  The blend and depth-stencil
+	// descs contain UINT8 masks and therefore padding, so they go field by field.
+	h = Hash::Combine(h, desc.RasterizerState);
+	h = HashBlend(desc.BlendState, h);
+	h = Hash::Combine(h, desc.SampleMask);
+	h = HashDepthStencil(desc.DepthStencilState, h);
+
+	h = Hash::Combine(h, desc.InputLayout.NumElements);
+	for (UINT i = 0; i < desc.InputLayout.NumElements; ++i)
+	{
+		const D3D12_INPUT_ELEMENT_DESC& e = desc.InputLayout.pInputElementDescs[i];
+		h = Hash::Fnv1a(std::string(e.SemanticName), h);
+		h = Hash::Combine(h, e.SemanticIndex);
+		h = Hash::Combine(h, e.Format);
+		h = Hash::Combine(h, e.InputSlot);
+		h = Hash::Combine(h, e.AlignedByteOffset);
+		h = Hash::Combine(h, e.InputSlotClass);
+		h = Hash::Combine(h, e.InstanceDataStepRate);
+	}
+
+	h = Hash::Combine(h, desc.IBStripCutValue);
+	h = Hash::Combine(h, desc.PrimitiveTopologyType);
+	h = Hash::Combine(h, desc.NumRenderTargets);
+	for (UINT i = 0; i < desc.NumRenderTargets; ++i)
+		h = Hash::Combine(h, desc.RTVFormats[i]);
+	h = Hash::Combine(h, desc.DSVFormat);
+	h = Hash::Combine(h, desc.SampleDesc.Count);
+	h = Hash::Combine(h, desc.SampleDesc.Quality);
+	h = Hash::Combine(h, desc.NodeMask);
+	h = Hash::Combine(h, desc.Flags);
+	return h;
+}
+
+PipelineStateCache::Result PipelineStateCache::LoadOrCreate(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t key)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	Result result;
+	std::wstring libraryName = AnsiToWString(Hash::ToHex(key));
+
+	if (mLibrary != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mLibraryMutex);
+		if (SUCCEEDED(mLibrary->LoadGraphicsPipeline(libraryName.c_str(), &desc, IID_PPV_ARGS(result.Pso.GetAddressOf()))))
+			result.FromLibrary = true;
+	}
+
+	if (!result.FromLibrary)
+	{
+		// Compiling is the slow part and the device is free-threaded, so only the
+		// library store is done under the lock.
+		ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(result.Pso.GetAddressOf())));
+
+		if (mLibrary != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(mLibraryMutex);
+			if (SUCCEEDED(mLibrary->StorePipeline(libraryName.c_str(), result.Pso.Get())))
+				mLibraryDirty = true;
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	result.Milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	return result;
+}
+
+void PipelineStateCache::Finish(const std::string& name, const Result& result, bool background)
+{
+	mPSOs[name] = result.Pso;
+	if (result.FromLibrary)
+		++mHits;
+	else
+		++mMisses;
+
+	std::ostringstream ss;
+	ss << "PSO " << name << ": " << (result.FromLibrary ? "loaded" : "created")
+		<< (background ? " in background" : "") << " in " << result.Milliseconds << " ms\n";
+	::OutputDebugStringA(ss.str().c_str());
+}
+
+ID3D12PipelineState* PipelineStateCache::Create(const std::string& name,
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t rootSignatureHash)
+{
+	Result result = LoadOrCreate(desc, HashDesc(desc, rootSignatureHash));
+	Finish(name, result, false);
+	return result.Pso.Get();
+}
+
+void PipelineStateCache::CreateAsync(const std::string& name,
+	const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t rootSignatureHash)
+{
+	if (mPSOs.count(name) != 0 || mPending.count(name) != 0)
+		return;
+
+	std::uint64_t key = HashDesc(desc, rootSignatureHash);
+	mPending[name] = std::async(std::launch::async, [this, desc, key]()
+	{
+		return LoadOrCreate(desc, key);
+	});
+}
+
+void PipelineStateCache::Poll()
+{
+	for (auto it = mPending.begin(); it != mPending.end();)
+	{
+		if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			Finish(it->first, it->second.get(), true);
+			it = mPending.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+ID3D12PipelineState* PipelineStateCache::Get(const std::string& name, const std::string& fallback)const
+{
+	auto it = mPSOs.find(name);
+	if (it != mPSOs.end())
+		return it->second.Get();
+
+	return Get(fallback);
+}
+
+ID3D12PipelineState* PipelineStateCache::Get(const std::string& name)const
+{
+	auto it = mPSOs.find(name);
+	return (it != mPSOs.end()) ? it->second.Get() : nullptr;
+}
+
+void PipelineStateCache::Save()
+{
+	for (auto& p : mPending)
+		p.second.wait();
+	Poll();
+
+	std::lock_guard<std::mutex> lock(mLibraryMutex);
+	if (mLibrary == nullptr || !mLibraryDirty)
+		return;
+
+	std::vector<char> data(mLibrary->GetSerializedSize());
+	if (FAILED(mLibrary->Serialize(data.data(), data.size())))
+		return;
+
+	std::ofstream fout(mFilename, std::ios::binary | std::ios::trunc);
+	fout.write(data.data(), data.size());
+	mLibraryDirty = false;
+}
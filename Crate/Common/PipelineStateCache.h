@@ -0,0 +1,83 @@
+//***************************************************************************************
+// PipelineStateCache.h
+//
+// Graphics PSOs backed by an ID3D12PipelineLibrary that is serialized to disk.  Each
+// PSO is stored under a hash of its full description, so any change to shaders, input
+// layout, root signature or render state produces a new entry instead of a stale hit.
+//
+// PSOs can be requested synchronously (needed before the first frame) or in the
+// background, in which case Get() returns a fallback until the worker has finished.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include <future>
+#include <mutex>
+
+class PipelineStateCache
+{
+public:
+	PipelineStateCache(ID3D12Device* device, const std::wstring& filename = L"ShaderCache\\pipelines.bin");
+	PipelineStateCache(const PipelineStateCache& rhs) = delete;
+	PipelineStateCache& operator=(const PipelineStateCache& rhs) = delete;
+	~PipelineStateCache();
+
+	// Hash of everything in desc that affects the compiled pipeline.  The root signature
+	// is passed as a hash of its serialized blob since the interface pointer says nothing
+	// about its contents.
+	static std::uint64_t HashDesc(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t rootSignatureHash);
+
+	// Loads or creates the PSO on the calling thread.
+	ID3D12PipelineState* Create(const std::string& name,
+		const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t rootSignatureHash);
+
+	// Loads or creates the PSO on a worker thread.  Everything desc points to (shader
+	// bytecode, input layout, root signature) must outlive the request.
+	void CreateAsync(const std::string& name,
+		const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t rootSignatureHash);
+
+	// Picks up PSOs finished by the workers.  Call once per frame.
+	void Poll();
+
+	// Returns the named PSO, or the fallback if it is still being created.
+	ID3D12PipelineState* Get(const std::string& name, const std::string& fallback)const;
+	ID3D12PipelineState* Get(const std::string& name)const;
+
+	// Waits for outstanding requests and writes the library if anything was added.
+	void Save();
+
+	UINT Hits()const { return mHits; }
+	UINT Misses()const { return mMisses; }
+
+private:
+	struct Result
+	{
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> Pso;
+		bool FromLibrary = false;
+		double Milliseconds = 0.0;
+	};
+
+	Result LoadOrCreate(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, std::uint64_t key);
+	void Finish(const std::string& name, const Result& result, bool background);
+	void OpenLibrary();
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Device1> md3dDevice1;
+	Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> mLibrary;
+	std::wstring mFilename;
+
+	// The library blob has to stay alive as long as the library created from it.
+	std::vector<char> mLibraryData;
+
+	// Guards mLibrary and mLibraryDirty against the worker threads.
+	std::mutex mLibraryMutex;
+	bool mLibraryDirty = false;
+
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D12PipelineState>> mPSOs;
+	std::unordered_map<std::string, std::future<Result>> mPending;
+
+	UINT mHits = 0;
+	UINT mMisses = 0;
+};
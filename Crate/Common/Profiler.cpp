@@ -0,0 +1,229 @@
+#include "Profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct ZoneEvent
+	{
+		const char* Name;
+		std::uint64_t Start;
+		std::uint64_t End;
+		std::uint32_t ThreadId;
+	};
+
+	const std::uint32_t EventsPerBuffer = 1 << 16;
+
+	// Written only by the thread that owns it.  A buffer goes back to the pool when its
+	// thread exits and may be picked up by a new thread, which is why every event
+	// carries its thread id.  Count is published with release so a reader sees the
+	// events below it.
+	struct EventBuffer
+	{
+		std::unique_ptr<ZoneEvent[]> Events{ new ZoneEvent[EventsPerBuffer] };
+		std::atomic<std::uint32_t> Count{ 0 };
+		std::atomic<std::uint32_t> Generation{ 0 };
+		std::atomic<std::uint64_t> Dropped{ 0 };
+	};
+
+	struct Registry
+	{
+		std::mutex Mutex;
+		std::vector<std::unique_ptr<EventBuffer>> Buffers;
+		std::vector<EventBuffer*> FreeBuffers;
+		std::map<std::uint32_t, std::string> ThreadNames;
+		std::atomic<std::uint32_t> Generation{ 0 };
+		std::atomic<std::uint32_t> NextThreadId{ 1 };
+		std::chrono::steady_clock::time_point Epoch = std::chrono::steady_clock::now();
+	};
+
+	Registry& GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	// Per-thread state.  The buffer is only taken from the registry once the thread
+	// records its first zone, so threads that never record cost nothing.
+	struct ThreadState
+	{
+		std::uint32_t Id = GetRegistry().NextThreadId.fetch_add(1);
+		EventBuffer* Buffer = nullptr;
+
+		~ThreadState()
+		{
+			if (Buffer)
+			{
+				Registry& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.Mutex);
+				registry.FreeBuffers.push_back(Buffer);
+			}
+		}
+
+		EventBuffer* AcquireBuffer()
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.Mutex);
+			if (!registry.FreeBuffers.empty())
+			{
+				Buffer = registry.FreeBuffers.back();
+				registry.FreeBuffers.pop_back();
+			}
+			else
+			{
+				registry.Buffers.push_back(std::unique_ptr<EventBuffer>(new EventBuffer()));
+				Buffer = registry.Buffers.back().get();
+			}
+			return Buffer;
+		}
+	};
+
+	thread_local ThreadState tThread;
+
+	void WriteJsonString(std::FILE* file, const char* s)
+	{
+		std::fputc('"', file);
+		for (; *s; ++s)
+		{
+			if (*s == '"' || *s == '\\')
+				std::fputc('\\', file);
+			if ((unsigned char)*s >= 0x20)
+				std::fputc(*s, file);
+		}
+		std::fputc('"', file);
+	}
+}
+
+std::atomic<bool> Profiler::sEnabled{ false };
+
+std::uint64_t Profiler::Now()
+{
+	auto elapsed = std::chrono::steady_clock::now() - GetRegistry().Epoch;
+	return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void Profiler::BeginCapture()
+{
+	GetRegistry().Generation.fetch_add(1);
+	sEnabled.store(true);
+}
+
+void Profiler::EndCapture()
+{
+	sEnabled.store(false);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.Mutex);
+	registry.ThreadNames[tThread.Id] = name;
+}
+
+std::uint32_t Profiler::CreateTrack(const char* name)
+{
+	Registry& registry = GetRegistry();
+	std::uint32_t track = registry.NextThreadId.fetch_add(1);
+
+	std::lock_guard<std::mutex> lock(registry.Mutex);
+	registry.ThreadNames[track] = name;
+	return track;
+}
+
+void Profiler::Record(const char* name, std::uint64_t start, std::uint64_t end)
+{
+	Record(name, start, end, tThread.Id);
+}
+
+void Profiler::Record(const char* name, std::uint64_t start, std::uint64_t end, std::uint32_t track)
+{
+	EventBuffer* buffer = tThread.Buffer ? tThread.Buffer : tThread.AcquireBuffer();
+
+	// The first event of a new capture empties the buffer.
+	std::uint32_t generation = GetRegistry().Generation.load(std::memory_order_relaxed);
+	if (buffer->Generation.load(std::memory_order_relaxed) != generation)
+	{
+		buffer->Count.store(0, std::memory_order_relaxed);
+		buffer->Dropped.store(0, std::memory_order_relaxed);
+		buffer->Generation.store(generation, std::memory_order_release);
+	}
+
+	std::uint32_t count = buffer->Count.load(std::memory_order_relaxed);
+	if (count == EventsPerBuffer)
+	{
+		buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ZoneEvent& e = buffer->Events[count];
+	e.Name = name;
+	e.Start = start;
+	e.End = end;
+	e.ThreadId = track;
+	buffer->Count.store(count + 1, std::memory_order_release);
+}
+
+std::uint64_t Profiler::DroppedEvents()
+{
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.Mutex);
+
+	std::uint64_t dropped = 0;
+	std::uint32_t generation = registry.Generation.load();
+	for (auto& buffer : registry.Buffers)
+	{
+		if (buffer->Generation.load(std::memory_order_acquire) == generation)
+			dropped += buffer->Dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	std::FILE* file = std::fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	Registry& registry = GetRegistry();
+	std::lock_guard<std::mutex> lock(registry.Mutex);
+
+	std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	bool first = true;
+
+	for (auto& thread : registry.ThreadNames)
+	{
+		std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+			first ? "" : ",\n", thread.first);
+		WriteJsonString(file, thread.second.c_str());
+		std::fprintf(file, "}}");
+		first = false;
+	}
+
+	// Timestamps are in microseconds; three decimals keep nanosecond precision.
+	std::uint32_t generation = registry.Generation.load();
+	for (auto& buffer : registry.Buffers)
+	{
+		if (buffer->Generation.load(std::memory_order_acquire) != generation)
+			continue;
+
+		std::uint32_t count = buffer->Count.load(std::memory_order_acquire);
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			const ZoneEvent& e = buffer->Events[i];
+			std::fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			WriteJsonString(file, e.Name);
+			std::fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				e.ThreadId, e.Start / 1000.0, (e.End - e.Start) / 1000.0);
+			first = false;
+		}
+	}
+
+	std::fprintf(file, "\n]}\n");
+	bool ok = std::ferror(file) == 0;
+	std::fclose(file);
+	return ok;
+}
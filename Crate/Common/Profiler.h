@@ -0,0 +1,78 @@
+//***************************************************************************************
+// Profiler.h
+//
+// Scoped CPU zones.  PROFILE_ZONE("name") records when the enclosing scope starts and
+// ends; zones nest, and the trace viewer draws them as a hierarchy per thread.
+//
+// Recording is off until BeginCapture(), and a disabled zone costs one relaxed atomic
+// load.  While capturing, each thread appends to its own buffer without locking.
+// WriteChromeTrace() writes the capture in the Chrome trace-event format, which
+// chrome://tracing and ui.perfetto.dev can open.
+//
+// Zone names must be string literals or otherwise outlive the capture.
+//***************************************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+class Profiler
+{
+public:
+	static bool Enabled() { return sEnabled.load(std::memory_order_relaxed); }
+
+	// Nanoseconds since the profiler was first used.
+	static std::uint64_t Now();
+
+	// Starts a new capture, discarding the previous one.
+	static void BeginCapture();
+	static void EndCapture();
+
+	// Names the calling thread in the trace.
+	static void SetThreadName(const char* name);
+
+	// Writes the last capture.  Call after EndCapture().
+	static bool WriteChromeTrace(const std::string& path);
+
+	// Events that did not fit in a thread's buffer during the last capture.
+	static std::uint64_t DroppedEvents();
+
+	static void Record(const char* name, std::uint64_t start, std::uint64_t end);
+
+	// A named row in the trace that is not a CPU thread, such as a GPU queue.  Any
+	// thread may record events for it, with timestamps converted to Now()'s timeline.
+	static std::uint32_t CreateTrack(const char* name);
+	static void Record(const char* name, std::uint64_t start, std::uint64_t end, std::uint32_t track);
+
+private:
+	static std::atomic<bool> sEnabled;
+};
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name) :
+		mName(Profiler::Enabled() ? name : nullptr),
+		mStart(mName ? Profiler::Now() : 0)
+	{
+	}
+
+	~ProfileZone()
+	{
+		if (mName)
+			Profiler::Record(mName, mStart, Profiler::Now());
+	}
+
+	ProfileZone(const ProfileZone& rhs) = delete;
+	ProfileZone& operator=(const ProfileZone& rhs) = delete;
+
+private:
+	const char* mName;
+	std::uint64_t mStart;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
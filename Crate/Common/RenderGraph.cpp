@@ -0,0 +1,549 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <cassert>
+#include <set>
+
+namespace
+{
+	std::uint64_t AlignUp(std::uint64_t value, std::uint64_t alignment)
+	{
+		return (alignment > 1) ? (value + alignment - 1) / alignment * alignment : value;
+	}
+
+	bool Overlaps(std::uint64_t offsetA, std::uint64_t sizeA, std::uint64_t offsetB, std::uint64_t sizeB)
+	{
+		return offsetA < offsetB + sizeB && offsetB < offsetA + sizeA;
+	}
+
+	// Merge all accesses of a pass to the same resource into one state.
+	template<typename AccessList>
+	void MergeAccesses(const AccessList& accesses, std::vector<RgResource>& touched,
+		std::vector<std::uint32_t>& needed, std::vector<bool>& writes)
+	{
+		for (auto& a : accesses)
+		{
+			auto it = std::find(touched.begin(), touched.end(), a.Resource);
+			if (it == touched.end())
+			{
+				touched.push_back(a.Resource);
+				needed.push_back(a.State);
+				writes.push_back(a.Write);
+			}
+			else
+			{
+				std::size_t k = it - touched.begin();
+				bool bothRead = (needed[k] & ~RgState::ReadOnly) == 0 && (a.State & ~RgState::ReadOnly) == 0;
+				needed[k] = bothRead ? (needed[k] | a.State) : (a.Write ? a.State : needed[k]);
+				writes[k] = writes[k] || a.Write;
+			}
+		}
+	}
+
+	// A resource in a combined read state can be read in any of its parts without a transition.
+	bool Satisfies(std::uint32_t current, std::uint32_t needed)
+	{
+		bool readOnly = (needed & ~RgState::ReadOnly) == 0 && (current & ~RgState::ReadOnly) == 0;
+		return (current == needed) || (readOnly && current != RgState::Common && (current & needed) == needed);
+	}
+}
+
+RgResource RenderGraph::ImportResource(const std::string& name, std::uint32_t initialState, std::uint32_t finalState)
+{
+	Resource r;
+	r.Name = name;
+	r.Imported = true;
+	r.InitialState = initialState;
+	r.FinalState = finalState;
+	mResources.push_back(r);
+	return (RgResource)mResources.size() - 1;
+}
+
+RgResource RenderGraph::CreateTexture(const std::string& name, const RgTextureDesc& desc)
+{
+	Resource r;
+	r.Name = name;
+	r.Desc = desc;
+	mResources.push_back(r);
+	return (RgResource)mResources.size() - 1;
+}
+
+RgPass RenderGraph::AddPass(const std::string& name, ExecuteFunc execute)
+{
+	Pass p;
+	p.Name = name;
+	p.Execute = execute;
+	mPasses.push_back(p);
+	return (RgPass)mPasses.size() - 1;
+}
+
+void RenderGraph::Read(RgPass pass, RgResource resource, std::uint32_t state)
+{
+	assert(pass < mPasses.size() && resource < mResources.size());
+
+	Access a = { resource, state, false };
+	mPasses[pass].Accesses.push_back(a);
+}
+
+void RenderGraph::Write(RgPass pass, RgResource resource, std::uint32_t state)
+{
+	assert(pass < mPasses.size() && resource < mResources.size());
+
+	Access a = { resource, state, true };
+	mPasses[pass].Accesses.push_back(a);
+}
+
+void RenderGraph::SetSideEffect(RgPass pass)
+{
+	mPasses[pass].SideEffect = true;
+}
+
+void RenderGraph::Execute(RgPass pass)const
+{
+	if (mPasses[pass].Execute)
+		mPasses[pass].Execute();
+}
+
+void RenderGraph::Clear()
+{
+	mPasses.clear();
+	mResources.clear();
+}
+
+namespace
+{
+	struct Dependencies
+	{
+		// Passes whose output a pass consumes: the last writer of everything it reads or
+		// writes.  Culling follows only these.
+		std::vector<std::vector<RgPass>> Data;
+
+		// Data plus write-after-read: a writer also waits for the readers of the version
+		// it overwrites.  Sorting follows these.
+		std::vector<std::vector<RgPass>> Order;
+	};
+
+	// Declaration order defines the versions of a resource: a read sees the last write
+	// declared before it.
+	template<typename PassList>
+	Dependencies BuildDependencies(const PassList& passes, std::size_t resourceCount)
+	{
+		std::vector<RgPass> lastWriter(resourceCount, RgInvalid);
+		std::vector<std::vector<RgPass>> readers(resourceCount);
+
+		Dependencies deps;
+		deps.Data.resize(passes.size());
+		deps.Order.resize(passes.size());
+		for (RgPass p = 0; p < passes.size(); ++p)
+		{
+			std::set<RgResource> read, written;
+			for (auto& a : passes[p].Accesses)
+				(a.Write ? written : read).insert(a.Resource);
+
+			std::set<RgPass> data, order;
+			for (RgResource r : read)
+			{
+				if (lastWriter[r] != RgInvalid)
+					data.insert(lastWriter[r]);
+			}
+			for (RgResource r : written)
+			{
+				if (lastWriter[r] != RgInvalid)
+					data.insert(lastWriter[r]);
+				for (RgPass reader : readers[r])
+				{
+					if (reader != p)
+						order.insert(reader);
+				}
+			}
+			order.insert(data.begin(), data.end());
+
+			deps.Data[p].assign(data.begin(), data.end());
+			deps.Order[p].assign(order.begin(), order.end());
+
+			for (RgResource r : read)
+			{
+				if (written.count(r) == 0)
+					readers[r].push_back(p);
+			}
+			for (RgResource r : written)
+			{
+				lastWriter[r] = p;
+				readers[r].clear();
+			}
+		}
+		return deps;
+	}
+}
+
+std::vector<bool> RenderGraph::Cull()const
+{
+	std::vector<std::vector<RgPass>> deps = BuildDependencies(mPasses, mResources.size()).Data;
+
+	std::vector<bool> alive(mPasses.size(), false);
+	std::vector<RgPass> stack;
+	for (RgPass p = 0; p < mPasses.size(); ++p)
+	{
+		bool root = mPasses[p].SideEffect;
+		for (auto& a : mPasses[p].Accesses)
+			root |= (a.Write && mResources[a.Resource].Imported);
+
+		if (root)
+		{
+			alive[p] = true;
+			stack.push_back(p);
+		}
+	}
+
+	while (!stack.empty())
+	{
+		RgPass p = stack.back();
+		stack.pop_back();
+		for (RgPass d : deps[p])
+		{
+			if (!alive[d])
+			{
+				alive[d] = true;
+				stack.push_back(d);
+			}
+		}
+	}
+	return alive;
+}
+
+void RenderGraph::Sort(const std::vector<bool>& alive, std::vector<RgPass>& order)const
+{
+	std::vector<std::vector<RgPass>> deps = BuildDependencies(mPasses, mResources.size()).Order;
+
+	std::vector<std::uint32_t> pending(mPasses.size(), 0);
+	std::vector<std::vector<RgPass>> dependents(mPasses.size());
+	for (RgPass p = 0; p < mPasses.size(); ++p)
+	{
+		if (!alive[p])
+			continue;
+
+		for (RgPass d : deps[p])
+		{
+			if (!alive[d])
+				continue;
+			++pending[p];
+			dependents[d].push_back(p);
+		}
+	}
+
+	// How many alive passes still have to touch each transient.
+	std::vector<std::uint32_t> remainingUses(mResources.size(), 0);
+	for (RgPass p = 0; p < mPasses.size(); ++p)
+	{
+		if (!alive[p])
+			continue;
+
+		std::set<RgResource> touched;
+		for (auto& a : mPasses[p].Accesses)
+			touched.insert(a.Resource);
+		for (RgResource r : touched)
+			++remainingUses[r];
+	}
+
+	// Kahn's algorithm.  Among ready passes, prefer the one that ends the most transient
+	// lifetimes so fewer textures are alive at once and more of them can alias; ties go
+	// to the earliest declared, which keeps the order stable from frame to frame.
+	std::vector<RgPass> ready;
+	std::size_t aliveCount = 0;
+	for (RgPass p = 0; p < mPasses.size(); ++p)
+	{
+		if (alive[p])
+		{
+			++aliveCount;
+			if (pending[p] == 0)
+				ready.push_back(p);
+		}
+	}
+
+	order.clear();
+	while (!ready.empty())
+	{
+		std::size_t best = 0;
+		int bestScore = -1;
+		for (std::size_t i = 0; i < ready.size(); ++i)
+		{
+			std::set<RgResource> touched;
+			for (auto& a : mPasses[ready[i]].Accesses)
+			{
+				if (!mResources[a.Resource].Imported)
+					touched.insert(a.Resource);
+			}
+
+			int score = 0;
+			for (RgResource r : touched)
+				score += (remainingUses[r] == 1) ? 1 : 0;
+
+			if (score > bestScore || (score == bestScore && ready[i] < ready[best]))
+			{
+				best = i;
+				bestScore = score;
+			}
+		}
+
+		RgPass p = ready[best];
+		ready.erase(ready.begin() + best);
+		order.push_back(p);
+
+		std::set<RgResource> touched;
+		for (auto& a : mPasses[p].Accesses)
+			touched.insert(a.Resource);
+		for (RgResource r : touched)
+			--remainingUses[r];
+
+		for (RgPass d : dependents[p])
+		{
+			if (--pending[d] == 0)
+				ready.push_back(d);
+		}
+	}
+
+	// Every dependency points at an earlier declared pass, so there are no cycles.
+	assert(order.size() == aliveCount);
+}
+
+void RenderGraph::Place(const std::vector<RgPass>& order, RgCompiledGraph& compiled,
+	std::vector<std::uint32_t>& firstUse)const
+{
+	std::vector<std::uint32_t> lastUse(mResources.size(), 0);
+	firstUse.assign(mResources.size(), RgInvalid);
+	for (std::uint32_t i = 0; i < order.size(); ++i)
+	{
+		for (auto& a : mPasses[order[i]].Accesses)
+		{
+			if (firstUse[a.Resource] == RgInvalid)
+				firstUse[a.Resource] = i;
+			lastUse[a.Resource] = i;
+		}
+	}
+
+	std::vector<RgResource> transients;
+	for (RgResource r = 0; r < mResources.size(); ++r)
+	{
+		if (!mResources[r].Imported && firstUse[r] != RgInvalid)
+		{
+			transients.push_back(r);
+			compiled.UnaliasedSize = AlignUp(compiled.UnaliasedSize, mResources[r].Desc.Alignment) + mResources[r].Desc.SizeBytes;
+		}
+	}
+
+	// Largest first gives the big render targets the low offsets and the small ones
+	// the gaps between them.
+	std::stable_sort(transients.begin(), transients.end(), [this](RgResource a, RgResource b)
+	{
+		return mResources[a].Desc.SizeBytes > mResources[b].Desc.SizeBytes;
+	});
+
+	std::vector<RgResource> placed;
+	for (RgResource r : transients)
+	{
+		const RgTextureDesc& desc = mResources[r].Desc;
+
+		// Only resources alive at the same time can collide.
+		std::vector<RgResource> live;
+		for (RgResource o : placed)
+		{
+			if (firstUse[o] <= lastUse[r] && firstUse[r] <= lastUse[o])
+				live.push_back(o);
+		}
+
+		// The lowest fitting offset is either 0 or the end of a live resource.
+		std::vector<std::uint64_t> candidates(1, 0);
+		for (RgResource o : live)
+			candidates.push_back(AlignUp(compiled.HeapOffsets[o] + mResources[o].Desc.SizeBytes, desc.Alignment));
+		std::sort(candidates.begin(), candidates.end());
+
+		std::uint64_t offset = 0;
+		for (std::uint64_t c : candidates)
+		{
+			bool fits = true;
+			for (RgResource o : live)
+				fits &= !Overlaps(c, desc.SizeBytes, compiled.HeapOffsets[o], mResources[o].Desc.SizeBytes);
+
+			if (fits)
+			{
+				offset = c;
+				break;
+			}
+		}
+
+		compiled.HeapOffsets[r] = offset;
+		compiled.HeapSize = std::max(compiled.HeapSize, offset + desc.SizeBytes);
+		placed.push_back(r);
+	}
+}
+
+void RenderGraph::Compile(RgCompiledGraph& compiled)const
+{
+	compiled = RgCompiledGraph();
+	compiled.HeapOffsets.assign(mResources.size(), ~0ull);
+
+	std::vector<bool> alive = Cull();
+	for (bool a : alive)
+		compiled.CulledPasses += a ? 0 : 1;
+
+	std::vector<RgPass> order;
+	Sort(alive, order);
+
+	std::vector<std::uint32_t> firstUse;
+	Place(order, compiled, firstUse);
+
+	auto shares = [this, &compiled](RgResource a, RgResource b)
+	{
+		return Overlaps(compiled.HeapOffsets[a], mResources[a].Desc.SizeBytes,
+			compiled.HeapOffsets[b], mResources[b].Desc.SizeBytes);
+	};
+
+	std::vector<RgResource> transients;
+	for (RgResource r = 0; r < mResources.size(); ++r)
+	{
+		if (!mResources[r].Imported && firstUse[r] != RgInvalid)
+			transients.push_back(r);
+	}
+
+	// A transient whose memory a later texture takes over is not the active alias at the
+	// end of the frame and cannot be transitioned then.
+	std::vector<bool> aliasedAway(mResources.size(), false);
+	for (RgResource r : transients)
+	{
+		for (RgResource o : transients)
+			aliasedAway[r] = aliasedAway[r] || (firstUse[o] > firstUse[r] && shares(o, r));
+	}
+
+	// The state each transient is left in by its last pass.
+	std::vector<std::uint32_t> endState(mResources.size(), RgState::Common);
+	std::vector<bool> seen(mResources.size(), false);
+	for (RgPass p : order)
+	{
+		std::vector<RgResource> touched;
+		std::vector<std::uint32_t> needed;
+		std::vector<bool> writes;
+		MergeAccesses(mPasses[p].Accesses, touched, needed, writes);
+		for (std::size_t k = 0; k < touched.size(); ++k)
+		{
+			RgResource r = touched[k];
+			if (!seen[r] || !Satisfies(endState[r], needed[k]))
+				endState[r] = needed[k];
+			seen[r] = true;
+		}
+	}
+
+	// Transient textures are created in the state of their first use and returned to it
+	// at the end of the frame, so the executor can keep them between frames.  One that is
+	// aliased away starts the next frame in the state its last pass left it in instead.
+	std::vector<std::uint32_t> frameStartState(mResources.size(), RgState::Common);
+	for (RgResource r = 0; r < mResources.size(); ++r)
+		frameStartState[r] = aliasedAway[r] ? endState[r] : mResources[r].InitialState;
+
+	std::vector<std::uint32_t> current = frameStartState;
+	std::vector<bool> lastWasUavWrite(mResources.size(), false);
+	std::vector<bool> activated(mResources.size(), false);
+
+	for (std::uint32_t i = 0; i < order.size(); ++i)
+	{
+		const Pass& pass = mPasses[order[i]];
+		RgCompiledPass cp;
+		cp.Pass = order[i];
+
+		std::vector<RgResource> touched;
+		std::vector<std::uint32_t> needed;
+		std::vector<bool> writes;
+		MergeAccesses(pass.Accesses, touched, needed, writes);
+
+		for (std::size_t k = 0; k < touched.size(); ++k)
+		{
+			RgResource r = touched[k];
+
+			// First use of a transient that shares memory with a resource used earlier in
+			// this frame, or with the last occupant of its range in the previous frame.
+			bool first = !mResources[r].Imported && !activated[r];
+			if (first)
+			{
+				activated[r] = true;
+
+				RgBarrier alias;
+				alias.BarrierType = RgBarrier::Type::Aliasing;
+				alias.Resource = r;
+				std::uint32_t previousCount = 0;
+				for (RgResource o : transients)
+				{
+					if (o == r || !shares(o, r))
+						continue;
+
+					bool lastOccupant = firstUse[o] > firstUse[r];
+					for (RgResource later : transients)
+						lastOccupant = lastOccupant && !(firstUse[later] > firstUse[o] && shares(later, o) && shares(later, r));
+
+					if (firstUse[o] < firstUse[r] || lastOccupant)
+					{
+						alias.AliasedBefore = o;
+						alias.PreviousFrame = alias.PreviousFrame || lastOccupant;
+						++previousCount;
+					}
+				}
+
+				if (previousCount > 0)
+				{
+					// With several predecessors D3D accepts a null "before" resource.
+					if (previousCount > 1)
+						alias.AliasedBefore = RgInvalid;
+					cp.Barriers.push_back(alias);
+				}
+
+				if (!aliasedAway[r])
+				{
+					frameStartState[r] = needed[k];
+					current[r] = needed[k];
+				}
+			}
+
+			// An aliased-away transient leaves its first pass in exactly the state it needs
+			// there, so it ends the frame in endState again.
+			bool satisfied = Satisfies(current[r], needed[k]) && !(first && current[r] != needed[k]);
+			if (!satisfied)
+			{
+				RgBarrier t;
+				t.Resource = r;
+				t.StateBefore = current[r];
+				t.StateAfter = needed[k];
+				cp.Barriers.push_back(t);
+				current[r] = needed[k];
+			}
+			else if (needed[k] == RgState::UnorderedAccess && lastWasUavWrite[r])
+			{
+				RgBarrier uav;
+				uav.BarrierType = RgBarrier::Type::Uav;
+				uav.Resource = r;
+				cp.Barriers.push_back(uav);
+			}
+
+			lastWasUavWrite[r] = writes[k] && needed[k] == RgState::UnorderedAccess;
+		}
+
+		compiled.Passes.push_back(cp);
+	}
+
+	for (RgResource r = 0; r < mResources.size(); ++r)
+	{
+		if (firstUse[r] == RgInvalid)
+			continue;
+
+		if (aliasedAway[r])
+			continue;
+
+		std::uint32_t target = mResources[r].Imported ? mResources[r].FinalState : frameStartState[r];
+		if (current[r] != target)
+		{
+			RgBarrier t;
+			t.Resource = r;
+			t.StateBefore = current[r];
+			t.StateAfter = target;
+			compiled.FinalBarriers.push_back(t);
+		}
+	}
+
+	compiled.InitialStates = frameStartState;
+}
@@ -0,0 +1,178 @@
+//***************************************************************************************
+// RenderGraph.h
+//
+// Frame graph.  Each frame the renderer declares its passes and the resources they read
+// and write; Compile() then works out, without touching D3D:
+//
+//   - which passes contribute to an imported resource or have side effects (the rest
+//     are culled),
+//   - an execution order.  Declaration order defines the versions of a resource (a
+//     read sees the last write declared before it); within that, independent passes
+//     are scheduled to end transient lifetimes early,
+//   - the state transitions each pass needs, batched into one list per pass,
+//   - where each transient texture lives in a shared heap, so textures whose lifetimes
+//     do not overlap share memory.
+//
+// RenderGraphExecutor turns the result into D3D12 resources and barriers.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Resource states.  The values match D3D12_RESOURCE_STATES so the executor can cast.
+namespace RgState
+{
+	const std::uint32_t Common = 0x0;
+	const std::uint32_t Present = 0x0;
+	const std::uint32_t RenderTarget = 0x4;
+	const std::uint32_t UnorderedAccess = 0x8;
+	const std::uint32_t DepthWrite = 0x10;
+	const std::uint32_t DepthRead = 0x20;
+	const std::uint32_t NonPixelShaderResource = 0x40;
+	const std::uint32_t PixelShaderResource = 0x80;
+	const std::uint32_t CopyDest = 0x400;
+	const std::uint32_t CopySource = 0x800;
+
+	// States that may be combined with each other.  Any other state is exclusive.
+	const std::uint32_t ReadOnly = DepthRead | NonPixelShaderResource | PixelShaderResource | CopySource;
+}
+
+typedef std::uint32_t RgResource;
+typedef std::uint32_t RgPass;
+
+const std::uint32_t RgInvalid = 0xffffffff;
+
+// Description of a transient texture.  SizeBytes and Alignment come from the device
+// (RenderGraphExecutor::DescribeTexture); the graph only needs them to place textures.
+struct RgTextureDesc
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+	std::uint32_t Format = 0;      // DXGI_FORMAT
+	std::uint32_t Flags = 0;       // D3D12_RESOURCE_FLAGS
+	std::uint64_t SizeBytes = 0;
+	std::uint64_t Alignment = 0;
+};
+
+struct RgBarrier
+{
+	enum class Type
+	{
+		Transition,
+		Aliasing,   // Resource takes over memory last used by AliasedBefore
+		Uav         // write-after-write on an unordered access resource
+	};
+
+	Type BarrierType = Type::Transition;
+	RgResource Resource = RgInvalid;
+	RgResource AliasedBefore = RgInvalid;
+	bool PreviousFrame = false;   // AliasedBefore last used the memory in the previous frame
+	std::uint32_t StateBefore = RgState::Common;
+	std::uint32_t StateAfter = RgState::Common;
+};
+
+struct RgCompiledPass
+{
+	RgPass Pass = RgInvalid;
+
+	// Issued in one ResourceBarrier call before the pass executes.
+	std::vector<RgBarrier> Barriers;
+};
+
+struct RgCompiledGraph
+{
+	std::vector<RgCompiledPass> Passes;
+
+	// Return imported resources to their final state and transients to their initial one,
+	// except transients whose memory a later texture took over.
+	std::vector<RgBarrier> FinalBarriers;
+
+	// Per resource; ~0 for imported and culled resources.
+	std::vector<std::uint64_t> HeapOffsets;
+
+	// Per resource, the state it must be in when the frame starts.  Transient textures
+	// start in the state of their first use and are returned to it by FinalBarriers; one
+	// whose memory is taken over later in the frame is no longer the active alias at the
+	// end, so it starts in the state its last pass left it in.
+	std::vector<std::uint32_t> InitialStates;
+	std::uint64_t HeapSize = 0;
+
+	// What the heap would need without aliasing, for logging.
+	std::uint64_t UnaliasedSize = 0;
+
+	std::uint32_t CulledPasses = 0;
+};
+
+class RenderGraph
+{
+public:
+	typedef std::function<void()> ExecuteFunc;
+
+	// External resources (back buffer, depth buffer).  They are in initialState when the
+	// frame starts and are returned to finalState after the last pass that uses them.
+	// Writing one keeps the writing pass alive.
+	RgResource ImportResource(const std::string& name, std::uint32_t initialState, std::uint32_t finalState);
+
+	// Texture owned by the graph for this frame only.  Its memory may have held another
+	// texture, so the first pass writing it has to clear or discard it.
+	RgResource CreateTexture(const std::string& name, const RgTextureDesc& desc);
+
+	RgPass AddPass(const std::string& name, ExecuteFunc execute);
+
+	// A read consumes the last write to the resource by a previously added pass.
+	void Read(RgPass pass, RgResource resource, std::uint32_t state);
+	void Write(RgPass pass, RgResource resource, std::uint32_t state);
+
+	// Passes with side effects outside the graph (readbacks, queries) are never culled.
+	void SetSideEffect(RgPass pass);
+
+	void Compile(RgCompiledGraph& compiled)const;
+
+	void Execute(RgPass pass)const;
+	void Clear();
+
+	std::size_t PassCount()const { return mPasses.size(); }
+	std::size_t ResourceCount()const { return mResources.size(); }
+	const std::string& PassName(RgPass pass)const { return mPasses[pass].Name; }
+	const std::string& ResourceName(RgResource resource)const { return mResources[resource].Name; }
+	bool IsImported(RgResource resource)const { return mResources[resource].Imported; }
+	const RgTextureDesc& TextureDesc(RgResource resource)const { return mResources[resource].Desc; }
+
+private:
+	struct Access
+	{
+		RgResource Resource;
+		std::uint32_t State;
+		bool Write;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		ExecuteFunc Execute;
+		std::vector<Access> Accesses;
+		bool SideEffect = false;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		bool Imported = false;
+		std::uint32_t InitialState = RgState::Common;
+		std::uint32_t FinalState = RgState::Common;
+		RgTextureDesc Desc;
+	};
+
+	void Sort(const std::vector<bool>& alive, std::vector<RgPass>& order)const;
+	std::vector<bool> Cull()const;
+	void Place(const std::vector<RgPass>& order, RgCompiledGraph& compiled,
+		std::vector<std::uint32_t>& firstUse)const;
+
+private:
+	std::vector<Pass> mPasses;
+	std::vector<Resource> mResources;
+};
@@ -0,0 +1,169 @@
+#include "RenderGraphExecutor.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	D3D12_RESOURCE_DESC TextureResourceDesc(const RgTextureDesc& desc)
+	{
+		return CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)desc.Format, desc.Width, desc.Height,
+			1, 1, 1, 0, (D3D12_RESOURCE_FLAGS)desc.Flags);
+	}
+
+	bool SameDesc(const RgTextureDesc& a, const RgTextureDesc& b)
+	{
+		return a.Width == b.Width && a.Height == b.Height && a.Format == b.Format && a.Flags == b.Flags;
+	}
+}
+
+RenderGraphExecutor::RenderGraphExecutor(ID3D12Device* device) :
+	md3dDevice(device)
+{
+}
+
+RgTextureDesc RenderGraphExecutor::DescribeTexture(UINT width, UINT height, DXGI_FORMAT format, D3D12_RESOURCE_FLAGS flags)const
+{
+	assert(flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL));
+
+	RgTextureDesc desc;
+	desc.Width = width;
+	desc.Height = height;
+	desc.Format = format;
+	desc.Flags = flags;
+
+	D3D12_RESOURCE_DESC resourceDesc = TextureResourceDesc(desc);
+	D3D12_RESOURCE_ALLOCATION_INFO info = md3dDevice->GetResourceAllocationInfo(0, 1, &resourceDesc);
+	desc.SizeBytes = info.SizeInBytes;
+	desc.Alignment = info.Alignment;
+	return desc;
+}
+
+void RenderGraphExecutor::Bind(RgResource resource, ID3D12Resource* d3dResource)
+{
+	if (mResources.size() <= resource)
+		mResources.resize(resource + 1, nullptr);
+
+	mResources[resource] = d3dResource;
+}
+
+ID3D12Resource* RenderGraphExecutor::Resource(RgResource resource)const
+{
+	return (resource < mResources.size()) ? mResources[resource] : nullptr;
+}
+
+void RenderGraphExecutor::PlaceTransients(const RenderGraph& graph, const RgCompiledGraph& compiled)
+{
+	// Grow the heap; everything placed in the old one goes with it.
+	if (compiled.HeapSize > mHeapSize)
+	{
+		Retired retired;
+		retired.Heap = mHeap;
+		retired.Fence = mLastSubmittedFence;
+		for (auto& t : mTransients)
+			retired.Resources.push_back(t.second.Resource);
+		mRetired.push_back(retired);
+		mTransients.clear();
+
+		mHeapSize = (compiled.HeapSize + D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT - 1)
+			/ D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT * D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+		CD3DX12_HEAP_DESC heapDesc(mHeapSize, D3D12_HEAP_TYPE_DEFAULT, 0, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES);
+		ThrowIfFailed(md3dDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(mHeap.GetAddressOf())));
+		mHeapMemory.Reset(MemoryDomain::Gpu, MemoryCategory::Textures, mHeapSize);
+	}
+
+	mCreated.assign(graph.ResourceCount(), false);
+	for (RgResource r = 0; r < graph.ResourceCount(); ++r)
+	{
+		if (graph.IsImported(r) || compiled.HeapOffsets[r] == ~0ull)
+			continue;
+
+		const RgTextureDesc& desc = graph.TextureDesc(r);
+		Transient& t = mTransients[graph.ResourceName(r)];
+		if (t.Resource == nullptr || t.HeapOffset != compiled.HeapOffsets[r] ||
+			!SameDesc(t.Desc, desc) || t.InitialState != compiled.InitialStates[r])
+		{
+			if (t.Resource != nullptr)
+			{
+				Retired retired;
+				retired.Resources.push_back(t.Resource);
+				retired.Fence = mLastSubmittedFence;
+				mRetired.push_back(retired);
+			}
+
+			D3D12_RESOURCE_DESC resourceDesc = TextureResourceDesc(desc);
+			t.Resource = nullptr;
+			ThrowIfFailed(md3dDevice->CreatePlacedResource(mHeap.Get(), compiled.HeapOffsets[r], &resourceDesc,
+				(D3D12_RESOURCE_STATES)compiled.InitialStates[r], nullptr, IID_PPV_ARGS(t.Resource.GetAddressOf())));
+			t.HeapOffset = compiled.HeapOffsets[r];
+			t.Desc = desc;
+			t.InitialState = compiled.InitialStates[r];
+			mCreated[r] = true;
+		}
+
+		Bind(r, t.Resource.Get());
+	}
+}
+
+void RenderGraphExecutor::Execute(const RenderGraph& graph, const RgCompiledGraph& compiled, ID3D12GraphicsCommandList* cmdList)
+{
+	PlaceTransients(graph, compiled);
+
+	std::vector<D3D12_RESOURCE_BARRIER> batch;
+	auto flush = [&](const std::vector<RgBarrier>& barriers)
+	{
+		batch.clear();
+		for (auto& b : barriers)
+		{
+			switch (b.BarrierType)
+			{
+			case RgBarrier::Type::Transition:
+				batch.push_back(CD3DX12_RESOURCE_BARRIER::Transition(Resource(b.Resource),
+					(D3D12_RESOURCE_STATES)b.StateBefore, (D3D12_RESOURCE_STATES)b.StateAfter));
+				break;
+			case RgBarrier::Type::Aliasing:
+			{
+				// A previous-frame occupant recreated since then never held this memory.
+				bool known = b.AliasedBefore != RgInvalid && !(b.PreviousFrame && mCreated[b.AliasedBefore]);
+				batch.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(
+					known ? Resource(b.AliasedBefore) : nullptr, Resource(b.Resource)));
+				break;
+			}
+			case RgBarrier::Type::Uav:
+				batch.push_back(CD3DX12_RESOURCE_BARRIER::UAV(Resource(b.Resource)));
+				break;
+			}
+		}
+
+		if (!batch.empty())
+			cmdList->ResourceBarrier((UINT)batch.size(), batch.data());
+	};
+
+	for (auto& pass : compiled.Passes)
+	{
+		flush(pass.Barriers);
+		graph.Execute(pass.Pass);
+	}
+	flush(compiled.FinalBarriers);
+}
+
+void RenderGraphExecutor::EndFrame(UINT64 fence)
+{
+	mLastSubmittedFence = fence;
+}
+
+void RenderGraphExecutor::ReleaseRetired(UINT64 completedFence)
+{
+	for (size_t i = 0; i < mRetired.size();)
+	{
+		if (mRetired[i].Fence <= completedFence)
+		{
+			mRetired[i] = mRetired.back();
+			mRetired.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
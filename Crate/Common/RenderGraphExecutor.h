@@ -0,0 +1,75 @@
+//***************************************************************************************
+// RenderGraphExecutor.h
+//
+// Runs a compiled RenderGraph on a D3D12 command list: places the transient textures in
+// a shared heap at the offsets chosen by the graph and records each pass's barrier batch
+// before calling the pass.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "RenderGraph.h"
+
+class RenderGraphExecutor
+{
+public:
+	RenderGraphExecutor(ID3D12Device* device);
+	RenderGraphExecutor(const RenderGraphExecutor& rhs) = delete;
+	RenderGraphExecutor& operator=(const RenderGraphExecutor& rhs) = delete;
+
+	// Fills in the size and alignment the graph needs to place a transient texture.
+	// Transient textures must be render targets or depth-stencil buffers, which is
+	// what a resource heap tier 1 aliasing heap can hold.
+	RgTextureDesc DescribeTexture(UINT width, UINT height, DXGI_FORMAT format, D3D12_RESOURCE_FLAGS flags)const;
+
+	// D3D resource behind an imported graph resource for this frame.
+	void Bind(RgResource resource, ID3D12Resource* d3dResource);
+
+	void Execute(const RenderGraph& graph, const RgCompiledGraph& compiled, ID3D12GraphicsCommandList* cmdList);
+
+	// For pass callbacks.
+	ID3D12Resource* Resource(RgResource resource)const;
+
+	// Heaps replaced by a bigger one are kept until the GPU is past fence.
+	void EndFrame(UINT64 fence);
+	void ReleaseRetired(UINT64 completedFence);
+
+private:
+	void PlaceTransients(const RenderGraph& graph, const RgCompiledGraph& compiled);
+
+private:
+	struct Transient
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		UINT64 HeapOffset = 0;
+		RgTextureDesc Desc;
+		UINT InitialState = 0;
+	};
+
+	struct Retired
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> Resources;
+		UINT64 Fence = 0;
+	};
+
+	ID3D12Device* md3dDevice = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Heap> mHeap;
+	UINT64 mHeapSize = 0;
+	TrackedMemory mHeapMemory;
+
+	// Transients are keyed by name so they survive from frame to frame while the graph
+	// keeps declaring them the same way.
+	std::unordered_map<std::string, Transient> mTransients;
+
+	// Indexed by RgResource for the frame being executed.
+	std::vector<ID3D12Resource*> mResources;
+
+	// Transients created for this frame; none of them held memory in the previous frame.
+	std::vector<bool> mCreated;
+
+	std::vector<Retired> mRetired;
+	UINT64 mLastSubmittedFence = 0;
+};
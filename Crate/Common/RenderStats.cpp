@@ -0,0 +1,144 @@
+#include "RenderStats.h"
+#include <iomanip>
+#include <sstream>
+
+RenderFrameStats RenderStats::sCurrent;
+RenderFrameStats RenderStats::sLast;
+RenderFrameStats RenderStats::sTotals;
+std::uint64_t RenderStats::sFrames = 0;
+std::ofstream RenderStats::sLog;
+
+namespace
+{
+	void WriteCount(std::ostream& out, double count)
+	{
+		if (count >= 1.0e6)
+			out << std::setprecision(2) << count / 1.0e6 << "M";
+		else if (count >= 1.0e4)
+			out << std::setprecision(1) << count / 1.0e3 << "k";
+		else
+			out << std::setprecision(0) << count;
+	}
+}
+
+std::uint64_t RenderFrameStats::TotalStateChanges()const
+{
+	std::uint64_t total = 0;
+	for (std::uint64_t n : StateChanges)
+		total += n;
+	return total;
+}
+
+std::uint64_t RenderFrameStats::TotalUploadBytes()const
+{
+	std::uint64_t total = 0;
+	for (std::uint64_t n : UploadBytes)
+		total += n;
+	return total;
+}
+
+void RenderFrameStats::Add(const RenderFrameStats& rhs)
+{
+	DrawCalls += rhs.DrawCalls;
+	Instances += rhs.Instances;
+	Triangles += rhs.Triangles;
+	for (int i = 0; i < (int)RenderState::Count; ++i)
+		StateChanges[i] += rhs.StateChanges[i];
+	for (int i = 0; i < (int)UploadKind::Count; ++i)
+		UploadBytes[i] += rhs.UploadBytes[i];
+	CulledItems += rhs.CulledItems;
+}
+
+void RenderStats::EndFrame()
+{
+	if (sLog.is_open())
+	{
+		const RenderFrameStats& s = sCurrent;
+		sLog << sFrames << ',' << s.DrawCalls << ',' << s.Instances << ',' << s.Triangles;
+		for (std::uint64_t n : s.StateChanges)
+			sLog << ',' << n;
+		for (std::uint64_t n : s.UploadBytes)
+			sLog << ',' << n;
+		sLog << ',' << s.CulledItems << '\n';
+	}
+
+	sTotals.Add(sCurrent);
+	sLast = sCurrent;
+	sCurrent.Clear();
+	++sFrames;
+}
+
+bool RenderStats::OpenLog(const std::string& path)
+{
+	CloseLog();
+	sLog.open(path.c_str(), std::ios::trunc);
+	if (!sLog)
+		return false;
+
+	sLog << "frame,draws,instances,triangles";
+	for (int i = 0; i < (int)RenderState::Count; ++i)
+		sLog << ',' << StateName((RenderState)i);
+	for (int i = 0; i < (int)UploadKind::Count; ++i)
+		sLog << ",upload_" << UploadName((UploadKind)i);
+	sLog << ",culled\n";
+	return (bool)sLog;
+}
+
+void RenderStats::CloseLog()
+{
+	if (sLog.is_open())
+		sLog.close();
+	sLog.clear();
+}
+
+const char* RenderStats::StateName(RenderState state)
+{
+	switch (state)
+	{
+	case RenderState::PipelineState:    return "pso";
+	case RenderState::RootSignature:    return "root_signature";
+	case RenderState::DescriptorHeaps:  return "descriptor_heaps";
+	case RenderState::DescriptorTable:  return "descriptor_table";
+	case RenderState::RootCbv:          return "root_cbv";
+	case RenderState::VertexBuffer:     return "vertex_buffer";
+	case RenderState::IndexBuffer:      return "index_buffer";
+	case RenderState::Topology:         return "topology";
+	default:                            return "unknown";
+	}
+}
+
+const char* RenderStats::UploadName(UploadKind kind)
+{
+	switch (kind)
+	{
+	case UploadKind::Constants:  return "constants";
+	case UploadKind::Geometry:   return "geometry";
+	case UploadKind::Textures:   return "textures";
+	case UploadKind::Dynamic:    return "dynamic";
+	default:                     return "unknown";
+	}
+}
+
+std::string RenderStats::Summary(const RenderFrameStats& stats)
+{
+	std::ostringstream ss;
+	ss << std::fixed << "draws ";
+	WriteCount(ss, (double)stats.DrawCalls);
+	ss << " instances ";
+	WriteCount(ss, (double)stats.Instances);
+	ss << " tris ";
+	WriteCount(ss, (double)stats.Triangles);
+
+	ss << " | states ";
+	WriteCount(ss, (double)stats.TotalStateChanges());
+	ss << " (";
+	for (int i = 0; i < (int)RenderState::Count; ++i)
+	{
+		ss << (i == 0 ? "" : ", ") << StateName((RenderState)i) << ' ';
+		WriteCount(ss, (double)stats.StateChanges[i]);
+	}
+
+	ss << ") | upload " << std::setprecision(1) << stats.TotalUploadBytes() / 1024.0 << " KB | culled "
+		<< stats.CulledItems;
+	return ss.str();
+}
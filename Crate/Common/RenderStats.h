@@ -0,0 +1,114 @@
+//***************************************************************************************
+// RenderStats.h
+//
+// Per-frame renderer counters: draw calls, instances, triangles, state changes by type,
+// bytes written to upload memory and items culled before drawing.  The renderer reports
+// through the RENDER_STAT_* macros, which compile to nothing when CRATE_RELEASE_PERF is
+// defined (the ReleasePerf configuration), so measuring costs nothing there.
+//
+// Counters are plain integers and belong to the render thread.  EndFrame closes the
+// frame: it keeps it as Last(), adds it to the run totals and appends a row to the log.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#if !defined(CRATE_RELEASE_PERF)
+#define RENDER_STATS_ENABLED 1
+#else
+#define RENDER_STATS_ENABLED 0
+#endif
+
+enum class RenderState : int
+{
+	PipelineState = 0,
+	RootSignature,
+	DescriptorHeaps,
+	DescriptorTable,
+	RootCbv,
+	VertexBuffer,
+	IndexBuffer,
+	Topology,
+	Count
+};
+
+enum class UploadKind : int
+{
+	Constants = 0,   // per-frame constant buffers
+	Geometry,        // vertex and index buffers
+	Textures,
+	Dynamic,         // other upload buffers
+	Count
+};
+
+struct RenderFrameStats
+{
+	std::uint64_t DrawCalls = 0;
+	std::uint64_t Instances = 0;
+	std::uint64_t Triangles = 0;
+	std::uint64_t StateChanges[(int)RenderState::Count] = {};
+	std::uint64_t UploadBytes[(int)UploadKind::Count] = {};
+	std::uint64_t CulledItems = 0;
+
+	std::uint64_t TotalStateChanges()const;
+	std::uint64_t TotalUploadBytes()const;
+
+	void Clear() { *this = RenderFrameStats(); }
+	void Add(const RenderFrameStats& rhs);
+};
+
+class RenderStats
+{
+public:
+	static void Draw(std::uint32_t indexCountPerInstance, std::uint32_t instanceCount)
+	{
+		++sCurrent.DrawCalls;
+		sCurrent.Instances += instanceCount;
+		sCurrent.Triangles += (std::uint64_t)(indexCountPerInstance / 3) * instanceCount;
+	}
+
+	static void StateChange(RenderState state) { ++sCurrent.StateChanges[(int)state]; }
+	static void Upload(UploadKind kind, std::uint64_t bytes) { sCurrent.UploadBytes[(int)kind] += bytes; }
+	static void Culled(std::uint64_t items) { sCurrent.CulledItems += items; }
+
+	static void EndFrame();
+
+	// The frame being recorded, the last finished one and the sum of every finished one.
+	static const RenderFrameStats& Current() { return sCurrent; }
+	static const RenderFrameStats& Last() { return sLast; }
+	static const RenderFrameStats& Totals() { return sTotals; }
+	static std::uint64_t Frames() { return sFrames; }
+
+	// Every later EndFrame appends a CSV row to the log.
+	static bool OpenLog(const std::string& path);
+	static void CloseLog();
+
+	static const char* StateName(RenderState state);
+	static const char* UploadName(UploadKind kind);
+
+	// "draws 412 instances 412 tris 180.2k | states 2480 (pso 3, ...) | upload 98.3 KB | culled 0"
+	// Counts of 10000 and more are abbreviated with k and M.
+	static std::string Summary(const RenderFrameStats& stats);
+
+private:
+	static RenderFrameStats sCurrent;
+	static RenderFrameStats sLast;
+	static RenderFrameStats sTotals;
+	static std::uint64_t sFrames;
+	static std::ofstream sLog;
+};
+
+#if RENDER_STATS_ENABLED
+#define RENDER_STAT_DRAW(indexCount, instanceCount) RenderStats::Draw((indexCount), (instanceCount))
+#define RENDER_STAT_STATE(state) RenderStats::StateChange(RenderState::state)
+#define RENDER_STAT_UPLOAD(kind, bytes) RenderStats::Upload((kind), (bytes))
+#define RENDER_STAT_CULLED(items) RenderStats::Culled(items)
+#else
+#define RENDER_STAT_DRAW(indexCount, instanceCount) ((void)0)
+#define RENDER_STAT_STATE(state) ((void)0)
+#define RENDER_STAT_UPLOAD(kind, bytes) ((void)0)
+#define RENDER_STAT_CULLED(items) ((void)0)
+#endif
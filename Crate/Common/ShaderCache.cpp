@@ -0,0 +1,97 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+#include <chrono>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	std::string WStringToAnsi(const std::wstring& str)
+	{
+		char buffer[512];
+		WideCharToMultiByte(CP_ACP, 0, str.c_str(), -1, buffer, 512, nullptr, nullptr);
+		return std::string(buffer);
+	}
+
+	std::wstring IndexPath(const std::wstring& directory)
+	{
+		return directory + L"\\index.txt";
+	}
+}
+
+ShaderCache::ShaderCache(const std::wstring& directory) :
+	mDirectory(directory)
+{
+	CreateDirectoryW(mDirectory.c_str(), nullptr);
+	mIndex.Load(WStringToAnsi(IndexPath(mDirectory)));
+}
+
+ShaderCache::~ShaderCache()
+{
+	SaveIndex();
+}
+
+void ShaderCache::SaveIndex()
+{
+	if (mIndex.Dirty())
+		mIndex.Save(WStringToAnsi(IndexPath(mDirectory)));
+}
+
+std::wstring ShaderCache::BlobPath(std::uint64_t key)const
+{
+	return mDirectory + L"\\" + AnsiToWString(Hash::ToHex(key)) + L".cso";
+}
+
+ComPtr<ID3DBlob> ShaderCache::Load(
+	const std::wstring& filename,
+	const D3D_SHADER_MACRO* defines,
+	const std::string& entrypoint,
+	const std::string& target)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ShaderPermutation permutation;
+	permutation.SourcePath = WStringToAnsi(filename);
+	permutation.EntryPoint = entrypoint;
+	permutation.Target = target;
+	permutation.CompileFlags = d3dUtil::ShaderCompileFlags();
+	for (const D3D_SHADER_MACRO* d = defines; d != nullptr && d->Name != nullptr; ++d)
+		permutation.Defines.push_back(std::make_pair(std::string(d->Name), std::string(d->Definition ? d->Definition : "")));
+
+	auto hashIt = mSourceHashes.find(permutation.SourcePath);
+	if (hashIt == mSourceHashes.end())
+	{
+		std::uint64_t sourceHash = 0;
+		if (!ShaderHash::HashSource(permutation.SourcePath, sourceHash))
+			sourceHash = 0; // unreadable; CompileShader below reports the real error
+		hashIt = mSourceHashes.insert(std::make_pair(permutation.SourcePath, sourceHash)).first;
+	}
+
+	ComPtr<ID3DBlob> byteCode = nullptr;
+	std::uint64_t key = ShaderHash::ComputeKey(permutation, hashIt->second);
+	std::wstring blobPath = BlobPath(key);
+
+	if (hashIt->second != 0 && GetFileAttributesW(blobPath.c_str()) != INVALID_FILE_ATTRIBUTES)
+	{
+		byteCode = d3dUtil::LoadBinary(blobPath);
+		++mHits;
+	}
+	else
+	{
+		byteCode = d3dUtil::CompileShader(filename, defines, entrypoint, target);
+		++mMisses;
+
+		if (hashIt->second != 0)
+			D3DWriteBlobToFile(byteCode.Get(), blobPath.c_str(), TRUE);
+	}
+
+	// The permutation's previous blob can never be hit again.
+	std::uint64_t staleKey = 0;
+	if (hashIt->second != 0 && mIndex.Update(permutation.Name(), key, staleKey))
+		DeleteFileW(BlobPath(staleKey).c_str());
+
+	auto end = std::chrono::high_resolution_clock::now();
+	mMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+
+	return byteCode;
+}
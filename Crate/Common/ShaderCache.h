@@ -0,0 +1,48 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Compiled shader bytecode cache.  Blobs are stored on disk under a key computed by
+// ShaderHash::ComputeKey, so a permutation is only compiled when its source, one of
+// its includes, its defines, its target or the compile flags have changed.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "ShaderCacheIndex.h"
+
+class ShaderCache
+{
+public:
+	ShaderCache(const std::wstring& directory = L"ShaderCache");
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+	~ShaderCache();
+
+	// Drop-in replacement for d3dUtil::CompileShader.
+	Microsoft::WRL::ComPtr<ID3DBlob> Load(
+		const std::wstring& filename,
+		const D3D_SHADER_MACRO* defines,
+		const std::string& entrypoint,
+		const std::string& target);
+
+	void SaveIndex();
+
+	UINT Hits()const { return mHits; }
+	UINT Misses()const { return mMisses; }
+	double Milliseconds()const { return mMilliseconds; }
+
+private:
+	std::wstring BlobPath(std::uint64_t key)const;
+
+private:
+	std::wstring mDirectory;
+	ShaderCacheIndex mIndex;
+
+	// Each source file (with its includes) is only read and hashed once per run.
+	std::unordered_map<std::string, std::uint64_t> mSourceHashes;
+
+	UINT mHits = 0;
+	UINT mMisses = 0;
+	double mMilliseconds = 0.0;
+};
@@ -0,0 +1,188 @@
+#include "ShaderCacheIndex.h"
+#include "Hash.h"
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace
+{
+	bool ReadFile(const std::string& path, std::string& contents)
+	{
+		std::ifstream fin(path.c_str(), std::ios::binary);
+		if (!fin)
+			return false;
+
+		std::ostringstream ss;
+		ss << fin.rdbuf();
+		contents = ss.str();
+		return true;
+	}
+
+	std::string DirectoryOf(const std::string& path)
+	{
+		std::string::size_type slash = path.find_last_of('/');
+		return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+	}
+
+	// Pulls the file names out of every '#include "name"' line.  Angle-bracket
+	// includes are system headers as far as D3D_COMPILE_STANDARD_FILE_INCLUDE is
+	// concerned, and the shaders here do not use them.
+	std::vector<std::string> FindIncludes(const std::string& source)
+	{
+		std::vector<std::string> includes;
+		std::istringstream lines(source);
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			std::string::size_type i = line.find_first_not_of(" \t");
+			if (i == std::string::npos || line[i] != '#')
+				continue;
+
+			i = line.find_first_not_of(" \t", i + 1);
+			if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+				continue;
+
+			std::string::size_type open = line.find('"', i + 7);
+			std::string::size_type close = (open == std::string::npos) ? open : line.find('"', open + 1);
+			if (close != std::string::npos)
+				includes.push_back(line.substr(open + 1, close - open - 1));
+		}
+		return includes;
+	}
+
+	bool HashRecursive(const std::string& path, std::uint64_t& hash,
+		std::set<std::string>& visited, std::vector<std::string>* files)
+	{
+		if (!visited.insert(path).second)
+			return true;
+
+		std::string source;
+		if (!ReadFile(path, source))
+			return false;
+
+		if (files)
+			files->push_back(path);
+
+		hash = Hash::Fnv1a(path, hash);
+		hash = Hash::Fnv1a(source, hash);
+
+		std::string dir = DirectoryOf(path);
+		for (const std::string& include : FindIncludes(source))
+		{
+			if (!HashRecursive(ShaderHash::NormalizePath(dir + include), hash, visited, files))
+				return false;
+		}
+		return true;
+	}
+}
+
+std::string ShaderPermutation::Name()const
+{
+	std::string name = ShaderHash::NormalizePath(SourcePath) + "|" + EntryPoint + "|" + Target;
+	for (std::size_t i = 0; i < Defines.size(); ++i)
+		name += (i == 0 ? "|" : ";") + Defines[i].first + "=" + Defines[i].second;
+	return name;
+}
+
+std::string ShaderHash::NormalizePath(const std::string& path)
+{
+	std::string result = path;
+	for (char& c : result)
+	{
+		if (c == '\\')
+			c = '/';
+	}
+
+	// Collapse "dir/../" so the same include reached two ways is only hashed once.
+	std::string::size_type up;
+	while ((up = result.find("/../")) != std::string::npos && up > 0)
+	{
+		std::string::size_type start = result.find_last_of('/', up - 1);
+		start = (start == std::string::npos) ? 0 : start + 1;
+		if (result.compare(start, up - start, "..") == 0)
+			break;
+		result.erase(start, up + 4 - start);
+	}
+	return result;
+}
+
+bool ShaderHash::HashSource(const std::string& path, std::uint64_t& hash, std::vector<std::string>* files)
+{
+	std::set<std::string> visited;
+	hash = Hash::FnvOffsetBasis;
+	return HashRecursive(NormalizePath(path), hash, visited, files);
+}
+
+std::uint64_t ShaderHash::ComputeKey(const ShaderPermutation& permutation, std::uint64_t sourceHash)
+{
+	std::uint64_t key = Hash::Combine(Hash::FnvOffsetBasis, sourceHash);
+	key = Hash::Fnv1a(permutation.EntryPoint, key);
+	key = Hash::Fnv1a(permutation.Target, key);
+	key = Hash::Combine(key, permutation.CompileFlags);
+	for (auto& define : permutation.Defines)
+	{
+		key = Hash::Fnv1a(define.first, key);
+		key = Hash::Fnv1a(define.second, key);
+	}
+	return key;
+}
+
+void ShaderCacheIndex::Load(const std::string& path)
+{
+	mEntries.clear();
+	mDirty = false;
+
+	std::ifstream fin(path.c_str());
+	std::string line;
+	while (std::getline(fin, line))
+	{
+		// <permutation name>\t<16 hex digit key>
+		std::string::size_type tab = line.rfind('\t');
+		if (tab == std::string::npos || tab == 0 || line.size() - tab - 1 != 16 ||
+			line.find_first_not_of("0123456789abcdefABCDEF", tab + 1) != std::string::npos)
+		{
+			continue;
+		}
+
+		std::uint64_t key = std::strtoull(line.c_str() + tab + 1, nullptr, 16);
+		mEntries[line.substr(0, tab)] = key;
+	}
+}
+
+bool ShaderCacheIndex::Save(const std::string& path)const
+{
+	std::ofstream fout(path.c_str(), std::ios::trunc);
+	if (!fout)
+		return false;
+
+	for (auto& e : mEntries)
+		fout << e.first << '\t' << Hash::ToHex(e.second) << '\n';
+
+	return (bool)fout;
+}
+
+bool ShaderCacheIndex::Find(const std::string& permutationName, std::uint64_t& key)const
+{
+	auto it = mEntries.find(permutationName);
+	if (it == mEntries.end())
+		return false;
+
+	key = it->second;
+	return true;
+}
+
+bool ShaderCacheIndex::Update(const std::string& permutationName, std::uint64_t key, std::uint64_t& staleKey)
+{
+	auto it = mEntries.find(permutationName);
+	bool replaced = (it != mEntries.end() && it->second != key);
+	if (replaced)
+		staleKey = it->second;
+
+	if (it == mEntries.end() || replaced)
+	{
+		mEntries[permutationName] = key;
+		mDirty = true;
+	}
+	return replaced;
+}
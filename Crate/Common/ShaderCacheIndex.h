@@ -0,0 +1,64 @@
+//***************************************************************************************
+// ShaderCacheIndex.h
+//
+// Platform-independent half of the shader bytecode cache.  Computes the cache key of
+// a shader permutation (source text, every file it #includes, defines, entry point,
+// target and compile flags) and keeps an index of which key each permutation was last
+// built with, so blobs made stale by a source edit can be deleted.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+struct ShaderPermutation
+{
+	std::string SourcePath;   // '/' or '\\' separated, relative to the working directory
+	ShaderDefines Defines;
+	std::string EntryPoint;
+	std::string Target;
+	std::uint32_t CompileFlags = 0;
+
+	// Human readable name of the permutation, e.g. "Shaders/Default.hlsl|PS|ps_5_1|FOG=1".
+	std::string Name()const;
+};
+
+namespace ShaderHash
+{
+	// Hashes a source file and, transitively, every file it pulls in with #include "...".
+	// Returns false if the file or one of its includes cannot be read.
+	bool HashSource(const std::string& path, std::uint64_t& hash, std::vector<std::string>* files = nullptr);
+
+	// Key of a permutation given the hash from HashSource.
+	std::uint64_t ComputeKey(const ShaderPermutation& permutation, std::uint64_t sourceHash);
+
+	std::string NormalizePath(const std::string& path);
+}
+
+class ShaderCacheIndex
+{
+public:
+	// A missing index just starts empty; malformed lines are skipped.
+	void Load(const std::string& path);
+	bool Save(const std::string& path)const;
+
+	// Returns true and sets key if the permutation has an entry.
+	bool Find(const std::string& permutationName, std::uint64_t& key)const;
+
+	// Records the key a permutation was built with.  If it replaces a different key,
+	// that key is returned through staleKey so its blob can be removed.
+	bool Update(const std::string& permutationName, std::uint64_t key, std::uint64_t& staleKey);
+
+	std::size_t Size()const { return mEntries.size(); }
+	bool Dirty()const { return mDirty; }
+
+private:
+	std::map<std::string, std::uint64_t> mEntries;
+	bool mDirty = false;
+};
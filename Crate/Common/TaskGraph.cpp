@@ -0,0 +1,165 @@
+#include "TaskGraph.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+TaskGraph::TaskId TaskGraph::Add(const std::string& name, TaskFunc func, std::initializer_list<TaskId> dependencies)
+{
+	TaskId id = (TaskId)mTasks.size();
+
+	Task task;
+	task.Name = name;
+	task.Func = func;
+	for (TaskId dependency : dependencies)
+	{
+		assert(dependency < id && "dependencies must be added first");
+		mTasks[dependency].Dependents.push_back(id);
+		task.Dependencies.push_back(dependency);
+	}
+	task.DependencyCount = (std::uint32_t)task.Dependencies.size();
+
+	mTasks.push_back(task);
+	return id;
+}
+
+void TaskGraph::Run(int threadCount)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	if (threadCount <= 0)
+		threadCount = (std::max)(1, (int)std::thread::hardware_concurrency());
+	threadCount = (std::min)(threadCount, (std::max)(1, (int)mTasks.size()));
+
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	// Ready tasks in id order, so a single thread runs them in the order they were added.
+	std::set<TaskId> ready;
+	std::vector<std::uint32_t> pending(mTasks.size());
+	for (TaskId id = 0; id < mTasks.size(); ++id)
+	{
+		pending[id] = mTasks[id].DependencyCount;
+		if (pending[id] == 0)
+			ready.insert(id);
+	}
+
+	mTimings.assign(mTasks.size(), TaskTiming());
+	std::size_t finished = 0;
+	std::size_t running = 0;
+	std::exception_ptr error;
+	Clock::time_point start = Clock::now();
+
+	auto msSinceStart = [start]()
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	auto work = [&](int worker)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			// After an error, stop once nothing is running rather than when all tasks finish.
+			wake.wait(lock, [&]() { return !ready.empty() || finished == mTasks.size() || (error && running == 0); });
+			if (ready.empty() || error)
+			{
+				wake.notify_all();
+				return;
+			}
+
+			TaskId id = *ready.begin();
+			ready.erase(ready.begin());
+			++running;
+			lock.unlock();
+
+			TaskTiming timing;
+			timing.Name = mTasks[id].Name;
+			timing.Worker = worker;
+			timing.StartMs = msSinceStart();
+			std::exception_ptr taskError;
+			try
+			{
+				mTasks[id].Func();
+			}
+			catch (...)
+			{
+				taskError = std::current_exception();
+			}
+			timing.EndMs = msSinceStart();
+
+			lock.lock();
+			--running;
+			++finished;
+			mTimings[id] = timing;
+			if (taskError && !error)
+				error = taskError;
+
+			if (!error)
+			{
+				for (TaskId dependent : mTasks[id].Dependents)
+				{
+					if (--pending[dependent] == 0)
+						ready.insert(dependent);
+				}
+			}
+			wake.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threadCount; ++i)
+		workers.push_back(std::thread(work, i));
+	work(0);
+	for (std::thread& t : workers)
+		t.join();
+
+	mTotalMs = msSinceStart();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+double TaskGraph::CriticalPathMs()const
+{
+	// Tasks are in topological order, so one pass finds the longest finishing chain.
+	std::vector<double> longest(mTasks.size(), 0.0);
+	double result = 0.0;
+	for (TaskId id = 0; id < mTasks.size() && id < mTimings.size(); ++id)
+	{
+		double before = 0.0;
+		for (TaskId dependency : mTasks[id].Dependencies)
+			before = (std::max)(before, longest[dependency]);
+
+		longest[id] = before + (mTimings[id].EndMs - mTimings[id].StartMs);
+		result = (std::max)(result, longest[id]);
+	}
+	return result;
+}
+
+std::string TaskGraph::TimelineString()const
+{
+	std::vector<const TaskTiming*> order;
+	std::size_t nameWidth = 0;
+	for (const TaskTiming& t : mTimings)
+	{
+		order.push_back(&t);
+		nameWidth = (std::max)(nameWidth, t.Name.size());
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[](const TaskTiming* a, const TaskTiming* b) { return a->StartMs < b->StartMs; });
+
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1);
+	for (const TaskTiming* t : order)
+	{
+		ss << "  " << std::left << std::setw((int)nameWidth) << t->Name << std::right
+			<< std::setw(9) << t->StartMs << " - " << std::setw(7) << t->EndMs << " ms  worker " << t->Worker << "\n";
+	}
+	return ss.str();
+}
@@ -0,0 +1,67 @@
+//***************************************************************************************
+// TaskGraph.h
+//
+// Runs a fixed set of tasks once each, starting every task as soon as the tasks it
+// depends on have finished.  Used for startup, where loading textures, compiling
+// shaders, creating PSOs and generating the world do not depend on each other.
+//
+// Each task's start and end time and the worker it ran on are recorded, so the startup
+// timeline can be logged.  Tasks that record into one command list must be chained with
+// dependencies; the graph knows nothing about D3D.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+struct TaskTiming
+{
+	std::string Name;
+	double StartMs = 0.0;   // since Run was called
+	double EndMs = 0.0;
+	int Worker = 0;         // 0 is the thread that called Run
+};
+
+class TaskGraph
+{
+public:
+	typedef std::uint32_t TaskId;
+	typedef std::function<void()> TaskFunc;
+
+	// Dependencies must have been added before the task, which keeps the graph acyclic.
+	TaskId Add(const std::string& name, TaskFunc func, std::initializer_list<TaskId> dependencies = {});
+
+	// Runs every task on threadCount threads, the calling thread included; 0 picks one
+	// per hardware thread.  With one thread the tasks run in the order they were added.
+	// If a task throws, no further tasks start and the first exception is rethrown here
+	// once the running ones have finished.
+	void Run(int threadCount = 0);
+
+	const std::vector<TaskTiming>& Timings()const { return mTimings; }
+	double TotalMs()const { return mTotalMs; }
+
+	// The longest chain of dependent tasks, by measured time.  No thread count can
+	// finish the graph sooner than this.
+	double CriticalPathMs()const;
+
+	// One line per task in start order, e.g. "  textures        0.0 -   84.2 ms  worker 1".
+	std::string TimelineString()const;
+
+private:
+	struct Task
+	{
+		std::string Name;
+		TaskFunc Func;
+		std::vector<TaskId> Dependencies;
+		std::vector<TaskId> Dependents;
+		std::uint32_t DependencyCount = 0;
+	};
+
+	std::vector<Task> mTasks;
+	std::vector<TaskTiming> mTimings;
+	double mTotalMs = 0.0;
+};
@@ -0,0 +1,341 @@
+#include "TextureBatchLoader.h"
+#include "GpuHeapAllocator.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <iomanip>
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+namespace
+{
+	// Where one subresource's rows come from.
+	struct SourceSubresource
+	{
+		const std::uint8_t* Bits = nullptr;
+		UINT64 RowPitch = 0;
+		UINT64 SlicePitch = 0;
+	};
+
+	struct PendingTexture
+	{
+		std::string Name;
+		std::wstring Filename;
+		D3D12_RESOURCE_DESC Desc = {};
+		HRESULT Result = E_FAIL;
+		std::vector<SourceSubresource> Sources;
+
+		// Loose files only: the mapping Sources point into.
+		MappedFile File;
+
+		// Archive entries only: the whole payload, already laid out for upload.
+		const std::uint8_t* Payload = nullptr;
+		UINT64 PayloadSize = 0;
+		std::vector<UINT64> PayloadOffsets;
+		std::vector<UINT> PayloadRowPitches;
+		bool CopyWholePayload = false;
+
+		// Where each subresource goes in the staging buffer.
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Footprints;
+		std::vector<UINT> NumRows;
+		std::vector<UINT64> RowSizes;
+	};
+
+	double MsSince(std::uint64_t start)
+	{
+		return (Profiler::Now() - start) / 1.0e6;
+	}
+
+	void ReadTexture(PendingTexture& pending)
+	{
+		PROFILE_ZONE("ReadTexture");
+
+		if (!pending.File.Open(pending.Filename))
+		{
+			DWORD error = GetLastError();
+			pending.Result = (error != ERROR_SUCCESS) ? HRESULT_FROM_WIN32(error) : E_FAIL;
+			return;
+		}
+
+		DDSFile dds;
+		DDSLayout layout;
+		pending.Result = DDSStatusToHResult(ParseDDSFile(pending.File.Data(), pending.File.Size(), dds));
+		if (SUCCEEDED(pending.Result))
+			pending.Result = GetDDSResourceDesc12(dds, 0, pending.Desc, layout);
+		if (FAILED(pending.Result))
+			return;
+
+		for (const DDSSubresource& sub : layout.Subresources)
+		{
+			SourceSubresource source;
+			source.Bits = dds.BitData + sub.Offset;
+			source.RowPitch = sub.RowPitch;
+			source.SlicePitch = sub.SlicePitch;
+			pending.Sources.push_back(source);
+		}
+	}
+
+	void StageTexture(const PendingTexture& pending, std::uint8_t* staging)
+	{
+		PROFILE_ZONE("StageTexture");
+
+		if (pending.CopyWholePayload)
+		{
+			memcpy(staging + pending.Footprints[0].Offset - pending.PayloadOffsets[0], pending.Payload, (size_t)pending.PayloadSize);
+			return;
+		}
+
+		for (size_t s = 0; s < pending.Sources.size(); ++s)
+		{
+			const SourceSubresource& src = pending.Sources[s];
+			const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& dst = pending.Footprints[s];
+			std::uint8_t* dstBits = staging + dst.Offset;
+			const UINT64 dstSlicePitch = (UINT64)dst.Footprint.RowPitch * pending.NumRows[s];
+
+			for (UINT z = 0; z < dst.Footprint.Depth; ++z)
+			{
+				for (UINT y = 0; y < pending.NumRows[s]; ++y)
+				{
+					memcpy(dstBits + z * dstSlicePitch + (UINT64)y * dst.Footprint.RowPitch,
+						src.Bits + z * src.SlicePitch + y * src.RowPitch,
+						(size_t)pending.RowSizes[s]);
+				}
+			}
+		}
+	}
+
+	// Creates the textures, stages every pending texture into one upload buffer and
+	// records the copies.  Fills in the create, copy and record times.
+	std::vector<std::unique_ptr<Texture>> UploadBatch(
+		ID3D12Device* device,
+		GpuHeapAllocator* heaps,
+		ID3D12GraphicsCommandList* cmdList,
+		std::vector<PendingTexture>& pending,
+		ComPtr<ID3D12Resource>& staging,
+		TextureBatchStats& batch)
+	{
+		std::vector<std::unique_ptr<Texture>> textures;
+		const int count = (int)pending.size();
+
+		// Create the textures and lay every subresource out in one staging buffer.  Each
+		// texture starts on a placement boundary, so the slices never overlap.
+		std::uint64_t phaseStart = Profiler::Now();
+		UINT64 stagingSize = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			PendingTexture& p = pending[i];
+
+			auto texture = std::make_unique<Texture>();
+			texture->Name = p.Name;
+			texture->Filename = p.Filename;
+			ThrowIfFailed(device->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+				D3D12_HEAP_FLAG_NONE,
+				&p.Desc,
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(&texture->Resource)));
+			textures.push_back(std::move(texture));
+
+			UINT subresourceCount = (UINT)p.Sources.size();
+			p.Footprints.resize(subresourceCount);
+			p.NumRows.resize(subresourceCount);
+			p.RowSizes.resize(subresourceCount);
+
+			UINT64 bytes = 0;
+			const UINT64 alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+			stagingSize = (stagingSize + alignment - 1) & ~(alignment - 1);
+			device->GetCopyableFootprints(&p.Desc, 0, subresourceCount, stagingSize,
+				p.Footprints.data(), p.NumRows.data(), p.RowSizes.data(), &bytes);
+
+			// An archive payload laid out exactly as this device wants goes over in one copy.
+			p.CopyWholePayload = (p.Payload != nullptr);
+			for (UINT s = 0; s < subresourceCount && p.CopyWholePayload; ++s)
+			{
+				p.CopyWholePayload = p.Footprints[s].Offset - stagingSize == p.PayloadOffsets[s] &&
+					p.Footprints[s].Footprint.RowPitch == p.PayloadRowPitches[s];
+			}
+			stagingSize += p.CopyWholePayload ? (std::max)(bytes, p.PayloadSize) : bytes;
+		}
+
+		staging = heaps->CreateBuffer(stagingSize, D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ, GpuMemoryCategory::Upload);
+		batch.StagingBytes = stagingSize;
+		batch.CreateMs = MsSince(phaseStart);
+
+		// Copy straight from the mappings into each texture's slice of the staging buffer.
+		phaseStart = Profiler::Now();
+		std::uint8_t* mapped = nullptr;
+		ThrowIfFailed(staging->Map(0, nullptr, reinterpret_cast<void**>(&mapped)));
+		ParallelFor(0, count, batch.Threads, [&](int i) { StageTexture(pending[i], mapped); });
+		staging->Unmap(0, nullptr);
+		batch.CopyMs = MsSince(phaseStart);
+		RENDER_STAT_UPLOAD(UploadKind::Textures, stagingSize);
+
+		// One batch of copies, then one barrier call for every texture.
+		phaseStart = Profiler::Now();
+		std::vector<D3D12_RESOURCE_BARRIER> barriers;
+		for (int i = 0; i < count; ++i)
+		{
+			ID3D12Resource* resource = textures[i]->Resource.Get();
+			for (UINT s = 0; s < (UINT)pending[i].Footprints.size(); ++s)
+			{
+				CD3DX12_TEXTURE_COPY_LOCATION dst(resource, s);
+				CD3DX12_TEXTURE_COPY_LOCATION src(staging.Get(), pending[i].Footprints[s]);
+				cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+			}
+
+			barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		}
+		cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+		batch.RecordMs = MsSince(phaseStart);
+
+		return textures;
+	}
+}
+
+bool LoadTextureManifest(const std::wstring& path, std::vector<TextureManifestEntry>& entries)
+{
+	entries.clear();
+
+	std::ifstream fin(path);
+	if (!fin)
+		return false;
+
+	std::string line;
+	while (std::getline(fin, line))
+	{
+		std::istringstream fields(line);
+		std::string name;
+		std::string filename;
+		if (!(fields >> name) || name[0] == '#' || !(fields >> filename))
+			continue;
+
+		TextureManifestEntry entry;
+		entry.Name = name;
+		entry.Filename = AnsiToWString(filename);
+		entries.push_back(entry);
+	}
+	return true;
+}
+
+std::string TextureBatchStats::ToString()const
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1) << "Textures: " << Count << " on " << Threads << " thread(s), "
+		<< StagingBytes / (1024.0 * 1024.0) << " MB staged, " << TotalMs() << " ms (read " << ReadMs
+		<< ", create " << CreateMs << ", copy " << CopyMs << ", record " << RecordMs << ")\n";
+	return ss.str();
+}
+
+std::vector<std::unique_ptr<Texture>> LoadTextureBatch(
+	ID3D12Device* device,
+	GpuHeapAllocator* heaps,
+	ID3D12GraphicsCommandList* cmdList,
+	const std::vector<TextureManifestEntry>& entries,
+	int threadCount,
+	ComPtr<ID3D12Resource>& staging,
+	TextureBatchStats* stats)
+{
+	PROFILE_ZONE("LoadTextureBatch");
+
+	TextureBatchStats batch;
+	batch.Count = (UINT)entries.size();
+	batch.Threads = (threadCount > 0) ? threadCount : DefaultThreadCount();
+
+	std::vector<std::unique_ptr<Texture>> textures;
+	if (!entries.empty())
+	{
+		const int count = (int)entries.size();
+		std::vector<PendingTexture> pending(entries.size());
+		for (int i = 0; i < count; ++i)
+		{
+			pending[i].Name = entries[i].Name;
+			pending[i].Filename = entries[i].Filename;
+		}
+
+		// Map and validate every file.  Workers cannot throw, so failures are reported here.
+		std::uint64_t phaseStart = Profiler::Now();
+		ParallelFor(0, count, batch.Threads, [&](int i) { ReadTexture(pending[i]); });
+		for (int i = 0; i < count; ++i)
+		{
+			if (FAILED(pending[i].Result))
+				throw DxException(pending[i].Result, L"LoadTextureBatch(" + entries[i].Filename + L")", AnsiToWString(__FILE__), __LINE__);
+		}
+		batch.ReadMs = MsSince(phaseStart);
+
+		textures = UploadBatch(device, heaps, cmdList, pending, staging, batch);
+	}
+
+	if (stats != nullptr)
+		*stats = batch;
+	return textures;
+}
+
+std::vector<std::unique_ptr<Texture>> LoadTextureBatch(
+	ID3D12Device* device,
+	GpuHeapAllocator* heaps,
+	ID3D12GraphicsCommandList* cmdList,
+	const AssetArchive& archive,
+	const std::wstring& archivePath,
+	int threadCount,
+	ComPtr<ID3D12Resource>& staging,
+	TextureBatchStats* stats)
+{
+	PROFILE_ZONE("LoadTextureBatch");
+
+	TextureBatchStats batch;
+	batch.Threads = (threadCount > 0) ? threadCount : DefaultThreadCount();
+
+	// The archive is already mapped and validated, so there is nothing to read.
+	std::uint32_t count = 0;
+	for (std::uint32_t i = 0; i < archive.EntryCount(); ++i)
+		count += (archive.Entry(i).Kind == ArchiveEntryKind::Texture) ? 1 : 0;
+
+	std::vector<PendingTexture> pending(count);
+	std::uint32_t next = 0;
+	for (std::uint32_t i = 0; i < archive.EntryCount(); ++i)
+	{
+		const ArchiveEntry& entry = archive.Entry(i);
+		if (entry.Kind != ArchiveEntryKind::Texture)
+			continue;
+
+		PendingTexture& p = pending[next++];
+		p.Name = archive.Name(entry);
+		p.Filename = archivePath;
+		p.Payload = archive.Payload(entry);
+		p.PayloadSize = entry.PayloadSize;
+
+		p.Desc.Dimension = (D3D12_RESOURCE_DIMENSION)entry.Dimension;
+		p.Desc.Width = entry.Width;
+		p.Desc.Height = entry.Height;
+		p.Desc.DepthOrArraySize = (UINT16)((entry.Dimension == ArchiveDimension::Texture3D) ? entry.Depth : entry.ArraySize);
+		p.Desc.MipLevels = (UINT16)entry.MipCount;
+		p.Desc.Format = (DXGI_FORMAT)entry.Format;
+		p.Desc.SampleDesc.Count = 1;
+		p.Desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+
+		const ArchiveSubresource* subresources = archive.Subresources(entry);
+		for (std::uint32_t s = 0; s < entry.SubresourceCount; ++s)
+		{
+			SourceSubresource source;
+			source.Bits = p.Payload + subresources[s].Offset;
+			source.RowPitch = subresources[s].RowPitch;
+			source.SlicePitch = (UINT64)subresources[s].RowPitch * subresources[s].NumRows;
+			p.Sources.push_back(source);
+			p.PayloadOffsets.push_back(subresources[s].Offset);
+			p.PayloadRowPitches.push_back(subresources[s].RowPitch);
+		}
+	}
+	batch.Count = count;
+
+	std::vector<std::unique_ptr<Texture>> textures;
+	if (count > 0)
+		textures = UploadBatch(device, heaps, cmdList, pending, staging, batch);
+
+	if (stats != nullptr)
+		*stats = batch;
+	return textures;
+}
@@ -0,0 +1,69 @@
+//***************************************************************************************
+// TextureBatchLoader.h
+//
+// Loads a list of DDS textures as one batch.  Worker threads map the files and validate
+// their headers, then copy each texture's subresources into its own slice of a single
+// staging buffer.  The copy commands for every texture are recorded into the command
+// list afterwards on the calling thread, followed by one barrier call for them all.
+//
+// The list comes either from a manifest file with one "name path" pair per line (blank
+// lines and lines starting with '#' are skipped) or from the texture entries of an
+// AssetArchive.  Archive payloads are already in the upload layout, so each texture is
+// staged with a single copy when the device agrees with that layout.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "AssetArchive.h"
+
+class GpuHeapAllocator;
+
+struct TextureManifestEntry
+{
+	std::string Name;
+	std::wstring Filename;
+};
+
+// Returns false if the manifest could not be opened.
+bool LoadTextureManifest(const std::wstring& path, std::vector<TextureManifestEntry>& entries);
+
+struct TextureBatchStats
+{
+	UINT Count = 0;
+	int Threads = 0;
+	UINT64 StagingBytes = 0;
+
+	double ReadMs = 0.0;     // map and validate loose files, in parallel
+	double CreateMs = 0.0;   // texture resources and the staging buffer
+	double CopyMs = 0.0;     // into the staging buffer, in parallel
+	double RecordMs = 0.0;   // copy commands and barriers
+
+	double TotalMs()const { return ReadMs + CreateMs + CopyMs + RecordMs; }
+	std::string ToString()const;
+};
+
+// Creates every texture in entries, in order, and records their uploads into cmdList.
+// The staging buffer is placed in heaps; free it there once cmdList has executed.
+// threadCount 0 uses one thread per core.  Throws DxException naming the file that
+// failed to load.
+std::vector<std::unique_ptr<Texture>> LoadTextureBatch(
+	ID3D12Device* device,
+	GpuHeapAllocator* heaps,
+	ID3D12GraphicsCommandList* cmdList,
+	const std::vector<TextureManifestEntry>& entries,
+	int threadCount,
+	Microsoft::WRL::ComPtr<ID3D12Resource>& staging,
+	TextureBatchStats* stats = nullptr);
+
+// Creates a texture for every texture entry in the archive, named after the entry.
+// The archive must stay open until this returns.
+std::vector<std::unique_ptr<Texture>> LoadTextureBatch(
+	ID3D12Device* device,
+	GpuHeapAllocator* heaps,
+	ID3D12GraphicsCommandList* cmdList,
+	const AssetArchive& archive,
+	const std::wstring& archivePath,
+	int threadCount,
+	Microsoft::WRL::ComPtr<ID3D12Resource>& staging,
+	TextureBatchStats* stats = nullptr);
@@ -0,0 +1,405 @@
+#include "TextureStreamer.h"
+#include "DescriptorHeapAllocator.h"
+#include "GpuHeapAllocator.h"
+#include "Profiler.h"
+#include <iomanip>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	const UINT64 TileBytes = D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+}
+
+TextureStreamer::TextureStreamer(ID3D12Device* device, ID3D12CommandQueue* queue, GpuHeapAllocator* heaps,
+	const MipResidencyParams& params, UINT tailMips) :
+	md3dDevice(device),
+	mQueue(queue),
+	mHeaps(heaps),
+	mTailMips(tailMips > 0 ? tailMips : 1),
+	mResidency(params)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// The owner has flushed the queue, so the staging buffers are idle.
+	for (PendingLoad& load : mPending)
+		mHeaps->Free(load.Staging.Get());
+}
+
+bool TextureStreamer::IsSupported(ID3D12Device* device, const AssetArchive& archive)
+{
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))) ||
+		options.TiledResourcesTier == D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED)
+	{
+		return false;
+	}
+
+	for (std::uint32_t i = 0; i < archive.EntryCount(); ++i)
+	{
+		const ArchiveEntry& entry = archive.Entry(i);
+		if (entry.Kind == ArchiveEntryKind::Texture &&
+			(entry.Dimension != ArchiveDimension::Texture2D || entry.ArraySize != 1 || entry.IsCubeMap != 0))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<std::unique_ptr<Texture>> TextureStreamer::CreateTextures(
+	ID3D12GraphicsCommandList* cmdList,
+	const AssetArchive& archive,
+	const std::wstring& archivePath,
+	ComPtr<ID3D12Resource>& staging)
+{
+	PROFILE_ZONE("TextureStreamer::CreateTextures");
+
+	std::vector<std::unique_ptr<Texture>> textures;
+	for (std::uint32_t i = 0; i < archive.EntryCount(); ++i)
+	{
+		const ArchiveEntry& entry = archive.Entry(i);
+		if (entry.Kind != ArchiveEntryKind::Texture)
+			continue;
+
+		StreamedTexture st;
+		st.Entry = &entry;
+		st.Subresources = archive.Subresources(entry);
+		st.Payload = archive.Payload(entry);
+		st.Desc = CD3DX12_RESOURCE_DESC::Tex2D((DXGI_FORMAT)entry.Format, entry.Width, entry.Height, 1, (UINT16)entry.MipCount);
+		st.Desc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE;
+
+		auto texture = std::make_unique<Texture>();
+		texture->Name = archive.Name(entry);
+		texture->Filename = archivePath;
+		ThrowIfFailed(md3dDevice->CreateReservedResource(&st.Desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+			IID_PPV_ARGS(&texture->Resource)));
+		st.Owner = texture.get();
+
+		UINT tileCount = 0;
+		UINT tilingCount = entry.MipCount;
+		D3D12_TILE_SHAPE tileShape = {};
+		st.Tilings.resize(entry.MipCount);
+		md3dDevice->GetResourceTiling(texture->Resource.Get(), &tileCount, &st.PackedMips, &tileShape,
+			&tilingCount, 0, st.Tilings.data());
+		st.StandardMips = st.PackedMips.NumStandardMips;
+
+		// The tail is the smallest mips asked for, or the packed mips if they go further.
+		std::vector<std::uint64_t> mipBytes(entry.MipCount);
+		for (UINT m = 0; m < entry.MipCount; ++m)
+			mipBytes[m] = TileCount(st, m) * TileBytes;
+		UINT tailMip = (entry.MipCount > mTailMips) ? entry.MipCount - mTailMips : 0;
+		mResidency.AddTexture(mipBytes, (std::min)(tailMip, st.StandardMips));
+		st.MinLod = mResidency.TailMip((std::uint32_t)mTextures.size());
+		st.MipHeaps.resize(entry.MipCount);
+
+		mTextures.push_back(std::move(st));
+		textures.push_back(std::move(texture));
+	}
+
+	// Map every tail into one heap per texture: the standard tail mips in order, then the
+	// packed tiles.
+	for (int s = 0; s < (int)mTextures.size(); ++s)
+	{
+		StreamedTexture& st = mTextures[s];
+		std::vector<D3D12_TILED_RESOURCE_COORDINATE> coordinates;
+		std::vector<D3D12_TILE_REGION_SIZE> sizes;
+		UINT tiles = 0;
+		for (UINT m = st.MinLod; m < st.Entry->MipCount; ++m)
+		{
+			UINT count = TileCount(st, m);
+			if (count == 0)
+				continue;
+
+			coordinates.push_back(CD3DX12_TILED_RESOURCE_COORDINATE(0, 0, 0, m));
+			D3D12_TILE_REGION_SIZE size = {};
+			size.NumTiles = count;
+			sizes.push_back(size);
+			tiles += count;
+		}
+
+		st.TailHeap = CreateTileHeap(tiles);
+		D3D12_TILE_RANGE_FLAGS flags = D3D12_TILE_RANGE_FLAG_NONE;
+		UINT heapStart = 0;
+		mQueue->UpdateTileMappings(st.Owner->Resource.Get(), (UINT)coordinates.size(), coordinates.data(), sizes.data(),
+			st.TailHeap.Get(), 1, &flags, &heapStart, &tiles, D3D12_TILE_MAPPING_FLAG_NONE);
+		TrackMemory(s);
+	}
+
+	// Stage every tail in one buffer and copy them over, as LoadTextureBatch does.
+	struct TailCopy
+	{
+		UINT Stream;
+		UINT Mip;
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint;
+		UINT NumRows;
+		UINT64 RowSize;
+	};
+	std::vector<TailCopy> copies;
+	UINT64 stagingSize = 0;
+	for (UINT s = 0; s < (UINT)mTextures.size(); ++s)
+	{
+		const StreamedTexture& st = mTextures[s];
+		for (UINT m = st.MinLod; m < st.Entry->MipCount; ++m)
+		{
+			TailCopy copy = { s, m };
+			UINT64 bytes = 0;
+			stagingSize = (stagingSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+			md3dDevice->GetCopyableFootprints(&st.Desc, m, 1, stagingSize, &copy.Footprint, &copy.NumRows, &copy.RowSize, &bytes);
+			stagingSize += bytes;
+			copies.push_back(copy);
+		}
+	}
+
+	if (!copies.empty())
+	{
+		staging = mHeaps->CreateBuffer(stagingSize, D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ, GpuMemoryCategory::Upload);
+
+		std::uint8_t* mapped = nullptr;
+		ThrowIfFailed(staging->Map(0, nullptr, reinterpret_cast<void**>(&mapped)));
+		for (const TailCopy& copy : copies)
+			CopyMip(mTextures[copy.Stream], copy.Mip, copy.Footprint, copy.NumRows, copy.RowSize, mapped);
+		staging->Unmap(0, nullptr);
+		RENDER_STAT_UPLOAD(UploadKind::Textures, stagingSize);
+
+		for (const TailCopy& copy : copies)
+		{
+			CD3DX12_TEXTURE_COPY_LOCATION dst(mTextures[copy.Stream].Owner->Resource.Get(), copy.Mip);
+			CD3DX12_TEXTURE_COPY_LOCATION src(staging.Get(), copy.Footprint);
+			cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+		}
+	}
+
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	for (const StreamedTexture& st : mTextures)
+	{
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(st.Owner->Resource.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+	}
+	if (!barriers.empty())
+		cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+	return textures;
+}
+
+int TextureStreamer::Find(const Texture* texture)const
+{
+	for (size_t i = 0; i < mTextures.size(); ++i)
+	{
+		if (mTextures[i].Owner == texture)
+			return (int)i;
+	}
+	return -1;
+}
+
+D3D12_SHADER_RESOURCE_VIEW_DESC TextureStreamer::SrvDesc(int stream)const
+{
+	const StreamedTexture& st = mTextures[stream];
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = st.Desc.Format;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = st.Desc.MipLevels;
+	srvDesc.Texture2D.ResourceMinLODClamp = (float)st.MinLod;
+	return srvDesc;
+}
+
+void TextureStreamer::BeginFrame(UINT64 completedFence, float pixelsPerUnit)
+{
+	PROFILE_ZONE("TextureStreamer::BeginFrame");
+
+	// The copies have executed, so the new mips can be sampled.
+	for (size_t i = 0; i < mPending.size();)
+	{
+		PendingLoad& load = mPending[i];
+		if (load.Fence > completedFence)
+		{
+			++i;
+			continue;
+		}
+
+		StreamedTexture& st = mTextures[load.Stream];
+		mResidency.FinishLoad((std::uint32_t)load.Stream);
+		st.MinLod = load.Mip;
+		UpdateSrv(st);
+
+		mHeaps->Free(load.Staging.Get());
+		mPending[i] = std::move(mPending.back());
+		mPending.pop_back();
+	}
+
+	for (size_t i = 0; i < mRetired.size();)
+	{
+		if (mRetired[i].Fence <= completedFence)
+		{
+			mRetired[i] = std::move(mRetired.back());
+			mRetired.pop_back();
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	mPixelsPerUnit = pixelsPerUnit;
+	mResidency.BeginFrame();
+}
+
+void TextureStreamer::Request(int stream, float distance)
+{
+	const ArchiveEntry& entry = *mTextures[stream].Entry;
+	float texelsPerUnit = (float)(std::max)(entry.Width, entry.Height);
+	mResidency.Request((std::uint32_t)stream, MipForDistance(texelsPerUnit, distance, mPixelsPerUnit));
+}
+
+void TextureStreamer::Update(ID3D12GraphicsCommandList* cmdList, UINT64 fence)
+{
+	PROFILE_ZONE("TextureStreamer::Update");
+
+	mResidency.Update(mChanges);
+
+	// Stop sampling each dropped mip, then unmap it behind the frames already submitted.
+	for (const MipChange& drop : mChanges.Drops)
+	{
+		StreamedTexture& st = mTextures[drop.Texture];
+		st.MinLod = drop.Mip + 1;
+		UpdateSrv(st);
+
+		D3D12_TILED_RESOURCE_COORDINATE coordinate = CD3DX12_TILED_RESOURCE_COORDINATE(0, 0, 0, drop.Mip);
+		D3D12_TILE_REGION_SIZE size = {};
+		size.NumTiles = TileCount(st, drop.Mip);
+		D3D12_TILE_RANGE_FLAGS flags = D3D12_TILE_RANGE_FLAG_NULL;
+		mQueue->UpdateTileMappings(st.Owner->Resource.Get(), 1, &coordinate, &size,
+			nullptr, 1, &flags, nullptr, &size.NumTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+
+		mRetired.push_back({ std::move(st.MipHeaps[drop.Mip]), fence });
+		TrackMemory((int)drop.Texture);
+	}
+
+	if (mChanges.Loads.empty())
+		return;
+
+	// Map each new mip to a heap of its own and copy it in from the archive.  The copied
+	// subresources are not sampled yet, so only they change state.
+	std::vector<D3D12_RESOURCE_BARRIER> toCopy;
+	std::vector<D3D12_RESOURCE_BARRIER> toRead;
+	for (const MipChange& load : mChanges.Loads)
+	{
+		StreamedTexture& st = mTextures[load.Texture];
+		ID3D12Resource* resource = st.Owner->Resource.Get();
+
+		D3D12_TILED_RESOURCE_COORDINATE coordinate = CD3DX12_TILED_RESOURCE_COORDINATE(0, 0, 0, load.Mip);
+		D3D12_TILE_REGION_SIZE size = {};
+		size.NumTiles = TileCount(st, load.Mip);
+		st.MipHeaps[load.Mip] = CreateTileHeap(size.NumTiles);
+		D3D12_TILE_RANGE_FLAGS flags = D3D12_TILE_RANGE_FLAG_NONE;
+		UINT heapStart = 0;
+		mQueue->UpdateTileMappings(resource, 1, &coordinate, &size,
+			st.MipHeaps[load.Mip].Get(), 1, &flags, &heapStart, &size.NumTiles, D3D12_TILE_MAPPING_FLAG_NONE);
+		TrackMemory((int)load.Texture);
+
+		PendingLoad pending = { (int)load.Texture, load.Mip, fence };
+		UINT numRows = 0;
+		UINT64 rowSize = 0;
+		UINT64 bytes = 0;
+		md3dDevice->GetCopyableFootprints(&st.Desc, load.Mip, 1, 0, &pending.Footprint, &numRows, &rowSize, &bytes);
+
+		pending.Staging = mHeaps->CreateBuffer(bytes, D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ, GpuMemoryCategory::Upload);
+		std::uint8_t* mapped = nullptr;
+		ThrowIfFailed(pending.Staging->Map(0, nullptr, reinterpret_cast<void**>(&mapped)));
+		CopyMip(st, load.Mip, pending.Footprint, numRows, rowSize, mapped);
+		pending.Staging->Unmap(0, nullptr);
+		RENDER_STAT_UPLOAD(UploadKind::Textures, bytes);
+
+		toCopy.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST, load.Mip));
+		toRead.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, load.Mip));
+		mPending.push_back(std::move(pending));
+	}
+
+	cmdList->ResourceBarrier((UINT)toCopy.size(), toCopy.data());
+	for (size_t i = mPending.size() - mChanges.Loads.size(); i < mPending.size(); ++i)
+	{
+		const PendingLoad& load = mPending[i];
+		CD3DX12_TEXTURE_COPY_LOCATION dst(mTextures[load.Stream].Owner->Resource.Get(), load.Mip);
+		CD3DX12_TEXTURE_COPY_LOCATION src(load.Staging.Get(), load.Footprint);
+		cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+	cmdList->ResourceBarrier((UINT)toRead.size(), toRead.data());
+}
+
+std::string TextureStreamer::StatsString()const
+{
+	const MipResidencyStats& stats = mResidency.Stats();
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1) << mResidency.ResidentBytes() / (1024.0 * 1024.0) << " MB resident ("
+		<< mResidency.TailBytes() / (1024.0 * 1024.0) << " MB tails) of " << mResidency.BudgetBytes() / (1024.0 * 1024.0)
+		<< " MB, " << mResidency.LoadsInFlight() << " loading, " << stats.Loads << " loads, " << stats.Drops << " drops, "
+		<< stats.Reloads << " reloads, " << stats.DeferredLoads << " deferred";
+	return ss.str();
+}
+
+UINT TextureStreamer::TileCount(const StreamedTexture& st, UINT mip)const
+{
+	// The packed tiles are counted once, on the first packed mip.
+	if (mip >= st.StandardMips)
+		return (mip == st.StandardMips) ? st.PackedMips.NumTilesForPackedMips : 0;
+
+	const D3D12_SUBRESOURCE_TILING& tiling = st.Tilings[mip];
+	return tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles;
+}
+
+ComPtr<ID3D12Heap> TextureStreamer::CreateTileHeap(UINT tiles)
+{
+	CD3DX12_HEAP_DESC desc((std::max)(tiles, 1u) * TileBytes, D3D12_HEAP_TYPE_DEFAULT, 0,
+		D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES);
+
+	ComPtr<ID3D12Heap> heap;
+	ThrowIfFailed(md3dDevice->CreateHeap(&desc, IID_PPV_ARGS(&heap)));
+	return heap;
+}
+
+void TextureStreamer::CopyMip(const StreamedTexture& st, UINT mip, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint,
+	UINT numRows, UINT64 rowSize, std::uint8_t* staging)const
+{
+	const ArchiveSubresource& src = st.Subresources[mip];
+	const std::uint8_t* srcBits = st.Payload + src.Offset;
+	std::uint8_t* dstBits = staging + footprint.Offset;
+
+	// Archive rows are already pitch aligned, so the rows usually line up as one block.
+	if (src.RowPitch == footprint.Footprint.RowPitch)
+	{
+		memcpy(dstBits, srcBits, (size_t)src.RowPitch * (numRows - 1) + (size_t)rowSize);
+		return;
+	}
+
+	for (UINT y = 0; y < numRows; ++y)
+		memcpy(dstBits + (UINT64)y * footprint.Footprint.RowPitch, srcBits + (UINT64)y * src.RowPitch, (size_t)rowSize);
+}
+
+void TextureStreamer::UpdateSrv(StreamedTexture& st)
+{
+	if (mSrvHeap == nullptr || st.Owner->SrvHeapIndex < 0)
+		return;
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = SrvDesc((int)(&st - mTextures.data()));
+	st.Owner->SrvHeapIndex = (int)mSrvHeap->ReplaceSrv((UINT)st.Owner->SrvHeapIndex, st.Owner->Resource.Get(), &srvDesc);
+}
+
+void TextureStreamer::TrackMemory(int stream)
+{
+	StreamedTexture& st = mTextures[stream];
+	std::uint32_t tailMip = mResidency.TailMip((std::uint32_t)stream);
+
+	UINT64 tiles = 0;
+	for (UINT m = 0; m < st.Entry->MipCount; ++m)
+		tiles += (m >= tailMip || st.MipHeaps[m] != nullptr) ? TileCount(st, m) : 0;
+	st.Memory.Reset(MemoryDomain::Gpu, MemoryCategory::Textures, tiles * TileBytes);
+}
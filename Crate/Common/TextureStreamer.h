@@ -0,0 +1,134 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Streams the mips of AssetArchive textures in and out of reserved (tiled) resources,
+// with MipResidency deciding what is resident.  At startup each texture maps and
+// uploads only its tail: its smallest TailMips mips, plus any mips D3D packs into
+// shared tiles.  A finer mip is given its own heap and uploaded straight from the
+// archive's mapping when a visible surface is close enough to show it, and loses the
+// heap again when the budget needs the room.
+//
+// Every SRV covers the whole mip chain with ResourceMinLODClamp at the finest resident
+// mip, so shaders never touch unmapped tiles.  Frames already submitted may still read
+// the old SRV, so a clamp change writes a new one and the texture's SrvHeapIndex moves:
+//
+//   load: map the tiles on the queue and record the copy into the frame's command
+//         list; lower the clamp once that frame's fence has passed.
+//   drop: raise the clamp at once, then unmap the tiles on the queue behind the frames
+//         already submitted; the heap is released once the current frame has executed.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "AssetArchive.h"
+#include "MipResidency.h"
+
+class DescriptorHeapAllocator;
+class GpuHeapAllocator;
+
+class TextureStreamer
+{
+public:
+	TextureStreamer(ID3D12Device* device, ID3D12CommandQueue* queue, GpuHeapAllocator* heaps,
+		const MipResidencyParams& params, UINT tailMips);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+	~TextureStreamer();
+
+	// Needs tiled resources, and every texture in the archive to be a single 2D texture.
+	static bool IsSupported(ID3D12Device* device, const AssetArchive& archive);
+
+	// Creates a reserved texture for every texture entry in the archive, named after the
+	// entry, and records the upload of each tail into cmdList.  The archive must stay
+	// open as long as the streamer.  The staging buffer is placed in heaps; free it
+	// there once cmdList has executed.
+	std::vector<std::unique_ptr<Texture>> CreateTextures(
+		ID3D12GraphicsCommandList* cmdList,
+		const AssetArchive& archive,
+		const std::wstring& archivePath,
+		Microsoft::WRL::ComPtr<ID3D12Resource>& staging);
+
+	// Index of the streamed texture, or -1.
+	int Find(const Texture* texture)const;
+
+	// The view a streamed texture's SRV must start with.  Once every SRV exists, hand the
+	// heap over with SetSrvHeap so the streamer can move the clamps.
+	D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc(int stream)const;
+	void SetSrvHeap(DescriptorHeapAllocator* srvHeap) { mSrvHeap = srvHeap; }
+
+	// The texture's current SRV; it changes whenever BeginFrame or Update moves the clamp.
+	int SrvHeapIndex(int stream)const { return mTextures[stream].Owner->SrvHeapIndex; }
+
+	// Call once the current frame resource's fence has been waited on.  Lowers the clamps
+	// of finished loads and releases the heaps of dropped mips.  pixelsPerUnit is as for
+	// MipForDistance.
+	void BeginFrame(UINT64 completedFence, float pixelsPerUnit);
+
+	// One use of a streamed texture, distance world units from the eye.  Textures are
+	// taken to cover one world unit, as they do on block faces.
+	void Request(int stream, float distance);
+
+	// Drops and loads what the requests and the budget call for.  Records the uploads into
+	// cmdList, whose commands are followed by a signal of fence.
+	void Update(ID3D12GraphicsCommandList* cmdList, UINT64 fence);
+
+	const MipResidency& Residency()const { return mResidency; }
+	std::string StatsString()const;
+
+private:
+	struct StreamedTexture
+	{
+		Texture* Owner = nullptr;
+		const ArchiveEntry* Entry = nullptr;
+		const ArchiveSubresource* Subresources = nullptr;
+		const std::uint8_t* Payload = nullptr;
+		D3D12_RESOURCE_DESC Desc = {};
+
+		// Mips from StandardMips on share the packed tiles.
+		UINT StandardMips = 0;
+		D3D12_PACKED_MIP_INFO PackedMips = {};
+		std::vector<D3D12_SUBRESOURCE_TILING> Tilings;
+
+		Microsoft::WRL::ComPtr<ID3D12Heap> TailHeap;
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> MipHeaps;   // null unless mapped
+		UINT MinLod = 0;
+		TrackedMemory Memory;
+	};
+
+	struct PendingLoad
+	{
+		int Stream;
+		UINT Mip;
+		UINT64 Fence;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Staging;
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint;
+	};
+
+	struct RetiredHeap
+	{
+		Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+		UINT64 Fence;
+	};
+
+	UINT TileCount(const StreamedTexture& st, UINT mip)const;
+	Microsoft::WRL::ComPtr<ID3D12Heap> CreateTileHeap(UINT tiles);
+	void CopyMip(const StreamedTexture& st, UINT mip, const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint,
+		UINT numRows, UINT64 rowSize, std::uint8_t* staging)const;
+	void UpdateSrv(StreamedTexture& st);
+	void TrackMemory(int stream);
+
+private:
+	ID3D12Device* md3dDevice = nullptr;
+	ID3D12CommandQueue* mQueue = nullptr;
+	GpuHeapAllocator* mHeaps = nullptr;
+	DescriptorHeapAllocator* mSrvHeap = nullptr;
+	UINT mTailMips = 0;
+	float mPixelsPerUnit = 0.0f;
+
+	MipResidency mResidency;
+	MipResidencyUpdate mChanges;
+	std::vector<StreamedTexture> mTextures;   // same order as mResidency's
+	std::vector<PendingLoad> mPending;
+	std::vector<RetiredHeap> mRetired;
+};
@@ -31,6 +31,9 @@ public:
 
         ThrowIfFailed(mUploadBuffer->Map(0, nullptr, reinterpret_cast<void**>(&mMappedData)));
 
+        mMemory.Reset(MemoryDomain::Gpu, isConstantBuffer ? MemoryCategory::Constants : MemoryCategory::Staging,
+            d3dUtil::AllocationSize(device, mUploadBuffer.Get()));
+
         // We do not need to unmap until we are done with the resource.  However, we must not write to
         // the resource while it is in use by the GPU (so we must use synchronization techniques).
     }
@@ -53,6 +56,7 @@ public:
     void CopyData(int elementIndex, const T& data)
     {
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
+        RENDER_STAT_UPLOAD(mIsConstantBuffer ? UploadKind::Constants : UploadKind::Dynamic, sizeof(T));
     }
 
 private:
@@ -61,4 +65,6 @@ private:
 
     UINT mElementByteSize = 0;
     bool mIsConstantBuffer = false;
+
+    TrackedMemory mMemory;
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 
 #include "d3dUtil.h"
+#include "GpuHeapAllocator.h"
 #include <comdef.h>
 #include <fstream>
 
@@ -35,6 +36,12 @@ ComPtr<ID3DBlob> d3dUtil::LoadBinary(const std::wstring& filename)
     return blob;
 }
 
+UINT64 d3dUtil::AllocationSize(ID3D12Device* device, ID3D12Resource* resource)
+{
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	return device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
 Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     ID3D12Device* device,
     ID3D12GraphicsCommandList* cmdList,
@@ -84,6 +91,31 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     // The caller can Release the uploadBuffer after it knows the copy has been executed.
 
 
+    RENDER_STAT_UPLOAD(UploadKind::Geometry, byteSize);
+    return defaultBuffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
+    GpuHeapAllocator* allocator,
+    ID3D12GraphicsCommandList* cmdList,
+    const void* initData,
+    UINT64 byteSize,
+    UINT64& offset,
+    Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
+    UINT64& uploadOffset)
+{
+    ComPtr<ID3D12Resource> defaultBuffer = allocator->CreateBufferRange(byteSize,
+        D3D12_HEAP_TYPE_DEFAULT, GpuMemoryCategory::Geometry, offset);
+
+    uploadBuffer = allocator->CreateBufferRange(byteSize,
+        D3D12_HEAP_TYPE_UPLOAD, GpuMemoryCategory::Upload, uploadOffset);
+
+    memcpy(allocator->MappedRange(uploadBuffer.Get(), uploadOffset), initData, (size_t)byteSize);
+    allocator->CopyRange(cmdList, defaultBuffer.Get(), offset, uploadBuffer.Get(), uploadOffset, byteSize);
+
+    // As above, the upload range must outlive the copy; give it back to the allocator
+    // with GpuHeapAllocator::Free once the command list has executed.
+    RENDER_STAT_UPLOAD(UploadKind::Geometry, byteSize);
     return defaultBuffer;
 }
 
@@ -93,10 +125,7 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::string& entrypoint,
 	const std::string& target)
 {
-	UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)  
-	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+	UINT compileFlags = ShaderCompileFlags();
 
 	HRESULT hr = S_OK;
 
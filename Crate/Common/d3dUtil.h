@@ -28,9 +28,13 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "MemoryTracker.h"
+#include "RenderStats.h"
 
 extern const int gNumFrameResources;
 
+class GpuHeapAllocator;
+
 inline void d3dSetDebugName(IDXGIObject* obj, const char* name)
 {
     if(obj)
@@ -114,6 +118,9 @@ public:
 
     static Microsoft::WRL::ComPtr<ID3DBlob> LoadBinary(const std::wstring& filename);
 
+	// Bytes the resource occupies in video memory, alignment padding included.
+	static UINT64 AllocationSize(ID3D12Device* device, ID3D12Resource* resource);
+
     static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
         ID3D12Device* device,
         ID3D12GraphicsCommandList* cmdList,
@@ -121,6 +128,28 @@ public:
         UINT64 byteSize,
         Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
 
+    // Same as above, but both buffers are byte ranges of the allocator's shared
+    // buffers rather than committed resources of their own.  Returns the shared
+    // buffer and sets offset to where the data starts in it, and the same for the
+    // upload range.  Call GpuHeapAllocator::FinishCopies before the data is read.
+    static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
+        GpuHeapAllocator* allocator,
+        ID3D12GraphicsCommandList* cmdList,
+        const void* initData,
+        UINT64 byteSize,
+        UINT64& offset,
+        Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer,
+        UINT64& uploadOffset);
+
+	static UINT ShaderCompileFlags()
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		return D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+		return 0;
+#endif
+	}
+
 	static Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(
 		const std::wstring& filename,
 		const D3D_SHADER_MACRO* defines,
@@ -173,6 +202,12 @@ struct MeshGeometry
 	Microsoft::WRL::ComPtr<ID3D12Resource> VertexBufferUploader = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBufferUploader = nullptr;
 
+	// Where the data starts when the buffers above are shared GpuHeapAllocator buffers.
+	UINT64 VertexBufferOffset = 0;
+	UINT64 IndexBufferOffset = 0;
+	UINT64 VertexUploaderOffset = 0;
+	UINT64 IndexUploaderOffset = 0;
+
     // Data about the buffers.
 	UINT VertexByteStride = 0;
 	UINT VertexBufferByteSize = 0;
@@ -187,7 +222,7 @@ struct MeshGeometry
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
-		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress();
+		vbv.BufferLocation = VertexBufferGPU->GetGPUVirtualAddress() + VertexBufferOffset;
 		vbv.StrideInBytes = VertexByteStride;
 		vbv.SizeInBytes = VertexBufferByteSize;
 
@@ -197,7 +232,7 @@ struct MeshGeometry
 	D3D12_INDEX_BUFFER_VIEW IndexBufferView()const
 	{
 		D3D12_INDEX_BUFFER_VIEW ibv;
-		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress();
+		ibv.BufferLocation = IndexBufferGPU->GetGPUVirtualAddress() + IndexBufferOffset;
 		ibv.Format = IndexFormat;
 		ibv.SizeInBytes = IndexBufferByteSize;
 
@@ -210,6 +245,20 @@ struct MeshGeometry
 		VertexBufferUploader = nullptr;
 		IndexBufferUploader = nullptr;
 	}
+
+	// Counts the system memory copies against MemoryCategory::Meshes.  The GPU buffers
+	// are counted by whoever allocated them.
+	void TrackCpuMemory()
+	{
+		UINT64 bytes = 0;
+		if (VertexBufferCPU != nullptr)
+			bytes += VertexBufferCPU->GetBufferSize();
+		if (IndexBufferCPU != nullptr)
+			bytes += IndexBufferCPU->GetBufferSize();
+		CpuMemory.Reset(MemoryDomain::Cpu, MemoryCategory::Meshes, bytes);
+	}
+
+	TrackedMemory CpuMemory;
 };
 
 struct Light
@@ -273,6 +322,20 @@ struct Texture
 	//The texture resources & uplaod heap
 	Microsoft::WRL::ComPtr<ID3D12Resource> Resource = nullptr;
 	Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap = nullptr;
+
+	// Index of the texture's SRV in the shader-visible heap.
+	int SrvHeapIndex = -1;
+
+	TrackedMemory Memory;        // Resource
+	TrackedMemory UploadMemory;  // UploadHeap
+
+	void TrackMemory(ID3D12Device* device)
+	{
+		if (Resource != nullptr)
+			Memory.Reset(MemoryDomain::Gpu, MemoryCategory::Textures, d3dUtil::AllocationSize(device, Resource.Get()));
+		if (UploadHeap != nullptr)
+			UploadMemory.Reset(MemoryDomain::Gpu, MemoryCategory::Staging, d3dUtil::AllocationSize(device, UploadHeap.Get()));
+	}
 };
 
 #ifndef ThrowIfFailed
@@ -6,12 +6,32 @@
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
 #include "Common/GeometryGenerator.h"
+#include "Common/GpuHeapAllocator.h"
+#include "Common/DescriptorHeapAllocator.h"
+#include "Common/ShaderCache.h"
+#include "Common/PipelineStateCache.h"
+#include "Common/Hash.h"
+#include "Common/RenderGraphExecutor.h"
+#include "Common/FramePipeline.h"
+#include "Common/Profiler.h"
+#include "Common/GpuTimer.h"
+#include "Common/FrameStats.h"
+#include "Common/InputRecording.h"
+#include "Common/TaskGraph.h"
+#include "Common/TextureBatchLoader.h"
+#include "Common/TextureStreamer.h"
 #include "FrameResource.h"
-#include "PerlinNoise.h"
+#include "WorldGenerator.h"
+#include "WorldSave.h"
+#include "WorldCache.h"
+#include "ChunkMesher.h"
+#include "ChunkMeshCache.h"
+#include "BlockRegistry.h"
 #include "Camera.h"
 #include <stdlib.h>  
 #include <time.h>  
 #include <stdio.h>
+#include <fstream>
 
 using namespace std; 
 
@@ -26,12 +46,26 @@ using namespace DirectX::PackedVector;
 #pragma comment(lib, "D3D12.lib")
 
 const int gNumFrameResources = 3;
+const int ProfileCaptureFrames = 300;
+const float MemoryLogInterval = 10.0f;
 bool wired = false;
 //handles camera state tracking
 bool cam1 = false;
 bool cam3 = true;
 bool camfree = false;
 
+static CameraMode GetCameraMode()
+{
+	return cam1 ? CameraMode::FirstPerson : (camfree ? CameraMode::Free : CameraMode::ThirdPerson);
+}
+
+static void SetCameraMode(CameraMode mode)
+{
+	cam1 = (mode == CameraMode::FirstPerson);
+	cam3 = (mode == CameraMode::ThirdPerson);
+	camfree = (mode == CameraMode::Free);
+}
+
 //Sets up character position variables
 float charX = 50;
 float charY = 2;
@@ -41,9 +75,8 @@ float YSpeed = 0;
 float ZSpeed = 0;
 float charRotation = 0;
 
-//determines size of the world generated, World height values must always = world size
+//determines size of the world generated
 int Worldsize = 100;
-float WorldHeight[100][100];
 
 //sets up a 0,0,0 vector for reference and the character position vector
 XMVECTOR V0 = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
@@ -90,8 +123,160 @@ struct RenderItem
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// World-space bounding sphere, used to pick texture mips and to cull the item when it
+	// is outside the camera frustum.  Items without one (radius 0) always ask for full
+	// detail and are always drawn.
+	XMFLOAT3 BoundsCenter = { 0.0f, 0.0f, 0.0f };
+	float BoundsRadius = 0.0f;
+};
+
+// Handed from the render thread to the simulation thread at the start of each frame.
+struct SimulationInput
+{
+	float DeltaTime = 0.0f;
+	float TotalTime = 0.0f;
+
+	// Keys held this frame and mouse-look since the last simulated step.  Every step
+	// sees the keys; only the first applies the mouse-look.
+	InputFrame Live;
+
+	// The frame is simulated as Steps steps of StepTime seconds.  Recording and replay
+	// use fixed steps, so a frame may run none or several.
+	int Steps = 1;
+	float StepTime = 0.0f;
+
+	float AspectRatio = 1.0f;
+};
+
+// A chunk's position in chunks.
+struct ChunkCoord
+{
+	int X = 0, Y = 0, Z = 0;
+
+	bool operator==(const ChunkCoord& rhs)const { return X == rhs.X && Y == rhs.Y && Z == rhs.Z; }
+};
+
+// Everything the render thread reads from the simulation to draw a frame.
+struct WorldSnapshot
+{
+	XMFLOAT4X4 View = MathHelper::Identity4x4();
+	XMFLOAT4X4 Proj = MathHelper::Identity4x4();
+	XMFLOAT3 EyePosW = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT4X4 CharacterWorld = MathHelper::Identity4x4();
+	float TotalTime = 0.0f;
+	float DeltaTime = 0.0f;
+	bool Wireframe = false;
+	bool ReplayFinished = false;
+
+	// Block edits simulated this frame, and the chunks whose meshes they change: the
+	// edited chunk and each neighbour the edited block touches.  The render thread
+	// applies the edits to its copy of the world and remeshes those chunks.
+	std::vector<BlockEdit> Edits;
+	std::vector<ChunkCoord> DirtyChunks;
+};
+
+// Command line: "-record <file>" saves this session's input, "-replay <file>" plays a
+// recording back in real time and "-benchmark <file>" plays it one step per frame,
+// then writes Benchmark.json and exits.  "-serialinit" runs the startup phases one
+// after another instead of in parallel; compare the "Startup: time to first frame" line
+// it logs with a run without it.  "-texturethreads <N>" loads the startup textures on
+// N threads instead of one per core, for timing texture loading against core count.
+// "-texturebudget <MB>" sets the memory streamed texture mips may use, 0 loading every
+// mip up front, and "-tailmips <N>" how many of each texture's smallest mips stay loaded.
+// "-world <dir>" keeps the world in a save directory: loaded from it if saved there
+// before, otherwise generated and saved to it.  "-seed <N>" generates the world from
+// that seed instead of a new one every run.  A generated world and its meshes are kept
+// in WorldCache, so the next run with the same seed skips both; "-noworldcache" always
+// builds them, for comparing startup times.  Chunks meshed without a snapshot go
+// through ChunkMeshCache, which keeps them in MeshCache across runs; "-nomeshcache"
+// meshes every chunk.
+enum class InputSessionMode
+{
+	Live,
+	Record,
+	Replay,
+	Benchmark
+};
+
+struct CommandLineOptions
+{
+	InputSessionMode InputMode = InputSessionMode::Live;
+	std::string InputPath;
+	bool SerialInit = false;
+	int TextureThreads = 0;   // 0 is one per core
+	int TextureBudgetMB = 32;
+	int TailMips = 4;
+	std::string WorldDirectory;   // empty generates the world every run
+	std::int64_t Seed = -1;       // -1 picks a new seed every run
+	bool NoWorldCache = false;
+	bool NoMeshCache = false;
 };
 
+static CommandLineOptions ParseCommandLine(const char* cmdLine)
+{
+	CommandLineOptions options;
+	std::istringstream args(cmdLine != nullptr ? cmdLine : "");
+	std::string arg;
+	while (args >> arg)
+	{
+		if (arg == "-serialinit")
+		{
+			options.SerialInit = true;
+			continue;
+		}
+		if (arg == "-texturethreads")
+		{
+			args >> options.TextureThreads;
+			continue;
+		}
+		if (arg == "-texturebudget")
+		{
+			args >> options.TextureBudgetMB;
+			continue;
+		}
+		if (arg == "-tailmips")
+		{
+			args >> options.TailMips;
+			continue;
+		}
+		if (arg == "-world")
+		{
+			args >> options.WorldDirectory;
+			continue;
+		}
+		if (arg == "-seed")
+		{
+			args >> options.Seed;
+			continue;
+		}
+		if (arg == "-noworldcache")
+		{
+			options.NoWorldCache = true;
+			continue;
+		}
+		if (arg == "-nomeshcache")
+		{
+			options.NoMeshCache = true;
+			continue;
+		}
+
+		InputSessionMode mode;
+		if (arg == "-record")
+			mode = InputSessionMode::Record;
+		else if (arg == "-replay")
+			mode = InputSessionMode::Replay;
+		else if (arg == "-benchmark")
+			mode = InputSessionMode::Benchmark;
+		else
+			continue;
+
+		if (args >> options.InputPath)
+			options.InputMode = mode;
+	}
+	return options;
+}
+
 enum class RenderLayer : int
 {
 	Opaque = 0,
@@ -103,7 +288,7 @@ enum class RenderLayer : int
 class CrateApp : public D3DApp
 {
 public:
-	CrateApp(HINSTANCE hInstance);
+	CrateApp(HINSTANCE hInstance, const CommandLineOptions& options);
 	CrateApp(const CrateApp& rhs) = delete;
 	CrateApp& operator=(const CrateApp& rhs) = delete;
 	~CrateApp();
@@ -114,14 +299,21 @@ private:
 	virtual void OnResize()override;
 	virtual void Update(const GameTimer& gt)override;
 	virtual void Draw(const GameTimer& gt)override;
+	virtual void CalculateFrameStats()override;
 
 	virtual void OnMouseDown(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)override;
 	virtual void OnMouseMove(WPARAM btnState, int x, int y)override;
 
-	void OnKeyboardInput(const GameTimer& gt);
+	InputFrame SampleInput();
+	void OnKeyboardInput(const InputFrame& input, float dt);
+	void Simulate(const SimulationInput& input, WorldSnapshot& snapshot); // runs on the simulation thread
+	void DigUnderCharacter(); // simulation thread
+	void RemeshDirtyChunks(); // render thread, while Draw records
+	void ReleaseChunkRanges(UINT64 completedFence);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
+	void UpdateObjectCB(RenderItem& item);
 	void UpdateMaterialCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 
@@ -135,15 +327,26 @@ private:
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildMaterials();
+	void GenerateWorld();
+	void MeshWorld();
 	void BuildRenderItems(); // builds the world
-	double RandomNum(int range_min, int range_max, int n); //random range number generator taken from MSDN 
+	void BuildChunkRenderItems(const ChunkMesh& mesh);
+	void RemoveChunkRenderItems(const MeshGeometry* geo);
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void RequestTextureMips();
+	void DrawScenePass();
 	void UpdateWireframe(bool wire);
 
 	
 	void BuildSkyGeometry();
 
 	void UpdateChar(float x, float y, float z, float Xs, float Ys, float Zs, float angle); //draws and updates the character
+	float SurfaceHeightAt(float x, float z)const; // height of the surface block under a position, clamped to the world
+	void BuildCharacter();
+	void LogFramePipelineStats(const GameTimer& gt);
+	void UpdateProfileCapture();
+	bool StartInputSession();
+	void FinishReplay();
 
 
 	
@@ -158,20 +361,68 @@ private:
 	FrameResource* mCurrFrameResource = nullptr;
 	int mCurrFrameResourceIndex = 0;
 
-	UINT mCbvSrvDescriptorSize = 0;
+	// Declared ahead of the geometry so the heaps outlive the resources placed in them.
+	std::unique_ptr<GpuHeapAllocator> mGpuHeaps;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 
-	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
+	std::unique_ptr<DescriptorHeapAllocator> mSrvHeap;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
+	BlockRegistry mBlocks;
+	Material* mBlockMaterials[(int)BlockId::Count] = {}; // by BlockId, from BuildMaterials
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mTextureStaging; // in mGpuHeaps until the init copies execute
+
+	// With a texture archive, mips stream in from its mapping.  Null when every mip is
+	// loaded up front.
+	AssetArchive mTextureArchive;
+	std::unique_ptr<TextureStreamer> mTextureStreamer;
+	std::vector<int> mMaterialStreams; // streamed texture of each material by MatCBIndex, or -1
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
-	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	std::unique_ptr<PipelineStateCache> mPipelines;
+
+	RenderGraph mRenderGraph;
+	RgCompiledGraph mCompiledGraph;
+	std::unique_ptr<RenderGraphExecutor> mGraphExecutor;
+	std::unique_ptr<GpuTimer> mGpuTimer;
+	std::uint64_t mRootSignatureHash = 0;
 
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
+	std::unique_ptr<World> mWorld;
+	std::unique_ptr<WorldSave> mWorldSave; // null without -world
+	std::unique_ptr<WorldCache> mWorldCache; // null with -noworldcache; writes the snapshot in the background
+	std::unique_ptr<ChunkMeshCache> mMeshCache; // null with -nomeshcache
+	const char* mWorldSource = "generated";
+	std::vector<ChunkMesh> mChunkMeshes; // from GenerateWorld until BuildRenderItems uploads them
+
+	// mWorld belongs to the simulation thread once it runs.  The render thread keeps a
+	// copy, brought up to date from each snapshot's edits, to remesh dirty chunks from.
+	std::unique_ptr<World> mRenderWorld;
+	ChunkMesher mRenderMesher;
+
+	// Every chunk has object constants of its own, empty or not, so a remeshed chunk
+	// never needs a new slot; all of a chunk's render items share them.
+	int mChunkObjCBBase = 0;
+	UINT mObjectCBCount = 0;
+
+	// Geometry ranges of remeshed chunks, and the upload ranges of their new meshes,
+	// held until the GPU is past Fence.
+	struct RetiredRange
+	{
+		ComPtr<ID3D12Resource> Buffer;
+		UINT64 Offset = 0;
+		UINT64 Fence = 0;
+	};
+	std::vector<RetiredRange> mRetiredRanges;
+
+	// Simulation thread: the edits of the frame being simulated, and its dig key.
+	std::vector<BlockEdit> mFrameEdits;
+	std::vector<ChunkCoord> mFrameDirtyChunks;
+	bool mDigKeyDown = false;
+
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
 
@@ -179,12 +430,11 @@ private:
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
 
-
-	// Render items divided by PSO.
-	std::vector<RenderItem*> mOpaqueRitems;
-
 	PassConstants mMainPassCB;
 
+	// World-space camera frustum, rebuilt with the pass constants every frame.
+	BoundingFrustum mCamFrustum;
+
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
@@ -195,6 +445,49 @@ private:
 
 	Camera freeCam;
 	POINT mLastMousePos;
+
+	// Simulation runs one frame ahead on its own thread.  From Initialize on, freeCam,
+	// the character and camera globals belong to it; the render thread only reads
+	// mSnapshot and hands over mouse-look through mMouseDx/mMouseDy.
+	std::unique_ptr<FramePipeline<SimulationInput, WorldSnapshot>> mFramePipeline;
+	const WorldSnapshot* mSnapshot = nullptr;
+	float mMouseDx = 0.0f;
+	float mMouseDy = 0.0f;
+	float mPipelineStatsTime = 0.0f;
+
+	bool mSimulationThreadNamed = false; // simulation thread only
+
+	// F9 captures the next ProfileCaptureFrames frames into a Chrome trace.
+	bool mProfileKeyDown = false;
+	int mProfileFramesLeft = 0;
+	int mProfileCaptureCount = 0;
+
+	// Frame times, written to FrameStats.csv once a second and FrameStats.json on exit.
+	FrameStats mFrameStats;
+	std::ofstream mFrameStatsCsv;
+	float mFrameStatsTime = 0.0f;
+	double mUpdateMs = 0.0;
+	double mFenceWaitMs = 0.0;
+
+	// Per-category memory, logged every MemoryLogInterval seconds.
+	TrackedMemory mRitemMemory;
+	float mMemoryLogTime = 0.0f;
+
+	// Input recording and replay.  Once the pipeline runs, only the simulation thread
+	// appends to mRecording and advances mInputPlayer.
+	CommandLineOptions mOptions;
+	std::unique_ptr<InputRecording> mRecording;
+	std::unique_ptr<InputPlayer> mInputPlayer;
+	FixedTimestep mTimestep;
+	std::uint32_t mWorldSeed = 0;
+	bool mReplayFinished = false;
+
+	// Profiler::Now() when the app was created; time to first frame is logged once.
+	std::uint64_t mStartupBegin = 0;
+	bool mFirstFrameLogged = false;
+
+	XMFLOAT4X4 mCharacterWorld = MathHelper::Identity4x4(); // written by UpdateChar
+	RenderItem* mCharacterRitem = nullptr;
 	
 };
 
@@ -210,7 +503,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
 	try
 	{
-		CrateApp theApp(hInstance);
+		CrateApp theApp(hInstance, ParseCommandLine(cmdLine));
 		if (!theApp.Initialize())
 			return 0;
 
@@ -223,15 +516,32 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 	}
 }
 
-CrateApp::CrateApp(HINSTANCE hInstance)
-	: D3DApp(hInstance)
+CrateApp::CrateApp(HINSTANCE hInstance, const CommandLineOptions& options)
+	: D3DApp(hInstance),
+	mOptions(options),
+	mStartupBegin(Profiler::Now())
 {
 }
 
 CrateApp::~CrateApp()
 {
+	// Stop the simulation thread before anything it touches goes away.
+	mFramePipeline.reset();
+
+	if (mOptions.InputMode == InputSessionMode::Record && mRecording != nullptr)
+	{
+		if (!mRecording->Save(mOptions.InputPath))
+			::OutputDebugStringA(("Could not write input recording " + mOptions.InputPath + "\n").c_str());
+	}
+
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
+
+	if (mFrameStats.Frames() > 0)
+	{
+		std::ofstream json("FrameStats.json");
+		mFrameStats.WriteJson(json);
+	}
 }
 
 bool CrateApp::Initialize()
@@ -239,32 +549,59 @@ bool CrateApp::Initialize()
 	if (!D3DApp::Initialize())
 		return false;
 
+	double d3dInitMs = (Profiler::Now() - mStartupBegin) / 1.0e6;
+
 	// Reset the command list to prep for initialization commands.
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
-	// Get the increment size of a descriptor in this heap type.  This is hardware specific, 
-	// so we have to query this information.
-	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	Profiler::SetThreadName("Main");
 
+	mGpuHeaps = std::make_unique<GpuHeapAllocator>(md3dDevice.Get());
+	mGraphExecutor = std::make_unique<RenderGraphExecutor>(md3dDevice.Get());
+	mGpuTimer = std::make_unique<GpuTimer>(md3dDevice.Get(), mCommandQueue.Get(), gNumFrameResources);
 
 
 	freeCam.SetPosition(charX, charY, (charZ-5)); //moves the camera to the character at the start 
 
-	LoadTextures();
-	BuildRootSignature();
-	BuildDescriptorHeaps();
-	BuildShadersAndInputLayout();
-	BuildShapeGeometry();
-	BuildSkyGeometry();
-	BuildGrassGeo();
-	BuildMaterials();
-	UpdateChar(charX, charY, charZ, XSpeed, YSpeed, ZSpeed, charRotation);
-	BuildRenderItems();
-	BuildFrameResources();
-	BuildPSOs();
-	
+	// Picks the world seed, so it has to run before BuildRenderItems.
+	if (!StartInputSession())
+		return false;
+
+#if RENDER_STATS_ENABLED
+	RenderStats::OpenLog("RenderStats.csv");
+#endif
+
+	// The startup phases run as a dependency graph.  Everything that records into
+	// mCommandList or places buffers in mGpuHeaps is chained: textures, then the fixed
+	// geometry, then the chunk buffers.  World generation, shader loading, the root
+	// signature and the PSOs run alongside.  With -serialinit the phases run one at a
+	// time in the order added, so the longest independent ones come first.
+	TaskGraph startup;
+	auto world = startup.Add("GenerateWorld", [this]() { GenerateWorld(); });
+	auto textures = startup.Add("LoadTextures", [this]() { LoadTextures(); });
+	auto shaders = startup.Add("BuildShadersAndInputLayout", [this]() { BuildShadersAndInputLayout(); });
+	auto rootSignature = startup.Add("BuildRootSignature", [this]() { BuildRootSignature(); });
+	startup.Add("BuildPSOs", [this]() { BuildPSOs(); }, { rootSignature, shaders });
+	auto heaps = startup.Add("BuildDescriptorHeaps", [this]() { BuildDescriptorHeaps(); }, { textures });
+	auto geometry = startup.Add("BuildGeometry", [this]()
+	{
+		BuildShapeGeometry();
+		BuildSkyGeometry();
+		BuildGrassGeo();
+	}, { textures });
+	auto materials = startup.Add("BuildMaterials", [this]() { BuildMaterials(); }, { heaps });
+	auto character = startup.Add("BuildCharacter", [this]()
+	{
+		UpdateChar(charX, charY, charZ, XSpeed, YSpeed, ZSpeed, charRotation);
+		BuildCharacter();
+	}, { geometry, materials, world });
+	auto renderItems = startup.Add("BuildRenderItems", [this]() { BuildRenderItems(); }, { character });
+	startup.Add("BuildFrameResources", [this]() { BuildFrameResources(); }, { renderItems });
+	startup.Run(mOptions.SerialInit ? 1 : 0);
 
 	// Execute the initialization commands.
+	std::uint64_t flushStart = Profiler::Now();
+	mGpuHeaps->FinishCopies(mCommandList.Get());
 	ThrowIfFailed(mCommandList->Close());
 	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
 	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
@@ -272,6 +609,61 @@ bool CrateApp::Initialize()
 	// Wait until initialization is complete.
 	FlushCommandQueue();
 
+	std::ostringstream startupLog;
+	startupLog.precision(1);
+	startupLog << std::fixed << "Startup: D3D " << d3dInitMs << " ms, " << (mOptions.SerialInit ? "serial" : "parallel")
+		<< " phases " << startup.TotalMs() << " ms (critical path " << startup.CriticalPathMs()
+		<< " ms), GPU upload " << (Profiler::Now() - flushStart) / 1.0e6 << " ms\n" << startup.TimelineString();
+	::OutputDebugStringA(startupLog.str().c_str());
+
+	// The geometry and texture copies have executed, so the staging buffers can go back to the heaps.
+	for (auto& e : mGeometries)
+	{
+		mGpuHeaps->Free(e.second->VertexBufferUploader.Get(), e.second->VertexUploaderOffset);
+		mGpuHeaps->Free(e.second->IndexBufferUploader.Get(), e.second->IndexUploaderOffset);
+		e.second->DisposeUploaders();
+		e.second->TrackCpuMemory();
+	}
+	mGpuHeaps->Free(mTextureStaging.Get());
+	mTextureStaging = nullptr;
+	::OutputDebugStringA(mGpuHeaps->StatsString().c_str());
+
+	// Streamed textures count the tiles they have mapped themselves.
+	for (auto& e : mTextures)
+	{
+		if (mTextureStreamer == nullptr || mTextureStreamer->Find(e.second.get()) < 0)
+			e.second->TrackMemory(md3dDevice.Get());
+	}
+	mRitemMemory.Reset(MemoryDomain::Cpu, MemoryCategory::RenderItems, mAllRitems.size() * sizeof(RenderItem));
+	::OutputDebugStringA(MemoryTracker::Report().c_str());
+
+#if RENDER_STATS_ENABLED
+	// Row 0 of the log is initialization: the geometry and texture uploads.
+	::OutputDebugStringA(("Startup: " + RenderStats::Summary(RenderStats::Current()) + "\n").c_str());
+	RenderStats::EndFrame();
+#endif
+
+	// Materials refer to their texture by SRV; note which streamed texture each one draws with.
+	if (mTextureStreamer != nullptr)
+	{
+		for (auto& m : mMaterials)
+		{
+			if (m.second->MatCBIndex >= (int)mMaterialStreams.size())
+				mMaterialStreams.resize(m.second->MatCBIndex + 1, -1);
+			for (auto& t : mTextures)
+			{
+				if (t.second->SrvHeapIndex == m.second->DiffuseSrvHeapIndex)
+					mMaterialStreams[m.second->MatCBIndex] = mTextureStreamer->Find(t.second.get());
+			}
+		}
+	}
+
+	// Taken before the simulation thread starts editing mWorld.
+	mRenderWorld = std::make_unique<World>(*mWorld);
+
+	mFramePipeline = std::make_unique<FramePipeline<SimulationInput, WorldSnapshot>>(
+		[this](const SimulationInput& input, WorldSnapshot& snapshot) { Simulate(input, snapshot); });
+
 	return true;
 }
 
@@ -283,14 +675,48 @@ void CrateApp::OnResize()
 	//XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	//XMStoreFloat4x4(&mProj, P);
 
-	freeCam.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+	// Once the simulation thread runs, it picks the new aspect ratio up from its input.
+	if (mFramePipeline == nullptr)
+		freeCam.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 }
 
 void CrateApp::Update(const GameTimer& gt)
 {
-	OnKeyboardInput(gt);
+	UpdateProfileCapture();
+	PROFILE_ZONE("Update");
+	std::uint64_t updateStart = Profiler::Now();
+
 	SetCapture(mhMainWnd);
-	
+
+	// Pick up the snapshot simulated while the previous frame was recorded and start
+	// simulating the next one.
+	SimulationInput input;
+	input.DeltaTime = gt.DeltaTime();
+	input.TotalTime = gt.TotalTime();
+	input.Live = SampleInput();
+	input.AspectRatio = AspectRatio();
+	switch (mOptions.InputMode)
+	{
+	case InputSessionMode::Live:
+		input.StepTime = gt.DeltaTime();
+		break;
+	case InputSessionMode::Benchmark:
+		// The same steps every frame, however long the frames take.
+		input.StepTime = mTimestep.Step();
+		break;
+	default:
+		input.Steps = mTimestep.Advance(gt.DeltaTime());
+		input.StepTime = mTimestep.Step();
+		break;
+	}
+
+	// Mouse-look waits for the next frame that simulates a step.
+	if (input.Steps > 0)
+		mMouseDx = mMouseDy = 0.0f;
+
+	mSnapshot = &mFramePipeline->BeginFrame(input);
+	if (mSnapshot->ReplayFinished && !mReplayFinished)
+		FinishReplay();
 
 	// Cycle through the circular frame resource array.
 	mCurrFrameResourceIndex = (mCurrFrameResourceIndex + 1) % gNumFrameResources;
@@ -298,28 +724,51 @@ void CrateApp::Update(const GameTimer& gt)
 
 	// Has the GPU finished processing the commands of the current frame resource?
 	// If not, wait until the GPU has completed commands up to this fence point.
+	std::uint64_t waitStart = Profiler::Now();
 	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
 	{
+		PROFILE_ZONE("WaitForFence");
 		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
 		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
 		WaitForSingleObject(eventHandle, INFINITE);
 		CloseHandle(eventHandle);
 	}
+	mFenceWaitMs = (Profiler::Now() - waitStart) / 1.0e6;
+
+	ReleaseChunkRanges(mFence->GetCompletedValue());
+
+	// Pick up the GPU timings of finished frames before reusing this frame's queries.
+	mGpuTimer->BeginFrame(mCurrFrameResourceIndex, mFence->GetCompletedValue());
+
+	// This frame resource's transient descriptors are free again.
+	mSrvHeap->BeginFrame(mCurrFrameResourceIndex, mFence->GetCompletedValue());
+
+	if (mTextureStreamer != nullptr)
+		RequestTextureMips();
+
+	// Swap in any PSO variants the background workers have finished.
+	mPipelines->Poll();
+	mGraphExecutor->ReleaseRetired(mFence->GetCompletedValue());
+
+	if (memcmp(&mCharacterRitem->World, &mSnapshot->CharacterWorld, sizeof(XMFLOAT4X4)) != 0)
+	{
+		mCharacterRitem->World = mSnapshot->CharacterWorld;
+		mCharacterRitem->NumFramesDirty = gNumFrameResources;
+	}
 
 	AnimateMaterials(gt);
 	UpdateObjectCBs(gt);
 	UpdateMaterialCBs(gt);
 	UpdateMainPassCB(gt);
-	UpdateChar(charX, charY, charZ, XSpeed, YSpeed, ZSpeed, charRotation);
 
-	
-	
-	
-	
+	mUpdateMs = (Profiler::Now() - updateStart) / 1.0e6;
 }
 
 void CrateApp::Draw(const GameTimer& gt)
 {
+	PROFILE_ZONE("Draw");
+	std::uint64_t drawStart = Profiler::Now();
+
 	auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
 
 	// Reuse the memory associated with command recording.
@@ -328,15 +777,235 @@ void CrateApp::Draw(const GameTimer& gt)
 
 	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
 	// Reusing the command list reuses memory.
-	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
+	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPipelines->Get("opaque")));
+	RENDER_STAT_STATE(PipelineState);
+	mGpuTimer->Begin(mCommandList.Get(), "frame");
+
+	// So do the meshes of chunks the simulation changed.
+	RemeshDirtyChunks();
+
+	// Mip uploads go ahead of the passes; the new mips are sampled from a later frame on.
+	if (mTextureStreamer != nullptr)
+	{
+		mTextureStreamer->Update(mCommandList.Get(), mCurrentFence + 1);
+
+		// Clamp changes moved the SRVs; draw with the new ones.
+		for (auto& m : mMaterials)
+		{
+			int stream = mMaterialStreams[m.second->MatCBIndex];
+			if (stream >= 0)
+				m.second->DiffuseSrvHeapIndex = mTextureStreamer->SrvHeapIndex(stream);
+		}
+	}
+
+	// Declare this frame's passes.  The graph derives the PRESENT <-> RENDER_TARGET
+	// transitions from the imported back buffer's initial and final states.
+	mRenderGraph.Clear();
+	RgResource backBuffer = mRenderGraph.ImportResource("backBuffer", RgState::Present, RgState::Present);
+	RgResource depthBuffer = mRenderGraph.ImportResource("depthBuffer", RgState::DepthWrite, RgState::DepthWrite);
+
+	RgPass scenePass = mRenderGraph.AddPass("scene", [this]() { DrawScenePass(); });
+	mRenderGraph.Write(scenePass, backBuffer, RgState::RenderTarget);
+	mRenderGraph.Write(scenePass, depthBuffer, RgState::DepthWrite);
+
+	mRenderGraph.Compile(mCompiledGraph);
+
+	mGraphExecutor->Bind(backBuffer, CurrentBackBuffer());
+	mGraphExecutor->Bind(depthBuffer, mDepthStencilBuffer.Get());
+	mGraphExecutor->Execute(mRenderGraph, mCompiledGraph, mCommandList.Get());
+
+	mGpuTimer->End(mCommandList.Get(), "frame");
+	mGpuTimer->Resolve(mCommandList.Get());
+
+	// Done recording commands.
+	ThrowIfFailed(mCommandList->Close());
+
+	// Add the command list to the queue for execution.
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	// Swap the back and front buffers
+	ThrowIfFailed(mSwapChain->Present(0, 0));
+	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
+
+	// Advance the fence value to mark commands up to this fence point.
+	mCurrFrameResource->Fence = ++mCurrentFence;
+
+	// Add an instruction to the command queue to set a new fence point. 
+	// Because we are on the GPU timeline, the new fence point won't be 
+	// set until the GPU finishes processing all the commands prior to this Signal().
+	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+	mSrvHeap->EndFrame(mCurrentFence);
+	mGraphExecutor->EndFrame(mCurrentFence);
+	mGpuTimer->EndFrame(mCurrentFence);
+
+#if RENDER_STATS_ENABLED
+	RenderStats::EndFrame();
+#endif
+
+	if (!mFirstFrameLogged)
+	{
+		std::ostringstream ss;
+		ss << "Startup: time to first frame " << (Profiler::Now() - mStartupBegin) / 1.0e6 << " ms, world " << mWorldSource << "\n";
+		::OutputDebugStringA(ss.str().c_str());
+		mFirstFrameLogged = true;
+	}
+
+	mFramePipeline->EndFrame();
+	LogFramePipelineStats(gt);
+
+	FrameSample sample;
+	sample.Milliseconds[(int)FrameMetric::Frame] = gt.DeltaTime() * 1000.0;
+	sample.Milliseconds[(int)FrameMetric::Update] = mUpdateMs;
+	sample.Milliseconds[(int)FrameMetric::Draw] = (Profiler::Now() - drawStart) / 1.0e6;
+	sample.Milliseconds[(int)FrameMetric::FenceWait] = mFenceWaitMs;
+	mFrameStats.AddFrame(sample);
+}
+
+void CrateApp::CalculateFrameStats()
+{
+	// Once a second: percentiles in the caption, the full summary in the debug output
+	// and a row in FrameStats.csv.
+	if (mTimer.TotalTime() - mFrameStatsTime < 1.0f || mFrameStats.Frames() == 0)
+		return;
+
+	mFrameStatsTime = mTimer.TotalTime();
+
+	FrameMetricSummary frame = mFrameStats.Summarize(FrameMetric::Frame);
+	std::wostringstream caption;
+	caption.precision(2);
+	caption << std::fixed << mMainWndCaption << L"    fps: " << (frame.Mean > 0.0 ? 1000.0 / frame.Mean : 0.0)
+		<< L"   p50: " << frame.P50 << L"   p99: " << frame.P99 << L"   max: " << frame.Max
+		<< L" ms   hitches: " << mFrameStats.WindowHitches();
+	SetWindowText(mhMainWnd, caption.str().c_str());
+
+	::OutputDebugStringA(("Frame stats: " + mFrameStats.SummaryString() + "\n").c_str());
+
+	if (!mFrameStatsCsv.is_open())
+	{
+		mFrameStatsCsv.open("FrameStats.csv", std::ios::trunc);
+		mFrameStats.WriteCsvHeader(mFrameStatsCsv);
+	}
+	mFrameStats.WriteCsvRow(mFrameStatsCsv, mTimer.TotalTime());
+	mFrameStatsCsv.flush();
+
+	if (mTimer.TotalTime() - mMemoryLogTime >= MemoryLogInterval)
+	{
+		::OutputDebugStringA(("Memory: " + MemoryTracker::Summary() + "\n").c_str());
+		mMemoryLogTime = mTimer.TotalTime();
+	}
+}
+
+void CrateApp::LogFramePipelineStats(const GameTimer& gt)
+{
+	if (gt.TotalTime() - mPipelineStatsTime < 1.0f)
+		return;
+
+	const FramePipelineStats& stats = mFramePipeline->Stats();
+	if (stats.Frames > 0)
+	{
+		double n = (double)stats.Frames;
+		std::ostringstream ss;
+		ss << "Frame pipeline: sim " << stats.SimulationMs / n << " ms, render " << stats.RenderMs / n
+			<< " ms, overlap " << stats.OverlapMs / n << " ms, wait " << stats.WaitMs / n << " ms\n";
+		::OutputDebugStringA(ss.str().c_str());
+	}
+
+	if (mGpuTimer->History().SeriesCount() > 0)
+		::OutputDebugStringA(("GPU: " + mGpuTimer->History().Summary() + "\n").c_str());
+
+	if (mTextureStreamer != nullptr)
+		::OutputDebugStringA(("Texture streaming: " + mTextureStreamer->StatsString() + "\n").c_str());
+
+#if RENDER_STATS_ENABLED
+	::OutputDebugStringA(("Render: " + RenderStats::Summary(RenderStats::Last()) + "\n").c_str());
+#endif
+
+	mFramePipeline->ResetStats();
+	mPipelineStatsTime = gt.TotalTime();
+}
+
+void CrateApp::UpdateProfileCapture()
+{
+	// A capture spans whole frames: it starts and stops here, before the Update zone.
+	if (mProfileFramesLeft > 0 && --mProfileFramesLeft == 0)
+	{
+		Profiler::EndCapture();
+
+		std::string path = "CpuProfile" + std::to_string(++mProfileCaptureCount) + ".json";
+		std::ostringstream ss;
+		if (Profiler::WriteChromeTrace(path))
+			ss << "Profiler: wrote " << ProfileCaptureFrames << " frames to " << path;
+		else
+			ss << "Profiler: could not write " << path;
+		ss << " (" << Profiler::DroppedEvents() << " events dropped)\n";
+		::OutputDebugStringA(ss.str().c_str());
+	}
+
+	bool keyDown = (GetAsyncKeyState(VK_F9) & 0x8000) != 0;
+	if (keyDown && !mProfileKeyDown && mProfileFramesLeft == 0)
+	{
+		Profiler::BeginCapture();
+		mProfileFramesLeft = ProfileCaptureFrames;
+	}
+	mProfileKeyDown = keyDown;
+}
+
+bool CrateApp::StartInputSession()
+{
+	mRecording = std::make_unique<InputRecording>();
+	if (mOptions.InputMode == InputSessionMode::Replay || mOptions.InputMode == InputSessionMode::Benchmark)
+	{
+		if (!mRecording->Load(mOptions.InputPath))
+		{
+			std::wstring message = L"Could not load input recording " +
+				std::wstring(mOptions.InputPath.begin(), mOptions.InputPath.end());
+			MessageBox(nullptr, message.c_str(), nullptr, MB_OK);
+			return false;
+		}
+
+		// The recording only replays in the world it was recorded in.
+		mWorldSeed = mRecording->Seed;
+		mTimestep = FixedTimestep(mRecording->TimeStep);
+		mInputPlayer = std::make_unique<InputPlayer>(*mRecording);
+	}
+	else
+	{
+		mWorldSeed = (mOptions.Seed >= 0) ? (std::uint32_t)mOptions.Seed : (std::uint32_t)time(NULL); //a new world every run
+		mRecording->Seed = mWorldSeed;
+		mTimestep = FixedTimestep(mRecording->TimeStep);
+	}
+	return true;
+}
+
+void CrateApp::FinishReplay()
+{
+	mReplayFinished = true;
+
+	std::ostringstream ss;
+	ss << "Replay of " << mOptions.InputPath << " finished: " << mRecording->Frames.size() << " steps, "
+		<< mFrameStats.Frames() << " frames\nFrame stats: " << mFrameStats.SummaryString() << "\n";
+	::OutputDebugStringA(ss.str().c_str());
+
+	if (mOptions.InputMode != InputSessionMode::Benchmark)
+		return;
+
+	std::ofstream json("Benchmark.json", std::ios::trunc);
+	json << "{\n  \"seed\": " << mRecording->Seed << ",\n  \"steps\": " << mRecording->Frames.size()
+		<< ",\n  \"time_step\": " << mRecording->TimeStep << ",\n  \"frame_stats\": ";
+	mFrameStats.WriteJson(json);
+	json << "}\n";
+
+	PostQuitMessage(0);
+}
+
+void CrateApp::DrawScenePass()
+{
+	PROFILE_ZONE("DrawScenePass");
 
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
 	// Clear the back buffer and depth buffer.
 	//mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
 	//mCommandList->ClearDepthStencilView(DepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, 1.0f, 0, 0, nullptr);
@@ -346,49 +1015,38 @@ void CrateApp::Draw(const GameTimer& gt)
 	// Specify the buffers we are going to render to.
 	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvHeap->Heap() };
 	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+	RENDER_STAT_STATE(DescriptorHeaps);
 
 	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
+	RENDER_STAT_STATE(RootSignature);
 
 	auto passCB = mCurrFrameResource->PassCB->Resource();
 	mCommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
+	RENDER_STAT_STATE(RootCbv);
 
-	mCommandList->SetPipelineState(mPSOs["opaque"].Get());
+	// Wireframe variants are created in the background; draw solid until they are ready.
+	mCommandList->SetPipelineState(mPipelines->Get(mSnapshot->Wireframe ? "opaqueWireframe" : "opaque", "opaque"));
+	RENDER_STAT_STATE(PipelineState);
+	mGpuTimer->Begin(mCommandList.Get(), "opaque");
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+	mGpuTimer->End(mCommandList.Get(), "opaque");
 
 
 	// Enable the alpha tested PSO for the chain cube 
-	mCommandList->SetPipelineState(mPSOs["alphaTested"].Get());
+	mCommandList->SetPipelineState(mPipelines->Get(mSnapshot->Wireframe ? "alphaTestedWireframe" : "alphaTested", "alphaTested"));
+	RENDER_STAT_STATE(PipelineState);
+	mGpuTimer->Begin(mCommandList.Get(), "alphaTested");
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::AlphaTested]);
+	mGpuTimer->End(mCommandList.Get(), "alphaTested");
 
 	// Enable the Transparent PSO
-	mCommandList->SetPipelineState(mPSOs["transparent"].Get());
+	mCommandList->SetPipelineState(mPipelines->Get(mSnapshot->Wireframe ? "transparentWireframe" : "transparent", "transparent"));
+	RENDER_STAT_STATE(PipelineState);
+	mGpuTimer->Begin(mCommandList.Get(), "transparent");
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Transparent]);
-
-
-	// Indicate a state transition on the resource usage.
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
-		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
-
-	// Done recording commands.
-	ThrowIfFailed(mCommandList->Close());
-
-	// Add the command list to the queue for execution.
-	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-
-	// Swap the back and front buffers
-	ThrowIfFailed(mSwapChain->Present(0, 0));
-	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
-
-	// Advance the fence value to mark commands up to this fence point.
-	mCurrFrameResource->Fence = ++mCurrentFence;
-
-	// Add an instruction to the command queue to set a new fence point. 
-	// Because we are on the GPU timeline, the new fence point won't be 
-	// set until the GPU finishes processing all the commands prior to this Signal().
-	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+	mGpuTimer->End(mCommandList.Get(), "transparent");
 }
 
 void CrateApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -426,11 +1084,9 @@ void CrateApp::OnMouseMove(WPARAM btnState, int x, int y)
 			//freeCam.Pitch(-90);
 		
 		
-		if (camfree || cam1)
-		{
-			freeCam.Pitch(dy);
-			freeCam.RotateY(dx);
-		}
+		// Applied by the simulation thread, which owns the camera.
+		mMouseDx += dx;
+		mMouseDy += dy;
 
 		//charRotation += dx; 
 		
@@ -456,13 +1112,141 @@ void CrateApp::OnMouseMove(WPARAM btnState, int x, int y)
 	mLastMousePos.y = y;
 }
 
-void CrateApp::OnKeyboardInput(const GameTimer& gt)
+void CrateApp::Simulate(const SimulationInput& input, WorldSnapshot& snapshot)
+{
+	PROFILE_ZONE("Simulate");
+
+	if (!mSimulationThreadNamed)
+	{
+		Profiler::SetThreadName("Simulation");
+		mSimulationThreadNamed = true;
+	}
+
+	if (input.AspectRatio != freeCam.GetAspect())
+		freeCam.SetLens(0.25f*MathHelper::Pi, input.AspectRatio, 1.0f, 1000.0f);
+
+	for (int step = 0; step < input.Steps; ++step)
+	{
+		InputFrame frame = input.Live;
+		if (step > 0)
+			frame.MouseDx = frame.MouseDy = 0.0f;
+
+		// A replay overrides the live input, camera mode included, until it runs out.
+		if (mInputPlayer != nullptr && mInputPlayer->Next(frame))
+			SetCameraMode(frame.Camera);
+		else
+			frame.Camera = GetCameraMode();
+
+		if (mOptions.InputMode == InputSessionMode::Record)
+			mRecording->Frames.push_back(frame);
+
+		if (camfree || cam1)
+		{
+			freeCam.Pitch(frame.MouseDy);
+			freeCam.RotateY(frame.MouseDx);
+		}
+
+		OnKeyboardInput(frame, input.StepTime);
+		UpdateChar(charX, charY, charZ, XSpeed, YSpeed, ZSpeed, charRotation);
+	}
+
+	snapshot.View = freeCam.GetView4x4f();
+	snapshot.Proj = freeCam.GetProj4x4f();
+	snapshot.EyePosW = freeCam.GetPosition3f();
+	snapshot.CharacterWorld = mCharacterWorld;
+	snapshot.TotalTime = input.TotalTime;
+	snapshot.DeltaTime = input.DeltaTime;
+	snapshot.Wireframe = wired;
+	snapshot.ReplayFinished = (mInputPlayer != nullptr && mInputPlayer->Finished());
+
+	// The snapshot is reused every other frame, so the lists are handed over whole.
+	snapshot.Edits.swap(mFrameEdits);
+	snapshot.DirtyChunks.swap(mFrameDirtyChunks);
+	mFrameEdits.clear();
+	mFrameDirtyChunks.clear();
+}
+
+void CrateApp::DigUnderCharacter()
+{
+	int x = (std::min)((std::max)((int)charX, 0), mWorld->SizeX() - 1);
+	int z = (std::min)((std::max)((int)charZ, 0), mWorld->SizeZ() - 1);
+	int y = mWorld->SurfaceHeight(x, z);
+	if (y <= mWorld->MinY() || mWorld->Get(x, y, z) == BlockId::Air)
+		return;
+
+	BlockEdit edit = BlockEdit::At(*mWorld, x, y, z, BlockId::Air);
+	mWorld->Set(x, y, z, BlockId::Air);
+	mWorld->SetSurfaceHeight(x, z, y - 1);
+	if (mWorldSave != nullptr)
+		mWorldSave->SaveEdit(edit);
+	mFrameEdits.push_back(edit);
+
+	// A block on a chunk's face also shows or hides faces of the chunk next to it.
+	int local[3] = { x % ChunkSize, (y - mWorld->MinY()) % ChunkSize, z % ChunkSize };
+	int chunk[3] = { edit.ChunkX, edit.ChunkY, edit.ChunkZ };
+	int chunks[3] = { mWorld->ChunksX(), mWorld->ChunksY(), mWorld->ChunksZ() };
+	auto markDirty = [this](int cx, int cy, int cz)
+	{
+		ChunkCoord c;
+		c.X = cx;
+		c.Y = cy;
+		c.Z = cz;
+		if (std::find(mFrameDirtyChunks.begin(), mFrameDirtyChunks.end(), c) == mFrameDirtyChunks.end())
+			mFrameDirtyChunks.push_back(c);
+	};
+
+	markDirty(chunk[0], chunk[1], chunk[2]);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		int neighbour[3] = { chunk[0], chunk[1], chunk[2] };
+		if (local[axis] == 0 && chunk[axis] > 0)
+			neighbour[axis] = chunk[axis] - 1;
+		else if (local[axis] == ChunkSize - 1 && chunk[axis] < chunks[axis] - 1)
+			neighbour[axis] = chunk[axis] + 1;
+		else
+			continue;
+		markDirty(neighbour[0], neighbour[1], neighbour[2]);
+	}
+}
+
+InputFrame CrateApp::SampleInput()
+{
+	static const struct { int VirtualKey; InputKey Key; } keyMap[] =
+	{
+		{ 'W', InputKey::Forward },
+		{ 'S', InputKey::Back },
+		{ 'A', InputKey::StrafeLeft },
+		{ 'D', InputKey::StrafeRight },
+		{ 'E', InputKey::FlyUp },
+		{ 'Q', InputKey::FlyDown },
+		{ 'F', InputKey::WireframeOn },
+		{ 'G', InputKey::WireframeOff },
+		{ VK_UP, InputKey::CharForward },
+		{ VK_DOWN, InputKey::CharBack },
+		{ VK_LEFT, InputKey::CharLeft },
+		{ VK_RIGHT, InputKey::CharRight },
+		{ '1', InputKey::FirstPerson },
+		{ '2', InputKey::ThirdPerson },
+		{ '3', InputKey::FreeCamera },
+		{ 'X', InputKey::Dig },
+	};
+
+	InputFrame frame;
+	for (auto& e : keyMap)
+		frame.SetDown(e.Key, (GetAsyncKeyState(e.VirtualKey) & 0x8000) != 0);
+
+	frame.MouseDx = mMouseDx;
+	frame.MouseDy = mMouseDy;
+	return frame;
+}
+
+void CrateApp::OnKeyboardInput(const InputFrame& input, float dt)
 {
-	const float dt = gt.DeltaTime();
+	PROFILE_ZONE("OnKeyboardInput");
 
 	//gets all the keyboard input
 
-	if (GetAsyncKeyState('W') & 0x8000)
+	if (input.Down(InputKey::Forward))
 	{
 		if (camfree)
 		{
@@ -475,57 +1259,57 @@ void CrateApp::OnKeyboardInput(const GameTimer& gt)
 	}
 
 	//Moves the free cam
-	if (GetAsyncKeyState('S') & 0x8000)
+	if (input.Down(InputKey::Back))
 		freeCam.Walk(-10.0f*dt);
 
-	if (GetAsyncKeyState('A') & 0x8000)
+	if (input.Down(InputKey::StrafeLeft))
 		freeCam.Strafe(-10.0f*dt);
 
-	if (GetAsyncKeyState('D') & 0x8000)
+	if (input.Down(InputKey::StrafeRight))
 		freeCam.Strafe(10.0f*dt);
 
-	if (GetAsyncKeyState('F') & 0x8000)
+	if (input.Down(InputKey::WireframeOn))
 	{
 		wired = true;
 		
 	}
 
-	if (GetAsyncKeyState('E') & 0x8000)
+	if (input.Down(InputKey::FlyUp))
 	{	
 		freeCam.FlyUp(10.0f*dt);
 	}
-	if (GetAsyncKeyState('Q') & 0x8000)
+	if (input.Down(InputKey::FlyDown))
 	{
 		freeCam.FlyUp(-10.0f*dt);
 	}
 
-	if (GetAsyncKeyState('G') & 0x8000)
+	if (input.Down(InputKey::WireframeOff))
 	{
 		wired = false;
 
 	}
 
 	//Moves the 3rd person camera
-	if (GetAsyncKeyState(VK_UP) )
+	if (input.Down(InputKey::CharForward))
 	{
 		charZ += 10.0f*dt;
 		//charX = charZ * charRotation; 
 
 	}
-	if (GetAsyncKeyState(VK_DOWN))
+	if (input.Down(InputKey::CharBack))
 	{
 		charZ += -10.0f*dt;
 
 	}
 
-	if (GetAsyncKeyState(VK_LEFT))
+	if (input.Down(InputKey::CharLeft))
 	{
 		charRotation += -2 * dt;
 		charX += -10.0f*dt;
 
 	}
 
-	if (GetAsyncKeyState(VK_RIGHT))
+	if (input.Down(InputKey::CharRight))
 	{
 		charRotation += 2 * dt;
 		charX += 10.0f*dt;
@@ -533,24 +1317,18 @@ void CrateApp::OnKeyboardInput(const GameTimer& gt)
 	}
 
 	//changes camera states
-	if (GetAsyncKeyState('1'))
-	{
-		cam1 = true;
-		cam3 = false;
-		camfree = false;
-	}
-	if (GetAsyncKeyState('2'))
-	{
-		cam1 = false;
-		cam3 = true;
-		camfree = false;
-	}
-	if (GetAsyncKeyState('3'))
-	{
-		cam1 = false;
-		cam3 = false;
-		camfree = true;
-	}
+	if (input.Down(InputKey::FirstPerson))
+		SetCameraMode(CameraMode::FirstPerson);
+	if (input.Down(InputKey::ThirdPerson))
+		SetCameraMode(CameraMode::ThirdPerson);
+	if (input.Down(InputKey::FreeCamera))
+		SetCameraMode(CameraMode::Free);
+
+	// Digs once per press, not once per step.
+	bool dig = input.Down(InputKey::Dig);
+	if (dig && !mDigKeyDown)
+		DigUnderCharacter();
+	mDigKeyDown = dig;
 
 	
 	//updates the camera matrix after moving it
@@ -567,30 +1345,36 @@ void CrateApp::AnimateMaterials(const GameTimer& gt)
 
 void CrateApp::UpdateObjectCBs(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
+	PROFILE_ZONE("UpdateObjectCBs");
+
 	for (auto& e : mAllRitems)
+		UpdateObjectCB(*e);
+}
+
+void CrateApp::UpdateObjectCB(RenderItem& item)
+{
+	// Only update the cbuffer data if the constants have changed.  
+	// This needs to be tracked per frame resource.
+	if (item.NumFramesDirty > 0)
 	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+		XMMATRIX world = XMLoadFloat4x4(&item.World);
+		XMMATRIX texTransform = XMLoadFloat4x4(&item.TexTransform);
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+		ObjectConstants objConstants;
+		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+		mCurrFrameResource->ObjectCB->CopyData(item.ObjCBIndex, objConstants);
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
+		// Next FrameResource need to be updated too.
+		item.NumFramesDirty--;
 	}
 }
 
 void CrateApp::UpdateMaterialCBs(const GameTimer& gt)
 {
+	PROFILE_ZONE("UpdateMaterialCBs");
+
 	auto currMaterialCB = mCurrFrameResource->MaterialCB.get();
 	for (auto& e : mMaterials)
 	{
@@ -617,8 +1401,10 @@ void CrateApp::UpdateMaterialCBs(const GameTimer& gt)
 
 void CrateApp::UpdateMainPassCB(const GameTimer& gt)
 {
-	XMMATRIX view = freeCam.GetView();
-	XMMATRIX proj = freeCam.GetProj();
+	PROFILE_ZONE("UpdateMainPassCB");
+
+	XMMATRIX view = XMLoadFloat4x4(&mSnapshot->View);
+	XMMATRIX proj = XMLoadFloat4x4(&mSnapshot->Proj);
 	//XMMATRIX view = XMLoadFloat4x4(&mView);
 	//XMMATRIX proj = XMLoadFloat4x4(&mProj);
 
@@ -633,16 +1419,19 @@ void CrateApp::UpdateMainPassCB(const GameTimer& gt)
 	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
 	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
 	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-	mMainPassCB.EyePosW = freeCam.GetPosition3f();
+	mMainPassCB.EyePosW = mSnapshot->EyePosW;
+
+	BoundingFrustum::CreateFromMatrix(mCamFrustum, proj);
+	mCamFrustum.Transform(mCamFrustum, invView);
 	//mMainPassCB.EyePosW = mEyePos;
 	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
 	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
 	mMainPassCB.NearZ = 1.0f;
 	mMainPassCB.FarZ = 1000.0f;
-	mMainPassCB.TotalTime = gt.TotalTime();
-	mMainPassCB.DeltaTime = gt.DeltaTime();
+	mMainPassCB.TotalTime = mSnapshot->TotalTime;
+	mMainPassCB.DeltaTime = mSnapshot->DeltaTime;
 	
-	float pulse = sin(gt.TotalTime() / 10); //creates a pulse effect for the lights 
+	float pulse = sin(mSnapshot->TotalTime / 10); //creates a pulse effect for the lights 
 	pulse = modff(pulse, &pulse);
 
 	//the main lighting used in the world 
@@ -662,174 +1451,48 @@ void CrateApp::UpdateMainPassCB(const GameTimer& gt)
 
 void CrateApp::LoadTextures() //loads in all of the textures used for the world
 {
-	//Load grass texture
-	auto grassMatTex = std::make_unique<Texture>();
-	grassMatTex->Name = "grassMatTex";
-	grassMatTex->Filename = L"Textures/minecraft_grass3.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), grassMatTex->Filename.c_str(),
-		grassMatTex->Resource, grassMatTex->UploadHeap));
-
-	mTextures[grassMatTex->Name] = std::move(grassMatTex);
-
-	//Load dirt texture
-	auto dirtMatTex = std::make_unique<Texture>();
-	dirtMatTex->Name = "dirtMatTex";
-	dirtMatTex->Filename = L"Textures/minecraft_dirt.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), dirtMatTex->Filename.c_str(),
-		dirtMatTex->Resource, dirtMatTex->UploadHeap));
-
-	mTextures[dirtMatTex->Name] = std::move(dirtMatTex);
-
-	//Load stone texture
-	auto stoneMatTex = std::make_unique<Texture>();
-	stoneMatTex->Name = "stoneMatTex";
-	stoneMatTex->Filename = L"Textures/minecraft_stone.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), stoneMatTex->Filename.c_str(),
-		stoneMatTex->Resource, stoneMatTex->UploadHeap));
-
-	mTextures[stoneMatTex->Name] = std::move(stoneMatTex);
-
-	//Load bedrock texture
-	auto bedrockMatTex = std::make_unique<Texture>();
-	bedrockMatTex->Name = "bedrockMatTex";
-	bedrockMatTex->Filename = L"Textures/minecraft_bedrock2.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), bedrockMatTex->Filename.c_str(),
-		bedrockMatTex->Resource, bedrockMatTex->UploadHeap));
-
-	mTextures[bedrockMatTex->Name] = std::move(bedrockMatTex);
-
-	//Load water texture
-	auto waterMatTex = std::make_unique<Texture>();
-	waterMatTex->Name = "waterMatTex";
-	waterMatTex->Filename = L"Textures/minecraft_water2.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), waterMatTex->Filename.c_str(),
-		waterMatTex->Resource, waterMatTex->UploadHeap));
-
-	mTextures[waterMatTex->Name] = std::move(waterMatTex);
-
-	//load coal texture
-	auto coalMatTex = std::make_unique<Texture>();
-	coalMatTex->Name = "coalMatTex";
-	coalMatTex->Filename = L"Textures/minecraft_coal.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), coalMatTex->Filename.c_str(),
-		coalMatTex->Resource, coalMatTex->UploadHeap));
-
-	mTextures[coalMatTex->Name] = std::move(coalMatTex);
-
-	//load iron texture
-	auto ironMatTex = std::make_unique<Texture>();
-	ironMatTex->Name = "ironMatTex";
-	ironMatTex->Filename = L"Textures/minecraft_iron.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), ironMatTex->Filename.c_str(),
-		ironMatTex->Resource, ironMatTex->UploadHeap));
-
-	mTextures[ironMatTex->Name] = std::move(ironMatTex);
-
-	//load diamond texture
-	auto diamondMatTex = std::make_unique<Texture>();
-	diamondMatTex->Name = "diamondMatTex";
-	diamondMatTex->Filename = L"Textures/minecraft_diamond.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), diamondMatTex->Filename.c_str(),
-		diamondMatTex->Resource, diamondMatTex->UploadHeap));
-
-	mTextures[diamondMatTex->Name] = std::move(diamondMatTex);
-
-	//load redstone texture
-	auto redsMatTex = std::make_unique<Texture>();
-	redsMatTex->Name = "redsMatTex";
-	redsMatTex->Filename = L"Textures/minecraft_redstone.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), redsMatTex->Filename.c_str(),
-		redsMatTex->Resource, redsMatTex->UploadHeap));
-
-	mTextures[redsMatTex->Name] = std::move(redsMatTex);
-
-	//load sand texture
-	auto sandMatTex = std::make_unique<Texture>();
-	sandMatTex->Name = "sandMatTex";
-	sandMatTex->Filename = L"Textures/minecraft_sand.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), sandMatTex->Filename.c_str(),
-		sandMatTex->Resource, sandMatTex->UploadHeap));
-
-	mTextures[sandMatTex->Name] = std::move(sandMatTex);
-
-	//load long grass texture
-	auto longGrassMatTex = std::make_unique<Texture>();
-	longGrassMatTex->Name = "longGrassMatTex";
-	longGrassMatTex->Filename = L"Textures/MineCraft_Tall_Grass.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), longGrassMatTex->Filename.c_str(),
-		longGrassMatTex->Resource, longGrassMatTex->UploadHeap));
-
-	mTextures[longGrassMatTex->Name] = std::move(longGrassMatTex);
-
-	//load wood texture
-	auto woodMatTex = std::make_unique<Texture>();
-	woodMatTex->Name = "woodMatTex";
-	woodMatTex->Filename = L"Textures/minecraft_tree_wood.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), woodMatTex->Filename.c_str(),
-		woodMatTex->Resource, woodMatTex->UploadHeap));
-
-	mTextures[woodMatTex->Name] = std::move(woodMatTex);
-
-	//load leaves texture
-	auto leafMatTex = std::make_unique<Texture>();
-	leafMatTex->Name = "leafMatTex";
-	leafMatTex->Filename = L"Textures/minecraft_tree_leaves.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), leafMatTex->Filename.c_str(),
-		leafMatTex->Resource, leafMatTex->UploadHeap));
-
-	mTextures[leafMatTex->Name] = std::move(leafMatTex);
-
-	//load yellow flower texture
-	auto flowerYMatTex = std::make_unique<Texture>();
-	flowerYMatTex->Name = "flowerYMatTex";
-	flowerYMatTex->Filename = L"Textures/minecraft_flower_yellow.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), flowerYMatTex->Filename.c_str(),
-		flowerYMatTex->Resource, flowerYMatTex->UploadHeap));
-
-	mTextures[flowerYMatTex->Name] = std::move(flowerYMatTex);
-
-	//load red flower texture
-	auto flowerRMatTex = std::make_unique<Texture>();
-	flowerRMatTex->Name = "flowerRMatTex";
-	flowerRMatTex->Filename = L"Textures/minecraft_flower_red.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), flowerRMatTex->Filename.c_str(),
-		flowerRMatTex->Resource, flowerRMatTex->UploadHeap));
-
-	mTextures[flowerRMatTex->Name] = std::move(flowerRMatTex);
-
-	//load sugarcane texture
-	auto sugarMatTex = std::make_unique<Texture>();
-	sugarMatTex->Name = "sugarMatTex";
-	sugarMatTex->Filename = L"Textures/minecraft_sugar.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), sugarMatTex->Filename.c_str(),
-		sugarMatTex->Resource, sugarMatTex->UploadHeap));
-
-	mTextures[sugarMatTex->Name] = std::move(sugarMatTex);
-
-	auto skyTex = std::make_unique<Texture>();
-	skyTex->Name = "skyTex";
-	skyTex->Filename = L"Textures/plainSky.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), skyTex->Filename.c_str(),
-		skyTex->Resource, skyTex->UploadHeap));
-
-	mTextures[skyTex->Name] = std::move(skyTex);
+	// Textures/Textures.pak, built from the manifest by Tools/AssetPacker, holds every
+	// texture ready to upload.  Packed with --mips, its textures stream: only the tails
+	// load now and finer mips follow as the camera gets close.  Without the archive the
+	// loose files listed in Textures/TextureManifest.txt are read instead.  Otherwise the
+	// textures are staged in parallel and uploaded with one batch of copies.
+	TextureBatchStats stats;
+	std::vector<std::unique_ptr<Texture>> textures;
+	if (mTextureArchive.Open(std::wstring(L"Textures/Textures.pak")))
+	{
+		if (mOptions.TextureBudgetMB > 0 && TextureStreamer::IsSupported(md3dDevice.Get(), mTextureArchive))
+		{
+			MipResidencyParams params;
+			params.BudgetBytes = (std::uint64_t)mOptions.TextureBudgetMB * 1024 * 1024;
+			mTextureStreamer = std::make_unique<TextureStreamer>(md3dDevice.Get(), mCommandQueue.Get(),
+				mGpuHeaps.get(), params, (UINT)(std::max)(mOptions.TailMips, 1));
+			textures = mTextureStreamer->CreateTextures(mCommandList.Get(), mTextureArchive,
+				L"Textures/Textures.pak", mTextureStaging);
+
+			::OutputDebugStringA(("Startup: streaming " + std::to_string(textures.size()) + " textures, " +
+				mTextureStreamer->StatsString() + "\n").c_str());
+		}
+		else
+		{
+			textures = LoadTextureBatch(md3dDevice.Get(), mGpuHeaps.get(), mCommandList.Get(),
+				mTextureArchive, L"Textures/Textures.pak", mOptions.TextureThreads, mTextureStaging, &stats);
+			mTextureArchive.Close();
+		}
+	}
+	else
+	{
+		std::vector<TextureManifestEntry> manifest;
+		if (!LoadTextureManifest(L"Textures/TextureManifest.txt", manifest))
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND));
+
+		textures = LoadTextureBatch(md3dDevice.Get(), mGpuHeaps.get(), mCommandList.Get(),
+			manifest, mOptions.TextureThreads, mTextureStaging, &stats);
+	}
+	for (auto& texture : textures)
+		mTextures[texture->Name] = std::move(texture);
+
+	if (mTextureStreamer == nullptr)
+		::OutputDebugStringA(("Startup: " + stats.ToString()).c_str());
 }
 
 
@@ -874,266 +1537,45 @@ void CrateApp::BuildRootSignature()
 		serializedRootSig->GetBufferPointer(),
 		serializedRootSig->GetBufferSize(),
 		IID_PPV_ARGS(mRootSignature.GetAddressOf())));
+
+	// PSO cache keys include the root signature by content.
+	mRootSignatureHash = Hash::Fnv1a(serializedRootSig->GetBufferPointer(), serializedRootSig->GetBufferSize());
 }
 
 void CrateApp::BuildDescriptorHeaps()
 {
 	//
-	// Create the SRV heap.
+	// Create the SRV heap: a persistent slot per texture plus a small transient range
+	// for each frame resource.  The heap grows by itself if more textures turn up.
 	//
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 17;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+	mSrvHeap = std::make_unique<DescriptorHeapAllocator>(md3dDevice.Get(),
+		(UINT)mTextures.size(), 16, gNumFrameResources);
 
 	//
-	// Fill out the heap with actual descriptors.
+	// Fill out the heap with actual descriptors.  Materials look the index up by texture name.
 	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	//Adds the grass texture to the descriptor heap
-	auto grassMatTex = mTextures["grassMatTex"]->Resource;
-
-
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-
-	
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = grassMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = grassMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-
-	md3dDevice->CreateShaderResourceView(grassMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	
-	//Adds the dirt texture to the descriptor heap
-	auto dirtMatTex = mTextures["dirtMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = dirtMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = dirtMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(dirtMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the stone texture to the descriptor heap
-	auto stoneMatTex = mTextures["stoneMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = stoneMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = stoneMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(stoneMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the bedrock texture to the descriptor heap
-	auto bedrockMatTex = mTextures["bedrockMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = bedrockMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = bedrockMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(bedrockMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the water texture to the descriptor heap
-	auto waterMatTex = mTextures["waterMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = waterMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = waterMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(waterMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the coal texture to the descriptor heap
-	auto coalMatTex = mTextures["coalMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = coalMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = coalMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(coalMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the iron texture to the descriptor heap
-	auto ironMatTex = mTextures["ironMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = ironMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = ironMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(ironMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the diamond texture to the descriptor heap
-	auto diamondMatTex = mTextures["diamondMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = diamondMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = diamondMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(diamondMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the redstone texture to the descriptor heap
-	auto redsMatTex = mTextures["redsMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = redsMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = redsMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(redsMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the sand texture to the descriptor heap
-	auto sandMatTex = mTextures["sandMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = sandMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = sandMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(sandMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the long grass texture to the descriptor heap
-	auto longGrassMatTex = mTextures["longGrassMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = longGrassMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = longGrassMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(longGrassMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-	
-	//Adds the Wood texture to the descriptor heap
-	auto woodMatTex = mTextures["woodMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = woodMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = woodMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(woodMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the leaves texture to the descriptor heap
-	auto leafMatTex = mTextures["leafMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = leafMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = leafMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(leafMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the yellow flower texture to the descriptor heap
-	auto flowerYMatTex = mTextures["flowerYMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = flowerYMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = flowerYMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(flowerYMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the red flower texture to the descriptor heap
-	auto flowerRMatTex = mTextures["flowerRMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = flowerRMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = flowerRMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(flowerRMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the sugar cane texture to the descriptor heap
-	auto sugarMatTex = mTextures["sugarMatTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = sugarMatTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = sugarMatTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(sugarMatTex.Get(), &srvDesc, hDescriptor);
-
-	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
-
-	//Adds the skybox texture to the descriptor heap
-	auto skyTex = mTextures["skyTex"]->Resource;
-
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = skyTex->GetDesc().Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.MipLevels = skyTex->GetDesc().MipLevels;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-
-	md3dDevice->CreateShaderResourceView(skyTex.Get(), &srvDesc, hDescriptor);
+	for (auto& e : mTextures)
+	{
+		auto tex = e.second->Resource;
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = tex->GetDesc().Format;
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = tex->GetDesc().MipLevels;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+		// Streamed textures start clamped to their tails.
+		int stream = (mTextureStreamer != nullptr) ? mTextureStreamer->Find(e.second.get()) : -1;
+		if (stream >= 0)
+			srvDesc = mTextureStreamer->SrvDesc(stream);
+
+		e.second->SrvHeapIndex = mSrvHeap->CreateSrv(tex.Get(), &srvDesc);
+	}
 
+	if (mTextureStreamer != nullptr)
+		mTextureStreamer->SetSrvHeap(mSrvHeap.get());
 }
 
 
@@ -1155,10 +1597,16 @@ void CrateApp::BuildShadersAndInputLayout()
 		NULL, NULL
 	};
 
-	//loads in shaders in from file and stores in the local shader list
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_1");
-	mShaders["alphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_1");
+	//loads in shaders from the bytecode cache, compiling only the permutations that changed
+	ShaderCache shaderCache;
+	mShaders["standardVS"] = shaderCache.Load(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
+	mShaders["opaquePS"] = shaderCache.Load(L"Shaders\\Default.hlsl", defines, "PS", "ps_5_1");
+	mShaders["alphaTestedPS"] = shaderCache.Load(L"Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_1");
+
+	std::ostringstream ss;
+	ss << "Shaders: " << shaderCache.Hits() << " cached, " << shaderCache.Misses()
+		<< " compiled, " << shaderCache.Milliseconds() << " ms\n";
+	::OutputDebugStringA(ss.str().c_str());
 
 	mInputLayout =
 	{
@@ -1202,11 +1650,13 @@ void CrateApp::BuildShapeGeometry() //builds the geometry of a box that can be u
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), vertices.data(), vbByteSize,
+		geo->VertexBufferOffset, geo->VertexBufferUploader, geo->VertexUploaderOffset);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), indices.data(), ibByteSize,
+		geo->IndexBufferOffset, geo->IndexBufferUploader, geo->IndexUploaderOffset);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -1248,11 +1698,13 @@ void CrateApp::BuildGrassGeo()  //builds the geometry of a quad that can be used
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), vertices.data(), vbByteSize,
+		geo->VertexBufferOffset, geo->VertexBufferUploader, geo->VertexUploaderOffset);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), indices.data(), ibByteSize,
+		geo->IndexBufferOffset, geo->IndexBufferUploader, geo->IndexUploaderOffset);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -1271,6 +1723,8 @@ void CrateApp::BuildGrassGeo()  //builds the geometry of a quad that can be used
 
 void CrateApp::BuildPSOs()
 {
+	mPipelines = std::make_unique<PipelineStateCache>(md3dDevice.Get());
+
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
 	//
@@ -1289,37 +1743,18 @@ void CrateApp::BuildPSOs()
 		reinterpret_cast<BYTE*>(mShaders["opaquePS"]->GetBufferPointer()),
 		mShaders["opaquePS"]->GetBufferSize()
 	};
-	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-	if (!wired)
-	{
-		opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(
-			D3D12_FILL_MODE_SOLID,
-			D3D12_CULL_MODE_BACK,
-			FALSE,
-			D3D12_DEFAULT_DEPTH_BIAS,
-			D3D12_DEFAULT_DEPTH_BIAS_CLAMP,
-			D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS,
-			FALSE,
-			FALSE,
-			FALSE,
-			0,
-			D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF);
-	}
-	else if (wired)
-	{
-		opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(
-			D3D12_FILL_MODE_WIREFRAME,
-			D3D12_CULL_MODE_BACK,
-			FALSE,
-			D3D12_DEFAULT_DEPTH_BIAS,
-			D3D12_DEFAULT_DEPTH_BIAS_CLAMP,
-			D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS,
-			TRUE,
-			FALSE,
-			FALSE,
-			0,
-			D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF);
-	}
+	opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(
+		D3D12_FILL_MODE_SOLID,
+		D3D12_CULL_MODE_BACK,
+		FALSE,
+		D3D12_DEFAULT_DEPTH_BIAS,
+		D3D12_DEFAULT_DEPTH_BIAS_CLAMP,
+		D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS,
+		FALSE,
+		FALSE,
+		FALSE,
+		0,
+		D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF);
 	//Changed this from D3D12_DEFAULT to play about with it while investigating performance issues
 
 
@@ -1332,7 +1767,7 @@ void CrateApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Count = m4xMsaaState ? 4 : 1;
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+	mPipelines->Create("opaque", opaquePsoDesc, mRootSignatureHash);
 
 
 	
@@ -1354,7 +1789,7 @@ void CrateApp::BuildPSOs()
 	transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
 
 	transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&mPSOs["transparent"])));
+	mPipelines->Create("transparent", transparentPsoDesc, mRootSignatureHash);
 
 
 	//PSO for alpha tested objects 
@@ -1367,10 +1802,38 @@ void CrateApp::BuildPSOs()
 
 	//Disable back face culling for Alpha tested objects 
 	alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, IID_PPV_ARGS(&mPSOs["alphaTested"])));
+	mPipelines->Create("alphaTested", alphaTestedPsoDesc, mRootSignatureHash);
+
+
+	//
+	// Wireframe variants for the 'F' toggle.  They are not needed for the first frame, so
+	// they are created in the background and Draw falls back to the solid PSOs meanwhile.
+	//
+	CD3DX12_RASTERIZER_DESC wireframeRasterizer(
+		D3D12_FILL_MODE_WIREFRAME,
+		D3D12_CULL_MODE_BACK,
+		FALSE,
+		D3D12_DEFAULT_DEPTH_BIAS,
+		D3D12_DEFAULT_DEPTH_BIAS_CLAMP,
+		D3D12_DEFAULT_SLOPE_SCALED_DEPTH_BIAS,
+		TRUE,
+		FALSE,
+		FALSE,
+		0,
+		D3D12_CONSERVATIVE_RASTERIZATION_MODE_OFF);
 
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaqueWireframePsoDesc = opaquePsoDesc;
+	opaqueWireframePsoDesc.RasterizerState = wireframeRasterizer;
+	mPipelines->CreateAsync("opaqueWireframe", opaqueWireframePsoDesc, mRootSignatureHash);
 
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentWireframePsoDesc = transparentPsoDesc;
+	transparentWireframePsoDesc.RasterizerState = wireframeRasterizer;
+	mPipelines->CreateAsync("transparentWireframe", transparentWireframePsoDesc, mRootSignatureHash);
 
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC alphaTestedWireframePsoDesc = alphaTestedPsoDesc;
+	alphaTestedWireframePsoDesc.RasterizerState = wireframeRasterizer;
+	alphaTestedWireframePsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	mPipelines->CreateAsync("alphaTestedWireframe", alphaTestedWireframePsoDesc, mRootSignatureHash);
 }
 
 
@@ -1379,180 +1842,55 @@ void CrateApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), (UINT)mMaterials.size()));
+			1, mObjectCBCount, (UINT)mMaterials.size()));
 	}
 }
 
 void CrateApp::BuildMaterials()
 {
-	//material for grass
-	auto grassMat = std::make_unique<Material>();
-	grassMat->Name = "grassMat";
-	grassMat->MatCBIndex = 0;
-	grassMat->DiffuseSrvHeapIndex = 0;
-	grassMat->DiffuseAlbedo = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
-	grassMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	grassMat->Roughness = 0.2f;
-
-	//material for dirt
-	auto dirtMat = std::make_unique<Material>();
-	dirtMat->Name = "dirtMat";
-	dirtMat->MatCBIndex = 1;
-	dirtMat->DiffuseSrvHeapIndex = 1;
-	dirtMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	dirtMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	dirtMat->Roughness = 0.2f;
-
-	//material for stone
-	auto stoneMat = std::make_unique<Material>();
-	stoneMat->Name = "stoneMat";
-	stoneMat->MatCBIndex = 2;
-	stoneMat->DiffuseSrvHeapIndex = 2;
-	stoneMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	stoneMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	stoneMat->Roughness = 0.2f;
-
-	//material for bedrock
-	auto bedrockMat = std::make_unique<Material>();
-	bedrockMat->Name = "bedrockMat";
-	bedrockMat->MatCBIndex = 3;
-	bedrockMat->DiffuseSrvHeapIndex = 3;
-	bedrockMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	bedrockMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	bedrockMat->Roughness = 0.2f;
-
-	//material for water
-	auto waterMat = std::make_unique<Material>();
-	waterMat->Name = "waterMat";
-	waterMat->MatCBIndex = 4;
-	waterMat->DiffuseSrvHeapIndex = 4;
-	waterMat->DiffuseAlbedo = XMFLOAT4(0.5f, 0.5f, 1.0f, 1.0f);
-	waterMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	waterMat->Roughness = 0.2f;
-
-	//material for Coal
-	auto coalMat = std::make_unique<Material>();
-	coalMat->Name = "coalMat";
-	coalMat->MatCBIndex = 5;
-	coalMat->DiffuseSrvHeapIndex = 5;
-	coalMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	coalMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	coalMat->Roughness = 0.2f;
-
-	//material for iron
-	auto ironMat = std::make_unique<Material>();
-	ironMat->Name = "ironMat";
-	ironMat->MatCBIndex = 6;
-	ironMat->DiffuseSrvHeapIndex = 6;
-	ironMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	ironMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	ironMat->Roughness = 0.2f;
-
-	//material for diamond
-	auto diamondMat = std::make_unique<Material>();
-	diamondMat->Name = "diamondMat";
-	diamondMat->MatCBIndex = 7;
-	diamondMat->DiffuseSrvHeapIndex = 7;
-	diamondMat->DiffuseAlbedo = XMFLOAT4(0.85f, 0.85f, 0.85f, 1.0f);
-	diamondMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	diamondMat->Roughness = 0.2f;
-
-	//material for redstone
-	auto redsMat = std::make_unique<Material>();
-	redsMat->Name = "redsMat";
-	redsMat->MatCBIndex = 8;
-	redsMat->DiffuseSrvHeapIndex = 8;
-	redsMat->DiffuseAlbedo = XMFLOAT4(0.85f, 0.85f, 0.85f, 1.0f);
-	redsMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	redsMat->Roughness = 0.2f;
-
-	//material for sand
-	auto sandMat = std::make_unique<Material>();
-	sandMat->Name = "sandMat";
-	sandMat->MatCBIndex = 9;
-	sandMat->DiffuseSrvHeapIndex = 9;
-	sandMat->DiffuseAlbedo = XMFLOAT4(0.85f, 0.85f, 0.85f, 1.0f);
-	sandMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	sandMat->Roughness = 0.2f;
-
-	//material for long grass
-	auto longGrassMat = std::make_unique<Material>();
-	longGrassMat->Name = "longGrassMat";
-	longGrassMat->MatCBIndex = 10;
-	longGrassMat->DiffuseSrvHeapIndex = 10;
-	longGrassMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-	longGrassMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	longGrassMat->Roughness = 0.2f;
-
-	//material for wood
-	auto woodMat = std::make_unique<Material>();
-	woodMat->Name = "woodMat";
-	woodMat->MatCBIndex = 11;
-	woodMat->DiffuseSrvHeapIndex = 11;
-	woodMat->DiffuseAlbedo = XMFLOAT4(0.9f, 1.0f, 0.75f, 1.0f);
-	woodMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	woodMat->Roughness = 0.2f;
-
-	//material for leaves 
-	auto leafMat = std::make_unique<Material>();
-	leafMat->Name = "leafMat";
-	leafMat->MatCBIndex = 12;
-	leafMat->DiffuseSrvHeapIndex = 12;
-	leafMat->DiffuseAlbedo = XMFLOAT4(0.5f, 0.5f, 0.5f, 1.0f);
-	leafMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	leafMat->Roughness = 0.2f;
-
-	//material for yellow flowers 
-	auto flowerYMat = std::make_unique<Material>();
-	flowerYMat->Name = "flowerYMat";
-	flowerYMat->MatCBIndex = 13;
-	flowerYMat->DiffuseSrvHeapIndex = 13;
-	flowerYMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 0.5f, 1.0f);
-	flowerYMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	flowerYMat->Roughness = 0.2f;
-
-	//material for red flowers 
-	auto flowerRMat = std::make_unique<Material>();
-	flowerRMat->Name = "flowerRMat";
-	flowerRMat->MatCBIndex = 14;
-	flowerRMat->DiffuseSrvHeapIndex = 14;
-	flowerRMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 0.5f, 1.0f);
-	flowerRMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	flowerRMat->Roughness = 0.2f;
-
-	//material for sugar canes 
-	auto sugarMat = std::make_unique<Material>();
-	sugarMat->Name = "sugarMat";
-	sugarMat->MatCBIndex = 15;
-	sugarMat->DiffuseSrvHeapIndex = 15;
-	sugarMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 0.5f, 1.0f);
-	sugarMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
-	sugarMat->Roughness = 0.2f;
+	// One material per drawn block, as Textures/Blocks.txt describes it.
+	std::string error;
+	if (!mBlocks.Load("Textures/Blocks.txt", error))
+	{
+		::OutputDebugStringA((error + "\n").c_str());
+		ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+	}
+
+	int matCBIndex = 0;
+	for (int i = 0; i < (int)BlockId::Count; ++i)
+	{
+		BlockId block = (BlockId)i;
+		if (GetBlockLayer(block) == BlockLayer::None)
+			continue;
+
+		const BlockAppearance& appearance = mBlocks.Appearance(block);
+		auto texture = mTextures.find(appearance.Texture);
+		if (texture == mTextures.end())
+		{
+			::OutputDebugStringA(("Textures/Blocks.txt: " + std::string(GetBlockName(block)) + " uses texture " +
+				appearance.Texture + ", which was not loaded\n").c_str());
+			ThrowIfFailed(HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+		}
+
+		auto mat = std::make_unique<Material>();
+		mat->Name = std::string(GetBlockName(block)) + "Mat";
+		mat->MatCBIndex = matCBIndex++;
+		mat->DiffuseSrvHeapIndex = texture->second->SrvHeapIndex;
+		mat->DiffuseAlbedo = XMFLOAT4(appearance.Albedo[0], appearance.Albedo[1], appearance.Albedo[2], appearance.Albedo[3]);
+		mat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
+		mat->Roughness = 0.2f;
+		mBlockMaterials[i] = mat.get();
+		mMaterials[mat->Name] = std::move(mat);
+	}
 
 	auto skyMat = std::make_unique<Material>();
 	skyMat->Name = "skyMat";
-	skyMat->MatCBIndex = 16;
-	skyMat->DiffuseSrvHeapIndex = 16;
+	skyMat->MatCBIndex = matCBIndex++;
+	skyMat->DiffuseSrvHeapIndex = mTextures["skyTex"]->SrvHeapIndex;
 	skyMat->DiffuseAlbedo = XMFLOAT4(0.8f, 0.8f, 0.8f, 1.0f);
 	skyMat->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 	skyMat->Roughness = 0.2f;
 
-	mMaterials["grassMat"] = std::move(grassMat);
-	mMaterials["dirtMat"] = std::move(dirtMat);
-	mMaterials["stoneMat"] = std::move(stoneMat);
-	mMaterials["bedrockMat"] = std::move(bedrockMat);
-	mMaterials["waterMat"] = std::move(waterMat);
-	mMaterials["coalMat"] = std::move(coalMat);
-	mMaterials["ironMat"] = std::move(ironMat);
-	mMaterials["diamondMat"] = std::move(diamondMat);
-	mMaterials["redsMat"] = std::move(redsMat);
-	mMaterials["sandMat"] = std::move(sandMat);
-	mMaterials["longGrassMat"] = std::move(longGrassMat);
-	mMaterials["woodMat"] = std::move(woodMat);
-	mMaterials["leafMat"] = std::move(leafMat);
-	mMaterials["flowerYMat"] = std::move(flowerYMat);
-	mMaterials["flowerRMat"] = std::move(flowerRMat);
-	mMaterials["sugarMat"] = std::move(sugarMat);
 	mMaterials["skyMat"] = std::move(skyMat);
 
 }
@@ -1560,6 +1898,8 @@ void CrateApp::BuildMaterials()
 
 void CrateApp::BuildRenderItems()
 {
+	PROFILE_ZONE("BuildRenderItems");
+
 	int i = 1; //object index value
 
 
@@ -1576,353 +1916,251 @@ void CrateApp::BuildRenderItems()
 	skyRitem->BaseVertexLocation = skyRitem->Geo->DrawArgs["skyBox"].BaseVertexLocation;
 	mAllRitems.push_back(std::move(skyRitem));
 
+	// The character and the sky are the only items so far; both are opaque.
+	for (auto& e : mAllRitems)
+		mRitemLayer[(int)RenderLayer::Opaque].push_back(e.get());
 
-	srand((size_t)time(NULL)); //reinitializes the random seed using the current time
-	PerlinNoise p; //initializes an object of perlinNoise
-	double persistence = 0.0; 
-	double frequency = 0.15; 
-	
-	double octaves = 1.0;
-	double amplitude = RandomNum(10, 20, 1); //randomises the amplitude between 10 and 20
-	double randomseed = RandomNum(1, 100, 1); //randomises the seed that is used by the perlin noise object
+	// Each chunk draws with one render item per block type instead of one per block.
+	mChunkObjCBBase = i;
+	mObjectCBCount = (UINT)(mChunkObjCBBase + mWorld->ChunkCount());
+	for (const ChunkMesh& mesh : mChunkMeshes)
+		BuildChunkRenderItems(mesh);
 
-	p.Set(persistence, frequency, amplitude, octaves, randomseed); //plugs the above variables into the perlin noise generator
+	std::vector<ChunkMesh>().swap(mChunkMeshes);
+}
 
-	//DRAW LAND//
-	for (int z = 0; z <= Worldsize; z++) // draw along the Z axis
+void CrateApp::GenerateWorld()
+{
+	PROFILE_ZONE("GenerateWorld");
+
+	// With -world the world comes from its save if it has one of the right size.
+	// Recordings replay in the world generated from their seed instead.
+	bool replaying = mOptions.InputMode == InputSessionMode::Replay || mOptions.InputMode == InputSessionMode::Benchmark;
+	if (!mOptions.WorldDirectory.empty() && !replaying)
 	{
-		for (int x = 0; x <= Worldsize; x++) //draw along the X axis
+		mWorldSave = std::make_unique<WorldSave>(mOptions.WorldDirectory);
+		WorldSaveInfo info;
+		if (mWorldSave->ReadInfo(info) && info.SizeX == Worldsize && info.SizeZ == Worldsize)
+			mWorld = mWorldSave->LoadWorld(&info);
+		if (mWorld != nullptr)
 		{
-			WorldHeight[x][z] = p.GetHeight(x, z); //stores the height of the surface block into the world height array at the X&Z so it can be referenced later.  
-			//GENERATE A BLOCK//
-			auto boxRitem = std::make_unique<RenderItem>();
-			XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(1.0f, 1.0f, 1.0f)*XMMatrixTranslation(x, p.GetHeight(x, z), z)); //sets the Y height of the block equal to the perlin noise value 
-			XMStoreFloat4x4(&boxRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-			boxRitem->ObjCBIndex = i; //store the object index of the render item.
-			i++;//increment the index value for the next item
-
-			if (WorldHeight[x][z] <= -2)
-			{ 
-				boxRitem->Mat = mMaterials["sandMat"].get(); //draw a sand block by changing obj material //if block is equal to water height (-2) make it sand
-			}
-			else
-			{
-				boxRitem->Mat = mMaterials["grassMat"].get(); //draw a grass block as it will be above -2 (water level) 
-			}
+			mWorldSeed = info.Seed;
+			mRecording->Seed = mWorldSeed;
+			::OutputDebugStringA(("Startup: loaded world " + std::to_string(mWorldSeed) + " from " + mOptions.WorldDirectory + "\n").c_str());
+		}
+	}
 
-			boxRitem->Geo = mGeometries["boxGeo"].get(); //gets the box geometry 
-			boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-			boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-			boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-			boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-			mAllRitems.push_back(std::move(boxRitem));
+	// Otherwise the world comes from its WorldCache snapshot, or is generated into
+	// blocks and meshed one chunk at a time on the CPU.  With -world it is saved in the
+	// background.  BuildRenderItems uploads the meshes.
+	if (mWorld == nullptr)
+	{
+		WorldGenParams params;
+		params.Size = Worldsize;
+		params.Seed = mWorldSeed;
 
-			//Draw Grass or a tree or Flowers or sugarCane//
-			if ((RandomNum(1, 100, 1) > 99) && p.GetHeight(x, z) == -2) // 1% chance of creating sugar cane at water level if the block is not water
-			{
-				int mh = RandomNum(1, 4, 1); 
-				for (int h = 0; h < mh; h++)
-				{ //draws sugar cane
-					auto sugarRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&sugarRitem->World, XMMatrixScaling(1.0, 1.0, 1.0) * XMMatrixRotationY(0.785398) * XMMatrixTranslation(x - 1, p.GetHeight(x, z) + 0.25 + h, z + 1.2));				//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-					sugarRitem->ObjCBIndex = i;
-					i++;
-					sugarRitem->Mat = mMaterials["sugarMat"].get();
-					sugarRitem->Geo = mGeometries["quadGeo"].get();
-					sugarRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					sugarRitem->IndexCount = sugarRitem->Geo->DrawArgs["quad"].IndexCount;
-					sugarRitem->StartIndexLocation = sugarRitem->Geo->DrawArgs["quad"].StartIndexLocation;
-					sugarRitem->BaseVertexLocation = sugarRitem->Geo->DrawArgs["quad"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(sugarRitem));
-
-					auto sugarRitem2 = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&sugarRitem2->World, XMMatrixScaling(1.0, 1.0, 1.0) * XMMatrixRotationY(-0.785398) * XMMatrixTranslation(x - 1, p.GetHeight(x, z) + 0.25 + h, z - 1));
-					sugarRitem2->ObjCBIndex = i;
-					i++;
-					sugarRitem2->Mat = mMaterials["sugarMat"].get();
-					sugarRitem2->Geo = mGeometries["quadGeo"].get();
-					sugarRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					sugarRitem2->IndexCount = sugarRitem2->Geo->DrawArgs["quad"].IndexCount;
-					sugarRitem2->StartIndexLocation = sugarRitem2->Geo->DrawArgs["quad"].StartIndexLocation;
-					sugarRitem2->BaseVertexLocation = sugarRitem2->Geo->DrawArgs["quad"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(sugarRitem2));
-				}
-			}
+		std::uint64_t key = 0;
+		if (!mOptions.NoWorldCache)
+		{
+			mWorldCache = std::make_unique<WorldCache>();
+			key = WorldCache::ComputeKey(params);
+			if (mWorldCache->Load(key, mWorld, mChunkMeshes))
+				mWorldSource = "from cache";
+		}
 
-			if ((RandomNum(1, 100, 1) > 99) && p.GetHeight(x, z) > -2) //creates a yellow flower above water level ontop of a block with a 1% chance
-			{
-				auto flowerRitem = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&flowerRitem->World, XMMatrixScaling(0.5, 0.5, 0.5) * XMMatrixRotationY(0.785398) * XMMatrixTranslation(x - 0.5, p.GetHeight(x, z) + 0.5, z + 0.6));
-				//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				flowerRitem->ObjCBIndex = i;
-				i++;
-				flowerRitem->Mat = mMaterials["flowerYMat"].get();
-				flowerRitem->Geo = mGeometries["quadGeo"].get();
-				flowerRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				flowerRitem->IndexCount = flowerRitem->Geo->DrawArgs["quad"].IndexCount;
-				flowerRitem->StartIndexLocation = flowerRitem->Geo->DrawArgs["quad"].StartIndexLocation;
-				flowerRitem->BaseVertexLocation = flowerRitem->Geo->DrawArgs["quad"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(flowerRitem));
-
-				auto flowerRitem2 = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&flowerRitem2->World, XMMatrixScaling(0.5, 0.5, 0.5) * XMMatrixRotationY(-0.785398) * XMMatrixTranslation(x - 0.5, p.GetHeight(x, z) + 0.5, z - 0.5));
-				//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				flowerRitem2->ObjCBIndex = i;
-				i++;
-				flowerRitem2->Mat = mMaterials["flowerYMat"].get();
-				flowerRitem2->Geo = mGeometries["quadGeo"].get();
-				flowerRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				flowerRitem2->IndexCount = flowerRitem2->Geo->DrawArgs["quad"].IndexCount;
-				flowerRitem2->StartIndexLocation = flowerRitem2->Geo->DrawArgs["quad"].StartIndexLocation;
-				flowerRitem2->BaseVertexLocation = flowerRitem2->Geo->DrawArgs["quad"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(flowerRitem2));
-			}
+		if (mWorld == nullptr)
+		{
+			WorldGenerator generator(params);
+			mWorld = generator.Generate();
+			MeshWorld();
+			if (mWorldCache != nullptr)
+				mWorldCache->Save(key, *mWorld, mChunkMeshes);
+		}
 
-			else if ((RandomNum(1, 100, 1) > 99) && p.GetHeight(x, z) > -2) //creates a red flower above water level ontop of a block with a 1% chance if it hasnt made a yellow flower
-			{
-				auto flowerRitem = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&flowerRitem->World, XMMatrixScaling(0.5, 0.5, 0.5) * XMMatrixRotationY(0.785398) * XMMatrixTranslation(x - 0.5, p.GetHeight(x, z) + 0.5, z + 0.6));
-				//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				flowerRitem->ObjCBIndex = i;
-				i++;
-				flowerRitem->Mat = mMaterials["flowerRMat"].get();
-				flowerRitem->Geo = mGeometries["quadGeo"].get();
-				flowerRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				flowerRitem->IndexCount = flowerRitem->Geo->DrawArgs["quad"].IndexCount;
-				flowerRitem->StartIndexLocation = flowerRitem->Geo->DrawArgs["quad"].StartIndexLocation;
-				flowerRitem->BaseVertexLocation = flowerRitem->Geo->DrawArgs["quad"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(flowerRitem));
-
-				auto flowerRitem2 = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&flowerRitem2->World, XMMatrixScaling(0.5, 0.5, 0.5) * XMMatrixRotationY(-0.785398) * XMMatrixTranslation(x - 0.5, p.GetHeight(x, z) + 0.5, z - 0.5));
-				//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				flowerRitem2->ObjCBIndex = i;
-				i++;
-				flowerRitem2->Mat = mMaterials["flowerRMat"].get();
-				flowerRitem2->Geo = mGeometries["quadGeo"].get();
-				flowerRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				flowerRitem2->IndexCount = flowerRitem2->Geo->DrawArgs["quad"].IndexCount;
-				flowerRitem2->StartIndexLocation = flowerRitem2->Geo->DrawArgs["quad"].StartIndexLocation;
-				flowerRitem2->BaseVertexLocation = flowerRitem2->Geo->DrawArgs["quad"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(flowerRitem2));
-			}
+		if (mWorldSave != nullptr)
+			mWorldSave->SaveWorld(*mWorld, mWorldSeed, WorldGenerator::Version);
+	}
+	else
+	{
+		mWorldSource = "from save";
+		MeshWorld();
+	}
+}
 
+float CrateApp::SurfaceHeightAt(float x, float z)const
+{
+	// Off the edge of the world the character stands on the nearest column.
+	int column = (std::min)((std::max)((int)x, 0), mWorld->SizeX() - 1);
+	int row = (std::min)((std::max)((int)z, 0), mWorld->SizeZ() - 1);
+	return (float)mWorld->SurfaceHeight(column, row);
+}
 
-			else if ((RandomNum(1, 100, 1) > 70) && p.GetHeight(x, z) > -2) //if no flower was created, have a 30% chance of drawing long grass
-			{
-				auto grassRitem = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&grassRitem->World, XMMatrixScaling(1.0, 1.0, 1.0) * XMMatrixRotationY(0.785398) * XMMatrixTranslation(x - 1, p.GetHeight(x, z) + 0.25, z + 1.2));
-				grassRitem->ObjCBIndex = i;
-				i++;
-				grassRitem->Mat = mMaterials["longGrassMat"].get();
-				grassRitem->Geo = mGeometries["quadGeo"].get();
-				grassRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				grassRitem->IndexCount = grassRitem->Geo->DrawArgs["quad"].IndexCount;
-				grassRitem->StartIndexLocation = grassRitem->Geo->DrawArgs["quad"].StartIndexLocation;
-				grassRitem->BaseVertexLocation = grassRitem->Geo->DrawArgs["quad"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(grassRitem));
-
-				auto grassRitem2 = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&grassRitem2->World, XMMatrixScaling(1.0, 1.0, 1.0) * XMMatrixRotationY(-0.785398) * XMMatrixTranslation(x -1, p.GetHeight(x, z) + 0.25 , z -1 ));
-				//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				grassRitem2->ObjCBIndex = i;
-				i++;
-				grassRitem2->Mat = mMaterials["longGrassMat"].get();
-				grassRitem2->Geo = mGeometries["quadGeo"].get();
-				grassRitem2->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				grassRitem2->IndexCount = grassRitem2->Geo->DrawArgs["quad"].IndexCount;
-				grassRitem2->StartIndexLocation = grassRitem2->Geo->DrawArgs["quad"].StartIndexLocation;
-				grassRitem2->BaseVertexLocation = grassRitem2->Geo->DrawArgs["quad"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(grassRitem2));
-			}
+void CrateApp::MeshWorld()
+{
+	if (mOptions.NoMeshCache)
+	{
+		mChunkMeshes = ChunkMesher::BuildAll(*mWorld);
+		return;
+	}
 
-			else if ((RandomNum(1, 200, 1) > 199) && p.GetHeight(x, z) > -2) // if no flower, or grass was created, have a 0.5% chance of creating a tree
-			{
-				for (int treeH = 0; treeH < 5; treeH++) //create the tree trunk
-				{
-					auto trunkRitem = std::make_unique<RenderItem>();
-					XMStoreFloat4x4(&trunkRitem->World, XMMatrixScaling(1.0, 1.0, 1.0)* XMMatrixTranslation(x , p.GetHeight(x, z) + 1 + treeH, z));
-					//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-					trunkRitem->ObjCBIndex = i;
-					i++;
-					trunkRitem->Mat = mMaterials["woodMat"].get();
-					trunkRitem->Geo = mGeometries["boxGeo"].get();
-					trunkRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-					trunkRitem->IndexCount = trunkRitem->Geo->DrawArgs["box"].IndexCount;
-					trunkRitem->StartIndexLocation = trunkRitem->Geo->DrawArgs["box"].StartIndexLocation;
-					trunkRitem->BaseVertexLocation = trunkRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-					mAllRitems.push_back(std::move(trunkRitem));
-				}
-
-				int maxHeight = 4; 
-				
-
-				for (int treeH = 0; treeH < maxHeight; treeH++) //nested for loops to create the leaves of the trees around and above the top of the trunk
-				{
-					for (int treeW = -2; treeW < 3; treeW++)
-					{
-						for (int treeL = -2; treeL < 3; treeL++)
-						{
-							auto trunkRitem = std::make_unique<RenderItem>();
-							XMStoreFloat4x4(&trunkRitem->World, XMMatrixScaling(1.0, 1.0, 1.0)* XMMatrixTranslation(x + treeW, p.GetHeight(x, z) + 3 + treeH, z + treeL));
-							//XMStoreFloat4x4(&grassRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-							trunkRitem->ObjCBIndex = i;
-							i++;
-							trunkRitem->Mat = mMaterials["leafMat"].get();
-							trunkRitem->Geo = mGeometries["boxGeo"].get();
-							trunkRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-							trunkRitem->IndexCount = trunkRitem->Geo->DrawArgs["box"].IndexCount;
-							trunkRitem->StartIndexLocation = trunkRitem->Geo->DrawArgs["box"].StartIndexLocation;
-							trunkRitem->BaseVertexLocation = trunkRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-							mAllRitems.push_back(std::move(trunkRitem));	
-						}
-					}	
-				}
-			}
+	mMeshCache = std::make_unique<ChunkMeshCache>("MeshCache");
+	mChunkMeshes = mMeshCache->BuildAll(*mWorld);
+	::OutputDebugStringA(("Startup: " + mMeshCache->Stats().ToString()).c_str());
+}
 
-			//DRAW DOWN//
-			for (int depth = 0; depth < 28; depth++) //after creating top block and/or foliage, start drawing down from the block to create depth layers 
-			{
-				///makes world hollow
-			//	if (((z == 0) || (z == Worldsize) || ((x == 0) || x == Worldsize)) || ((p.GetHeight(x, z) == WorldHeight[x][z] -1) || (p.GetHeight(x, z) == WorldHeight[x][z] - depth)))
-			//	{
-				auto boxRitem = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(1.0f, 1.0f, 1.0f)*XMMatrixTranslation(x, p.GetHeight(x, z) - depth, z));  //subtract the depth from the height of the block 
-				XMStoreFloat4x4(&boxRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-				boxRitem->ObjCBIndex = i;
-				i++;
-
-				if (depth <= 0 && p.GetHeight(x, z) == -2)
-				{
-					boxRitem->Mat = mMaterials["sandMat"].get();  //if the block is equal in height to the water or less, make it sand 
-
-				}
-				else if (depth <= 0)
-				{
-					boxRitem->Mat = mMaterials["sandMat"].get();
-
-				}
-				else if (depth>0 && depth <= 5)
-				{
-					boxRitem->Mat = mMaterials["dirtMat"].get(); // if block is below 0 depth and less than 5 depth make it dirt
-				}
-
-				else if (depth > 5 && depth <= 15) // else if block is deeper than 5 but not as deep as 15 decide what to make it: 
-				{
-					if (RandomNum(1, 100, 1) > 95)
-					{
-						boxRitem->Mat = mMaterials["coalMat"].get(); //5% chance of creating a coal block -- coal is more common than iron above 15
-					}
-					else if (RandomNum(1, 100, 1) > 98)
-					{
-						boxRitem->Mat = mMaterials["ironMat"].get(); //2% chance of creating iron ore
-					}
-					else
-					{
-						boxRitem->Mat = mMaterials["stoneMat"].get(); // if no ores selected, just draw stone 
-					}
-				}
-
-				else if (depth > 15  && depth < 25) //else if the block is deeper than 15 but not as deep as 25
-				{
-					if (RandomNum(1, 200, 1) > 199)
-					{
-						boxRitem->Mat = mMaterials["diamondMat"].get(); //0.5% chance of diamond
-					}
-					else if (RandomNum(1, 100, 1) > 99)
-					{
-						boxRitem->Mat = mMaterials["redsMat"].get(); //1% chance of red stone 
-					}
-
-					else if (RandomNum(1, 100, 1) > 98)
-					{
-						boxRitem->Mat = mMaterials["coalMat"].get(); // 2% chance of coal
-					}
-					else if (RandomNum(1, 100, 1) > 95)
-					{
-						boxRitem->Mat = mMaterials["ironMat"].get(); // 5% chance of iron ore -- iron ore is more common than coal below 15
-					}
-					else
-					{
-						boxRitem->Mat = mMaterials["stoneMat"].get(); // draw stone if no ore is created
-					}
-				}
-				else
-				{
-					boxRitem->Mat = mMaterials["bedrockMat"].get(); // else if none of the above are true, create bedrock
-				}
-
-				boxRitem->Geo = mGeometries["boxGeo"].get();
-				boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
-				boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
-				boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(boxRitem));
-				//	}
-			}
-		}
-	}
+void CrateApp::BuildChunkRenderItems(const ChunkMesh& mesh)
+{
+	static_assert(sizeof(ChunkVertex) == sizeof(Vertex), "ChunkVertex must match Vertex");
+
+	const UINT vbByteSize = (UINT)mesh.Vertices.size() * sizeof(Vertex);
+	const UINT ibByteSize = (UINT)mesh.Indices.size() * sizeof(std::uint32_t);
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = "chunk" + std::to_string(mesh.ChunkX) + "_" + std::to_string(mesh.ChunkY) + "_" + std::to_string(mesh.ChunkZ);
+
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), mesh.Vertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), mesh.Indices.data(), ibByteSize);
+
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), mesh.Vertices.data(), vbByteSize,
+		geo->VertexBufferOffset, geo->VertexBufferUploader, geo->VertexUploaderOffset);
+
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), mesh.Indices.data(), ibByteSize,
+		geo->IndexBufferOffset, geo->IndexBufferUploader, geo->IndexUploaderOffset);
+
+	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexBufferByteSize = vbByteSize;
+	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+	geo->IndexBufferByteSize = ibByteSize;
 
-	for (int waterz = 0; waterz <= Worldsize; waterz++) //DRAW WATER
+	for (const ChunkSubmesh& submesh : mesh.Submeshes)
 	{
-		for (int waterx = 0; waterx <= Worldsize; waterx++)
+		SubmeshGeometry args;
+		args.IndexCount = submesh.IndexCount;
+		args.StartIndexLocation = submesh.StartIndex;
+		args.BaseVertexLocation = submesh.BaseVertex;
+		geo->DrawArgs[GetBlockName(submesh.Block)] = args;
+
+		auto ritem = std::make_unique<RenderItem>();
+		XMStoreFloat4x4(&ritem->World, XMMatrixTranslation(mesh.Origin[0], mesh.Origin[1], mesh.Origin[2]));
+		ritem->ObjCBIndex = mChunkObjCBBase + mesh.ChunkX + mWorld->ChunksX() * (mesh.ChunkZ + mWorld->ChunksZ() * mesh.ChunkY);
+		ritem->Mat = mBlockMaterials[(int)submesh.Block];
+		ritem->Geo = geo.get();
+		ritem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		ritem->IndexCount = args.IndexCount;
+		ritem->StartIndexLocation = args.StartIndexLocation;
+		ritem->BaseVertexLocation = args.BaseVertexLocation;
+		ritem->BoundsCenter = XMFLOAT3(mesh.Origin[0] + 0.5f * ChunkSize, mesh.Origin[1] + 0.5f * ChunkSize, mesh.Origin[2] + 0.5f * ChunkSize);
+		ritem->BoundsRadius = 0.8660254f * ChunkSize;
+
+		switch (GetBlockLayer(submesh.Block))
 		{
-			for (int watery = -2; watery >= -10; watery--) //draw water at a set level if -2 and down
-			{
-				auto Water = std::make_unique<RenderItem>();
-				XMStoreFloat4x4(&Water->World, XMMatrixScaling(1.0f, 1.0f, 1.0f)*XMMatrixTranslation(waterx, watery, waterz));
-				XMStoreFloat4x4(&Water->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-
-				Water->ObjCBIndex = i;
-				i++;
-				Water->Mat = mMaterials["waterMat"].get();
-				Water->Geo = mGeometries["boxGeo"].get();
-				Water->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-				Water->IndexCount = Water->Geo->DrawArgs["box"].IndexCount;
-				Water->StartIndexLocation = Water->Geo->DrawArgs["box"].StartIndexLocation;
-				Water->BaseVertexLocation = Water->Geo->DrawArgs["box"].BaseVertexLocation;
-				mAllRitems.push_back(std::move(Water));
-			}
+		case BlockLayer::AlphaTested:
+			mRitemLayer[(int)RenderLayer::AlphaTested].push_back(ritem.get());
+			break;
+		case BlockLayer::Transparent:
+			mRitemLayer[(int)RenderLayer::Transparent].push_back(ritem.get());
+			break;
+		default:
+			mRitemLayer[(int)RenderLayer::Opaque].push_back(ritem.get());
+			break;
 		}
+		mAllRitems.push_back(std::move(ritem));
 	}
 
+	mGeometries[geo->Name] = std::move(geo);
+}
 
+void CrateApp::RemoveChunkRenderItems(const MeshGeometry* geo)
+{
+	for (auto& layer : mRitemLayer)
+		layer.erase(std::remove_if(layer.begin(), layer.end(), [geo](RenderItem* r) { return r->Geo == geo; }), layer.end());
 
-	
-	for (auto& e : mAllRitems)
-	{	//if the render item material, is equal to one that is alpha tested...
-		if (e.get()->Mat == mMaterials["longGrassMat"].get() || e.get()->Mat == mMaterials["leafMat"].get() || e.get()->Mat == mMaterials["flowerYMat"].get() || e.get()->Mat == mMaterials["flowerRMat"].get() || e.get()->Mat == mMaterials["sugarMat"].get())
+	mAllRitems.erase(std::remove_if(mAllRitems.begin(), mAllRitems.end(),
+		[geo](const std::unique_ptr<RenderItem>& r) { return r->Geo == geo; }), mAllRitems.end());
+}
+
+void CrateApp::RemeshDirtyChunks()
+{
+	if (mSnapshot->Edits.empty() && mSnapshot->DirtyChunks.empty())
+		return;
+
+	PROFILE_ZONE("RemeshDirtyChunks");
+
+	for (const BlockEdit& e : mSnapshot->Edits)
+		mRenderWorld->GetChunk(e.ChunkX, e.ChunkY, e.ChunkZ).Blocks[e.Index] = e.New;
+
+	// Frames in flight may still draw from the old ranges, and this frame's copies read
+	// the new upload ranges; both are freed once this frame's fence has passed.
+	UINT64 fence = mCurrentFence + 1;
+	auto retire = [this, fence](const ComPtr<ID3D12Resource>& buffer, UINT64 offset)
+	{
+		RetiredRange r;
+		r.Buffer = buffer;
+		r.Offset = offset;
+		r.Fence = fence;
+		mRetiredRanges.push_back(r);
+	};
+
+	for (const ChunkCoord& c : mSnapshot->DirtyChunks)
+	{
+		ChunkMesh mesh;
+		mRenderMesher.Build(*mRenderWorld, c.X, c.Y, c.Z, mesh);
+
+		std::string name = "chunk" + std::to_string(c.X) + "_" + std::to_string(c.Y) + "_" + std::to_string(c.Z);
+		auto old = mGeometries.find(name);
+		if (old != mGeometries.end())
 		{
-			mRitemLayer[(int)RenderLayer::AlphaTested].push_back(e.get()); //...pass it to the alpha tested render layer
+			RemoveChunkRenderItems(old->second.get());
+			retire(old->second->VertexBufferGPU, old->second->VertexBufferOffset);
+			retire(old->second->IndexBufferGPU, old->second->IndexBufferOffset);
+			mGeometries.erase(old);
 		}
-		else if(e.get()->Mat == mMaterials["waterMat"].get()) // if the render item's material is transparent...
+
+		if (mesh.Empty())
+			continue;
+
+		// UpdateObjectCBs has already run for this frame.
+		std::size_t firstNew = mAllRitems.size();
+		BuildChunkRenderItems(mesh);
+		for (std::size_t i = firstNew; i < mAllRitems.size(); ++i)
+			UpdateObjectCB(*mAllRitems[i]);
+
+		MeshGeometry* geo = mGeometries[name].get();
+		retire(geo->VertexBufferUploader, geo->VertexUploaderOffset);
+		retire(geo->IndexBufferUploader, geo->IndexUploaderOffset);
+		geo->DisposeUploaders();
+		geo->TrackCpuMemory();
+	}
+	mGpuHeaps->FinishCopies(mCommandList.Get());
+	mRitemMemory.Reset(MemoryDomain::Cpu, MemoryCategory::RenderItems, mAllRitems.size() * sizeof(RenderItem));
+}
+
+void CrateApp::ReleaseChunkRanges(UINT64 completedFence)
+{
+	for (std::size_t i = 0; i < mRetiredRanges.size();)
+	{
+		if (mRetiredRanges[i].Fence <= completedFence)
 		{
-			mRitemLayer[(int)RenderLayer::Transparent].push_back(e.get());  //...pass it to the transparent render layer
-			
+			mGpuHeaps->Free(mRetiredRanges[i].Buffer.Get(), mRetiredRanges[i].Offset);
+			mRetiredRanges[i] = mRetiredRanges.back();
+			mRetiredRanges.pop_back();
 		}
-		else //else pass all other items to the opaque render layer
+		else
 		{
-			mRitemLayer[(int)RenderLayer::Opaque].push_back(e.get());
+			++i;
 		}
 	}
 }
 
-
-double CrateApp::RandomNum(int range_min, int range_max, int n)  //COPIED FROM MSDN// - Then modified - //Origional Link https://msdn.microsoft.com/en-us/library/398ax69y.aspx //
-{
-	// Generate random numbers in the half-closed interval  
-	// [range_min, range_max). In other words,  
-	// range_min <= random number < range_max  
-	
-
-	//removed for loop because we only want one value
-		double u = (double)rand() / (RAND_MAX + 1) * (range_max - range_min)
-			+ range_min;
-		return(u);  //modified this line to return a value rather than print it.
-}
-
 void CrateApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
+	PROFILE_ZONE("DrawRenderItems");
+
 	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 	UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
 
@@ -1935,12 +2173,22 @@ void CrateApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 		
 			auto ri = ritems[i];
 
+			// Chunks behind the camera or off to the side are skipped.
+			if (ri->BoundsRadius > 0.0f &&
+				mCamFrustum.Contains(BoundingSphere(ri->BoundsCenter, ri->BoundsRadius)) == DISJOINT)
+			{
+				RENDER_STAT_CULLED(1);
+				continue;
+			}
+
 			cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
 			cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
 			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+			RENDER_STAT_STATE(VertexBuffer);
+			RENDER_STAT_STATE(IndexBuffer);
+			RENDER_STAT_STATE(Topology);
 
-			CD3DX12_GPU_DESCRIPTOR_HANDLE tex(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-			tex.Offset(ri->Mat->DiffuseSrvHeapIndex, mCbvSrvDescriptorSize);
+			CD3DX12_GPU_DESCRIPTOR_HANDLE tex = mSrvHeap->GpuHandle(ri->Mat->DiffuseSrvHeapIndex);
 
 			D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex*objCBByteSize;
 			D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex*matCBByteSize;
@@ -1948,13 +2196,46 @@ void CrateApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::ve
 			cmdList->SetGraphicsRootDescriptorTable(0, tex);
 			cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
 			cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+			RENDER_STAT_STATE(DescriptorTable);
+			RENDER_STAT_STATE(RootCbv);
+			RENDER_STAT_STATE(RootCbv);
 
 			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			RENDER_STAT_DRAW(ri->IndexCount, 1);
 		
 		
 	}
 }
 
+void CrateApp::RequestTextureMips()
+{
+	PROFILE_ZONE("RequestTextureMips");
+
+	// One world unit at distance 1 spans half the viewport height times the y scale.
+	float pixelsPerUnit = 0.5f * mClientHeight * mSnapshot->Proj._22;
+	mTextureStreamer->BeginFrame(mFence->GetCompletedValue(), pixelsPerUnit);
+
+	// Past the end of the fog everything is fog colour, so the tails will do.
+	float fogEnd = mMainPassCB.gFogStart + mMainPassCB.gFogRange;
+	XMVECTOR eye = XMLoadFloat3(&mSnapshot->EyePosW);
+	for (const auto& ri : mAllRitems)
+	{
+		int stream = (ri->Mat->MatCBIndex < (int)mMaterialStreams.size()) ? mMaterialStreams[ri->Mat->MatCBIndex] : -1;
+		if (stream < 0)
+			continue;
+
+		float distance = 0.0f;
+		if (ri->BoundsRadius > 0.0f)
+		{
+			distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&ri->BoundsCenter) - eye)) - ri->BoundsRadius;
+			distance = (std::max)(distance, 0.0f);
+			if (distance >= fogEnd)
+				continue;
+		}
+		mTextureStreamer->Request(stream, distance);
+	}
+}
+
 std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> CrateApp::GetStaticSamplers()
 {
 	// Applications usually only need a handful of samplers.  So just define them all up front
@@ -2046,11 +2327,13 @@ void CrateApp::BuildSkyGeometry()
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), vertices.data(), vbByteSize,
+		geo->VertexBufferOffset, geo->VertexBufferUploader, geo->VertexUploaderOffset);
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(mGpuHeaps.get(),
+		mCommandList.Get(), indices.data(), ibByteSize,
+		geo->IndexBufferOffset, geo->IndexBufferUploader, geo->IndexUploaderOffset);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
@@ -2062,8 +2345,29 @@ void CrateApp::BuildSkyGeometry()
 	mGeometries["skyBoxGeo"] = std::move(geo);
 }
 
+void CrateApp::BuildCharacter()
+{
+	// Created once with object index 0; UpdateChar only moves it.
+	auto character = std::make_unique<RenderItem>();
+	character->World = mCharacterWorld;
+	XMStoreFloat4x4(&character->TexTransform, XMMatrixScaling(1.0f, 2.0f, 1.0f));
+
+	character->ObjCBIndex = 0;
+	character->Mat = mMaterials["stoneMat"].get();
+	character->Geo = mGeometries["boxGeo"].get();
+	character->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	character->IndexCount = character->Geo->DrawArgs["box"].IndexCount;
+	character->StartIndexLocation = character->Geo->DrawArgs["box"].StartIndexLocation;
+	character->BaseVertexLocation = character->Geo->DrawArgs["box"].BaseVertexLocation;
+
+	mCharacterRitem = character.get();
+	mAllRitems.push_back(std::move(character));
+}
+
 void CrateApp::UpdateChar(float x, float y, float z , float Xs, float Ys, float Zs, float angle)
 {
+	PROFILE_ZONE("UpdateChar");
+
 	
 	charRotation = angle;
 
@@ -2072,10 +2376,7 @@ void CrateApp::UpdateChar(float x, float y, float z , float Xs, float Ys, float
 	//charZ += Zs; 
 
 
-	int X = charX;
-	//int Y = charY;
-	int Z = charZ;
-	float Y = (WorldHeight[X][Z]); //COLLISION//  set the character height equal to  the charX and charZ values in the World height array (Make the charater the same height as the block he is equal to on the X and Z axis)
+	float Y = SurfaceHeightAt(charX, charZ); //COLLISION//  set the character height equal to the surface block under charX and charZ (Make the charater the same height as the block he is equal to on the X and Z axis)
 	charY = Y; 
 
 	//XMStoreFloat4x4(&character->World, XMMatrixRotationY(30.0f));
@@ -2100,41 +2401,10 @@ void CrateApp::UpdateChar(float x, float y, float z , float Xs, float Ys, float
 	);*/
 
 	// SRT  //Scale, rotate, translate//
-	auto character = std::make_unique<RenderItem>();
 	CharPos = XMVectorSet(charX, Y, charZ , 1.0f); 
 	
 	XMMATRIX Local = (XMMatrixScaling(1.0f, 2.0f, 1.0f)*XMMatrixRotationRollPitchYaw(0.0f, 0.0f, 0.0f)*XMMatrixTranslation(charX, Y + 1.5, charZ)); //set the position = to the charX, Y, charZ
-	XMStoreFloat4x4(&character->World, Local);
-	//XMVECTOR *outScale = &V0; 
-	//XMVECTOR *outRotQuat = &V0;
-	//XMVECTOR *outTrans = &V0;
-
-	//XMMatrixDecompose(
-	//	outScale,
-	//	outRotQuat,
-	//	outTrans,
-	//	Local
-	//);
-
-	//CharPos = *outTrans;
-	
-	//float tempX = XMVectorGetX(V0);
-	//float tempY = XMVectorGetY(V0);
-	//float tempZ = XMVectorGetZ(V0);
-
-	XMStoreFloat4x4(&character->TexTransform, XMMatrixScaling(1.0f, 2.0f, 1.0f));
-	//XMMATRIX R = XMMatrixRotationY();
-	//XMStoreFloat3(&Look, XMVector3TransformNormal(XMLoadFloat3(&Look), R));
-
-	character->ObjCBIndex = 0;
-	character->Mat = mMaterials["stoneMat"].get();
-	character->Geo = mGeometries["boxGeo"].get();
-	character->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	character->IndexCount = character->Geo->DrawArgs["box"].IndexCount;
-	character->StartIndexLocation = character->Geo->DrawArgs["box"].StartIndexLocation;
-	character->BaseVertexLocation = character->Geo->DrawArgs["box"].BaseVertexLocation;
-
-	mAllRitems.push_back(std::move(character));
+	XMStoreFloat4x4(&mCharacterWorld, Local); //picked up by the render thread through the world snapshot
 
 	if (cam3 == true )
 	{
@@ -2163,8 +2433,6 @@ void CrateApp::UpdateChar(float x, float y, float z , float Xs, float Ys, float
 		freeCam.FP(true);
 		int tx = (int)XMVectorGetIntX(freeCam.GetPosition());
 		int tz = (int)XMVectorGetIntZ(freeCam.GetPosition());
-		
-		int  ty = WorldHeight[X][Z];
 
 		freeCam.ClampHeight = Y + 2; 
 	}
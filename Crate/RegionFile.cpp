@@ -0,0 +1,197 @@
+#include "RegionFile.h"
+#include "Common/FileUtil.h"
+#include "Common/Hash.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char RegionMagic[4] = { 'C', 'R', 'R', 'G' };
+}
+
+bool RegionFile::Open(const std::string& path)
+{
+	Close();
+	mPath = path;
+
+	// A compaction interrupted between removing the old file and renaming the new one,
+	// which builds that did not replace the file in one step could leave behind.
+	std::string temp = path + ".tmp";
+	if (!FileUtil::FileExists(path) && FileUtil::FileExists(temp))
+		FileUtil::RenameOver(temp, path);
+
+	if (!FileUtil::FileExists(path))
+		return Create();
+
+	mFile.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!mFile || !Load())
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void RegionFile::Close()
+{
+	if (mFile.is_open())
+		mFile.close();
+	mFile.clear();
+	mTable.clear();
+	mFileBytes = 0;
+	mRecordBytes = 0;
+}
+
+bool RegionFile::Create()
+{
+	Header header = {};
+	std::memcpy(header.Magic, RegionMagic, sizeof(RegionMagic));
+	header.Version = Version;
+	header.Slots = Slots;
+	mTable.assign(Slots, TableEntry());
+
+	{
+		std::ofstream fout(mPath.c_str(), std::ios::binary | std::ios::trunc);
+		fout.write((const char*)&header, sizeof(header));
+		fout.write((const char*)mTable.data(), mTable.size() * sizeof(TableEntry));
+		if (!fout)
+			return false;
+	}
+
+	mFile.open(mPath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+	mFileBytes = RecordsOffset;
+	mRecordBytes = 0;
+	return (bool)mFile;
+}
+
+bool RegionFile::Load()
+{
+	Header header;
+	mTable.assign(Slots, TableEntry());
+	mFile.seekg(0, std::ios::end);
+	mFileBytes = (std::uint64_t)mFile.tellg();
+	mFile.seekg(0);
+	if (!mFile.read((char*)&header, sizeof(header)) ||
+		std::memcmp(header.Magic, RegionMagic, sizeof(RegionMagic)) != 0 ||
+		header.Version != Version || header.Slots != Slots ||
+		!mFile.read((char*)mTable.data(), mTable.size() * sizeof(TableEntry)))
+	{
+		return false;
+	}
+
+	mRecordBytes = 0;
+	for (const TableEntry& e : mTable)
+	{
+		if (e.Offset != 0 && (e.Offset < RecordsOffset || (std::uint64_t)e.Offset + e.Size > mFileBytes))
+			return false;
+		mRecordBytes += e.Size;
+	}
+	return true;
+}
+
+bool RegionFile::Read(int slot, std::vector<std::uint8_t>& record)
+{
+	const TableEntry& e = mTable[slot];
+	if (e.Offset == 0)
+		return false;
+
+	record.resize(e.Size);
+	mFile.clear();
+	mFile.seekg(e.Offset);
+	if (!mFile.read((char*)record.data(), e.Size))
+	{
+		mFile.clear();
+		return false;
+	}
+	return Hash::Fnv1a(record.data(), record.size()) == e.Hash;
+}
+
+bool RegionFile::Write(int slot, const std::uint8_t* record, std::size_t size)
+{
+	if (mFileBytes + size > 0xffffffffull)
+		return false;
+
+	TableEntry entry;
+	entry.Offset = (std::uint32_t)mFileBytes;
+	entry.Size = (std::uint32_t)size;
+	entry.Hash = Hash::Fnv1a(record, size);
+
+	// Record first, then the table entry that points at it.
+	mFile.clear();
+	mFile.seekp(mFileBytes);
+	mFile.write((const char*)record, size);
+	mFile.flush();
+	if (!mFile)
+	{
+		mFile.clear();
+		return false;
+	}
+	mFileBytes += size;
+
+	mFile.seekp(TableOffset + slot * sizeof(TableEntry));
+	mFile.write((const char*)&entry, sizeof(entry));
+	mFile.flush();
+	if (!mFile)
+	{
+		mFile.clear();
+		return false;
+	}
+
+	mRecordBytes += size;
+	mRecordBytes -= mTable[slot].Size;
+	mTable[slot] = entry;
+	return true;
+}
+
+std::uint64_t RegionFile::LiveBytes()const
+{
+	return RecordsOffset + mRecordBytes;
+}
+
+bool RegionFile::WantsCompaction()const
+{
+	std::uint64_t garbage = mFileBytes - LiveBytes();
+	return garbage >= MinGarbageBytes && garbage * 2 > mFileBytes;
+}
+
+bool RegionFile::Compact()
+{
+	std::vector<TableEntry> table(Slots, TableEntry());
+	std::vector<std::uint8_t> records;
+	std::vector<std::uint8_t> record;
+	for (int slot = 0; slot < Slots; ++slot)
+	{
+		if (mTable[slot].Offset == 0)
+			continue;
+		if (!Read(slot, record))
+			return false;
+
+		table[slot] = mTable[slot];
+		table[slot].Offset = (std::uint32_t)(RecordsOffset + records.size());
+		records.insert(records.end(), record.begin(), record.end());
+	}
+
+	Header header = {};
+	std::memcpy(header.Magic, RegionMagic, sizeof(RegionMagic));
+	header.Version = Version;
+	header.Slots = Slots;
+
+	std::string temp = mPath + ".tmp";
+	{
+		std::ofstream fout(temp.c_str(), std::ios::binary | std::ios::trunc);
+		fout.write((const char*)&header, sizeof(header));
+		fout.write((const char*)table.data(), table.size() * sizeof(TableEntry));
+		fout.write((const char*)records.data(), records.size());
+		if (!fout)
+		{
+			fout.close();
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+
+	std::string path = mPath;
+	mFile.close();
+	bool replaced = FileUtil::RenameOver(temp, path);
+	return Open(path) && replaced;
+}
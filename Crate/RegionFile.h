@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// One file holding the saved chunks of a Size x Size x Size cube of chunk positions,
+// behind an offset table so any chunk can be read or written without touching the
+// others:
+//
+//   header   "CRRG", Version, Slots
+//   table    per slot: offset of its record (0 if none), size, FNV-1a hash of the record
+//   records  one per write, in the order they were written
+//
+// A write appends the new record and only then points the table at it, so a write
+// cut short leaves the previous record in use.  Records replaced by later writes are
+// garbage until Compact copies the live ones into a new file and swaps it in.
+//
+// Not thread safe; WorldSave serializes access.
+class RegionFile
+{
+public:
+	static const int Size = 8;
+	static const int Slots = Size * Size * Size;
+	static const std::uint32_t Version = 1;
+
+	// Compaction waits until garbage is at least this and more than half the file.
+	static const std::uint64_t MinGarbageBytes = 64 * 1024;
+
+	RegionFile() = default;
+	RegionFile(const RegionFile& rhs) = delete;
+	RegionFile& operator=(const RegionFile& rhs) = delete;
+
+	// Opens the file, creating an empty region if there is none.  Returns false if the
+	// file exists but is not a region file of this version.
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen()const { return mFile.is_open(); }
+
+	// Slot of a chunk from its position within the region, 0 to Size - 1 on each axis.
+	static int Slot(int x, int y, int z) { return x + Size * (z + Size * y); }
+
+	bool Has(int slot)const { return mTable[slot].Offset != 0; }
+
+	// Returns false if the slot is empty or its record does not match its hash.
+	bool Read(int slot, std::vector<std::uint8_t>& record);
+	bool Write(int slot, const std::uint8_t* record, std::size_t size);
+
+	std::uint64_t FileBytes()const { return mFileBytes; }
+	std::uint64_t LiveBytes()const;
+	bool WantsCompaction()const;
+
+	// Rewrites the file with only the live records.  On failure the old file stays.
+	bool Compact();
+
+private:
+	struct Header
+	{
+		char Magic[4];
+		std::uint32_t Version;
+		std::uint32_t Slots;
+		std::uint32_t Reserved;
+	};
+
+	struct TableEntry
+	{
+		std::uint32_t Offset;
+		std::uint32_t Size;
+		std::uint64_t Hash;
+	};
+
+	static const std::uint64_t TableOffset = sizeof(Header);
+	static const std::uint64_t RecordsOffset = sizeof(Header) + Slots * sizeof(TableEntry);
+
+	bool Create();
+	bool Load();
+
+private:
+	std::string mPath;
+	std::fstream mFile;
+	std::vector<TableEntry> mTable;
+	std::uint64_t mFileBytes = 0;
+	std::uint64_t mRecordBytes = 0;   // sum of the live records
+};
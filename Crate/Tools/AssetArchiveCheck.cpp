@@ -0,0 +1,237 @@
+//***************************************************************************************
+// AssetArchiveCheck.cpp
+//
+// Headless checks of AssetArchive and AssetArchiveWriter with raw entries:
+//
+//   roundtrip  random entries, one of them empty, are saved, opened and found by name
+//              with their bytes intact and their payloads aligned; a missing name is
+//              not found and a duplicate name fails to serialize
+//   truncated  the archive cut short at every length is refused, in memory and on disk
+//   header     a wrong magic, a wrong version and a names table past the end of the
+//              file are refused
+//   entries    an entry whose payload, name or subresources run out of range, an index
+//              out of hash order and a texture entry without subresources are refused
+//
+// Every damaged copy is checked against the undamaged archive loading, so a refusal is
+// down to the damage.  Textures need DDSLayout; AssetPacker --verify covers those.
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: AssetArchiveCheck [--entries N] [--seed N] [--dir path]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/AssetArchiveCheck.cpp Common/AssetArchive.cpp
+//       Common/MappedFile.cpp -o AssetArchiveCheck
+//***************************************************************************************
+
+#include "../Common/AssetArchive.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace
+{
+	struct SourceEntry
+	{
+		std::string Name;
+		std::vector<std::uint8_t> Bytes;
+	};
+
+	std::vector<SourceEntry> MakeEntries(int count, std::mt19937& rng)
+	{
+		std::vector<SourceEntry> entries(count);
+		for (int i = 0; i < count; ++i)
+		{
+			entries[i].Name = "Textures/entry" + std::to_string(i) + ".bin";
+			entries[i].Bytes.resize(i == 0 ? 0 : rng() % 5000);
+			for (std::uint8_t& b : entries[i].Bytes)
+				b = (std::uint8_t)rng();
+		}
+		return entries;
+	}
+
+	bool WriteFile(const std::string& path, const std::uint8_t* data, std::size_t size)
+	{
+		std::ofstream fout(path.c_str(), std::ios::binary | std::ios::trunc);
+		return (bool)fout.write(reinterpret_cast<const char*>(data), size);
+	}
+
+	bool Loads(const std::vector<std::uint8_t>& data)
+	{
+		AssetArchive archive;
+		return archive.Load(data.data(), data.size());
+	}
+
+	bool MatchesSource(const AssetArchive& archive, const std::vector<SourceEntry>& entries)
+	{
+		bool ok = archive.EntryCount() == entries.size() && archive.Find("Textures/missing.bin") == nullptr;
+		for (const SourceEntry& source : entries)
+		{
+			const ArchiveEntry* entry = archive.Find(source.Name);
+			ok = ok && entry != nullptr && archive.Name(*entry) == source.Name &&
+				entry->Kind == ArchiveEntryKind::Raw && entry->PayloadSize == source.Bytes.size() &&
+				entry->PayloadOffset % AssetArchive::PlacementAlignment == 0 &&
+				(source.Bytes.empty() || std::memcmp(archive.Payload(*entry), source.Bytes.data(), source.Bytes.size()) == 0);
+		}
+		for (std::uint32_t i = 1; i < archive.EntryCount(); ++i)
+			ok = ok && archive.Entry(i - 1).NameHash <= archive.Entry(i).NameHash;
+		return ok;
+	}
+
+	bool CheckRoundTrip(const std::vector<SourceEntry>& entries, const std::string& path, std::vector<std::uint8_t>& data)
+	{
+		AssetArchiveWriter writer;
+		for (const SourceEntry& source : entries)
+			writer.AddRaw(source.Name, source.Bytes.data(), source.Bytes.size());
+		if (!writer.Save(path) || !writer.Serialize(data))
+			return false;
+
+		AssetArchive fromFile;
+		AssetArchive fromMemory;
+		bool ok = fromFile.Open(path) && MatchesSource(fromFile, entries) &&
+			fromMemory.Load(data.data(), data.size()) && MatchesSource(fromMemory, entries);
+
+		std::string error;
+		std::vector<std::uint8_t> duplicate;
+		writer.AddRaw(entries.back().Name, nullptr, 0);
+		return ok && !writer.Serialize(duplicate, &error) && !error.empty();
+	}
+
+	bool CheckTruncated(const std::vector<std::uint8_t>& data, const std::string& path)
+	{
+		bool ok = Loads(data);
+		for (std::size_t size = 0; size < data.size() && ok; ++size)
+		{
+			AssetArchive archive;
+			ok = !archive.Load(data.data(), size) && archive.EntryCount() == 0;
+		}
+
+		AssetArchive archive;
+		return ok && WriteFile(path, data.data(), data.size() / 2) && !archive.Open(path);
+	}
+
+	bool CheckHeader(const std::vector<std::uint8_t>& data)
+	{
+		ArchiveHeader header;
+		std::memcpy(&header, data.data(), sizeof(header));
+
+		std::vector<std::uint8_t> magic = data;
+		magic[0] ^= 0x20;
+
+		std::vector<std::uint8_t> version = data;
+		ArchiveHeader newer = header;
+		newer.Version = AssetArchive::Version + 1;
+		std::memcpy(version.data(), &newer, sizeof(newer));
+
+		std::vector<std::uint8_t> names = data;
+		ArchiveHeader pastEnd = header;
+		pastEnd.NamesOffset = data.size() - pastEnd.NamesSize + 1;
+		std::memcpy(names.data(), &pastEnd, sizeof(pastEnd));
+
+		return Loads(data) && !Loads(magic) && !Loads(version) && !Loads(names);
+	}
+
+	// A copy of the archive with one entry changed by edit.
+	template<typename Edit>
+	std::vector<std::uint8_t> WithEntry(const std::vector<std::uint8_t>& data, std::uint32_t index, Edit edit)
+	{
+		std::vector<std::uint8_t> copy = data;
+		std::uint8_t* p = copy.data() + sizeof(ArchiveHeader) + index * sizeof(ArchiveEntry);
+		ArchiveEntry entry;
+		std::memcpy(&entry, p, sizeof(entry));
+		edit(entry);
+		std::memcpy(p, &entry, sizeof(entry));
+		return copy;
+	}
+
+	bool CheckEntries(const std::vector<std::uint8_t>& data)
+	{
+		AssetArchive archive;
+		if (!archive.Load(data.data(), data.size()) || archive.EntryCount() < 2)
+			return false;
+
+		// The entry with the largest payload, so an offset one past its room is in the file.
+		std::uint32_t largest = 0;
+		for (std::uint32_t i = 1; i < archive.EntryCount(); ++i)
+		{
+			if (archive.Entry(i).PayloadSize > archive.Entry(largest).PayloadSize)
+				largest = i;
+		}
+		std::uint64_t size = data.size();
+		std::uint64_t nameHash = archive.Entry(1).NameHash;
+
+		bool ok = !Loads(WithEntry(data, largest, [size](ArchiveEntry& e) { e.PayloadOffset = size - e.PayloadSize + 1; }));
+		ok = ok && !Loads(WithEntry(data, largest, [](ArchiveEntry& e) { e.PayloadOffset = ~0ull - 8; }));
+		ok = ok && !Loads(WithEntry(data, largest, [](ArchiveEntry& e) { e.PayloadSize = ~0ull; }));
+		ok = ok && !Loads(WithEntry(data, 0, [](ArchiveEntry& e) { e.NameLength = ~0u; }));
+		ok = ok && !Loads(WithEntry(data, 0, [](ArchiveEntry& e) { e.NameOffset += e.NameLength + 1000000; }));
+		ok = ok && !Loads(WithEntry(data, 0, [](ArchiveEntry& e) { e.SubresourceCount = 1; }));
+		ok = ok && !Loads(WithEntry(data, 0, [nameHash](ArchiveEntry& e) { e.NameHash = nameHash + 1; }));
+		ok = ok && !Loads(WithEntry(data, largest, [](ArchiveEntry& e) { e.Kind = ArchiveEntryKind::Texture; }));
+
+		// An edit that keeps the entry valid still loads.
+		return ok && Loads(WithEntry(data, largest, [](ArchiveEntry& e) { e.PayloadSize -= 1; }));
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: AssetArchiveCheck [--entries N] [--seed N] [--dir path]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int count = 40;
+	std::uint32_t seed = 1;
+	std::string dir = ".";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--entries") == 0)
+			count = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--dir") == 0)
+			dir = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (count < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	std::vector<SourceEntry> entries = MakeEntries(count, rng);
+	std::string path = dir + "/AssetArchiveCheck.pak";
+
+	std::vector<std::uint8_t> data;
+	bool roundTripOk = CheckRoundTrip(entries, path, data);
+	bool truncatedOk = roundTripOk && CheckTruncated(data, path);
+	bool headerOk = roundTripOk && CheckHeader(data);
+	bool entriesOk = roundTripOk && CheckEntries(data);
+	std::remove(path.c_str());
+
+	bool verified = roundTripOk && truncatedOk && headerOk && entriesOk;
+
+	std::printf("{\n");
+	std::printf("  \"entries\": %d,\n", count);
+	std::printf("  \"archive_bytes\": %zu,\n", data.size());
+	std::printf("  \"roundtrip_ok\": %s,\n", roundTripOk ? "true" : "false");
+	std::printf("  \"truncated_ok\": %s,\n", truncatedOk ? "true" : "false");
+	std::printf("  \"header_ok\": %s,\n", headerOk ? "true" : "false");
+	std::printf("  \"entries_ok\": %s,\n", entriesOk ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
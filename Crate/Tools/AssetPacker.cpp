@@ -0,0 +1,276 @@
+//***************************************************************************************
+// AssetPacker.cpp
+//
+// Builds an AssetArchive from a manifest with one "name path" pair per line, the same
+// format as Textures/TextureManifest.txt.  Files ending in .dds are stored as textures
+// in the uploadable layout; anything else is stored as is.
+//
+// Usage: AssetPacker <manifest> <archive> [--mips] [--verify]
+//        AssetPacker --list <archive>
+//
+// Paths in the manifest are relative to the working directory, so run it from the
+// Crate directory:
+//   AssetPacker Textures/TextureManifest.txt Textures/Textures.pak --mips --verify
+//
+// --mips gives single-mip textures of four 8-bit channels a full mip chain, which the
+// texture streamer needs to have anything to stream.
+//
+// --verify reopens the written archive and checks every entry against its source file,
+// byte for byte for raw entries and row by row for textures.  The exit code is 1 if
+// anything failed.
+//
+// Build on Linux from the Crate directory, with a dxgiformat.h on the include path:
+//   g++ -std=c++14 -O2 -I. -I<dxgiformat.h dir> Tools/AssetPacker.cpp
+//       Common/AssetArchive.cpp Common/AssetArchiveTexture.cpp Common/DDSLayout.cpp
+//       Common/MappedFile.cpp -o AssetPacker
+//***************************************************************************************
+
+#include "../Common/AssetArchive.h"
+#include "../Common/DDSLayout.h"
+#include "../Common/MappedFile.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace
+{
+	struct ManifestEntry
+	{
+		std::string Name;
+		std::string Path;
+	};
+
+	bool LoadManifest(const std::string& path, std::vector<ManifestEntry>& entries)
+	{
+		std::ifstream fin(path.c_str());
+		if (!fin)
+			return false;
+
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			std::istringstream fields(line);
+			ManifestEntry entry;
+			if (!(fields >> entry.Name) || entry.Name[0] == '#' || !(fields >> entry.Path))
+				continue;
+			entries.push_back(entry);
+		}
+		return true;
+	}
+
+	bool IsTexture(const std::string& path)
+	{
+		if (path.size() < 4)
+			return false;
+
+		std::string extension = path.substr(path.size() - 4);
+		for (char& c : extension)
+			c = (char)std::tolower((unsigned char)c);
+		return extension == ".dds";
+	}
+
+	// Compares a texture entry row by row against the DDS it was built from.  Generated
+	// mips are only checked for their size.
+	bool VerifyTexture(const AssetArchive& archive, const ArchiveEntry& entry, const MappedFile& source)
+	{
+		DDSFile file;
+		DDSTextureDesc desc;
+		DDSLayout layout;
+		if (ParseDDSFile(source.Data(), source.Size(), file) != DDSStatus::Ok ||
+			GetDDSTextureDesc(file, desc) != DDSStatus::Ok ||
+			ComputeDDSLayout(desc, file.BitSize, 0, layout) != DDSStatus::Ok ||
+			(std::uint32_t)desc.Format != entry.Format)
+		{
+			return false;
+		}
+
+		const ArchiveSubresource* subresources = archive.Subresources(entry);
+		bool generated = entry.MipCount > layout.MipCount;
+		if (!generated && layout.Subresources.size() != entry.SubresourceCount)
+			return false;
+		if (generated)
+		{
+			if (layout.Subresources.size() != 1 || entry.SubresourceCount != entry.MipCount)
+				return false;
+			for (std::uint32_t m = 1; m < entry.MipCount; ++m)
+			{
+				if (subresources[m].Width != (std::max)(subresources[m - 1].Width / 2, 1u) ||
+					subresources[m].Height != (std::max)(subresources[m - 1].Height / 2, 1u))
+				{
+					return false;
+				}
+			}
+		}
+
+		const std::uint8_t* payload = archive.Payload(entry);
+		for (std::size_t s = 0; s < layout.Subresources.size(); ++s)
+		{
+			const DDSSubresource& src = layout.Subresources[s];
+			const ArchiveSubresource& dst = subresources[s];
+			if (dst.RowSize != src.RowPitch || dst.NumRows != src.NumRows || dst.Depth != src.Depth)
+				return false;
+
+			for (std::size_t z = 0; z < src.Depth; ++z)
+			{
+				for (std::size_t y = 0; y < src.NumRows; ++y)
+				{
+					const std::uint8_t* a = file.BitData + src.Offset + z * src.SlicePitch + y * src.RowPitch;
+					const std::uint8_t* b = payload + dst.Offset + (z * dst.NumRows + y) * dst.RowPitch;
+					if (std::memcmp(a, b, src.RowPitch) != 0)
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	int List(const std::string& archivePath)
+	{
+		AssetArchive archive;
+		if (!archive.Open(archivePath))
+		{
+			std::fprintf(stderr, "could not open %s\n", archivePath.c_str());
+			return 1;
+		}
+
+		for (std::uint32_t i = 0; i < archive.EntryCount(); ++i)
+		{
+			const ArchiveEntry& entry = archive.Entry(i);
+			if (entry.Kind == ArchiveEntryKind::Texture)
+			{
+				std::printf("%-20s texture %4ux%-4u format %3u mips %2u array %u  %9llu bytes at %llu\n",
+					archive.Name(entry).c_str(), entry.Width, entry.Height, entry.Format, entry.MipCount,
+					entry.ArraySize, (unsigned long long)entry.PayloadSize, (unsigned long long)entry.PayloadOffset);
+			}
+			else
+			{
+				std::printf("%-20s raw  %9llu bytes at %llu\n", archive.Name(entry).c_str(),
+					(unsigned long long)entry.PayloadSize, (unsigned long long)entry.PayloadOffset);
+			}
+		}
+		return 0;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: AssetPacker <manifest> <archive> [--mips] [--verify]\n"
+			"       AssetPacker --list <archive>\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 3 && std::strcmp(argv[1], "--list") == 0)
+		return List(argv[2]);
+
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	bool generateMips = false;
+	bool verify = false;
+	for (int i = 3; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--mips") == 0)
+			generateMips = true;
+		else if (std::strcmp(argv[i], "--verify") == 0)
+			verify = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	const std::string manifestPath = argv[1];
+	const std::string archivePath = argv[2];
+
+	std::vector<ManifestEntry> manifest;
+	if (!LoadManifest(manifestPath, manifest))
+	{
+		std::fprintf(stderr, "could not read %s\n", manifestPath.c_str());
+		return 1;
+	}
+
+	AssetArchiveWriter writer;
+	std::uint64_t looseBytes = 0;
+	for (const ManifestEntry& e : manifest)
+	{
+		MappedFile source;
+		if (!source.Open(e.Path))
+		{
+			std::fprintf(stderr, "could not open %s\n", e.Path.c_str());
+			return 1;
+		}
+		looseBytes += source.Size();
+
+		std::string error;
+		if (IsTexture(e.Path))
+		{
+			if (!writer.AddTexture(e.Name, source.Data(), source.Size(), generateMips, &error))
+			{
+				std::fprintf(stderr, "%s (%s)\n", error.c_str(), e.Path.c_str());
+				return 1;
+			}
+		}
+		else
+		{
+			writer.AddRaw(e.Name, source.Data(), source.Size());
+		}
+	}
+
+	std::string error;
+	if (!writer.Save(archivePath, &error))
+	{
+		std::fprintf(stderr, "%s\n", error.c_str());
+		return 1;
+	}
+
+	AssetArchive archive;
+	if (!archive.Open(archivePath))
+	{
+		std::fprintf(stderr, "%s was written but does not read back\n", archivePath.c_str());
+		return 1;
+	}
+
+	MappedFile written;
+	written.Open(archivePath);
+	std::printf("%s: %u entries, %.1f MB from %.1f MB of loose files\n", archivePath.c_str(), archive.EntryCount(),
+		written.Size() / (1024.0 * 1024.0), looseBytes / (1024.0 * 1024.0));
+
+	if (!verify)
+		return 0;
+
+	int failures = 0;
+	for (const ManifestEntry& e : manifest)
+	{
+		const ArchiveEntry* entry = archive.Find(e.Name);
+		MappedFile source;
+		bool ok = entry != nullptr && source.Open(e.Path);
+		if (ok && entry->Kind == ArchiveEntryKind::Texture)
+		{
+			ok = VerifyTexture(archive, *entry, source);
+		}
+		else if (ok)
+		{
+			ok = entry->PayloadSize == source.Size() &&
+				std::memcmp(archive.Payload(*entry), source.Data(), source.Size()) == 0;
+		}
+
+		if (!ok)
+		{
+			std::fprintf(stderr, "verify failed: %s (%s)\n", e.Name.c_str(), e.Path.c_str());
+			++failures;
+		}
+	}
+
+	std::printf("verified %u entries, %d failed\n", (unsigned)manifest.size(), failures);
+	return failures > 0 ? 1 : 0;
+}
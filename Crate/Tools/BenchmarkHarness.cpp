@@ -0,0 +1,169 @@
+#include "BenchmarkHarness.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+
+namespace Benchmark
+{
+	const void* volatile gSink = nullptr;
+}
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	double TimeMs(const Benchmark::Function& function, std::uint64_t iterations)
+	{
+		Clock::time_point start = Clock::now();
+		function(iterations);
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	double Median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		std::size_t n = values.size();
+		return (n % 2 == 1) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+	}
+}
+
+void Benchmark::Runner::Add(const std::string& name, Function function)
+{
+	mBenchmarks.push_back(std::make_pair(name, function));
+}
+
+std::vector<Benchmark::Result> Benchmark::Runner::Run(std::ostream& log)const
+{
+	std::vector<Result> results;
+	for (auto& b : mBenchmarks)
+	{
+		if (!mOptions.Filter.empty() && b.first.find(mOptions.Filter) == std::string::npos)
+			continue;
+
+		Result r = Measure(b.first, b.second);
+		log << std::left << std::setw(36) << r.Name << std::right << std::fixed
+			<< std::setprecision(1) << std::setw(12) << r.MedianNs << " ns  +/- "
+			<< std::setprecision(1) << std::setw(4) << r.Spread * 100.0 << "%  ("
+			<< r.Repetitions << " x " << r.Iterations << ")\n";
+		log.flush();
+		results.push_back(r);
+	}
+	return results;
+}
+
+Benchmark::Result Benchmark::Runner::Measure(const std::string& name, const Function& function)const
+{
+	// Warm caches, branch predictors and the clock speed up, doubling the batch size so
+	// the warmup also gives a first estimate of the cost per iteration.
+	std::uint64_t iterations = 1;
+	double elapsedMs = 0.0;
+	double warmedMs = 0.0;
+	for (;;)
+	{
+		elapsedMs = TimeMs(function, iterations);
+		warmedMs += elapsedMs;
+		if (warmedMs >= mOptions.WarmupMs && elapsedMs >= mOptions.MinRepetitionMs * 0.1)
+			break;
+		iterations *= 2;
+	}
+
+	// Scale the batch so one repetition takes about MinRepetitionMs.
+	double perIterationMs = elapsedMs / iterations;
+	if (perIterationMs > 0.0)
+		iterations = (std::max)((std::uint64_t)1, (std::uint64_t)std::ceil(mOptions.MinRepetitionMs / perIterationMs));
+
+	std::vector<double> samples;
+	for (int i = 0; i < mOptions.Repetitions; ++i)
+		samples.push_back(TimeMs(function, iterations) * 1.0e6 / iterations);
+
+	Result r;
+	r.Name = name;
+	r.Iterations = iterations;
+	r.Repetitions = mOptions.Repetitions;
+	r.MedianNs = Median(samples);
+	r.MinNs = *std::min_element(samples.begin(), samples.end());
+	r.MaxNs = *std::max_element(samples.begin(), samples.end());
+
+	std::vector<double> deviations;
+	for (double s : samples)
+		deviations.push_back(std::fabs(s - r.MedianNs));
+	r.Spread = (r.MedianNs > 0.0) ? Median(deviations) / r.MedianNs : 0.0;
+	return r;
+}
+
+std::map<std::string, double> Benchmark::LoadBaseline(const std::string& path)
+{
+	std::map<std::string, double> baseline;
+	std::ifstream fin(path.c_str());
+	std::string line;
+	while (std::getline(fin, line))
+	{
+		std::string::size_type tab = line.rfind('\t');
+		if (tab == std::string::npos || line.empty() || line[0] == '#')
+			continue;
+
+		double ns = std::strtod(line.c_str() + tab + 1, nullptr);
+		if (ns > 0.0)
+			baseline[line.substr(0, tab)] = ns;
+	}
+	return baseline;
+}
+
+bool Benchmark::SaveBaseline(const std::string& path, const std::vector<Result>& results)
+{
+	std::ofstream fout(path.c_str(), std::ios::trunc);
+	if (!fout)
+		return false;
+
+	fout << "# median ns per iteration\n" << std::fixed << std::setprecision(3);
+	for (const Result& r : results)
+		fout << r.Name << '\t' << r.MedianNs << '\n';
+	return (bool)fout;
+}
+
+std::vector<Benchmark::Comparison> Benchmark::Compare(const std::vector<Result>& results,
+	const std::map<std::string, double>& baseline, double threshold)
+{
+	std::vector<Comparison> comparisons;
+	for (const Result& r : results)
+	{
+		auto it = baseline.find(r.Name);
+		if (it == baseline.end())
+			continue;
+
+		Comparison c;
+		c.Name = r.Name;
+		c.BaselineNs = it->second;
+		c.CurrentNs = r.MedianNs;
+		c.Change = (c.CurrentNs - c.BaselineNs) / c.BaselineNs;
+		c.Regressed = c.Change > threshold;
+		comparisons.push_back(c);
+	}
+	return comparisons;
+}
+
+void Benchmark::WriteJson(std::ostream& out, const std::vector<Result>& results,
+	const std::vector<Comparison>& comparisons)
+{
+	out << std::fixed << std::setprecision(3) << "{\n  \"results\": [";
+	for (std::size_t i = 0; i < results.size(); ++i)
+	{
+		const Result& r = results[i];
+		out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << r.Name << "\", \"median_ns\": " << r.MedianNs
+			<< ", \"min_ns\": " << r.MinNs << ", \"max_ns\": " << r.MaxNs << ", \"spread\": " << r.Spread
+			<< ", \"repetitions\": " << r.Repetitions << ", \"iterations\": " << r.Iterations << " }";
+	}
+
+	out << "\n  ],\n  \"comparisons\": [";
+	for (std::size_t i = 0; i < comparisons.size(); ++i)
+	{
+		const Comparison& c = comparisons[i];
+		out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << c.Name << "\", \"baseline_ns\": " << c.BaselineNs
+			<< ", \"current_ns\": " << c.CurrentNs << ", \"change\": " << c.Change
+			<< ", \"regressed\": " << (c.Regressed ? "true" : "false") << " }";
+	}
+	out << "\n  ]\n}\n";
+}
@@ -0,0 +1,107 @@
+//***************************************************************************************
+// BenchmarkHarness.h
+//
+// Minimal microbenchmark runner.  Each benchmark is a function that runs its operation
+// a given number of times.  The runner warms it up, picks an iteration count so one
+// repetition takes at least MinRepetitionMs, then times Repetitions repetitions and
+// reports the median time per iteration together with its spread, so a single noisy
+// repetition does not move the result.
+//
+// Results can be saved as a baseline ("name<TAB>median ns" per line) and later runs
+// compared against it; a benchmark whose median grew by more than the threshold counts
+// as a regression.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Benchmark
+{
+	// Keeps the compiler from discarding a result that is otherwise unused.
+	template<typename T>
+	inline void DoNotOptimize(const T& value)
+	{
+#if defined(_MSC_VER)
+		extern const void* volatile gSink;
+		gSink = &value;
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+
+	// Runs the operation being measured `iterations` times.
+	typedef std::function<void(std::uint64_t iterations)> Function;
+
+	struct Options
+	{
+		double WarmupMs = 50.0;
+		double MinRepetitionMs = 20.0;
+		int Repetitions = 15;
+
+		// Only benchmarks whose name contains Filter run.
+		std::string Filter;
+	};
+
+	struct Result
+	{
+		std::string Name;
+		std::uint64_t Iterations = 0;   // per repetition
+		int Repetitions = 0;
+		double MedianNs = 0.0;          // per iteration
+		double MinNs = 0.0;
+		double MaxNs = 0.0;
+
+		// Median absolute deviation as a fraction of the median.
+		double Spread = 0.0;
+	};
+
+	struct Comparison
+	{
+		std::string Name;
+		double BaselineNs = 0.0;
+		double CurrentNs = 0.0;
+		double Change = 0.0;   // (current - baseline) / baseline
+		bool Regressed = false;
+	};
+
+	class Runner
+	{
+	public:
+		explicit Runner(const Options& options) : mOptions(options) {}
+
+		void Add(const std::string& name, Function function);
+
+		// Runs every registered benchmark that passes the filter, printing one line each
+		// to log.
+		std::vector<Result> Run(std::ostream& log)const;
+
+	private:
+		Result Measure(const std::string& name, const Function& function)const;
+
+	private:
+		Options mOptions;
+		std::vector<std::pair<std::string, Function>> mBenchmarks;
+	};
+
+	// A missing or malformed baseline loads as empty.
+	std::map<std::string, double> LoadBaseline(const std::string& path);
+	bool SaveBaseline(const std::string& path, const std::vector<Result>& results);
+
+	// Benchmarks missing from the baseline are left out.
+	std::vector<Comparison> Compare(const std::vector<Result>& results,
+		const std::map<std::string, double>& baseline, double threshold);
+
+	void WriteJson(std::ostream& out, const std::vector<Result>& results,
+		const std::vector<Comparison>& comparisons);
+}
@@ -0,0 +1,284 @@
+//***************************************************************************************
+// BlockCompressionCheck.cpp
+//
+// Headless checks of the BC1, BC3 and BC7 encoders in BlockCompression on reference
+// tiles: solid colours, smooth colour and alpha gradients, two colours split by an
+// edge, and noise.
+//
+//   identical  the SSE2 and plain C++ paths write the same bytes for every tile and
+//              format, and for a whole image with ragged edges compressed on several
+//              threads; skipped, and reported as such, where SSE2 is not compiled in
+//   error      decoding each block gives back the tile within a per-format and
+//              per-kind bound on the worst RMSE of the colour and alpha channels
+//
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: BlockCompressionCheck [--tiles N] [--seed N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/BlockCompressionCheck.cpp
+//       Common/BlockCompression.cpp -o BlockCompressionCheck
+//***************************************************************************************
+
+#include "../Common/BlockCompression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	enum TileKind
+	{
+		Solid,
+		Gradient,
+		Edge,
+		Noise,
+		TileKindCount
+	};
+
+	const char* TileKindName(int kind)
+	{
+		static const char* names[TileKindCount] = { "solid", "gradient", "edge", "noise" };
+		return names[kind];
+	}
+
+	const BlockFormat Formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC7 };
+	const int FormatCount = 3;
+
+	// Worst RMSE allowed for a tile, [format][kind], over the colour channels and over
+	// alpha.  BC1 only gets opaque tiles and must keep them opaque.  BC1 and BC3
+	// colour have only four levels for a gradient that can take sixteen values, hence
+	// the wide gradient bound.  Noise has no structure for an encoder to find, so its bound only
+	// catches garbage.
+	const double RgbBound[FormatCount][TileKindCount] =
+	{
+		{ 4.0, 24.0, 4.5, 80.0 },
+		{ 4.0, 24.0, 4.5, 80.0 },
+		{ 1.5, 5.0, 1.5, 80.0 },
+	};
+	const double AlphaBound[FormatCount][TileKindCount] =
+	{
+		{ 0.0, 0.0, 0.0, 0.0 },
+		{ 0.5, 12.0, 0.5, 15.0 },
+		{ 1.5, 6.0, 1.5, 100.0 },
+	};
+
+	struct Tile
+	{
+		int Kind = Solid;
+		bool Opaque = false;
+		std::uint8_t Rgba[64];
+	};
+
+	std::uint8_t Lerp(int a, int b, float t)
+	{
+		return (std::uint8_t)std::lround(a + (b - a) * t);
+	}
+
+	Tile MakeTile(int kind, bool opaque, std::mt19937& rng)
+	{
+		Tile tile;
+		tile.Kind = kind;
+		tile.Opaque = opaque;
+		int c0[4], c1[4];
+		for (int c = 0; c < 4; ++c)
+		{
+			c0[c] = (int)(rng() % 256);
+			c1[c] = (int)(rng() % 256);
+		}
+		if (opaque)
+			c0[3] = c1[3] = 255;
+
+		// Gradients run along a random direction; edges split the tile along one.
+		float dx = (float)(rng() % 9) - 4.0f;
+		float dy = (float)(rng() % 9) - 4.0f;
+		if (dx == 0.0f && dy == 0.0f)
+			dx = 1.0f;
+		float low = (std::min)(0.0f, 3 * dx) + (std::min)(0.0f, 3 * dy);
+		float high = (std::max)(0.0f, 3 * dx) + (std::max)(0.0f, 3 * dy);
+		float split = low + (high - low) * (0.25f + 0.5f * (float)(rng() % 256) / 255.0f);
+
+		for (int i = 0; i < 16; ++i)
+		{
+			float along = (i % 4) * dx + (i / 4) * dy;
+			for (int c = 0; c < 4; ++c)
+			{
+				std::uint8_t v = 0;
+				switch (kind)
+				{
+				case Solid:    v = (std::uint8_t)c0[c]; break;
+				case Gradient: v = Lerp(c0[c], c1[c], (along - low) / (high - low)); break;
+				case Edge:     v = (std::uint8_t)(along < split ? c0[c] : c1[c]); break;
+				default:       v = (std::uint8_t)(opaque && c == 3 ? 255 : rng() % 256); break;
+				}
+				tile.Rgba[i * 4 + c] = v;
+			}
+		}
+		return tile;
+	}
+
+	void BlockRmse(const std::uint8_t a[64], const std::uint8_t b[64], double& rgb, double& alpha)
+	{
+		double rgbSum = 0.0;
+		double alphaSum = 0.0;
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				double diff = (double)a[i * 4 + c] - (double)b[i * 4 + c];
+				(c < 3 ? rgbSum : alphaSum) += diff * diff;
+			}
+		}
+		rgb = std::sqrt(rgbSum / 48.0);
+		alpha = std::sqrt(alphaSum / 16.0);
+	}
+
+	struct Result
+	{
+		bool Identical = true;
+		bool Error = true;
+		std::size_t BlocksCompared = 0;
+		double WorstRgb[FormatCount][TileKindCount] = {};
+		double WorstAlpha[FormatCount][TileKindCount] = {};
+	};
+
+	void CheckTiles(const std::vector<Tile>& tiles, bool simd, Result& result)
+	{
+		for (int f = 0; f < FormatCount; ++f)
+		{
+			BlockFormat format = Formats[f];
+			for (const Tile& tile : tiles)
+			{
+				// BC1 stores no alpha, so it gets the opaque tiles only.
+				if (format == BlockFormat::BC1 && !tile.Opaque)
+					continue;
+
+				std::uint8_t block[16];
+				std::uint8_t scalarBlock[16];
+				SetBlockCompressionSimd(false);
+				CompressBlock(format, tile.Rgba, scalarBlock);
+				SetBlockCompressionSimd(true);
+				CompressBlock(format, tile.Rgba, block);
+				if (simd)
+				{
+					result.Identical = result.Identical && std::memcmp(block, scalarBlock, BlockBytes(format)) == 0;
+					++result.BlocksCompared;
+				}
+
+				std::uint8_t decoded[64];
+				DecompressBlock(format, block, decoded);
+				double rgb = 0.0;
+				double alpha = 0.0;
+				BlockRmse(tile.Rgba, decoded, rgb, alpha);
+				result.WorstRgb[f][tile.Kind] = (std::max)(result.WorstRgb[f][tile.Kind], rgb);
+				result.WorstAlpha[f][tile.Kind] = (std::max)(result.WorstAlpha[f][tile.Kind], alpha);
+				result.Error = result.Error && rgb <= RgbBound[f][tile.Kind] && alpha <= AlphaBound[f][tile.Kind];
+			}
+		}
+	}
+
+	// A 37x23 image, so the right and bottom blocks repeat their last column and row,
+	// compressed on four threads.
+	void CheckImage(std::mt19937& rng, Result& result)
+	{
+		RgbaImage image;
+		image.Width = 37;
+		image.Height = 23;
+		image.Pixels.resize(image.Width * image.Height * 4);
+		for (std::size_t y = 0; y < image.Height; ++y)
+		{
+			for (std::size_t x = 0; x < image.Width; ++x)
+			{
+				std::uint8_t* p = &image.Pixels[(y * image.Width + x) * 4];
+				p[0] = (std::uint8_t)(x * 7);
+				p[1] = (std::uint8_t)(y * 11);
+				p[2] = (std::uint8_t)(rng() % 64 + 96);
+				p[3] = (std::uint8_t)((x + y) * 4);
+			}
+		}
+
+		for (BlockFormat format : Formats)
+		{
+			SetBlockCompressionSimd(false);
+			std::vector<std::uint8_t> scalar = CompressImage(format, image, 4);
+			SetBlockCompressionSimd(true);
+			std::vector<std::uint8_t> simd = CompressImage(format, image, 4);
+			result.Identical = result.Identical && scalar == simd &&
+				scalar.size() == CompressedSize(format, image.Width, image.Height);
+		}
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: BlockCompressionCheck [--tiles N] [--seed N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int tilesPerKind = 500;
+	std::uint32_t seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--tiles") == 0)
+			tilesPerKind = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (tilesPerKind <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Half the tiles of each kind are opaque, for BC1.
+	std::mt19937 rng(seed);
+	std::vector<Tile> tiles;
+	for (int kind = 0; kind < TileKindCount; ++kind)
+	{
+		for (int i = 0; i < tilesPerKind; ++i)
+			tiles.push_back(MakeTile(kind, i % 2 == 0, rng));
+	}
+
+	bool simd = BlockCompressionHasSimd();
+	Result result;
+	CheckTiles(tiles, simd, result);
+	if (simd)
+		CheckImage(rng, result);
+
+	bool verified = result.Identical && result.Error;
+
+	std::printf("{\n");
+	std::printf("  \"tiles\": %zu,\n", tiles.size());
+	std::printf("  \"simd\": %s,\n", simd ? "true" : "false");
+	std::printf("  \"blocks_compared\": %zu,\n", result.BlocksCompared);
+	for (int f = 0; f < FormatCount; ++f)
+	{
+		std::printf("  \"%s_worst_rmse\": {", BlockFormatName(Formats[f]));
+		for (int kind = 0; kind < TileKindCount; ++kind)
+		{
+			std::printf("%s\"%s\": [%.2f, %.2f]", kind ? ", " : "", TileKindName(kind),
+				result.WorstRgb[f][kind], result.WorstAlpha[f][kind]);
+		}
+		std::printf("},\n");
+	}
+	std::printf("  \"identical_ok\": %s,\n", result.Identical ? "true" : "false");
+	std::printf("  \"error_ok\": %s,\n", result.Error ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+//***************************************************************************************
+// BlockRegistryCheck.cpp
+//
+// Headless checks of the block registry:
+//
+//   load       the definition file loads, and names only textures in the manifest
+//   find       every block is found by its name and nothing else is
+//   refused    broken definition files are refused with a message naming the line,
+//              and leave the registry as it was
+//   lookup     property lookups by BlockId against the string-keyed map lookups they
+//              replaced, in nanoseconds per lookup
+//
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: BlockRegistryCheck [--blocks path] [--manifest path] [--dir path]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/BlockRegistryCheck.cpp BlockRegistry.cpp World.cpp
+//       Common/MemoryTracker.cpp -o BlockRegistryCheck
+//***************************************************************************************
+
+#include "../BlockRegistry.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct BrokenFile
+	{
+		const char* Name;
+		const char* Text;
+		const char* Message;   // expected in the error
+	};
+
+	const BrokenFile gBrokenFiles[] =
+	{
+		{ "unknown_block",  "granite stoneMatTex 1 1 1 1\n",                 ":1: unknown block granite" },
+		{ "wrong_case",     "Stone stoneMatTex 1 1 1 1\n",                   ":1: unknown block Stone" },
+		{ "air",            "# comment\nair stoneMatTex 1 1 1 1\n",          ":2: air is never drawn" },
+		{ "duplicate",      "stone a 1 1 1 1\nstone b 1 1 1 1\n",            ":2: stone is defined twice" },
+		{ "short_line",     "stone stoneMatTex 1 1 1\n",                     ":1: expected" },
+		{ "extra_field",    "stone stoneMatTex 1 1 1 1 1\n",                 ":1: expected" },
+		{ "bad_number",     "stone stoneMatTex 1 one 1 1\n",                 ":1: expected" },
+		{ "missing_block",  "stone stoneMatTex 1 1 1 1\n",                   "grass is not defined" },
+	};
+
+	double NanosecondsSince(Clock::time_point start, int count)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+	}
+
+	std::set<std::string> ReadManifestNames(const std::string& path)
+	{
+		std::set<std::string> names;
+		std::ifstream fin(path.c_str());
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			std::istringstream fields(line);
+			std::string name;
+			if ((fields >> name) && name[0] != '#')
+				names.insert(name);
+		}
+		return names;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: BlockRegistryCheck [--blocks path] [--manifest path] [--dir path]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string blocksPath = "Textures/Blocks.txt";
+	std::string manifestPath = "Textures/TextureManifest.txt";
+	std::string directory = ".";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--blocks") == 0)
+			blocksPath = argv[++i];
+		else if (std::strcmp(argv[i], "--manifest") == 0)
+			manifestPath = argv[++i];
+		else if (std::strcmp(argv[i], "--dir") == 0)
+			directory = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	// Load: every drawn block has a texture the manifest provides.
+	BlockRegistry registry;
+	std::string error;
+	bool loaded = registry.Load(blocksPath, error);
+	const std::set<std::string> textures = ReadManifestNames(manifestPath);
+	bool texturesOk = loaded && !textures.empty();
+	for (int i = 0; i < (int)BlockId::Count && loaded; ++i)
+	{
+		BlockId id = (BlockId)i;
+		if (GetBlockLayer(id) != BlockLayer::None && textures.count(registry.Appearance(id).Texture) == 0)
+		{
+			std::fprintf(stderr, "%s: no texture %s in %s\n", GetBlockName(id), registry.Appearance(id).Texture.c_str(), manifestPath.c_str());
+			texturesOk = false;
+		}
+	}
+	if (!loaded)
+		std::fprintf(stderr, "%s\n", error.c_str());
+
+	// Find: names and ids map one to one.
+	bool findOk = true;
+	for (int i = 0; i < (int)BlockId::Count; ++i)
+	{
+		BlockId id;
+		findOk = BlockRegistry::Find(GetBlockName((BlockId)i), id) && id == (BlockId)i && findOk;
+		findOk = registry.Properties((BlockId)i).Id == (BlockId)i && findOk;
+	}
+	BlockId unused;
+	findOk = !BlockRegistry::Find("", unused) && !BlockRegistry::Find("stoneMat", unused) && findOk;
+
+	// Refused: each broken file fails with its message and changes nothing.
+	int refused = 0;
+	const std::string before = registry.Appearance(BlockId::Grass).Texture;
+	for (const BrokenFile& broken : gBrokenFiles)
+	{
+		std::string path = directory + "/BlockRegistryCheck." + broken.Name + ".txt";
+		{
+			std::ofstream fout(path.c_str(), std::ios::trunc);
+			fout << broken.Text;
+		}
+		std::string message;
+		bool failed = !registry.Load(path, message);
+		std::remove(path.c_str());
+
+		if (failed && message.find(broken.Message) != std::string::npos && registry.Appearance(BlockId::Grass).Texture == before)
+			++refused;
+		else
+			std::fprintf(stderr, "%s: %s\n", broken.Name, failed ? message.c_str() : "loaded");
+	}
+	std::string message;
+	bool missingRefused = !registry.Load(directory + "/BlockRegistryCheck.missing.txt", message) &&
+		message.find("cannot be read") != std::string::npos;
+	bool refusedOk = refused == (int)(sizeof(gBrokenFiles) / sizeof(gBrokenFiles[0])) && missingRefused;
+
+	// Lookup: what meshing and render item building now do, against the map of names
+	// the materials used to be found through.
+	const int lookups = 20000000;
+	std::unordered_map<std::string, int> byName;
+	for (int i = 0; i < (int)BlockId::Count; ++i)
+		byName[std::string(GetBlockName((BlockId)i)) + "Mat"] = i;
+	std::string names[(int)BlockId::Count];
+	for (int i = 0; i < (int)BlockId::Count; ++i)
+		names[i] = std::string(GetBlockName((BlockId)i)) + "Mat";
+
+	Clock::time_point start = Clock::now();
+	int opaque = 0;
+	for (int i = 0; i < lookups; ++i)
+		opaque += IsOpaqueBlock((BlockId)(i % (int)BlockId::Count)) ? 1 : 0;
+	double byIdNs = NanosecondsSince(start, lookups);
+
+	start = Clock::now();
+	int sum = 0;
+	for (int i = 0; i < lookups; ++i)
+		sum += byName[names[i % (int)BlockId::Count]];
+	double byNameNs = NanosecondsSince(start, lookups);
+
+	bool verified = loaded && texturesOk && findOk && refusedOk;
+
+	std::printf("{\n");
+	std::printf("  \"blocks\": %d,\n", (int)BlockId::Count);
+	std::printf("  \"loaded\": %s,\n", loaded ? "true" : "false");
+	std::printf("  \"textures_ok\": %s,\n", texturesOk ? "true" : "false");
+	std::printf("  \"find_ok\": %s,\n", findOk ? "true" : "false");
+	std::printf("  \"refused\": %d,\n", refused + (missingRefused ? 1 : 0));
+	std::printf("  \"refused_ok\": %s,\n", refusedOk ? "true" : "false");
+	std::printf("  \"lookup_by_id_ns\": %.2f,\n", byIdNs);
+	std::printf("  \"lookup_by_name_ns\": %.2f,\n", byNameNs);
+	std::printf("  \"checksum\": %d,\n", opaque + sum);
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
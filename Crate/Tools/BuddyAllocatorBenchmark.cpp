@@ -0,0 +1,267 @@
+//***************************************************************************************
+// BuddyAllocatorBenchmark.cpp
+//
+// Alloc/free throughput of BuddyAllocator, in nanoseconds per operation:
+//
+//   fixed      --count blocks of the minimum size, then all freed in allocation order
+//   mixed      the same number of random sizes up to 16 minimum blocks, freed in a
+//              random order so that buddies merge back at every level
+//   churn      a half-full allocator freeing one random block and allocating another
+//   defrag     Defragment passes over a range left fragmented by freeing every other
+//              block, each followed by ReleaseMoved, until no move is left; its time
+//              is per block moved
+//
+// Each pass runs --repetitions times and reports the median.  CheckConsistency() is
+// called after each repetition, outside the timed part, and the range must coalesce
+// back into one free block.  Prints one JSON object to stdout; the exit code is 1 if a
+// check fails.
+//
+// Usage: BuddyAllocatorBenchmark [--count N] [--repetitions N] [--seed N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/BuddyAllocatorBenchmark.cpp Common/BuddyAllocator.cpp
+//       -o BuddyAllocatorBenchmark
+//***************************************************************************************
+
+#include "../Common/BuddyAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const std::uint64_t MinBlock = 64 * 1024;
+
+	struct Pass
+	{
+		const char* Name;
+		double NsPerOp;
+		bool Ok;
+	};
+
+	double NanosecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	}
+
+	double Median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+
+	// Large enough for count blocks of up to maxBlocks minimum blocks each.
+	std::uint64_t CapacityFor(int count, std::uint64_t maxBlocks)
+	{
+		std::uint64_t capacity = MinBlock;
+		while (capacity < (std::uint64_t)count * maxBlocks * MinBlock)
+			capacity *= 2;
+		return capacity;
+	}
+
+	bool Empty(const BuddyAllocator& allocator)
+	{
+		return allocator.CheckConsistency() && allocator.BytesReserved() == 0 &&
+			allocator.LargestFreeBlock() == allocator.Capacity();
+	}
+
+	Pass RunFixed(int count, int repetitions)
+	{
+		Pass pass = { "fixed", 0.0, true };
+		BuddyAllocator allocator(CapacityFor(count, 1), MinBlock);
+		std::vector<std::uint64_t> offsets(count);
+		std::vector<double> times;
+		for (int r = 0; r < repetitions; ++r)
+		{
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < count; ++i)
+				offsets[i] = allocator.Allocate(MinBlock);
+			for (int i = 0; i < count; ++i)
+				allocator.Free(offsets[i]);
+			times.push_back(NanosecondsSince(start) / (2.0 * count));
+
+			pass.Ok = pass.Ok && std::find(offsets.begin(), offsets.end(), (std::uint64_t)BuddyAllocator::InvalidOffset) == offsets.end() &&
+				Empty(allocator);
+		}
+		pass.NsPerOp = Median(times);
+		return pass;
+	}
+
+	Pass RunMixed(int count, int repetitions, std::mt19937_64& rng)
+	{
+		Pass pass = { "mixed", 0.0, true };
+		BuddyAllocator allocator(CapacityFor(count, 16), MinBlock);
+		std::vector<std::uint64_t> sizes(count);
+		std::vector<std::uint64_t> offsets(count);
+		std::vector<double> times;
+		for (int r = 0; r < repetitions; ++r)
+		{
+			for (std::uint64_t& size : sizes)
+				size = 1 + rng() % (16 * MinBlock);
+			std::vector<int> order(count);
+			for (int i = 0; i < count; ++i)
+				order[i] = i;
+			std::shuffle(order.begin(), order.end(), rng);
+
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < count; ++i)
+				offsets[i] = allocator.Allocate(sizes[i], 0, (std::uint32_t)(i % 4));
+			for (int i : order)
+				allocator.Free(offsets[i]);
+			times.push_back(NanosecondsSince(start) / (2.0 * count));
+
+			pass.Ok = pass.Ok && std::find(offsets.begin(), offsets.end(), (std::uint64_t)BuddyAllocator::InvalidOffset) == offsets.end() &&
+				Empty(allocator);
+		}
+		pass.NsPerOp = Median(times);
+		return pass;
+	}
+
+	Pass RunChurn(int count, int repetitions, std::mt19937_64& rng)
+	{
+		Pass pass = { "churn", 0.0, true };
+		BuddyAllocator allocator(CapacityFor(count, 8), MinBlock);
+		std::vector<std::uint64_t> live;
+		for (int i = 0; i < count / 2; ++i)
+			live.push_back(allocator.Allocate(1 + rng() % (4 * MinBlock)));
+
+		std::vector<double> times;
+		for (int r = 0; r < repetitions; ++r)
+		{
+			std::vector<std::uint64_t> victims(count);
+			std::vector<std::uint64_t> sizes(count);
+			for (int i = 0; i < count; ++i)
+			{
+				victims[i] = rng() % live.size();
+				sizes[i] = 1 + rng() % (4 * MinBlock);
+			}
+
+			int failed = 0;
+			Clock::time_point start = Clock::now();
+			for (int i = 0; i < count; ++i)
+			{
+				std::uint64_t& slot = live[victims[i]];
+				allocator.Free(slot);
+				slot = allocator.Allocate(sizes[i]);
+				failed += slot == BuddyAllocator::InvalidOffset;
+			}
+			times.push_back(NanosecondsSince(start) / (2.0 * count));
+
+			pass.Ok = pass.Ok && failed == 0 && allocator.CheckConsistency();
+		}
+		for (std::uint64_t offset : live)
+			allocator.Free(offset);
+		pass.Ok = pass.Ok && Empty(allocator);
+		pass.NsPerOp = Median(times);
+		return pass;
+	}
+
+	Pass RunDefragment(int count, int repetitions)
+	{
+		Pass pass = { "defrag", 0.0, true };
+		BuddyAllocator allocator(CapacityFor(count, 1), MinBlock);
+		std::vector<double> times;
+		for (int r = 0; r < repetitions; ++r)
+		{
+			std::vector<std::uint64_t> offsets(count);
+			for (int i = 0; i < count; ++i)
+				offsets[i] = allocator.Allocate(MinBlock);
+			for (int i = 0; i < count; i += 2)
+				allocator.Free(offsets[i]);
+
+			// Which minimum blocks hold a live allocation.
+			std::vector<char> used(allocator.Capacity() / MinBlock, 0);
+			for (int i = 1; i < count; i += 2)
+				used[offsets[i] / MinBlock] = 1;
+
+			std::uint64_t moves = 0;
+			std::uint32_t moved = 0;
+			Clock::time_point start = Clock::now();
+			do
+			{
+				moved = allocator.Defragment([&](std::uint64_t src, std::uint64_t dst, std::uint64_t, std::uint32_t)
+				{
+					used[src / MinBlock] = 0;
+					used[dst / MinBlock] = 1;
+					return true;
+				}, 64);
+				allocator.ReleaseMoved();
+				moves += moved;
+			} while (moved > 0);
+			times.push_back(NanosecondsSince(start) / (double)(moves > 0 ? moves : 1));
+
+			// Every block is packed at the start of the range, so the rest is free.
+			std::uint32_t liveCount = (std::uint32_t)(count / 2);
+			pass.Ok = pass.Ok && allocator.CheckConsistency() && moves > 0 &&
+				allocator.Stats(0).Allocations == liveCount &&
+				std::count(used.begin(), used.begin() + liveCount, 1) == liveCount;
+			for (std::uint32_t i = 0; i < liveCount; ++i)
+				allocator.Free(i * MinBlock);
+			pass.Ok = pass.Ok && Empty(allocator);
+		}
+		pass.NsPerOp = Median(times);
+		return pass;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: BuddyAllocatorBenchmark [--count N] [--repetitions N] [--seed N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int count = 10000;
+	int repetitions = 20;
+	std::uint64_t seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--count") == 0)
+			count = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--repetitions") == 0)
+			repetitions = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (count < 2 || repetitions <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937_64 rng(seed);
+	std::vector<Pass> passes;
+	passes.push_back(RunFixed(count, repetitions));
+	passes.push_back(RunMixed(count, repetitions, rng));
+	passes.push_back(RunChurn(count, repetitions, rng));
+	passes.push_back(RunDefragment(count, repetitions));
+
+	bool verified = true;
+	for (const Pass& pass : passes)
+		verified = verified && pass.Ok;
+
+	std::printf("{\n");
+	std::printf("  \"count\": %d,\n", count);
+	std::printf("  \"repetitions\": %d,\n", repetitions);
+	for (const Pass& pass : passes)
+		std::printf("  \"%s\": { \"ns_per_op\": %.1f, \"ok\": %s },\n", pass.Name, pass.NsPerOp, pass.Ok ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
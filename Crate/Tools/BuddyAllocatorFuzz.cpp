@@ -0,0 +1,313 @@
+//***************************************************************************************
+// BuddyAllocatorFuzz.cpp
+//
+// Randomised check of BuddyAllocator against an interval map of the blocks it handed
+// out.  Each round allocates and frees at random, with occasional Defragment passes
+// that veto some of the moves and occasional ReleaseMoved calls standing in for the
+// copies' fence, and after every operation checks that:
+//
+//   - a block is at least as large as requested and aligned to its own size,
+//   - no two live blocks overlap,
+//   - CheckConsistency() holds,
+//   - moves only ever start at a live block of the reported size and category, and
+//     the per-category statistics are the same after a Defragment pass as before it,
+//   - neither a move's destination nor a new block overlaps a block moved out of
+//     before ReleaseMoved, whether in the same pass or an earlier one, and
+//     BytesMoved() is the size of those blocks.
+//
+// At the end of a round every block is freed, and the range must coalesce back into
+// one free block.  Prints one JSON object to stdout; the exit code is 1 if a check
+// fails, and stderr names the first one.
+//
+// Usage: BuddyAllocatorFuzz [--rounds N] [--steps N] [--seed N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/BuddyAllocatorFuzz.cpp Common/BuddyAllocator.cpp
+//       -o BuddyAllocatorFuzz
+//***************************************************************************************
+
+#include "../Common/BuddyAllocator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <random>
+
+namespace
+{
+	struct Block
+	{
+		std::uint64_t Size = 0;       // block size
+		std::uint64_t Requested = 0;
+		std::uint32_t Category = 0;
+	};
+
+	typedef std::map<std::uint64_t, Block> IntervalMap;
+
+	struct Totals
+	{
+		std::uint64_t Allocations = 0;
+		std::uint64_t Failed = 0;
+		std::uint64_t Frees = 0;
+		std::uint64_t Moves = 0;
+		std::uint64_t Vetoed = 0;
+		std::uint64_t Releases = 0;
+	};
+
+	const char* gFailure = nullptr;
+
+	bool Fail(const char* what)
+	{
+		if (gFailure == nullptr)
+			gFailure = what;
+		return false;
+	}
+
+	// True if [offset, offset + size) overlaps no block in the map.
+	bool IsFree(const IntervalMap& live, std::uint64_t offset, std::uint64_t size)
+	{
+		IntervalMap::const_iterator it = live.lower_bound(offset);
+		if (it != live.end() && it->first < offset + size)
+			return false;
+		if (it != live.begin())
+		{
+			--it;
+			if (it->first + it->second.Size > offset)
+				return false;
+		}
+		return true;
+	}
+
+	bool SameStats(const BuddyAllocator& allocator, const BuddyAllocator::CategoryStats (&before)[BuddyAllocator::MaxCategories])
+	{
+		for (std::uint32_t c = 0; c < BuddyAllocator::MaxCategories; ++c)
+		{
+			const BuddyAllocator::CategoryStats& s = allocator.Stats(c);
+			if (s.Allocations != before[c].Allocations || s.BytesRequested != before[c].BytesRequested ||
+				s.BytesReserved != before[c].BytesReserved)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// The allocator's statistics must describe exactly the blocks in the map.
+	bool MatchesMap(const BuddyAllocator& allocator, const IntervalMap& live)
+	{
+		BuddyAllocator::CategoryStats expected[BuddyAllocator::MaxCategories];
+		std::uint64_t reserved = 0;
+		for (const auto& entry : live)
+		{
+			BuddyAllocator::CategoryStats& s = expected[entry.second.Category];
+			s.Allocations++;
+			s.BytesRequested += entry.second.Requested;
+			s.BytesReserved += entry.second.Size;
+			reserved += entry.second.Size;
+			if (allocator.BlockSize(entry.first) != entry.second.Size)
+				return false;
+		}
+		return reserved == allocator.BytesReserved() && SameStats(allocator, expected);
+	}
+
+	std::uint64_t TotalSize(const IntervalMap& blocks)
+	{
+		std::uint64_t bytes = 0;
+		for (const auto& entry : blocks)
+			bytes += entry.second.Size;
+		return bytes;
+	}
+
+	// moved holds the blocks moved out of since the last ReleaseMoved; their copies may
+	// not have run, so nothing may land on them.
+	bool Defragment(BuddyAllocator& allocator, IntervalMap& live, IntervalMap& moved, std::mt19937_64& rng, Totals& totals)
+	{
+		BuddyAllocator::CategoryStats before[BuddyAllocator::MaxCategories];
+		for (std::uint32_t c = 0; c < BuddyAllocator::MaxCategories; ++c)
+			before[c] = allocator.Stats(c);
+
+		bool ok = true;
+		std::uint32_t moves = allocator.Defragment([&](std::uint64_t src, std::uint64_t dst, std::uint64_t size, std::uint32_t category)
+		{
+			IntervalMap::iterator it = live.find(src);
+			if (it == live.end() || it->second.Size != size || it->second.Category != category || dst >= src || dst % size != 0)
+			{
+				ok = Fail("move_source");
+				return false;
+			}
+			if (rng() % 4 == 0)
+			{
+				totals.Vetoed++;
+				return false;
+			}
+
+			Block block = it->second;
+			live.erase(it);
+			if (!IsFree(live, dst, size))
+			{
+				ok = Fail("move_destination");
+				live[src] = block;
+				return false;
+			}
+			if (!IsFree(moved, dst, size))
+			{
+				ok = Fail("move_over_source");
+				live[src] = block;
+				return false;
+			}
+			live[dst] = block;
+			moved[src] = block;
+			return true;
+		}, 1 + (std::uint32_t)(rng() % 16));
+		totals.Moves += moves;
+
+		if (ok && !SameStats(allocator, before))
+			return Fail("move_stats");
+		if (ok && allocator.BytesMoved() != TotalSize(moved))
+			return Fail("moved_bytes");
+		return ok;
+	}
+
+	bool RunRound(std::mt19937_64& rng, int steps, Totals& totals)
+	{
+		const std::uint64_t minBlock = 64 * 1024;
+		BuddyAllocator allocator(64ull << 20, minBlock);
+		IntervalMap live;
+		IntervalMap moved;
+
+		for (int step = 0; step < steps; ++step)
+		{
+			std::uint64_t r = rng() % 20;
+			if (r < 10 || live.empty())
+			{
+				// Mostly small requests, with the odd one of up to a sixteenth of the range.
+				std::uint64_t limit = (rng() % 8 == 0) ? (allocator.Capacity() / 16) : (4 * minBlock);
+				std::uint64_t size = 1 + rng() % limit;
+				std::uint32_t category = (std::uint32_t)(rng() % BuddyAllocator::MaxCategories);
+				std::uint64_t offset = allocator.Allocate(size, 0, category);
+				if (offset == BuddyAllocator::InvalidOffset)
+				{
+					totals.Failed++;
+				}
+				else
+				{
+					std::uint64_t blockSize = allocator.BlockSize(offset);
+					if (blockSize < size || offset % blockSize != 0)
+						return Fail("block_size");
+					if (offset + blockSize > allocator.Capacity() || !IsFree(live, offset, blockSize))
+						return Fail("overlap");
+					if (!IsFree(moved, offset, blockSize))
+						return Fail("allocated_over_source");
+
+					Block block;
+					block.Size = blockSize;
+					block.Requested = size;
+					block.Category = category;
+					live[offset] = block;
+					totals.Allocations++;
+				}
+			}
+			else if (r < 16)
+			{
+				IntervalMap::iterator it = live.begin();
+				std::advance(it, rng() % live.size());
+				allocator.Free(it->first);
+				live.erase(it);
+				totals.Frees++;
+			}
+			else if (r < 18)
+			{
+				if (!Defragment(allocator, live, moved, rng, totals))
+					return false;
+			}
+			else
+			{
+				allocator.ReleaseMoved();
+				moved.clear();
+				totals.Releases++;
+				if (allocator.BytesMoved() != 0)
+					return Fail("moved_bytes");
+			}
+
+			if (!allocator.CheckConsistency())
+				return Fail("consistency");
+			if (step % 64 == 0 && !MatchesMap(allocator, live))
+				return Fail("statistics");
+		}
+
+		if (!MatchesMap(allocator, live))
+			return Fail("statistics");
+		for (const auto& entry : live)
+			allocator.Free(entry.first);
+		allocator.ReleaseMoved();
+		if (!allocator.CheckConsistency() || allocator.BytesReserved() != 0 ||
+			allocator.LargestFreeBlock() != allocator.Capacity())
+		{
+			return Fail("coalesce");
+		}
+		return true;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: BuddyAllocatorFuzz [--rounds N] [--steps N] [--seed N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int rounds = 50;
+	int steps = 5000;
+	std::uint64_t seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--rounds") == 0)
+			rounds = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--steps") == 0)
+			steps = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			seed = std::strtoull(argv[++i], nullptr, 10);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (rounds <= 0 || steps <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937_64 rng(seed);
+	Totals totals;
+	int round = 0;
+	bool verified = true;
+	for (; round < rounds && verified; ++round)
+		verified = RunRound(rng, steps, totals);
+
+	if (!verified)
+		std::fprintf(stderr, "round %d failed: %s\n", round - 1, gFailure);
+
+	std::printf("{\n");
+	std::printf("  \"seed\": %llu,\n", (unsigned long long)seed);
+	std::printf("  \"rounds\": %d,\n", round);
+	std::printf("  \"steps\": %d,\n", steps);
+	std::printf("  \"allocations\": %llu,\n", (unsigned long long)totals.Allocations);
+	std::printf("  \"failed_allocations\": %llu,\n", (unsigned long long)totals.Failed);
+	std::printf("  \"frees\": %llu,\n", (unsigned long long)totals.Frees);
+	std::printf("  \"moves\": %llu,\n", (unsigned long long)totals.Moves);
+	std::printf("  \"vetoed_moves\": %llu,\n", (unsigned long long)totals.Vetoed);
+	std::printf("  \"releases\": %llu,\n", (unsigned long long)totals.Releases);
+	std::printf("  \"failure\": %s%s%s,\n", gFailure ? "\"" : "", gFailure ? gFailure : "null", gFailure ? "\"" : "");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+//***************************************************************************************
+// DDSLayoutCheck.cpp
+//
+// Headless checks of DDSLayout against real files, normally every .dds in Textures/.
+// For each file:
+//
+//   parse      ParseDDSFile, GetDDSTextureDesc and ComputeDDSLayout all succeed
+//   offsets    the subresources come in D3D order, array slice major and mip minor, each
+//              mip half the size of the one before, and each starts where the one
+//              before ends
+//   pitch      row pitch, row count and slice pitch match the format: 4x4 blocks for
+//              BC formats, bits per pixel rounded up to bytes otherwise
+//   size       the last subresource ends exactly at the end of the file
+//   truncated  the same file one byte short gives DDSStatus::Truncated
+//   maxsize    with a maxsize of half the top mip, a mipmapped file skips one mip and
+//              keeps the rest of the full layout unchanged
+//
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: DDSLayoutCheck <file.dds>...
+//
+// Build on Linux from the Crate directory, with a dxgiformat.h on the include path:
+//   g++ -std=c++14 -O2 -I. -I<dxgiformat.h dir> Tools/DDSLayoutCheck.cpp
+//       Common/DDSLayout.cpp Common/MappedFile.cpp -o DDSLayoutCheck
+//   ./DDSLayoutCheck Textures/*.dds
+//***************************************************************************************
+
+#include "../Common/DDSLayout.h"
+#include "../Common/MappedFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Result
+	{
+		bool Parse = true;
+		bool Offsets = true;
+		bool Pitch = true;
+		bool Size = true;
+		bool Truncated = true;
+		bool MaxSize = true;
+		std::size_t Subresources = 0;
+		std::vector<std::string> Failed;
+	};
+
+	// Bytes per 4x4 block, or 0 for a format that is not block compressed.
+	std::size_t BlockBytes(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+			return 8;
+
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 16;
+
+		default:
+			return 0;
+		}
+	}
+
+	bool CheckPitch(const DDSTextureDesc& desc, const DDSSubresource& sub)
+	{
+		std::size_t rowPitch = 0;
+		std::size_t rows = 0;
+		std::size_t blockBytes = BlockBytes(desc.Format);
+		if (blockBytes != 0)
+		{
+			rowPitch = (std::max)((sub.Width + 3) / 4, (std::size_t)1) * blockBytes;
+			rows = (std::max)((sub.Height + 3) / 4, (std::size_t)1);
+		}
+		else
+		{
+			rowPitch = (sub.Width * BitsPerPixel(desc.Format) + 7) / 8;
+			rows = sub.Height;
+		}
+		return rowPitch != 0 && sub.RowPitch == rowPitch && sub.NumRows == rows && sub.SlicePitch == rowPitch * rows;
+	}
+
+	bool SameSubresource(const DDSSubresource& a, const DDSSubresource& b)
+	{
+		return a.Offset == b.Offset && a.RowPitch == b.RowPitch && a.SlicePitch == b.SlicePitch &&
+			a.NumRows == b.NumRows && a.Width == b.Width && a.Height == b.Height && a.Depth == b.Depth;
+	}
+
+	void CheckFile(const std::string& path, Result& result)
+	{
+		MappedFile mapped;
+		DDSFile file;
+		DDSTextureDesc desc;
+		DDSLayout layout;
+		bool parsed = mapped.Open(path) &&
+			ParseDDSFile(mapped.Data(), mapped.Size(), file) == DDSStatus::Ok &&
+			GetDDSTextureDesc(file, desc) == DDSStatus::Ok &&
+			ComputeDDSLayout(desc, file.BitSize, 0, layout) == DDSStatus::Ok;
+		if (!parsed)
+		{
+			result.Parse = false;
+			result.Failed.push_back(path);
+			return;
+		}
+		result.Subresources += layout.Subresources.size();
+
+		bool offsets = layout.Subresources.size() == desc.ArraySize * desc.MipCount && layout.SkipMip == 0 &&
+			layout.MipCount == desc.MipCount && layout.Width == desc.Width && layout.Height == desc.Height;
+		bool pitch = true;
+		std::size_t end = 0;
+		for (std::size_t slice = 0; slice < desc.ArraySize && offsets; ++slice)
+		{
+			std::size_t w = desc.Width;
+			std::size_t h = desc.Height;
+			std::size_t d = desc.Depth;
+			for (std::size_t mip = 0; mip < desc.MipCount; ++mip)
+			{
+				const DDSSubresource& sub = layout.Subresources[slice * desc.MipCount + mip];
+				offsets = offsets && sub.Offset == end && sub.Width == w && sub.Height == h && sub.Depth == d;
+				pitch = pitch && CheckPitch(desc, sub);
+				end = sub.Offset + sub.SlicePitch * sub.Depth;
+
+				w = (std::max)(w / 2, (std::size_t)1);
+				h = (std::max)(h / 2, (std::size_t)1);
+				d = (std::max)(d / 2, (std::size_t)1);
+			}
+		}
+		bool size = offsets && end == file.BitSize;
+
+		DDSLayout shortLayout;
+		bool truncated = ComputeDDSLayout(desc, file.BitSize - 1, 0, shortLayout) == DDSStatus::Truncated;
+
+		bool maxSize = true;
+		if (desc.MipCount > 1)
+		{
+			DDSLayout smaller;
+			std::size_t maxsize = (std::max)(desc.Width, desc.Height) / 2;
+			maxSize = ComputeDDSLayout(desc, file.BitSize, maxsize, smaller) == DDSStatus::Ok &&
+				smaller.SkipMip == 1 && smaller.MipCount == desc.MipCount - 1 &&
+				smaller.Width == (std::max)(desc.Width / 2, (std::size_t)1) &&
+				smaller.Subresources.size() == desc.ArraySize * (desc.MipCount - 1);
+			for (std::size_t slice = 0; slice < desc.ArraySize && maxSize; ++slice)
+			{
+				for (std::size_t mip = 1; mip < desc.MipCount; ++mip)
+				{
+					maxSize = maxSize && SameSubresource(smaller.Subresources[slice * (desc.MipCount - 1) + mip - 1],
+						layout.Subresources[slice * desc.MipCount + mip]);
+				}
+			}
+		}
+
+		result.Offsets = result.Offsets && offsets;
+		result.Pitch = result.Pitch && pitch;
+		result.Size = result.Size && size;
+		result.Truncated = result.Truncated && truncated;
+		result.MaxSize = result.MaxSize && maxSize;
+		if (!offsets || !pitch || !size || !truncated || !maxSize)
+			result.Failed.push_back(path);
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: DDSLayoutCheck <file.dds>...\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	Result result;
+	for (int i = 1; i < argc; ++i)
+		CheckFile(argv[i], result);
+
+	bool verified = result.Parse && result.Offsets && result.Pitch && result.Size &&
+		result.Truncated && result.MaxSize;
+
+	std::printf("{\n");
+	std::printf("  \"files\": %d,\n", argc - 1);
+	std::printf("  \"subresources\": %zu,\n", result.Subresources);
+	std::printf("  \"failed\": [");
+	for (std::size_t i = 0; i < result.Failed.size(); ++i)
+		std::printf("%s\"%s\"", i ? ", " : "", result.Failed[i].c_str());
+	std::printf("],\n");
+	std::printf("  \"parse_ok\": %s,\n", result.Parse ? "true" : "false");
+	std::printf("  \"offsets_ok\": %s,\n", result.Offsets ? "true" : "false");
+	std::printf("  \"pitch_ok\": %s,\n", result.Pitch ? "true" : "false");
+	std::printf("  \"size_ok\": %s,\n", result.Size ? "true" : "false");
+	std::printf("  \"truncated_ok\": %s,\n", result.Truncated ? "true" : "false");
+	std::printf("  \"maxsize_ok\": %s,\n", result.MaxSize ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+//***************************************************************************************
+// DescriptorAllocatorCheck.cpp
+//
+// Headless checks of DescriptorIndexAllocator, driven the way DescriptorHeapAllocator
+// drives it from CrateApp: one transient range per frame resource, a fence per submitted
+// frame, persistent indices freed on the last submitted fence, and a GPU that finishes
+// frames a random number of frames later.
+//
+//   reuse      a freed persistent index is not handed out again until CompletedFence has
+//              passed the fence it was freed on, and is handed out once it has
+//   transient  each frame's indices are contiguous, lie in that frame resource's range
+//              after the persistent range, never overlap, and start over when the frame
+//              resource comes round again; an exhausted range or a count of 0 returns
+//              InvalidIndex
+//   growth     a full persistent range doubles without moving the indices already handed
+//              out, and the transient ranges move up behind it
+//   in use     PersistentInUse counts live indices only, not free or pending ones
+//
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: DescriptorAllocatorCheck [--frames N] [--seed N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/DescriptorAllocatorCheck.cpp Common/DescriptorIndexAllocator.cpp
+//       -o DescriptorAllocatorCheck
+//***************************************************************************************
+
+#include "../Common/DescriptorIndexAllocator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	// CrateApp's gNumFrameResources.
+	const std::uint32_t FrameResources = 3;
+	const std::uint32_t TransientPerFrame = 64;
+
+	const std::uint32_t Invalid = DescriptorIndexAllocator::InvalidIndex;
+
+	enum SlotState : char
+	{
+		Unused,
+		Live,
+		Pending
+	};
+
+	bool CheckReuse()
+	{
+		DescriptorIndexAllocator indices(8, TransientPerFrame, FrameResources);
+		std::uint32_t a = indices.AllocatePersistent();
+		std::uint32_t b = indices.AllocatePersistent();
+		indices.FreePersistent(a, 5);
+
+		// Fence 4 does not release it, so a fresh index comes from the high-water mark.
+		indices.CompletedFence(4);
+		std::uint32_t c = indices.AllocatePersistent();
+		bool ok = c != a && c != b && indices.PersistentInUse() == 2;
+
+		indices.CompletedFence(5);
+		std::uint32_t d = indices.AllocatePersistent();
+		ok = ok && d == a && indices.PersistentInUse() == 3;
+
+		// Frees on different fences come back as each fence passes.
+		indices.FreePersistent(b, 7);
+		indices.FreePersistent(c, 6);
+		indices.CompletedFence(6);
+		std::uint32_t e = indices.AllocatePersistent();
+		indices.CompletedFence(7);
+		std::uint32_t f = indices.AllocatePersistent();
+		return ok && e == c && f == b && indices.PersistentInUse() == 3;
+	}
+
+	bool CheckTransient()
+	{
+		DescriptorIndexAllocator indices(8, TransientPerFrame, FrameResources);
+		bool ok = indices.Capacity() == 8 + FrameResources * TransientPerFrame;
+		for (std::uint32_t frame = 0; frame < 2 * FrameResources; ++frame)
+		{
+			std::uint32_t slot = frame % FrameResources;
+			indices.BeginFrame(slot);
+			std::uint32_t base = indices.PersistentCapacity() + slot * TransientPerFrame;
+			ok = ok && indices.CurrentFrame() == slot && indices.TransientInUse() == 0;
+
+			std::uint32_t first = indices.AllocateTransient(5);
+			std::uint32_t second = indices.AllocateTransient(TransientPerFrame - 5);
+			ok = ok && first == base && second == base + 5 &&
+				indices.TransientInUse() == TransientPerFrame &&
+				indices.AllocateTransient(1) == Invalid &&
+				indices.AllocateTransient(0) == Invalid &&
+				!indices.IsPersistent(first);
+		}
+
+		// A range too large for the frame fails without using any of it.
+		indices.BeginFrame(0);
+		return ok && indices.AllocateTransient(TransientPerFrame + 1) == Invalid &&
+			indices.TransientInUse() == 0 && indices.AllocateTransient(TransientPerFrame) == indices.PersistentCapacity();
+	}
+
+	bool CheckGrowth()
+	{
+		DescriptorIndexAllocator indices(4, TransientPerFrame, FrameResources);
+		std::vector<std::uint32_t> handed;
+		for (int i = 0; i < 4; ++i)
+			handed.push_back(indices.AllocatePersistent());
+		indices.BeginFrame(1);
+		bool ok = indices.PersistentCapacity() == 4 && indices.AllocateTransient(1) == 4 + TransientPerFrame;
+
+		// The fifth index doubles the range; the first four keep their values.
+		handed.push_back(indices.AllocatePersistent());
+		ok = ok && indices.PersistentCapacity() == 8 &&
+			indices.Capacity() == 8 + FrameResources * TransientPerFrame;
+		for (std::uint32_t i = 0; i < (std::uint32_t)handed.size(); ++i)
+			ok = ok && handed[i] == i && indices.IsPersistent(handed[i]);
+
+		// The transient ranges now start after the grown persistent range.
+		indices.BeginFrame(1);
+		ok = ok && indices.AllocateTransient(1) == 8 + TransientPerFrame;
+
+		// Growth does not forget the indices waiting on a fence.
+		indices.FreePersistent(handed[2], 3);
+		for (int i = 0; i < 4; ++i)
+			ok = ok && indices.AllocatePersistent() != handed[2];
+		ok = ok && indices.PersistentCapacity() == 16 && indices.PersistentInUse() == 8;
+		indices.CompletedFence(3);
+		return ok && indices.AllocatePersistent() == handed[2] && indices.PersistentInUse() == 9;
+	}
+
+	struct PipelineResult
+	{
+		bool ReuseOk = true;
+		bool TransientOk = true;
+		bool GrowthOk = true;
+		bool InUseOk = true;
+		std::uint64_t Reused = 0;
+		std::uint32_t Growths = 0;
+		std::uint32_t PeakInUse = 0;
+	};
+
+	// Frames allocate and free persistent indices and fill part of their transient range,
+	// with the GPU up to FrameResources frames behind.  A freed index is retired on the
+	// last submitted fence, like DescriptorHeapAllocator::Free; it must not be handed out
+	// before that fence has completed.
+	PipelineResult RunPipeline(int frames, std::mt19937& rng)
+	{
+		PipelineResult result;
+		DescriptorIndexAllocator indices(16, TransientPerFrame, FrameResources);
+		std::vector<char> state;
+		std::vector<std::uint64_t> freedOn;
+		std::vector<std::uint32_t> live;
+		std::vector<std::uint64_t> slotFence(FrameResources, 0);
+		std::uint64_t submitted = 0;
+		std::uint64_t completed = 0;
+
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			std::uint32_t slot = (std::uint32_t)frame % FrameResources;
+
+			// Wait for this frame resource, and let the GPU get a little further at random.
+			if (completed < slotFence[slot])
+				completed = slotFence[slot];
+			completed += rng() % (submitted - completed + 1);
+
+			indices.CompletedFence(completed);
+			indices.BeginFrame(slot);
+
+			// Persistent churn; the live set drifts up and down so the range keeps growing.
+			int target = 200 + (int)(150.0 * ((frame / 500) % 4) / 3.0);
+			int ops = (int)(rng() % 8);
+			for (int op = 0; op < ops; ++op)
+			{
+				bool allocate = live.empty() || ((int)live.size() < target ? rng() % 3 != 0 : rng() % 3 == 0);
+				if (allocate)
+				{
+					std::uint32_t capacity = indices.PersistentCapacity();
+					std::uint32_t index = indices.AllocatePersistent();
+					if (indices.PersistentCapacity() != capacity)
+					{
+						++result.Growths;
+						result.GrowthOk = result.GrowthOk && indices.PersistentCapacity() == 2 * capacity;
+					}
+					if (index >= state.size())
+					{
+						state.resize(index + 1, Unused);
+						freedOn.resize(index + 1, 0);
+					}
+
+					result.GrowthOk = result.GrowthOk && indices.IsPersistent(index);
+					result.ReuseOk = result.ReuseOk && state[index] != Live &&
+						(state[index] != Pending || freedOn[index] <= completed);
+					result.Reused += state[index] == Pending;
+					state[index] = Live;
+					live.push_back(index);
+				}
+				else
+				{
+					std::size_t victim = rng() % live.size();
+					std::uint32_t index = live[victim];
+					live[victim] = live.back();
+					live.pop_back();
+
+					indices.FreePersistent(index, submitted);
+					state[index] = Pending;
+					freedOn[index] = submitted;
+				}
+			}
+			result.InUseOk = result.InUseOk && indices.PersistentInUse() == live.size();
+			if (indices.PersistentInUse() > result.PeakInUse)
+				result.PeakInUse = indices.PersistentInUse();
+
+			// Transient ranges of random sizes until some request no longer fits.
+			std::uint32_t base = indices.PersistentCapacity() + slot * TransientPerFrame;
+			std::uint32_t cursor = 0;
+			result.TransientOk = result.TransientOk && indices.TransientInUse() == 0;
+			for (;;)
+			{
+				std::uint32_t count = 1 + (std::uint32_t)(rng() % 16);
+				std::uint32_t index = indices.AllocateTransient(count);
+				if (cursor + count > TransientPerFrame)
+				{
+					result.TransientOk = result.TransientOk && index == Invalid && indices.TransientInUse() == cursor;
+					break;
+				}
+
+				result.TransientOk = result.TransientOk && index == base + cursor && !indices.IsPersistent(index) &&
+					index + count <= indices.Capacity();
+				cursor += count;
+			}
+
+			slotFence[slot] = ++submitted;
+		}
+		return result;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: DescriptorAllocatorCheck [--frames N] [--seed N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 20000;
+	unsigned seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--frames") == 0)
+			frames = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			seed = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (frames <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	PipelineResult pipeline = RunPipeline(frames, rng);
+	bool reuseOk = CheckReuse() && pipeline.ReuseOk && pipeline.Reused > 0;
+	bool transientOk = CheckTransient() && pipeline.TransientOk;
+	bool growthOk = CheckGrowth() && pipeline.GrowthOk && pipeline.Growths > 0;
+	bool inUseOk = pipeline.InUseOk;
+	bool verified = reuseOk && transientOk && growthOk && inUseOk;
+
+	std::printf("{\n");
+	std::printf("  \"frames\": %d,\n", frames);
+	std::printf("  \"indices_reused\": %llu,\n", (unsigned long long)pipeline.Reused);
+	std::printf("  \"growths\": %u,\n", pipeline.Growths);
+	std::printf("  \"peak_in_use\": %u,\n", pipeline.PeakInUse);
+	std::printf("  \"reuse_ok\": %s,\n", reuseOk ? "true" : "false");
+	std::printf("  \"transient_ok\": %s,\n", transientOk ? "true" : "false");
+	std::printf("  \"growth_ok\": %s,\n", growthOk ? "true" : "false");
+	std::printf("  \"in_use_ok\": %s,\n", inUseOk ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,449 @@
+//***************************************************************************************
+// EditJournalBenchmark.cpp
+//
+// Headless benchmark and crash recovery check of the block edit journal in WorldSave.
+// Generates and saves a world, then:
+//
+//   throughput   --edits random edits through SaveEdit: how fast they queue, how fast
+//                they reach the journal, and how fast checkpoints fold them into the
+//                regions; and for comparison, edits saved by rewriting their chunks
+//   recovery     crashes simulated by copying the save's files at a chosen moment and
+//                putting them back after the WorldSave is gone:
+//
+//     replay        edits journaled, no checkpoint
+//     torn_tail     the journal cut at many lengths, as a crash mid-append leaves it;
+//                   the load must hold exactly the edits recovered, oldest first
+//     corrupt_frame one byte of the journal changed
+//     refold        every region checkpointed but the journal not yet emptied
+//     partial_fold  only some regions checkpointed
+//     checkpointed  the recovered edits checkpointed and the save reopened
+//
+// Every load is checked block for block against the world with the edits applied.
+// Prints one JSON object to stdout; the exit code is 1 if any check fails.  The save
+// directory is emptied before and after the run.
+//
+// Usage: EditJournalBenchmark [--size N] [--seed N] [--threads N] [--dir path]
+//                             [--edits N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/EditJournalBenchmark.cpp World.cpp
+//       WorldGenerator.cpp PerlinNoise.cpp ChunkCodec.cpp RegionFile.cpp WorldSave.cpp
+//       BlockJournal.cpp Common/FileUtil.cpp Common/LzCompression.cpp Common/Profiler.cpp
+//       Common/MemoryTracker.cpp -o EditJournalBenchmark
+//***************************************************************************************
+
+#include "../World.h"
+#include "../WorldGenerator.h"
+#include "../WorldSave.h"
+#include "../Common/ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <iterator>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// Edits for the recovery checks; below WorldSave::CheckpointEdits, so nothing is
+	// checkpointed before the test means it to be.
+	const int RecoveryEdits = 3000;
+	const int TornTailCuts = 48;
+	const int ChunkRewriteEdits = 10000;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	double PerSecond(double count, double ms)
+	{
+		return count / ((ms > 0.0) ? ms / 1000.0 : 1e-9);
+	}
+
+	struct FileCopy
+	{
+		std::string Path;
+		bool Exists = false;
+		std::vector<char> Bytes;
+	};
+
+	// The save's files as they are on disk at one moment.
+	typedef std::vector<FileCopy> SaveCopy;
+
+	int RegionCount(int chunks)
+	{
+		return (chunks + RegionFile::Size - 1) / RegionFile::Size;
+	}
+
+	std::vector<std::string> RegionPaths(const WorldSave& save, const World& world)
+	{
+		std::vector<std::string> paths;
+		for (int ry = 0; ry < RegionCount(world.ChunksY()); ++ry)
+		{
+			for (int rz = 0; rz < RegionCount(world.ChunksZ()); ++rz)
+			{
+				for (int rx = 0; rx < RegionCount(world.ChunksX()); ++rx)
+					paths.push_back(save.RegionPath(rx, ry, rz));
+			}
+		}
+		return paths;
+	}
+
+	std::vector<std::string> SavePaths(const WorldSave& save, const World& world)
+	{
+		std::vector<std::string> paths = RegionPaths(save, world);
+		paths.push_back(save.InfoPath());
+		paths.push_back(save.JournalPath());
+		return paths;
+	}
+
+	SaveCopy CopySave(const std::vector<std::string>& paths)
+	{
+		SaveCopy copy;
+		for (const std::string& path : paths)
+		{
+			FileCopy file;
+			file.Path = path;
+			std::ifstream fin(path.c_str(), std::ios::binary);
+			file.Exists = (bool)fin;
+			if (file.Exists)
+				file.Bytes.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+			copy.push_back(file);
+		}
+		return copy;
+	}
+
+	void RestoreSave(const SaveCopy& copy)
+	{
+		for (const FileCopy& file : copy)
+		{
+			std::remove((file.Path + ".tmp").c_str());
+			if (!file.Exists)
+			{
+				std::remove(file.Path.c_str());
+				continue;
+			}
+			std::ofstream fout(file.Path.c_str(), std::ios::binary | std::ios::trunc);
+			fout.write(file.Bytes.data(), file.Bytes.size());
+		}
+	}
+
+	FileCopy* FindFile(SaveCopy& copy, const std::string& path)
+	{
+		for (FileCopy& file : copy)
+		{
+			if (file.Path == path)
+				return &file;
+		}
+		return nullptr;
+	}
+
+	void RemoveSave(const std::vector<std::string>& paths)
+	{
+		for (const std::string& path : paths)
+		{
+			std::remove(path.c_str());
+			std::remove((path + ".tmp").c_str());
+		}
+	}
+
+	std::vector<Chunk> CopyChunks(const World& world)
+	{
+		std::vector<Chunk> chunks;
+		for (int cy = 0; cy < world.ChunksY(); ++cy)
+		{
+			for (int cz = 0; cz < world.ChunksZ(); ++cz)
+			{
+				for (int cx = 0; cx < world.ChunksX(); ++cx)
+					chunks.push_back(world.GetChunk(cx, cy, cz));
+			}
+		}
+		return chunks;
+	}
+
+	// Random edits made one after another to chunks, laid out as CopyChunks does.
+	std::vector<BlockEdit> MakeEdits(const World& world, std::vector<Chunk> chunks, int count, std::mt19937& random)
+	{
+		std::uniform_int_distribution<int> pickX(0, world.SizeX() - 1);
+		std::uniform_int_distribution<int> pickY(0, world.SizeY() - 1);
+		std::uniform_int_distribution<int> pickZ(0, world.SizeZ() - 1);
+		std::uniform_int_distribution<int> pickBlock(0, (int)BlockId::Count - 1);
+
+		std::vector<BlockEdit> edits(count);
+		for (BlockEdit& e : edits)
+		{
+			int x = pickX(random), y = pickY(random), z = pickZ(random);
+			e.ChunkX = x / ChunkSize;
+			e.ChunkY = y / ChunkSize;
+			e.ChunkZ = z / ChunkSize;
+			e.Index = Chunk::Index(x % ChunkSize, y % ChunkSize, z % ChunkSize);
+
+			Chunk& chunk = chunks[e.ChunkX + world.ChunksX() * (e.ChunkZ + world.ChunksZ() * e.ChunkY)];
+			e.Old = chunk.Blocks[e.Index];
+			e.New = (BlockId)pickBlock(random);
+			chunk.Blocks[e.Index] = e.New;
+		}
+		return edits;
+	}
+
+	// The base chunks with the first count edits applied.
+	std::vector<Chunk> ApplyEdits(const World& world, std::vector<Chunk> chunks, const std::vector<BlockEdit>& edits, std::size_t count)
+	{
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const BlockEdit& e = edits[i];
+			chunks[e.ChunkX + world.ChunksX() * (e.ChunkZ + world.ChunksZ() * e.ChunkY)].Blocks[e.Index] = e.New;
+		}
+		return chunks;
+	}
+
+	bool SameWorld(const World* loaded, const std::vector<Chunk>& expected)
+	{
+		if (loaded == nullptr)
+			return false;
+
+		std::size_t i = 0;
+		for (int cy = 0; cy < loaded->ChunksY(); ++cy)
+		{
+			for (int cz = 0; cz < loaded->ChunksZ(); ++cz)
+			{
+				for (int cx = 0; cx < loaded->ChunksX(); ++cx, ++i)
+				{
+					if (i >= expected.size() || std::memcmp(loaded->GetChunk(cx, cy, cz).Blocks, expected[i].Blocks, sizeof(Chunk)) != 0)
+						return false;
+				}
+			}
+		}
+		return i == expected.size();
+	}
+
+	// Opens the save as a restarted game would, loads it, and checks it holds the base
+	// world with exactly the first edits, as many as were recovered from the journal.
+	bool LoadMatches(const std::string& directory, int threads, const World& world, const std::vector<Chunk>& base,
+		const std::vector<BlockEdit>& edits, std::uint64_t& recovered)
+	{
+		WorldSave save(directory);
+		recovered = save.Stats().EditsRecovered;
+		std::unique_ptr<World> loaded = save.LoadWorld(nullptr, threads);
+		return recovered <= edits.size() && SameWorld(loaded.get(), ApplyEdits(world, base, edits, (std::size_t)recovered));
+	}
+
+	void PrintCheck(const char* name, bool ok, bool last = false)
+	{
+		std::printf("    \"%s\": %s%s\n", name, ok ? "true" : "false", last ? "" : ",");
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: EditJournalBenchmark [--size N] [--seed N] [--threads N] [--dir path] [--edits N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	WorldGenParams params;
+	params.Seed = 1;
+	int threads = 0;
+	int editCount = 100000;
+	std::string directory = "EditJournalBenchmark.save";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--size") == 0)
+			params.Size = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			params.Seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--threads") == 0)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--dir") == 0)
+			directory = argv[++i];
+		else if (std::strcmp(argv[i], "--edits") == 0)
+			editCount = std::atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (params.Size <= 0 || threads < 0 || editCount <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (threads == 0)
+		threads = DefaultThreadCount();
+
+	std::unique_ptr<World> world = WorldGenerator(params).Generate(threads);
+	const std::vector<Chunk> base = CopyChunks(*world);
+	std::mt19937 random(params.Seed);
+
+	std::vector<std::string> paths, regions;
+	{
+		WorldSave save(directory);
+		paths = SavePaths(save, *world);
+		regions = RegionPaths(save, *world);
+	}
+	auto saveBase = [&]()
+	{
+		RemoveSave(paths);
+		WorldSave save(directory);
+		save.SaveWorld(*world, params.Seed, WorldGenerator::Version);
+		save.Flush();
+	};
+
+	// Throughput.  Checkpoints run as the edits pass CheckpointEdits, as in a game.
+	std::vector<BlockEdit> edits = MakeEdits(*world, base, editCount, random);
+	double queueMs, journalMs, checkpointMs;
+	std::uint64_t journaled, checkpoints, checkpointed;
+	bool throughputOk;
+	{
+		saveBase();
+		WorldSave save(directory);
+		Clock::time_point start = Clock::now();
+		for (const BlockEdit& e : edits)
+			save.SaveEdit(e);
+		queueMs = MillisecondsSince(start);
+		save.Flush();
+		journalMs = MillisecondsSince(start);
+
+		throughputOk = save.Checkpoint() && save.UncheckpointedEdits() == 0;
+
+		WorldSaveStats stats = save.Stats();
+		journaled = stats.EditsJournaled;
+		checkpoints = stats.Checkpoints;
+		checkpointed = stats.EditsCheckpointed;
+		checkpointMs = stats.CheckpointMs;
+		throughputOk = throughputOk && journaled == (std::uint64_t)editCount && checkpointed == (std::uint64_t)editCount;
+	}
+	{
+		WorldSave save(directory);
+		std::unique_ptr<World> loaded = save.LoadWorld(nullptr, threads);
+		throughputOk = throughputOk && SameWorld(loaded.get(), ApplyEdits(*world, base, edits, edits.size()));
+	}
+
+	// The same edits saved the way SaveChunk alone would, the whole chunk each time.
+	double rewriteMs;
+	const int rewriteEdits = (std::min)(editCount, ChunkRewriteEdits);
+	{
+		saveBase();
+		std::vector<Chunk> chunks = base;
+		WorldSave save(directory);
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < rewriteEdits; ++i)
+		{
+			const BlockEdit& e = edits[i];
+			Chunk& chunk = chunks[e.ChunkX + world->ChunksX() * (e.ChunkZ + world->ChunksZ() * e.ChunkY)];
+			chunk.Blocks[e.Index] = e.New;
+			save.SaveChunk(e.ChunkX, e.ChunkY, e.ChunkZ, chunk);
+			save.Flush();
+		}
+		rewriteMs = MillisecondsSince(start);
+	}
+
+	// Recovery.  journaledCopy is the save after the edits reached the journal,
+	// foldedCopy after they were checkpointed.
+	edits = MakeEdits(*world, base, RecoveryEdits, random);
+	const std::string journalPath = directory + "/edits.journal";
+	SaveCopy journaledCopy, foldedCopy;
+	{
+		saveBase();
+		WorldSave save(directory);
+		for (std::size_t i = 0; i < edits.size(); ++i)
+		{
+			save.SaveEdit(edits[i]);
+			if (i % 100 == 99)
+				save.Flush();   // several frames, so a torn tail can cut between them
+		}
+		save.Flush();
+		journaledCopy = CopySave(paths);
+		save.Checkpoint();
+		foldedCopy = CopySave(paths);
+	}
+	const std::size_t journalBytes = FindFile(journaledCopy, journalPath)->Bytes.size();
+	std::uint64_t recovered = 0;
+
+	RestoreSave(journaledCopy);
+	bool replayOk = LoadMatches(directory, threads, *world, base, edits, recovered) && recovered == edits.size();
+
+	bool tornOk = true;
+	std::uint64_t lastRecovered = 0;
+	for (int cut = 0; cut <= TornTailCuts && tornOk; ++cut)
+	{
+		SaveCopy torn = journaledCopy;
+		FindFile(torn, journalPath)->Bytes.resize(BlockJournal::HeaderBytes + (journalBytes - BlockJournal::HeaderBytes) * cut / TornTailCuts);
+		RestoreSave(torn);
+		tornOk = LoadMatches(directory, threads, *world, base, edits, recovered) && recovered >= lastRecovered &&
+			(cut < TornTailCuts || recovered == edits.size());
+		lastRecovered = recovered;
+	}
+
+	SaveCopy corrupt = journaledCopy;
+	FindFile(corrupt, journalPath)->Bytes[journalBytes / 2] ^= 0x5a;
+	RestoreSave(corrupt);
+	bool corruptOk = LoadMatches(directory, threads, *world, base, edits, recovered) && recovered < edits.size();
+
+	SaveCopy refold = foldedCopy;
+	*FindFile(refold, journalPath) = *FindFile(journaledCopy, journalPath);
+	RestoreSave(refold);
+	bool refoldOk = LoadMatches(directory, threads, *world, base, edits, recovered) && recovered == edits.size();
+
+	SaveCopy partial = journaledCopy;
+	for (std::size_t i = 0; i < regions.size(); i += 2)
+		*FindFile(partial, regions[i]) = *FindFile(foldedCopy, regions[i]);
+	RestoreSave(partial);
+	bool partialOk = LoadMatches(directory, threads, *world, base, edits, recovered) && recovered == edits.size();
+
+	// Checkpointed edits are in the regions, so the reopened save recovers none.
+	bool checkpointedOk;
+	RestoreSave(journaledCopy);
+	{
+		WorldSave save(directory);
+		checkpointedOk = save.Checkpoint() && save.UncheckpointedEdits() == 0;
+	}
+	const std::vector<Chunk> expected = ApplyEdits(*world, base, edits, edits.size());
+	{
+		WorldSave save(directory);
+		std::unique_ptr<World> loaded = save.LoadWorld(nullptr, threads);
+		checkpointedOk = checkpointedOk && save.Stats().EditsRecovered == 0 && SameWorld(loaded.get(), expected);
+	}
+
+	RemoveSave(paths);
+
+	bool verified = throughputOk && replayOk && tornOk && corruptOk && refoldOk && partialOk && checkpointedOk;
+
+	std::printf("{\n");
+	std::printf("  \"size\": %d,\n", params.Size);
+	std::printf("  \"seed\": %u,\n", (unsigned)params.Seed);
+	std::printf("  \"threads\": %d,\n", threads);
+	std::printf("  \"edits\": %d,\n", editCount);
+	std::printf("  \"edit_queue_per_second\": %.0f,\n", PerSecond(editCount, queueMs));
+	std::printf("  \"edits_journaled_per_second\": %.0f,\n", PerSecond(editCount, journalMs));
+	std::printf("  \"chunk_rewrite_edits_per_second\": %.0f,\n", PerSecond(rewriteEdits, rewriteMs));
+	std::printf("  \"journal_bytes_per_edit\": %.1f,\n", (double)journalBytes / RecoveryEdits);
+	std::printf("  \"checkpoints\": %llu,\n", (unsigned long long)checkpoints);
+	std::printf("  \"checkpoint_ms\": %.3f,\n", checkpointMs);
+	std::printf("  \"checkpointed_edits_per_second\": %.0f,\n", PerSecond((double)checkpointed, checkpointMs));
+	std::printf("  \"recovery\": {\n");
+	PrintCheck("replay", replayOk);
+	PrintCheck("torn_tail", tornOk);
+	PrintCheck("corrupt_frame", corruptOk);
+	PrintCheck("refold", refoldOk);
+	PrintCheck("partial_fold", partialOk);
+	PrintCheck("checkpointed", checkpointedOk, true);
+	std::printf("  },\n");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
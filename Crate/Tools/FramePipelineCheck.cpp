@@ -0,0 +1,159 @@
+//***************************************************************************************
+// FramePipelineCheck.cpp
+//
+// Headless producer/consumer check of FramePipeline, with the render thread played by
+// main and a simulation that stamps each snapshot:
+//
+//   handoff    every snapshot is the next frame, built from the input handed over one
+//              frame earlier, and a slot is never written while it is being read
+//   slow_gpu   the "render" sleeps as a GPU- or vsync-bound frame would; the simulation
+//              thread must sleep too rather than spin, so the process uses little CPU
+//   slow_sim   the simulation sleeps instead; the render thread's wait is counted as
+//              stall time, and it must not spin either
+//
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.  CPU time is
+// read with std::clock, which counts the time of every thread of the process on Linux.
+//
+// Usage: FramePipelineCheck [--frames N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/FramePipelineCheck.cpp -o FramePipelineCheck
+//***************************************************************************************
+
+#include "../Common/FramePipeline.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct TestInput
+	{
+		std::uint64_t Value = 0;
+	};
+
+	struct TestSnapshot
+	{
+		std::uint64_t Frame = 0;
+		std::uint64_t Input = 0;
+		std::uint64_t Payload[64];   // written whole by the simulation, checked by the render
+	};
+
+	struct RunResult
+	{
+		bool HandoffOk = true;
+		double WallMs = 0.0;
+		double CpuMs = 0.0;
+		FramePipelineStats Stats;
+	};
+
+	// Slots being read by the render thread; the simulation must never write one.
+	std::atomic<int> gReading[2];
+	std::atomic<bool> gOverwrite(false);
+
+	RunResult Run(int frames, int renderSleepMs, int simSleepMs)
+	{
+		RunResult result;
+		std::uint64_t simulated = 0;
+		FramePipeline<TestInput, TestSnapshot> pipeline([&](const TestInput& input, TestSnapshot& snapshot)
+		{
+			if (gReading[simulated % 2].load() != 0)
+				gOverwrite.store(true);
+			if (simSleepMs > 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(simSleepMs));
+			snapshot.Frame = simulated++;
+			snapshot.Input = input.Value;
+			for (std::uint64_t& p : snapshot.Payload)
+				p = snapshot.Frame * 31 + snapshot.Input;
+		});
+
+		Clock::time_point start = Clock::now();
+		std::clock_t cpuStart = std::clock();
+		for (int i = 0; i < frames; ++i)
+		{
+			TestInput input;
+			input.Value = 1000 + i;
+			const TestSnapshot& snapshot = pipeline.BeginFrame(input);
+			int slot = (int)(snapshot.Frame % 2);
+			gReading[slot].store(1);
+
+			// Snapshot 0 and 1 are both simulated from the first input.
+			std::uint64_t expectedInput = 1000 + (i > 0 ? i - 1 : 0);
+			bool ok = snapshot.Frame == (std::uint64_t)i && snapshot.Input == expectedInput;
+			if (renderSleepMs > 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(renderSleepMs));
+			for (std::uint64_t p : snapshot.Payload)
+				ok = ok && p == snapshot.Frame * 31 + snapshot.Input;
+			result.HandoffOk = result.HandoffOk && ok;
+
+			gReading[slot].store(0);
+			pipeline.EndFrame();
+		}
+		result.CpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+		result.WallMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		result.Stats = pipeline.Stats();
+		return result;
+	}
+
+	void PrintRun(const char* name, const RunResult& r, bool ok, bool last)
+	{
+		std::printf("  \"%s\": { \"wall_ms\": %.1f, \"cpu_ms\": %.1f, \"cpu_share\": %.3f, \"frames\": %llu, "
+			"\"wait_ms\": %.1f, \"handoff_ok\": %s, \"ok\": %s }%s\n", name, r.WallMs, r.CpuMs,
+			r.CpuMs / (r.WallMs > 0.0 ? r.WallMs : 1.0), (unsigned long long)r.Stats.Frames, r.Stats.WaitMs,
+			r.HandoffOk ? "true" : "false", ok ? "true" : "false", last ? "" : ",");
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: FramePipelineCheck [--frames N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 100000;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 < argc && std::strcmp(argv[i], "--frames") == 0)
+			frames = std::atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (frames < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Idle phases are short; 100 frames of 5 ms show whether either thread spins.
+	const int idleFrames = 100;
+	RunResult handoff = Run(frames, 0, 0);
+	RunResult slowGpu = Run(idleFrames, 5, 0);
+	RunResult slowSim = Run(idleFrames, 0, 5);
+
+	bool handoffOk = handoff.HandoffOk && handoff.Stats.Frames == (std::uint64_t)frames;
+	bool slowGpuOk = slowGpu.HandoffOk && slowGpu.CpuMs < 0.25 * slowGpu.WallMs;
+	bool slowSimOk = slowSim.HandoffOk && slowSim.CpuMs < 0.25 * slowSim.WallMs &&
+		slowSim.Stats.WaitMs > 0.5 * slowSim.WallMs;
+	bool overwriteOk = !gOverwrite.load();
+	bool verified = handoffOk && slowGpuOk && slowSimOk && overwriteOk;
+
+	std::printf("{\n");
+	PrintRun("handoff", handoff, handoffOk, false);
+	PrintRun("slow_gpu", slowGpu, slowGpuOk, false);
+	PrintRun("slow_sim", slowSim, slowSimOk, false);
+	std::printf("  \"handoffs_per_second\": %.0f,\n", frames / (handoff.WallMs / 1000.0));
+	std::printf("  \"slot_overwritten\": %s,\n", overwriteOk ? "false" : "true");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
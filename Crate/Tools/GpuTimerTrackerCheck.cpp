@@ -0,0 +1,307 @@
+//***************************************************************************************
+// GpuTimerTrackerCheck.cpp
+//
+// Headless checks of GpuTimerTracker, driven the way GpuTimer drives it from CrateApp:
+// one query slot per frame resource, a fence per submitted frame, and a simulated GPU
+// that finishes frames a random number of frames later.  The GPU only writes a frame's
+// timestamps into its slot's readback when that frame completes, so a slot read early
+// shows the previous frame's values.
+//
+//   slots      frame n records into slot n % FrameResources, timers get queries 2i and
+//              2i+1 of their slot, and a slot is only reused once its frame was read
+//   fences     a frame is read once, in submission order, and only after its fence
+//              completes; every sample matches the timestamps its own frame wrote
+//   ticks      tick to millisecond conversion, including a timer straddling a counter
+//              reset and a zero frequency
+//   history    a timer's history keeps the last HistoryLength values once it wraps
+//   dropped    timers past the per-frame limit, timers never ended and frames begun
+//              again before being read are counted as dropped
+//
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: GpuTimerTrackerCheck [--frames N] [--seed N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/GpuTimerTrackerCheck.cpp Common/GpuTimerTracker.cpp
+//       -o GpuTimerTrackerCheck
+//***************************************************************************************
+
+#include "../Common/GpuTimerTracker.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	// CrateApp's gNumFrameResources, which sizes GpuTimer's slots.
+	const std::uint32_t FrameResources = 3;
+	const std::uint32_t MaxTimers = 4;
+	const std::uint64_t Frequency = 10000000;   // 10 MHz, a typical timestamp rate
+
+	const char* TimerNames[] = { "frame", "opaque", "alphaTested" };
+
+	// Ticks timer i of frame n takes; distinct per frame so a stale slot is noticed.
+	std::uint64_t Duration(std::uint64_t frame, std::uint32_t timer)
+	{
+		return 1000 * (timer + 1) + frame % 997;
+	}
+
+	bool Near(double a, double b)
+	{
+		return std::fabs(a - b) <= 1e-9 * (std::fabs(b) > 1.0 ? std::fabs(b) : 1.0);
+	}
+
+	struct PipelineResult
+	{
+		bool SlotsOk = true;
+		bool FencesOk = true;
+		std::uint64_t Resolved = 0;
+		std::uint64_t Samples = 0;
+		std::uint32_t MaxPending = 0;
+	};
+
+	PipelineResult RunPipeline(int frames, std::mt19937& rng)
+	{
+		PipelineResult result;
+		GpuTimerTracker tracker(FrameResources, MaxTimers);
+		result.SlotsOk = tracker.FrameCount() == FrameResources && tracker.QueriesPerFrame() == 2 * MaxTimers;
+
+		// What each slot's readback buffer holds, written when the GPU finishes a frame.
+		std::vector<std::vector<std::uint64_t>> readback(FrameResources, std::vector<std::uint64_t>(2 * MaxTimers, 0));
+		std::vector<std::uint64_t> slotFence(FrameResources, 0);   // last fence submitted in each slot
+		std::uint64_t submitted = 0;
+		std::uint64_t completed = 0;
+		std::uint64_t nextToRead = 1;
+		std::vector<GpuTimerSample> samples;
+
+		auto complete = [&](std::uint64_t fence)
+		{
+			// Frame fence - 1 ran in slot (fence - 1) % FrameResources.
+			std::uint64_t frame = fence - 1;
+			std::vector<std::uint64_t>& slot = readback[frame % FrameResources];
+			std::uint64_t start = 1000000 * fence;
+			for (std::uint32_t t = 0; t < 3; ++t)
+			{
+				slot[2 * t] = start;
+				slot[2 * t + 1] = start + Duration(frame, t);
+			}
+			completed = fence;
+		};
+
+		for (int n = 0; n < frames; ++n)
+		{
+			std::uint32_t slot = (std::uint32_t)(n % FrameResources);
+
+			// The GPU catches up by a random amount, and the CPU waits for the frame that
+			// last used this slot, as CrateApp does before reusing a frame resource.
+			std::uint64_t target = completed + rng() % 3;
+			if (target < slotFence[slot])
+				target = slotFence[slot];
+			if (target > submitted)
+				target = submitted;
+			while (completed < target)
+				complete(completed + 1);
+			std::uint32_t pending = (std::uint32_t)(submitted - completed);
+			result.MaxPending = pending > result.MaxPending ? pending : result.MaxPending;
+
+			// GpuTimer::BeginFrame: read every frame that is done, oldest first.
+			std::uint32_t ready;
+			while (tracker.NextReady(completed, ready))
+			{
+				std::uint64_t fence = nextToRead++;
+				result.FencesOk = result.FencesOk && fence <= completed && ready == (fence - 1) % FrameResources;
+
+				tracker.Resolve(ready, readback[ready].data(), Frequency, samples);
+				++result.Resolved;
+				result.Samples += samples.size();
+				result.FencesOk = result.FencesOk && samples.size() == 3;
+				for (std::size_t t = 0; t < samples.size() && t < 3; ++t)
+				{
+					double expected = 1000.0 * Duration(fence - 1, (std::uint32_t)t) / Frequency;
+					result.FencesOk = result.FencesOk && std::strcmp(samples[t].Name, TimerNames[t]) == 0 &&
+						Near(samples[t].Milliseconds, expected);
+				}
+			}
+			// Every frame still pending has a fence the GPU has not reached.
+			result.FencesOk = result.FencesOk && nextToRead == completed + 1;
+
+			tracker.BeginFrame(slot);
+			std::uint32_t frameBegin = tracker.BeginTimer("frame");
+			std::uint32_t opaqueBegin = tracker.BeginTimer("opaque");
+			std::uint32_t opaqueEnd = tracker.EndTimer("opaque");
+			std::uint32_t alphaBegin = tracker.BeginTimer("alphaTested");
+			std::uint32_t alphaEnd = tracker.EndTimer("alphaTested");
+			std::uint32_t frameEnd = tracker.EndTimer("frame");
+			result.SlotsOk = result.SlotsOk && frameBegin == 0 && frameEnd == 1 && opaqueBegin == 2 && opaqueEnd == 3 &&
+				alphaBegin == 4 && alphaEnd == 5 && tracker.UsedQueries() == 6;
+
+			tracker.EndFrame(++submitted);
+			slotFence[slot] = submitted;
+		}
+
+		// Drain: everything submitted is read once the GPU is idle.
+		while (completed < submitted)
+			complete(completed + 1);
+		std::uint32_t ready;
+		while (tracker.NextReady(completed, ready))
+		{
+			tracker.Resolve(ready, readback[ready].data(), Frequency, samples);
+			++nextToRead;
+			++result.Resolved;
+			result.Samples += samples.size();
+		}
+		result.FencesOk = result.FencesOk && result.Resolved == (std::uint64_t)frames &&
+			result.Samples == 3ull * frames && tracker.DroppedTimers() == 0;
+		return result;
+	}
+
+	bool CheckTicks()
+	{
+		GpuTimerTracker tracker(1, 3);
+		std::vector<GpuTimerSample> samples;
+		tracker.BeginFrame(0);
+		tracker.BeginTimer("a");
+		tracker.EndTimer("a");
+		tracker.BeginTimer("reset");
+		tracker.EndTimer("reset");
+		tracker.BeginTimer("b");
+		tracker.EndTimer("b");
+		tracker.EndFrame(1);
+
+		// 24000 ticks at 24 MHz is 1 ms; the second timer's end is before its begin.
+		const std::uint64_t timestamps[] = { 1000, 25000, 900000, 100, 0, 12000000 };
+		std::uint32_t ready = 0;
+		bool ok = tracker.NextReady(1, ready) && ready == 0;
+		tracker.Resolve(ready, timestamps, 24000000, samples);
+		ok = ok && samples.size() == 3 && Near(samples[0].Milliseconds, 1.0) && samples[1].Milliseconds == 0.0 &&
+			Near(samples[2].Milliseconds, 500.0) && samples[0].Begin == 1000 && samples[0].End == 25000;
+
+		// Without a frequency there is nothing to convert with.
+		tracker.BeginFrame(0);
+		tracker.BeginTimer("a");
+		tracker.EndTimer("a");
+		tracker.EndFrame(2);
+		ok = ok && tracker.NextReady(2, ready);
+		tracker.Resolve(ready, timestamps, 0, samples);
+		ok = ok && samples.size() == 1 && samples[0].Milliseconds == 0.0;
+		return ok;
+	}
+
+	bool CheckHistory()
+	{
+		const std::uint32_t length = GpuTimingHistory::HistoryLength;
+		GpuTimingHistory history;
+		bool ok = history.SeriesCount() == 0;
+
+		// 1, 2, ..., length + 72: only the last length values are kept.
+		std::uint32_t total = length + 72;
+		for (std::uint32_t i = 1; i <= total; ++i)
+			history.Add("opaque", (double)i);
+		double first = (double)(total - length + 1);
+		ok = ok && history.SeriesCount() == 1 && history.Latest(0) == (double)total &&
+			Near(history.Average(0), (first + total) / 2.0) && history.Max(0) == (double)total;
+
+		// A spike leaves the maximum once it has been overwritten.
+		history.Add("opaque", 1000.0);
+		ok = ok && history.Max(0) == 1000.0;
+		for (std::uint32_t i = 0; i < length; ++i)
+			history.Add("opaque", 0.5);
+		ok = ok && history.Max(0) == 0.5 && Near(history.Average(0), 0.5) && history.Latest(0) == 0.5;
+
+		// Names are compared by value, not by pointer.
+		char name[] = "opaque";
+		history.Add(name, 0.5);
+		history.Add("transparent", 2.0);
+		ok = ok && history.SeriesCount() == 2 && history.Latest(1) == 2.0 && history.Average(1) == 2.0;
+		return ok;
+	}
+
+	bool CheckDropped()
+	{
+		GpuTimerTracker tracker(2, 2);
+		bool ok = true;
+
+		// A third timer does not fit; "open" is never ended.
+		tracker.BeginFrame(0);
+		ok = ok && tracker.BeginTimer("a") == 0 && tracker.BeginTimer("open") == 2;
+		ok = ok && tracker.BeginTimer("extra") == GpuTimerTracker::Invalid && tracker.EndTimer("extra") == GpuTimerTracker::Invalid;
+		ok = ok && tracker.EndTimer("a") == 1;
+		tracker.EndFrame(1);
+		ok = ok && tracker.DroppedTimers() == 1;
+
+		std::uint32_t ready = 0;
+		ok = ok && !tracker.NextReady(0, ready) && tracker.NextReady(1, ready) && ready == 0;
+		const std::uint64_t timestamps[] = { 0, 10, 0, 0 };
+		std::vector<GpuTimerSample> samples;
+		tracker.Resolve(ready, timestamps, 1000, samples);
+		ok = ok && samples.size() == 1 && tracker.DroppedTimers() == 2 && !tracker.NextReady(1, ready);
+
+		// Slot 1 is begun again while its frame is still pending: both timers are lost.
+		tracker.BeginFrame(1);
+		tracker.BeginTimer("a");
+		tracker.EndTimer("a");
+		tracker.BeginTimer("b");
+		tracker.EndTimer("b");
+		tracker.EndFrame(2);
+		tracker.BeginFrame(1);
+		ok = ok && tracker.DroppedTimers() == 4 && tracker.UsedQueries() == 0;
+		return ok;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: GpuTimerTrackerCheck [--frames N] [--seed N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int frames = 100000;
+	std::uint32_t seed = 1;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--frames") == 0)
+			frames = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (frames <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	PipelineResult pipeline = RunPipeline(frames, rng);
+	bool ticksOk = CheckTicks();
+	bool historyOk = CheckHistory();
+	bool droppedOk = CheckDropped();
+	bool verified = pipeline.SlotsOk && pipeline.FencesOk && ticksOk && historyOk && droppedOk;
+
+	std::printf("{\n");
+	std::printf("  \"frames\": %d,\n", frames);
+	std::printf("  \"frames_resolved\": %llu,\n", (unsigned long long)pipeline.Resolved);
+	std::printf("  \"samples\": %llu,\n", (unsigned long long)pipeline.Samples);
+	std::printf("  \"max_pending_frames\": %u,\n", pipeline.MaxPending);
+	std::printf("  \"slots_ok\": %s,\n", pipeline.SlotsOk ? "true" : "false");
+	std::printf("  \"fences_ok\": %s,\n", pipeline.FencesOk ? "true" : "false");
+	std::printf("  \"ticks_ok\": %s,\n", ticksOk ? "true" : "false");
+	std::printf("  \"history_ok\": %s,\n", historyOk ? "true" : "false");
+	std::printf("  \"dropped_ok\": %s,\n", droppedOk ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,415 @@
+//***************************************************************************************
+// InputRecordingCheck.cpp
+//
+// Headless checks of InputRecording, InputPlayer and FixedTimestep:
+//
+//   roundtrip  a random session is recorded, saved, loaded and played back frame for
+//              frame; seed and time step survive
+//   encoding   a step with the keys and camera of the previous one and no mouse-look
+//              is one byte, and the other fields cost exactly what the header says
+//   truncated  truncated recordings are refused, on disk and in memory, as are a wrong
+//              magic or version, trailing bytes and an unknown camera mode in any step
+//   timestep   replaying the recording through FixedTimestep at 30, 60, 144 and a
+//              jittery 40-240 frames per second gives the same camera path, step for
+//              step, while integrating with the frame time does not
+//
+// The camera is a stand-in for CrateApp's: the same Walk, Strafe, FlyUp, Pitch and
+// RotateY moves at 10 units per second, in plain floats instead of DirectXMath.
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: InputRecordingCheck [--steps N] [--seed N] [--dir path]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/InputRecordingCheck.cpp Common/InputRecording.cpp
+//       -o InputRecordingCheck
+//***************************************************************************************
+
+#include "../Common/InputRecording.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+namespace
+{
+	struct Float3
+	{
+		float x = 0.0f, y = 0.0f, z = 0.0f;
+	};
+
+	// Rotates v about a unit axis.
+	Float3 Rotate(const Float3& v, const Float3& axis, float angle)
+	{
+		float c = std::cos(angle), s = std::sin(angle);
+		float d = (v.x * axis.x + v.y * axis.y + v.z * axis.z) * (1.0f - c);
+		Float3 r;
+		r.x = v.x * c + (axis.y * v.z - axis.z * v.y) * s + axis.x * d;
+		r.y = v.y * c + (axis.z * v.x - axis.x * v.z) * s + axis.y * d;
+		r.z = v.z * c + (axis.x * v.y - axis.y * v.x) * s + axis.z * d;
+		return r;
+	}
+
+	struct TestCamera
+	{
+		Float3 Position;
+		Float3 Right;
+		Float3 Up;
+		Float3 Look;
+		CameraMode Mode = CameraMode::ThirdPerson;
+
+		TestCamera()
+		{
+			Position.y = 40.0f;
+			Right.x = 1.0f;
+			Up.y = 1.0f;
+			Look.z = 1.0f;
+		}
+
+		void Move(const Float3& direction, float d)
+		{
+			Position.x += d * direction.x;
+			Position.y += d * direction.y;
+			Position.z += d * direction.z;
+		}
+
+		// One simulation step, as CrateApp::Simulate and OnKeyboardInput apply it.
+		void Step(const InputFrame& frame, float dt)
+		{
+			Mode = frame.Camera;
+			if (Mode != CameraMode::ThirdPerson)
+			{
+				Up = Rotate(Up, Right, frame.MouseDy);
+				Look = Rotate(Look, Right, frame.MouseDy);
+				Float3 y;
+				y.y = 1.0f;
+				Right = Rotate(Right, y, frame.MouseDx);
+				Up = Rotate(Up, y, frame.MouseDx);
+				Look = Rotate(Look, y, frame.MouseDx);
+			}
+
+			if (frame.Down(InputKey::Forward) && Mode != CameraMode::ThirdPerson)
+				Move(Look, 10.0f * dt);
+			if (frame.Down(InputKey::Back))
+				Move(Look, -10.0f * dt);
+			if (frame.Down(InputKey::StrafeLeft))
+				Move(Right, -10.0f * dt);
+			if (frame.Down(InputKey::StrafeRight))
+				Move(Right, 10.0f * dt);
+			if (frame.Down(InputKey::FlyUp))
+				Move(Up, 10.0f * dt);
+			if (frame.Down(InputKey::FlyDown))
+				Move(Up, -10.0f * dt);
+
+			if (frame.Down(InputKey::FirstPerson))
+				Mode = CameraMode::FirstPerson;
+			if (frame.Down(InputKey::ThirdPerson))
+				Mode = CameraMode::ThirdPerson;
+			if (frame.Down(InputKey::FreeCamera))
+				Mode = CameraMode::Free;
+		}
+	};
+
+	// A session with held keys, bursts of mouse-look and the odd camera switch.
+	InputRecording MakeSession(int steps, std::mt19937& rng)
+	{
+		InputRecording recording;
+		recording.Seed = rng();
+		InputFrame frame;
+		frame.Camera = CameraMode::Free;
+		for (int i = 0; i < steps; ++i)
+		{
+			frame.MouseDx = frame.MouseDy = 0.0f;
+			if (rng() % 20 == 0)
+				frame.SetDown((InputKey)(rng() % (std::uint32_t)InputKey::FirstPerson), rng() % 2 == 0);
+			if (rng() % 4 == 0)
+			{
+				frame.MouseDx = ((int)(rng() % 201) - 100) * 0.0005f;
+				frame.MouseDy = ((int)(rng() % 201) - 100) * 0.0002f;
+			}
+			if (rng() % 500 == 0)
+				frame.Camera = (CameraMode)(rng() % (std::uint32_t)CameraMode::Count);
+			recording.Frames.push_back(frame);
+		}
+		return recording;
+	}
+
+	bool ReadFile(const std::string& path, std::vector<std::uint8_t>& data)
+	{
+		std::ifstream fin(path.c_str(), std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+		return (bool)fin || fin.eof();
+	}
+
+	bool WriteFile(const std::string& path, const std::uint8_t* data, std::size_t size)
+	{
+		std::ofstream fout(path.c_str(), std::ios::binary | std::ios::trunc);
+		fout.write((const char*)data, size);
+		return (bool)fout;
+	}
+
+	bool CheckRoundTrip(const InputRecording& recording, const std::string& path, std::size_t& fileBytes)
+	{
+		if (!recording.Save(path))
+			return false;
+
+		InputRecording loaded;
+		bool ok = loaded.Load(path) && loaded.Seed == recording.Seed && loaded.TimeStep == recording.TimeStep &&
+			loaded.Frames.size() == recording.Frames.size();
+
+		InputPlayer player(loaded);
+		InputFrame frame;
+		std::size_t played = 0;
+		while (ok && player.Next(frame))
+			ok = frame == recording.Frames[played++];
+		ok = ok && played == recording.Frames.size() && player.Finished() && !player.Next(frame);
+
+		std::vector<std::uint8_t> data;
+		ok = ok && ReadFile(path, data);
+		fileBytes = data.size();
+
+		// A different time step and seed come back too.
+		InputRecording other = recording;
+		other.Seed = 7;
+		other.TimeStep = 1.0f / 144.0f;
+		std::vector<std::uint8_t> otherData;
+		other.Serialize(otherData);
+		InputRecording otherLoaded;
+		ok = ok && otherLoaded.Deserialize(otherData.data(), otherData.size()) && otherLoaded.Seed == 7 &&
+			otherLoaded.TimeStep == 1.0f / 144.0f && otherLoaded.Frames == recording.Frames;
+		return ok;
+	}
+
+	bool CheckEncoding()
+	{
+		const std::size_t header = 20;
+		InputRecording recording;
+		InputFrame frame;
+		frame.SetDown(InputKey::Forward, true);
+		recording.Frames.push_back(frame);           // flags + u16 keys
+		for (int i = 0; i < 99; ++i)
+			recording.Frames.push_back(frame);       // flags only
+		frame.MouseDx = 0.25f;
+		recording.Frames.push_back(frame);           // flags + 2 f32
+		frame.MouseDx = 0.0f;
+		frame.Camera = CameraMode::Free;
+		recording.Frames.push_back(frame);           // flags + u8 camera
+		recording.Frames.push_back(frame);           // flags only
+
+		std::vector<std::uint8_t> data;
+		recording.Serialize(data);
+		bool ok = data.size() == header + 3 + 99 + 9 + 2 + 1;
+
+		// A default frame differs from nothing, so an idle session is one byte a step.
+		InputRecording idle;
+		idle.Frames.resize(1000);
+		idle.Serialize(data);
+		ok = ok && data.size() == header + 1000;
+
+		InputRecording loaded;
+		ok = ok && loaded.Deserialize(data.data(), data.size()) && loaded.Frames == idle.Frames;
+		return ok;
+	}
+
+	bool CheckTruncated(const InputRecording& recording, const std::string& path)
+	{
+		std::vector<std::uint8_t> data;
+		recording.Serialize(data);
+
+		// Every prefix of the first 2000 steps; each refusal reads the whole prefix.
+		InputRecording head = recording;
+		if (head.Frames.size() > 2000)
+			head.Frames.resize(2000);
+		std::vector<std::uint8_t> headData;
+		head.Serialize(headData);
+
+		bool ok = true;
+		InputRecording loaded;
+		for (std::size_t size = 0; size < headData.size() && ok; ++size)
+			ok = !loaded.Deserialize(headData.data(), size) && loaded.Frames.empty();
+
+		// A few truncated files on disk, including an empty one.
+		std::size_t sizes[] = { 0, 3, 19, 20, data.size() / 2, data.size() - 1 };
+		for (std::size_t size : sizes)
+		{
+			ok = ok && WriteFile(path, data.data(), size);
+			ok = ok && !loaded.Load(path) && loaded.Frames.empty();
+		}
+		ok = ok && !loaded.Load(path + ".missing");
+
+		std::vector<std::uint8_t> bad = data;
+		bad[0] = 'X';
+		ok = ok && !loaded.Deserialize(bad.data(), bad.size());
+
+		bad = data;
+		bad[4] = InputRecording::Version + 1;
+		ok = ok && !loaded.Deserialize(bad.data(), bad.size());
+
+		bad = data;
+		bad.push_back(0);
+		ok = ok && !loaded.Deserialize(bad.data(), bad.size());
+
+		// A single step switching to camera mode 3.
+		InputRecording one;
+		InputFrame frame;
+		frame.Camera = CameraMode::Free;
+		one.Frames.push_back(frame);
+		one.Serialize(bad);
+		bad.back() = (std::uint8_t)CameraMode::Count;
+		ok = ok && !loaded.Deserialize(bad.data(), bad.size());
+
+		// The untouched recording still loads.
+		ok = ok && loaded.Deserialize(data.data(), data.size()) && loaded.Frames == recording.Frames;
+		return ok;
+	}
+
+	// Replays the recording at a render frame rate the way CrateApp's replay does: each
+	// frame asks FixedTimestep how many steps to run.  Returns the camera after every step.
+	std::vector<TestCamera> Replay(const InputRecording& recording, double minFps, double maxFps, std::mt19937& rng)
+	{
+		std::vector<TestCamera> path;
+		FixedTimestep timestep(recording.TimeStep);
+		InputPlayer player(recording);
+		TestCamera camera;
+		std::uniform_real_distribution<double> fps(minFps, maxFps);
+		while (!player.Finished())
+		{
+			int steps = timestep.Advance(1.0 / fps(rng));
+			InputFrame frame;
+			for (int s = 0; s < steps && player.Next(frame); ++s)
+			{
+				camera.Step(frame, timestep.Step());
+				path.push_back(camera);
+			}
+		}
+		return path;
+	}
+
+	// The same input applied once per render frame with that frame's time, as live
+	// play does; the path depends on the frame rate.
+	TestCamera Integrate(const InputRecording& recording, double fpsValue)
+	{
+		TestCamera camera;
+		double step = recording.TimeStep;
+		double elapsed = 0.0;
+		double frameTime = 1.0 / fpsValue;
+		std::size_t next = 0;
+		while (next < recording.Frames.size())
+		{
+			elapsed += frameTime;
+			camera.Step(recording.Frames[next], (float)frameTime);
+			while (next < recording.Frames.size() && (next + 1) * step <= elapsed)
+				++next;
+		}
+		return camera;
+	}
+
+	bool SameCamera(const TestCamera& a, const TestCamera& b)
+	{
+		return std::memcmp(&a.Position, &b.Position, sizeof(Float3)) == 0 && std::memcmp(&a.Look, &b.Look, sizeof(Float3)) == 0 &&
+			a.Mode == b.Mode;
+	}
+
+	float Distance(const TestCamera& a, const TestCamera& b)
+	{
+		float dx = a.Position.x - b.Position.x, dy = a.Position.y - b.Position.y, dz = a.Position.z - b.Position.z;
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	struct TimestepResult
+	{
+		bool Ok = true;
+		float VariableDrift = 0.0f;   // distance between the 30 and 144 fps end points without fixed steps
+	};
+
+	TimestepResult CheckTimestep(const InputRecording& recording, std::mt19937& rng)
+	{
+		TimestepResult result;
+		std::vector<TestCamera> reference = Replay(recording, 60.0, 60.0, rng);
+		const double rates[][2] = { { 30.0, 30.0 }, { 144.0, 144.0 }, { 40.0, 240.0 } };
+		result.Ok = reference.size() == recording.Frames.size();
+		for (auto& rate : rates)
+		{
+			std::vector<TestCamera> path = Replay(recording, rate[0], rate[1], rng);
+			result.Ok = result.Ok && path.size() == reference.size();
+			for (std::size_t i = 0; i < path.size() && result.Ok; ++i)
+				result.Ok = SameCamera(path[i], reference[i]);
+		}
+
+		result.VariableDrift = Distance(Integrate(recording, 30.0), Integrate(recording, 144.0));
+		result.Ok = result.Ok && result.VariableDrift > 0.0f;
+
+		// A hitch runs at most maxSteps steps and drops the rest instead of catching up.
+		// A step of 1/64 s keeps the arithmetic exact.
+		FixedTimestep timestep(1.0f / 64.0f, 8);
+		int steps = timestep.Advance(1.0);
+		result.Ok = result.Ok && steps == 8 && timestep.DroppedSteps() == 56 && timestep.Advance(1.0 / 64.0) == 1;
+		return result;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: InputRecordingCheck [--steps N] [--seed N] [--dir path]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int steps = 20000;
+	std::uint32_t seed = 1;
+	std::string dir = ".";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--steps") == 0)
+			steps = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--dir") == 0)
+			dir = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (steps <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	std::mt19937 rng(seed);
+	InputRecording recording = MakeSession(steps, rng);
+	std::string path = dir + "/InputRecordingCheck.rec";
+
+	std::size_t fileBytes = 0;
+	bool roundTripOk = CheckRoundTrip(recording, path, fileBytes);
+	bool encodingOk = CheckEncoding();
+	bool truncatedOk = CheckTruncated(recording, path);
+	TimestepResult timestep = CheckTimestep(recording, rng);
+	std::remove(path.c_str());
+
+	bool verified = roundTripOk && encodingOk && truncatedOk && timestep.Ok;
+
+	std::printf("{\n");
+	std::printf("  \"steps\": %d,\n", steps);
+	std::printf("  \"seconds\": %.1f,\n", recording.Duration());
+	std::printf("  \"file_bytes\": %zu,\n", fileBytes);
+	std::printf("  \"bytes_per_step\": %.2f,\n", (double)fileBytes / steps);
+	std::printf("  \"frame_time_drift\": %.3f,\n", timestep.VariableDrift);
+	std::printf("  \"roundtrip_ok\": %s,\n", roundTripOk ? "true" : "false");
+	std::printf("  \"encoding_ok\": %s,\n", encodingOk ? "true" : "false");
+	std::printf("  \"truncated_ok\": %s,\n", truncatedOk ? "true" : "false");
+	std::printf("  \"timestep_ok\": %s,\n", timestep.Ok ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
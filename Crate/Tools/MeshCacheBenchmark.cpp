@@ -0,0 +1,266 @@
+//***************************************************************************************
+// MeshCacheBenchmark.cpp
+//
+// Headless benchmark of ChunkMeshCache.  Generates a world and meshes it with
+// ChunkMesher::BuildAll for reference, then through the cache in five passes:
+//
+//   cold      empty cache; chunks with equal content already hit each other
+//   revisit   the same cache again, served from memory as far as its budget allows
+//   restart   a new cache on the same directory, served from disk; one file is damaged
+//             first and must be refused and meshed again, so its hit rate falls short
+//             of 1 by that one miss; restart_hit_rate_undamaged leaves it out
+//   edit      one block changed on a chunk border; only the two chunks that see it miss
+//   budget    a memory-only cache too small for the world, which must stay in budget
+//
+// Every pass is checked mesh for mesh against ChunkMesher::BuildAll.  Prints one JSON
+// object to stdout; the exit code is 1 if a check fails.  The cache directory is
+// emptied before and after the run.
+//
+// Usage: MeshCacheBenchmark [--size N] [--seed N] [--threads N] [--dir path]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/MeshCacheBenchmark.cpp World.cpp
+//       WorldGenerator.cpp ChunkMesher.cpp PerlinNoise.cpp ChunkMeshCache.cpp
+//       Common/FileUtil.cpp Common/Profiler.cpp Common/MemoryTracker.cpp -o MeshCacheBenchmark
+//***************************************************************************************
+
+#include "../World.h"
+#include "../WorldGenerator.h"
+#include "../ChunkMesher.h"
+#include "../ChunkMeshCache.h"
+#include "../Common/ParallelFor.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	struct Pass
+	{
+		const char* Name;
+		double Ms;
+		ChunkMeshCacheStats Stats;
+		bool Ok;
+	};
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool SameMeshes(const std::vector<ChunkMesh>& a, const std::vector<ChunkMesh>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			const ChunkMesh& ma = a[i];
+			const ChunkMesh& mb = b[i];
+			if (ma.ChunkX != mb.ChunkX || ma.ChunkY != mb.ChunkY || ma.ChunkZ != mb.ChunkZ ||
+				std::memcmp(ma.Origin, mb.Origin, sizeof(ma.Origin)) != 0 ||
+				ma.Vertices.size() != mb.Vertices.size() || ma.Indices.size() != mb.Indices.size() ||
+				ma.Submeshes.size() != mb.Submeshes.size() ||
+				std::memcmp(ma.Vertices.data(), mb.Vertices.data(), ma.Vertices.size() * sizeof(ChunkVertex)) != 0 ||
+				std::memcmp(ma.Indices.data(), mb.Indices.data(), ma.Indices.size() * sizeof(std::uint32_t)) != 0)
+			{
+				return false;
+			}
+			for (std::size_t s = 0; s < ma.Submeshes.size(); ++s)
+			{
+				const ChunkSubmesh& sa = ma.Submeshes[s];
+				const ChunkSubmesh& sb = mb.Submeshes[s];
+				if (sa.Block != sb.Block || sa.IndexCount != sb.IndexCount || sa.StartIndex != sb.StartIndex || sa.BaseVertex != sb.BaseVertex)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Removes the mesh files the cache's index lists, and the index.
+	void ClearCache(const std::string& directory)
+	{
+		std::string indexPath = directory + "/index.txt";
+		std::ifstream fin(indexPath.c_str());
+		std::string name;
+		std::uint64_t bytes;
+		while (fin >> name >> bytes)
+			std::remove((directory + "/" + name + ".mesh").c_str());
+		fin.close();
+		std::remove(indexPath.c_str());
+	}
+
+	// The difference between two snapshots of the same cache's counters.
+	ChunkMeshCacheStats Since(const ChunkMeshCacheStats& now, const ChunkMeshCacheStats& before)
+	{
+		ChunkMeshCacheStats s = now;
+		s.Lookups -= before.Lookups;
+		s.MemoryHits -= before.MemoryHits;
+		s.DiskHits -= before.DiskHits;
+		s.Misses -= before.Misses;
+		s.BytesSaved -= before.BytesSaved;
+		s.DiskBytesRead -= before.DiskBytesRead;
+		s.DiskBytesWritten -= before.DiskBytesWritten;
+		s.MemoryEvictions -= before.MemoryEvictions;
+		s.DiskEvictions -= before.DiskEvictions;
+		return s;
+	}
+
+	Pass RunPass(const char* name, ChunkMeshCache& cache, const World& world, int threads,
+		const std::vector<ChunkMesh>& expected)
+	{
+		ChunkMeshCacheStats before = cache.Stats();
+		Clock::time_point start = Clock::now();
+		std::vector<ChunkMesh> meshes = cache.BuildAll(world, threads);
+		Pass pass;
+		pass.Name = name;
+		pass.Ms = MillisecondsSince(start);
+		pass.Stats = Since(cache.Stats(), before);
+		pass.Ok = SameMeshes(meshes, expected);
+		return pass;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: MeshCacheBenchmark [--size N] [--seed N] [--threads N] [--dir path]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	WorldGenParams params;
+	params.Seed = 1;
+	int threads = 0;
+	std::string directory = "MeshCacheBenchmark.cache";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--size") == 0)
+			params.Size = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			params.Seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--threads") == 0)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--dir") == 0)
+			directory = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (params.Size <= ChunkSize || threads < 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (threads == 0)
+		threads = DefaultThreadCount();
+
+	std::unique_ptr<World> world = WorldGenerator(params).Generate(threads);
+
+	Clock::time_point start = Clock::now();
+	std::vector<ChunkMesh> expected = ChunkMesher::BuildAll(*world, threads);
+	double meshMs = MillisecondsSince(start);
+
+	std::vector<Pass> passes;
+	ClearCache(directory);
+	{
+		ChunkMeshCache cache(directory);
+		passes.push_back(RunPass("cold", cache, *world, threads, expected));
+		passes.push_back(RunPass("revisit", cache, *world, threads, expected));
+	}
+
+	// Damage one file; the restarted cache must refuse it and mesh that chunk again.
+	{
+		ChunkMeshCache probe(directory);
+		std::string damaged = probe.MeshPath(probe.ComputeKey(*world, 0, world->ChunksY() - 1, 0));
+		std::fstream file(damaged.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(8);
+		file.put('\x5a');
+	}
+	{
+		ChunkMeshCache cache(directory);
+		passes.push_back(RunPass("restart", cache, *world, threads, expected));
+	}
+
+	// A block in the middle of the face between chunks 0 and 1 along x.
+	int x = ChunkSize - 1;
+	int z = ChunkSize / 2;
+	int cy = (world->SurfaceHeight(x, z) - world->MinY()) / ChunkSize;
+	int y = world->MinY() + cy * ChunkSize + ChunkSize / 2;
+	world->Set(x, y, z, world->Get(x, y, z) == BlockId::Stone ? BlockId::Air : BlockId::Stone);
+	std::vector<ChunkMesh> edited = ChunkMesher::BuildAll(*world, threads);
+	{
+		ChunkMeshCache cache(directory);
+		passes.push_back(RunPass("edit", cache, *world, threads, edited));
+	}
+
+	const std::uint64_t budget = 1024 * 1024;
+	{
+		ChunkMeshCache cache("", budget);
+		RunPass("fill", cache, *world, threads, edited);
+		Pass pass = RunPass("budget", cache, *world, threads, edited);
+		pass.Ok = pass.Ok && pass.Stats.MemoryBytes <= budget && pass.Stats.MemoryEvictions > 0;
+		passes.push_back(pass);
+	}
+	ClearCache(directory);
+
+	// Equal chunks share keys, so even the cold pass hits; the rest must match their
+	// pass exactly.
+	const Pass& cold = passes[0];
+	const Pass& revisit = passes[1];
+	const Pass& restart = passes[2];
+	const Pass& edit = passes[3];
+	bool countsOk = cold.Stats.Lookups == (std::uint64_t)world->ChunkCount() && revisit.Stats.HitRate() == 1.0 &&
+		restart.Stats.Misses == 1 && restart.Stats.DiskHits > 0 &&
+		restart.Stats.MemoryHits + restart.Stats.DiskHits + restart.Stats.Misses == restart.Stats.Lookups &&
+		edit.Stats.Misses == 2;
+
+	bool verified = countsOk;
+	for (const Pass& pass : passes)
+		verified = verified && pass.Ok;
+
+	std::size_t vertices = 0;
+	for (const ChunkMesh& mesh : expected)
+		vertices += mesh.Vertices.size();
+
+	std::printf("{\n");
+	std::printf("  \"size\": %d,\n", params.Size);
+	std::printf("  \"seed\": %u,\n", (unsigned)params.Seed);
+	std::printf("  \"threads\": %d,\n", threads);
+	std::printf("  \"chunks\": %d,\n", world->ChunkCount());
+	std::printf("  \"meshes\": %zu,\n", expected.size());
+	std::printf("  \"vertices\": %zu,\n", vertices);
+	std::printf("  \"mesh_ms\": %.3f,\n", meshMs);
+	for (const Pass& pass : passes)
+	{
+		const ChunkMeshCacheStats& s = pass.Stats;
+		std::printf("  \"%s\": { \"ms\": %.3f, \"lookups\": %llu, \"hit_rate\": %.3f, \"memory_hits\": %llu, "
+			"\"disk_hits\": %llu, \"misses\": %llu, \"bytes_saved\": %llu, \"disk_bytes_read\": %llu, "
+			"\"disk_bytes_written\": %llu, \"memory_bytes\": %llu, \"memory_evictions\": %llu, \"ok\": %s },\n",
+			pass.Name, pass.Ms, (unsigned long long)s.Lookups, s.HitRate(), (unsigned long long)s.MemoryHits,
+			(unsigned long long)s.DiskHits, (unsigned long long)s.Misses, (unsigned long long)s.BytesSaved,
+			(unsigned long long)s.DiskBytesRead, (unsigned long long)s.DiskBytesWritten, (unsigned long long)s.MemoryBytes,
+			(unsigned long long)s.MemoryEvictions, pass.Ok ? "true" : "false");
+	}
+	// The restart pass's hit rate without the damaged file's lookup.
+	std::uint64_t undamaged = restart.Stats.Lookups - 1;
+	std::printf("  \"restart_hit_rate_undamaged\": %.3f,\n",
+		(undamaged > 0) ? (double)(restart.Stats.MemoryHits + restart.Stats.DiskHits) / undamaged : 0.0);
+	std::printf("  \"counts_ok\": %s,\n", countsOk ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
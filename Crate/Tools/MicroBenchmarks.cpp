@@ -0,0 +1,335 @@
+//***************************************************************************************
+// MicroBenchmarks.cpp
+//
+// Microbenchmarks of the small hot functions: PerlinNoise::GetHeight, Hash::Fnv1a,
+// BC block compression, and the GeometryGenerator shapes, MathHelper and Camera.
+// Needs no GPU or window.
+//
+// The GeometryGenerator, MathHelper and Camera benchmarks need DirectXMath and the
+// Windows headers MathHelper.h includes; they are built when
+// MICROBENCHMARKS_DIRECTXMATH is 1, which is the default on Windows.  The rest build
+// anywhere.
+//
+// Usage: MicroBenchmarks [--filter text] [--repetitions N] [--baseline file]
+//                        [--save-baseline file] [--threshold fraction] [--json file]
+//
+// With --baseline, each result is compared against the stored median.  The exit code
+// is 2 if any benchmark got slower by more than --threshold (default 0.10).
+// --save-baseline writes this run's medians for later comparisons.  Baselines only
+// mean something on the machine and build they were recorded with.
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/MicroBenchmarks.cpp Tools/BenchmarkHarness.cpp
+//       PerlinNoise.cpp Common/BlockCompression.cpp -o MicroBenchmarks
+// and for the DirectXMath benchmarks add -DMICROBENCHMARKS_DIRECTXMATH=1, the
+// DirectXMath, sal.h and Windows.h include directories, and Camera.cpp,
+// Common/MathHelper.cpp and Common/GeometryGenerator.cpp.
+//***************************************************************************************
+
+#include "BenchmarkHarness.h"
+#include "../PerlinNoise.h"
+#include "../Common/BlockCompression.h"
+#include "../Common/Hash.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if !defined(MICROBENCHMARKS_DIRECTXMATH)
+#if defined(_WIN32)
+#define MICROBENCHMARKS_DIRECTXMATH 1
+#else
+#define MICROBENCHMARKS_DIRECTXMATH 0
+#endif
+#endif
+
+#if MICROBENCHMARKS_DIRECTXMATH
+#include "../Camera.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MathHelper.h"
+
+using namespace DirectX;
+#endif
+
+namespace
+{
+	void AddPerlinNoise(Benchmark::Runner& runner)
+	{
+		const int octaveCounts[] = { 1, 2, 4, 8 };
+		for (int octaves : octaveCounts)
+		{
+			runner.Add("PerlinNoise/GetHeight/octaves:" + std::to_string(octaves), [octaves](std::uint64_t n)
+			{
+				PerlinNoise noise(0.5, 0.15, 20.0, octaves, 12345);
+				int sum = 0;
+				for (std::uint64_t i = 0; i < n; ++i)
+					sum += noise.GetHeight((int)(i & 255), (int)((i >> 8) & 255));
+				Benchmark::DoNotOptimize(sum);
+			});
+		}
+	}
+
+	void AddHash(Benchmark::Runner& runner)
+	{
+		const std::size_t sizes[] = { 16, 1024, 65536 };
+		for (std::size_t size : sizes)
+		{
+			runner.Add("Hash/Fnv1a/bytes:" + std::to_string(size), [size](std::uint64_t n)
+			{
+				std::vector<std::uint8_t> data(size);
+				for (std::size_t i = 0; i < size; ++i)
+					data[i] = (std::uint8_t)(i * 31);
+				std::uint64_t h = 0;
+				for (std::uint64_t i = 0; i < n; ++i)
+					h ^= Hash::Fnv1a(data.data(), data.size(), i);
+				Benchmark::DoNotOptimize(h);
+			});
+		}
+	}
+
+	// One 4x4 block per call, cycling through 64 blocks of a noisy ramp.
+	void AddBlockCompression(Benchmark::Runner& runner)
+	{
+		const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC7 };
+		for (BlockFormat format : formats)
+		{
+			runner.Add(std::string("BlockCompression/CompressBlock/") + BlockFormatName(format), [format](std::uint64_t n)
+			{
+				std::vector<std::uint8_t> texels(64 * 64);
+				std::uint32_t state = 12345;
+				for (std::size_t i = 0; i < texels.size(); ++i)
+				{
+					state = state * 1664525u + 1013904223u;
+					texels[i] = (std::uint8_t)((i % 64) * 3 + (state >> 28));
+				}
+				std::uint8_t block[16];
+				for (std::uint64_t i = 0; i < n; ++i)
+				{
+					CompressBlock(format, &texels[(i & 63) * 64], block);
+					Benchmark::DoNotOptimize(block[0]);
+				}
+			});
+		}
+	}
+
+#if MICROBENCHMARKS_DIRECTXMATH
+	void AddGeometryGenerator(Benchmark::Runner& runner)
+	{
+		runner.Add("GeometryGenerator/CreateBox/subdivisions:0", [](std::uint64_t n)
+		{
+			GeometryGenerator geoGen;
+			for (std::uint64_t i = 0; i < n; ++i)
+				Benchmark::DoNotOptimize(geoGen.CreateBox(1.0f, 1.0f, 1.0f, 0));
+		});
+
+		runner.Add("GeometryGenerator/CreateBox/subdivisions:3", [](std::uint64_t n)
+		{
+			GeometryGenerator geoGen;
+			for (std::uint64_t i = 0; i < n; ++i)
+				Benchmark::DoNotOptimize(geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3));
+		});
+
+		runner.Add("GeometryGenerator/CreateSphere/20x20", [](std::uint64_t n)
+		{
+			GeometryGenerator geoGen;
+			for (std::uint64_t i = 0; i < n; ++i)
+				Benchmark::DoNotOptimize(geoGen.CreateSphere(0.5f, 20, 20));
+		});
+
+		// Subdivide is private; each extra geosphere level is one more Subdivide pass, so
+		// the difference between consecutive levels is the cost of subdividing.
+		for (std::uint32_t depth = 0; depth <= 5; ++depth)
+		{
+			runner.Add("GeometryGenerator/CreateGeosphere/depth:" + std::to_string(depth), [depth](std::uint64_t n)
+			{
+				GeometryGenerator geoGen;
+				for (std::uint64_t i = 0; i < n; ++i)
+					Benchmark::DoNotOptimize(geoGen.CreateGeosphere(0.5f, depth));
+			});
+		}
+	}
+
+	void AddMathHelper(Benchmark::Runner& runner)
+	{
+		runner.Add("MathHelper/InverseTranspose", [](std::uint64_t n)
+		{
+			XMMATRIX m = XMMatrixScaling(1.0f, 2.0f, 1.0f) * XMMatrixRotationRollPitchYaw(0.1f, 0.2f, 0.3f) *
+				XMMatrixTranslation(5.0f, 2.0f, 1.0f);
+			XMFLOAT4X4 result;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				XMStoreFloat4x4(&result, MathHelper::InverseTranspose(m));
+				Benchmark::DoNotOptimize(result);
+			}
+		});
+
+		runner.Add("MathHelper/RandF", [](std::uint64_t n)
+		{
+			std::srand(1);
+			float sum = 0.0f;
+			for (std::uint64_t i = 0; i < n; ++i)
+				sum += MathHelper::RandF(-1.0f, 1.0f);
+			Benchmark::DoNotOptimize(sum);
+		});
+
+		runner.Add("MathHelper/Rand", [](std::uint64_t n)
+		{
+			std::srand(1);
+			int sum = 0;
+			for (std::uint64_t i = 0; i < n; ++i)
+				sum += MathHelper::Rand(0, 100);
+			Benchmark::DoNotOptimize(sum);
+		});
+
+		runner.Add("MathHelper/RandUnitVec3", [](std::uint64_t n)
+		{
+			std::srand(1);
+			XMFLOAT3 v;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				XMStoreFloat3(&v, MathHelper::RandUnitVec3());
+				Benchmark::DoNotOptimize(v);
+			}
+		});
+
+		runner.Add("MathHelper/RandHemisphereUnitVec3", [](std::uint64_t n)
+		{
+			std::srand(1);
+			XMVECTOR normal = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+			XMFLOAT3 v;
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				XMStoreFloat3(&v, MathHelper::RandHemisphereUnitVec3(normal));
+				Benchmark::DoNotOptimize(v);
+			}
+		});
+	}
+
+	void AddCamera(Benchmark::Runner& runner)
+	{
+		// UpdateViewMatrix does nothing unless the view moved, so each iteration turns the
+		// camera slightly first.
+		runner.Add("Camera/UpdateViewMatrix", [](std::uint64_t n)
+		{
+			Camera camera;
+			camera.SetPosition(50.0f, 10.0f, 45.0f);
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				camera.RotateY(0.001f);
+				camera.UpdateViewMatrix();
+			}
+			Benchmark::DoNotOptimize(camera.GetView4x4f());
+		});
+
+		runner.Add("Camera/LookAt", [](std::uint64_t n)
+		{
+			Camera camera;
+			XMFLOAT3 target(50.0f, 5.0f, 50.0f);
+			XMFLOAT3 up(0.0f, 1.0f, 0.0f);
+			for (std::uint64_t i = 0; i < n; ++i)
+			{
+				XMFLOAT3 pos(50.0f + (float)(i & 15), 10.0f, 40.0f);
+				camera.LookAt(pos, target, up);
+				camera.UpdateViewMatrix();
+			}
+			Benchmark::DoNotOptimize(camera.GetView4x4f());
+		});
+	}
+#endif
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: MicroBenchmarks [--filter text] [--repetitions N] [--baseline file]\n"
+			"                       [--save-baseline file] [--threshold fraction] [--json file]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Benchmark::Options options;
+	const char* baselinePath = nullptr;
+	const char* saveBaselinePath = nullptr;
+	const char* jsonPath = nullptr;
+	double threshold = 0.10;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--filter") == 0)
+			options.Filter = argv[++i];
+		else if (std::strcmp(argv[i], "--repetitions") == 0)
+			options.Repetitions = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--baseline") == 0)
+			baselinePath = argv[++i];
+		else if (std::strcmp(argv[i], "--save-baseline") == 0)
+			saveBaselinePath = argv[++i];
+		else if (std::strcmp(argv[i], "--threshold") == 0)
+			threshold = std::atof(argv[++i]);
+		else if (std::strcmp(argv[i], "--json") == 0)
+			jsonPath = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (options.Repetitions <= 0 || threshold < 0.0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	Benchmark::Runner runner(options);
+	AddPerlinNoise(runner);
+	AddHash(runner);
+	AddBlockCompression(runner);
+#if MICROBENCHMARKS_DIRECTXMATH
+	AddGeometryGenerator(runner);
+	AddMathHelper(runner);
+	AddCamera(runner);
+#endif
+
+	std::vector<Benchmark::Result> results = runner.Run(std::cout);
+
+	std::vector<Benchmark::Comparison> comparisons;
+	int regressions = 0;
+	if (baselinePath != nullptr)
+	{
+		std::map<std::string, double> baseline = Benchmark::LoadBaseline(baselinePath);
+		if (baseline.empty())
+			std::fprintf(stderr, "no baseline in %s\n", baselinePath);
+
+		comparisons = Benchmark::Compare(results, baseline, threshold);
+		for (const Benchmark::Comparison& c : comparisons)
+		{
+			std::printf("%-36s %+6.1f%%%s\n", c.Name.c_str(), c.Change * 100.0, c.Regressed ? "  REGRESSION" : "");
+			regressions += c.Regressed ? 1 : 0;
+		}
+	}
+
+	if (saveBaselinePath != nullptr && !Benchmark::SaveBaseline(saveBaselinePath, results))
+	{
+		std::fprintf(stderr, "could not write %s\n", saveBaselinePath);
+		return 1;
+	}
+
+	if (jsonPath != nullptr)
+	{
+		std::ofstream json(jsonPath);
+		Benchmark::WriteJson(json, results, comparisons);
+	}
+
+	if (regressions > 0)
+	{
+		std::printf("%d benchmark(s) regressed by more than %.0f%%\n", regressions, threshold * 100.0);
+		return 2;
+	}
+	return 0;
+}
@@ -0,0 +1,359 @@
+//***************************************************************************************
+// MipStreamingSim.cpp
+//
+// Drives MipResidency along simulated camera paths through a generated world, the way
+// CrateApp's TextureStreamer does, and checks the residency policy as it goes:
+//
+//   - resident plus loading bytes never exceed the budget (once the tails fit in it),
+//   - a texture only loads the mip just finer than what it has, and never below its tail,
+//   - a mip wanted this frame is never dropped to make room for another texture,
+//   - once the camera stops, every texture reaches the mip it wants if they all fit.
+//
+// Each chunk submesh requests its block's texture at the mip its distance calls for;
+// loads finish a fixed number of frames after they start.  Mip sizes are rounded up
+// to 64KB tiles and mips under a tile are part of the tail, as with reserved resources.
+// Prints one line per path and budget; the exit code is 1 if any check failed.
+//
+// Usage: MipStreamingSim [--budget MB] [--latency frames] [--tail mips] [--seed N]
+//
+// Without --budget, each path runs with budgets of 4, 8, 16 and 64 MB.
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/MipStreamingSim.cpp Common/MipResidency.cpp
+//       World.cpp WorldGenerator.cpp ChunkMesher.cpp PerlinNoise.cpp Common/Profiler.cpp
+//       Common/MemoryTracker.cpp -o MipStreamingSim
+//***************************************************************************************
+
+#include "../World.h"
+#include "../WorldGenerator.h"
+#include "../ChunkMesher.h"
+#include "../Common/MipResidency.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+
+namespace
+{
+	const int FramesPerSecond = 60;
+	const int SettleFrames = 240;
+	const std::uint64_t TileBytes = 64 * 1024;
+	const float FogEnd = 235.0f;                          // FogStart + FogRange
+	const float ChunkRadius = ChunkSize * 0.8660254f;     // half the chunk's diagonal
+
+	// 600 pixel high viewport with CrateApp's 45 degree vertical field of view.
+	const float PixelsPerUnit = 0.5f * 600.0f / std::tan(0.125f * 3.14159265f);
+
+	// Sizes of the block textures in TextureManifest.txt, in BlockId order from Grass.
+	const int TextureSizes[][2] =
+	{
+		{ 512, 512 }, { 360, 360 }, { 512, 512 }, { 511, 511 }, { 511, 509 }, { 509, 510 },
+		{ 400, 400 }, { 400, 400 }, { 400, 400 }, { 360, 360 }, { 512, 510 }, { 400, 400 },
+		{ 265, 265 }, { 150, 150 }, { 150, 150 }, { 175, 175 },
+	};
+	const int TextureCount = sizeof(TextureSizes) / sizeof(TextureSizes[0]);
+
+	struct Vec3
+	{
+		float X, Y, Z;
+	};
+
+	struct Surface
+	{
+		Vec3 Center;
+		std::uint32_t Texture;
+	};
+
+	struct CameraPath
+	{
+		const char* Name;
+		int Frames;
+		std::function<Vec3(int frame)> Position;
+	};
+
+	struct PendingLoad
+	{
+		std::uint32_t Texture;
+		int DoneFrame;
+	};
+
+	struct RunResult
+	{
+		int Failures = 0;
+		std::uint64_t PeakBytes = 0;
+		double MipErrorSum = 0.0;     // resident minus wanted mips, over every texture and frame
+		std::uint64_t MipErrorSamples = 0;
+		int SettleFramesUsed = -1;    // -1 if it never settled
+	};
+
+	float Distance(const Vec3& a, const Vec3& b)
+	{
+		float dx = a.X - b.X, dy = a.Y - b.Y, dz = a.Z - b.Z;
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+
+	// Mip sizes as tiles of a reserved 32bpp texture with a full mip chain.  Mips under a
+	// tile are packed together; their tiles are all counted on the first of them.
+	std::vector<std::uint64_t> MipBytes(int width, int height, std::uint32_t& packedMip)
+	{
+		std::vector<std::uint64_t> bytes;
+		std::uint64_t packedBytes = 0;
+		packedMip = 0;
+		for (;;)
+		{
+			std::uint64_t size = (std::uint64_t)width * height * 4;
+			if (size < TileBytes && packedBytes == 0)
+				packedMip = (std::uint32_t)bytes.size();
+			if (size < TileBytes)
+			{
+				packedBytes += size;
+				bytes.push_back(0);
+			}
+			else
+			{
+				bytes.push_back((size + TileBytes - 1) / TileBytes * TileBytes);
+			}
+
+			if (width == 1 && height == 1)
+				break;
+			width = (std::max)(width / 2, 1);
+			height = (std::max)(height / 2, 1);
+		}
+		bytes[packedMip] = (packedBytes + TileBytes - 1) / TileBytes * TileBytes;
+		return bytes;
+	}
+
+	RunResult Run(const std::vector<Surface>& surfaces, const CameraPath& path, std::uint64_t budget,
+		int latency, std::uint32_t tailMips, MipResidencyStats& stats)
+	{
+		MipResidencyParams params;
+		params.BudgetBytes = budget;
+		MipResidency residency(params);
+
+		// The tail is the smallest tailMips mips, or the packed mips if they go further.
+		std::vector<std::vector<std::uint64_t>> mipBytes(TextureCount);
+		for (int t = 0; t < TextureCount; ++t)
+		{
+			std::uint32_t packedMip = 0;
+			mipBytes[t] = MipBytes(TextureSizes[t][0], TextureSizes[t][1], packedMip);
+			std::uint32_t mipCount = (std::uint32_t)mipBytes[t].size();
+			std::uint32_t tail = (mipCount > tailMips) ? mipCount - tailMips : 0;
+			residency.AddTexture(mipBytes[t], (std::min)(tail, packedMip));
+		}
+
+		RunResult result;
+		const bool tailsFit = residency.TailBytes() <= budget;
+		std::deque<PendingLoad> pending;
+		MipResidencyUpdate changes;
+		std::vector<std::uint32_t> resident(TextureCount);
+
+		const int totalFrames = path.Frames + SettleFrames;
+		for (int frame = 0; frame < totalFrames; ++frame)
+		{
+			while (!pending.empty() && pending.front().DoneFrame <= frame)
+			{
+				residency.FinishLoad(pending.front().Texture);
+				pending.pop_front();
+			}
+
+			Vec3 eye = path.Position((std::min)(frame, path.Frames - 1));
+			residency.BeginFrame();
+			for (const Surface& s : surfaces)
+			{
+				float distance = (std::max)(Distance(eye, s.Center) - ChunkRadius, 0.0f);
+				if (distance >= FogEnd)
+					continue;
+				const int* size = TextureSizes[s.Texture];
+				residency.Request(s.Texture, MipForDistance((float)(std::max)(size[0], size[1]), distance, PixelsPerUnit));
+			}
+
+			for (int t = 0; t < TextureCount; ++t)
+				resident[t] = residency.ResidentMip(t);
+
+			residency.Update(changes);
+			for (const MipChange& load : changes.Loads)
+			{
+				if (load.Mip + 1 != resident[load.Texture] || load.Mip >= residency.TailMip(load.Texture))
+				{
+					std::fprintf(stderr, "  %s frame %d: texture %u loads mip %u with mip %u resident\n",
+						path.Name, frame, load.Texture, load.Mip, resident[load.Texture]);
+					++result.Failures;
+				}
+				pending.push_back({ load.Texture, frame + latency });
+			}
+			for (const MipChange& drop : changes.Drops)
+			{
+				if (drop.Mip >= residency.WantedMip(drop.Texture) || drop.Mip >= residency.TailMip(drop.Texture))
+				{
+					std::fprintf(stderr, "  %s frame %d: texture %u dropped mip %u it wants\n",
+						path.Name, frame, drop.Texture, drop.Mip);
+					++result.Failures;
+				}
+			}
+
+			std::uint64_t used = residency.ResidentBytes() + residency.LoadingBytes();
+			result.PeakBytes = (std::max)(result.PeakBytes, used);
+			if (tailsFit && used > budget)
+			{
+				std::fprintf(stderr, "  %s frame %d: %llu bytes in use over a %llu byte budget\n",
+					path.Name, frame, (unsigned long long)used, (unsigned long long)budget);
+				++result.Failures;
+			}
+
+			bool settled = true;
+			for (int t = 0; t < TextureCount; ++t)
+			{
+				std::uint32_t wanted = residency.WantedMip(t);
+				std::uint32_t have = residency.ResidentMip(t);
+				if (have > wanted)
+				{
+					result.MipErrorSum += have - wanted;
+					settled = false;
+				}
+				++result.MipErrorSamples;
+			}
+			if (frame >= path.Frames && settled && result.SettleFramesUsed < 0)
+				result.SettleFramesUsed = frame - path.Frames;
+		}
+
+		// Standing still, everything wanted should arrive if it fits.
+		std::uint64_t wantedBytes = residency.TailBytes();
+		for (int t = 0; t < TextureCount; ++t)
+		{
+			for (std::uint32_t m = residency.WantedMip(t); m < residency.TailMip(t); ++m)
+				wantedBytes += mipBytes[t][m];
+		}
+		if (wantedBytes <= budget && result.SettleFramesUsed < 0)
+		{
+			std::fprintf(stderr, "  %s: wanted mips fit in the budget but never all arrived\n", path.Name);
+			++result.Failures;
+		}
+
+		stats = residency.Stats();
+		return result;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: MipStreamingSim [--budget MB] [--latency frames] [--tail mips] [--seed N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::uint64_t> budgets = { 4, 8, 16, 64 };
+	int latency = 3;
+	std::uint32_t tailMips = 4;
+	WorldGenParams params;
+	params.Size = 100;
+	params.Seed = 1;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--budget") == 0)
+			budgets.assign(1, std::strtoull(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--latency") == 0)
+			latency = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--tail") == 0)
+			tailMips = (std::uint32_t)std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			params.Seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (latency < 1 || tailMips < 1)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// One surface per chunk submesh, as CrateApp has one render item per chunk and block.
+	WorldGenerator generator(params);
+	std::unique_ptr<World> world = generator.Generate();
+	std::vector<ChunkMesh> meshes = ChunkMesher::BuildAll(*world);
+
+	std::vector<Surface> surfaces;
+	for (const ChunkMesh& mesh : meshes)
+	{
+		for (const ChunkSubmesh& submesh : mesh.Submeshes)
+		{
+			Surface s;
+			s.Center = { mesh.Origin[0] + 0.5f * ChunkSize, mesh.Origin[1] + 0.5f * ChunkSize, mesh.Origin[2] + 0.5f * ChunkSize };
+			s.Texture = (std::uint32_t)submesh.Block - 1;
+			surfaces.push_back(s);
+		}
+	}
+
+	const float size = (float)params.Size;
+	const float ground = (float)world->SurfaceHeight(params.Size / 2, params.Size / 2) + 2.0f;
+	std::vector<CameraPath> paths =
+	{
+		// Walk corner to corner at 5 units a second.
+		{ "walk", 20 * FramesPerSecond, [=](int f)
+		{
+			float t = (std::min)(f * 5.0f / FramesPerSecond / (size * 1.41f), 1.0f);
+			return Vec3{ t * size, ground, t * size };
+		} },
+		// Circle the middle of the world once every 20 seconds.
+		{ "orbit", 40 * FramesPerSecond, [=](int f)
+		{
+			float a = f * 2.0f * 3.14159265f / (20.0f * FramesPerSecond);
+			return Vec3{ 0.5f * size + 30.0f * std::cos(a), ground, 0.5f * size + 30.0f * std::sin(a) };
+		} },
+		// Jump between opposite corners every second and a half.
+		{ "teleport", 30 * FramesPerSecond, [=](int f)
+		{
+			bool far = (f / 90) % 2 != 0;
+			return far ? Vec3{ size - 4.0f, ground, size - 4.0f } : Vec3{ 4.0f, ground, 4.0f };
+		} },
+		// Dive from high above the world down to the ground in the middle.
+		{ "dive", 10 * FramesPerSecond, [=](int f)
+		{
+			float t = (float)f / (10 * FramesPerSecond - 1);
+			return Vec3{ 0.5f * size, ground + (1.0f - t) * 300.0f, 0.5f * size };
+		} },
+	};
+
+	std::printf("%zu surfaces, %d textures, load latency %d frames, %u tail mips\n",
+		surfaces.size(), TextureCount, latency, tailMips);
+
+	int failures = 0;
+	for (const CameraPath& path : paths)
+	{
+		for (std::uint64_t budgetMB : budgets)
+		{
+			MipResidencyStats stats;
+			RunResult r = Run(surfaces, path, budgetMB * 1024 * 1024, latency, tailMips, stats);
+			failures += r.Failures;
+
+			char settle[32];
+			if (r.SettleFramesUsed >= 0)
+				std::snprintf(settle, sizeof(settle), "%d frames", r.SettleFramesUsed);
+			else
+				std::snprintf(settle, sizeof(settle), "never");
+
+			std::printf("%-8s %3llu MB: peak %6.1f MB, loads %5llu, drops %5llu, reloads %5llu, deferred %6llu, "
+				"mean mip error %.3f, settled %s%s\n", path.Name, (unsigned long long)budgetMB,
+				r.PeakBytes / (1024.0 * 1024.0), (unsigned long long)stats.Loads, (unsigned long long)stats.Drops,
+				(unsigned long long)stats.Reloads, (unsigned long long)stats.DeferredLoads,
+				r.MipErrorSamples ? r.MipErrorSum / r.MipErrorSamples : 0.0, settle,
+				r.Failures ? "  FAILED" : "");
+		}
+	}
+
+	std::printf("%d check(s) failed\n", failures);
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,356 @@
+//***************************************************************************************
+// RenderGraphCheck.cpp
+//
+// Headless checks of RenderGraph::Compile on a prepass / SSAO / SSAO blur / scene /
+// bloom / post frame with one dead pass, and on two smaller graphs:
+//
+//   culling    the pass whose output reaches no imported resource is culled, along with
+//              its texture; a pass marked as having side effects is kept
+//   order      every pass runs after the passes whose output it reads, and independent
+//              passes are scheduled so that a transient dies before the next is born
+//   barriers   the barrier batch of each pass, and the final transitions that return
+//              imported resources to their final state and transients to their first;
+//              a transient whose memory is taken over later in the frame gets no final
+//              transition and starts the next frame in the state it was left in
+//   aliasing   which transient textures share heap memory, that no two textures alive
+//              at the same time overlap, and that the first occupant of a range aliases
+//              against the previous frame's last occupant, since the heap is reused
+//
+// Prints one JSON object to stdout; the exit code is 1 if a check fails, and stderr
+// shows the expected and compiled barriers of the pass that differs.
+//
+// Usage: RenderGraphCheck
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/RenderGraphCheck.cpp Common/RenderGraph.cpp
+//       -o RenderGraphCheck
+//***************************************************************************************
+
+#include "../Common/RenderGraph.h"
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char* StateName(std::uint32_t state)
+	{
+		switch (state)
+		{
+		case RgState::Present: return "Present";
+		case RgState::RenderTarget: return "RenderTarget";
+		case RgState::UnorderedAccess: return "UnorderedAccess";
+		case RgState::DepthWrite: return "DepthWrite";
+		case RgState::DepthRead: return "DepthRead";
+		case RgState::NonPixelShaderResource: return "NonPixelShaderResource";
+		case RgState::PixelShaderResource: return "PixelShaderResource";
+		case RgState::CopyDest: return "CopyDest";
+		case RgState::CopySource: return "CopySource";
+		default: return "Combined";
+		}
+	}
+
+	std::string Describe(const RenderGraph& graph, const RgBarrier& b)
+	{
+		const std::string& name = graph.ResourceName(b.Resource);
+		switch (b.BarrierType)
+		{
+		case RgBarrier::Type::Aliasing:
+			return "alias " + name + " after " + (b.PreviousFrame ? "last frame's " : "") +
+				(b.AliasedBefore == RgInvalid ? std::string("*") : graph.ResourceName(b.AliasedBefore));
+		case RgBarrier::Type::Uav:
+			return "uav " + name;
+		default:
+			return name + " " + StateName(b.StateBefore) + "->" + StateName(b.StateAfter);
+		}
+	}
+
+	bool SameBarriers(const RenderGraph& graph, const char* where, const std::vector<RgBarrier>& compiled,
+		const std::vector<std::string>& expected)
+	{
+		std::vector<std::string> actual;
+		for (const RgBarrier& b : compiled)
+			actual.push_back(Describe(graph, b));
+		if (actual == expected)
+			return true;
+
+		std::fprintf(stderr, "%s: expected", where);
+		for (const std::string& s : expected)
+			std::fprintf(stderr, " [%s]", s.c_str());
+		std::fprintf(stderr, ", compiled");
+		for (const std::string& s : actual)
+			std::fprintf(stderr, " [%s]", s.c_str());
+		std::fprintf(stderr, "\n");
+		return false;
+	}
+
+	std::vector<std::string> PassOrder(const RenderGraph& graph, const RgCompiledGraph& compiled)
+	{
+		std::vector<std::string> order;
+		for (const RgCompiledPass& p : compiled.Passes)
+			order.push_back(graph.PassName(p.Pass));
+		return order;
+	}
+
+	// Position of a pass in the compiled order, or -1 if it was culled.
+	int PositionOf(const RgCompiledGraph& compiled, RgPass pass)
+	{
+		for (std::size_t i = 0; i < compiled.Passes.size(); ++i)
+		{
+			if (compiled.Passes[i].Pass == pass)
+				return (int)i;
+		}
+		return -1;
+	}
+
+	bool Shares(const RgCompiledGraph& compiled, const RenderGraph& graph, RgResource a, RgResource b)
+	{
+		std::uint64_t offsetA = compiled.HeapOffsets[a];
+		std::uint64_t offsetB = compiled.HeapOffsets[b];
+		return offsetA != ~0ull && offsetB != ~0ull &&
+			offsetA < offsetB + graph.TextureDesc(b).SizeBytes && offsetB < offsetA + graph.TextureDesc(a).SizeBytes;
+	}
+
+	// Transients used in overlapping spans of the compiled order must not overlap in the heap.
+	bool NoLiveOverlap(const RenderGraph& graph, const RgCompiledGraph& compiled, const std::vector<std::vector<RgResource>>& uses)
+	{
+		std::vector<int> first(graph.ResourceCount(), -1), last(graph.ResourceCount(), -1);
+		for (std::size_t i = 0; i < compiled.Passes.size(); ++i)
+		{
+			for (RgResource r : uses[compiled.Passes[i].Pass])
+			{
+				if (first[r] < 0)
+					first[r] = (int)i;
+				last[r] = (int)i;
+			}
+		}
+
+		for (RgResource a = 0; a < graph.ResourceCount(); ++a)
+		{
+			for (RgResource b = a + 1; b < graph.ResourceCount(); ++b)
+			{
+				if (graph.IsImported(a) || graph.IsImported(b) || first[a] < 0 || first[b] < 0)
+					continue;
+				if (first[a] <= last[b] && first[b] <= last[a] && Shares(compiled, graph, a, b))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	struct Result
+	{
+		bool Culling = true;
+		bool Order = true;
+		bool Barriers = true;
+		bool Aliasing = true;
+	};
+
+	// The frame: depth prepass, SSAO and its blur read the depth, the scene draws into an
+	// HDR target with the blurred SSAO, bloom reads the HDR target and post combines both
+	// into the back buffer.  "debug" writes a texture nobody reads.
+	void CheckFrame(Result& result, RgCompiledGraph& compiled, RenderGraph& graph)
+	{
+		RgTextureDesc full;
+		full.SizeBytes = 8 * 1024 * 1024;
+		full.Alignment = 64 * 1024;
+		RgTextureDesc half = full;
+		half.SizeBytes = 2 * 1024 * 1024;
+
+		RgResource backBuffer = graph.ImportResource("backBuffer", RgState::Present, RgState::Present);
+		RgResource depth = graph.ImportResource("depth", RgState::DepthWrite, RgState::DepthWrite);
+		RgResource hdr = graph.CreateTexture("hdr", full);
+		RgResource bloom = graph.CreateTexture("bloom", half);
+		RgResource debugView = graph.CreateTexture("debugView", full);
+		RgResource ssao = graph.CreateTexture("ssao", half);
+		RgResource ssaoBlur = graph.CreateTexture("ssaoBlur", half);
+
+		std::vector<std::vector<RgResource>> uses;
+		RgPass prepass = graph.AddPass("prepass", nullptr);
+		graph.Write(prepass, depth, RgState::DepthWrite);
+		uses.push_back({ depth });
+
+		RgPass ssaoPass = graph.AddPass("ssao", nullptr);
+		graph.Read(ssaoPass, depth, RgState::PixelShaderResource);
+		graph.Write(ssaoPass, ssao, RgState::RenderTarget);
+		uses.push_back({ depth, ssao });
+
+		RgPass blurPass = graph.AddPass("ssaoBlur", nullptr);
+		graph.Read(blurPass, ssao, RgState::PixelShaderResource);
+		graph.Write(blurPass, ssaoBlur, RgState::RenderTarget);
+		uses.push_back({ ssao, ssaoBlur });
+
+		RgPass scene = graph.AddPass("scene", nullptr);
+		graph.Write(scene, hdr, RgState::RenderTarget);
+		graph.Write(scene, depth, RgState::DepthWrite);
+		graph.Read(scene, ssaoBlur, RgState::PixelShaderResource);
+		uses.push_back({ hdr, depth, ssaoBlur });
+
+		RgPass debugPass = graph.AddPass("debug", nullptr);
+		graph.Read(debugPass, hdr, RgState::PixelShaderResource);
+		graph.Write(debugPass, debugView, RgState::RenderTarget);
+		uses.push_back({ hdr, debugView });
+
+		RgPass bloomPass = graph.AddPass("bloom", nullptr);
+		graph.Read(bloomPass, hdr, RgState::PixelShaderResource);
+		graph.Write(bloomPass, bloom, RgState::RenderTarget);
+		uses.push_back({ hdr, bloom });
+
+		RgPass post = graph.AddPass("post", nullptr);
+		graph.Read(post, hdr, RgState::PixelShaderResource);
+		graph.Read(post, bloom, RgState::PixelShaderResource);
+		graph.Write(post, backBuffer, RgState::RenderTarget);
+		uses.push_back({ hdr, bloom, backBuffer });
+
+		graph.Compile(compiled);
+
+		result.Culling = compiled.CulledPasses == 1 && PositionOf(compiled, debugPass) < 0 &&
+			compiled.HeapOffsets[debugView] == ~0ull;
+
+		const char* expectedOrder[] = { "prepass", "ssao", "ssaoBlur", "scene", "bloom", "post" };
+		std::vector<std::string> order = PassOrder(graph, compiled);
+		result.Order = order == std::vector<std::string>(std::begin(expectedOrder), std::end(expectedOrder));
+		RgPass producers[][2] = { { prepass, ssaoPass }, { ssaoPass, blurPass }, { blurPass, scene },
+			{ prepass, scene }, { scene, bloomPass }, { scene, post }, { bloomPass, post } };
+		for (auto& edge : producers)
+			result.Order = result.Order && PositionOf(compiled, edge[0]) < PositionOf(compiled, edge[1]);
+
+		// hdr and bloom are born after ssao and ssaoBlur die, so they take over their memory,
+		// and ssao and ssaoBlur take it back from them at the start of the next frame; the
+		// depth buffer goes from the prepass's write to SSAO's read and back.
+		std::vector<std::vector<std::string>> expected =
+		{
+			{},
+			{ "depth DepthWrite->PixelShaderResource", "alias ssao after last frame's hdr", "ssao PixelShaderResource->RenderTarget" },
+			{ "ssao RenderTarget->PixelShaderResource", "alias ssaoBlur after last frame's bloom", "ssaoBlur PixelShaderResource->RenderTarget" },
+			{ "alias hdr after ssao", "depth PixelShaderResource->DepthWrite", "ssaoBlur RenderTarget->PixelShaderResource" },
+			{ "hdr RenderTarget->PixelShaderResource", "alias bloom after ssaoBlur" },
+			{ "bloom RenderTarget->PixelShaderResource", "backBuffer Present->RenderTarget" },
+		};
+		result.Barriers = compiled.Passes.size() == expected.size();
+		for (std::size_t i = 0; i < compiled.Passes.size() && result.Barriers; ++i)
+			result.Barriers = SameBarriers(graph, order[i].c_str(), compiled.Passes[i].Barriers, expected[i]);
+
+		// ssao and ssaoBlur no longer own their memory at the end of the frame.
+		std::vector<std::string> expectedFinal =
+		{
+			"backBuffer RenderTarget->Present",
+			"hdr PixelShaderResource->RenderTarget",
+			"bloom PixelShaderResource->RenderTarget",
+		};
+		result.Barriers = result.Barriers && SameBarriers(graph, "final", compiled.FinalBarriers, expectedFinal);
+		result.Barriers = result.Barriers && compiled.InitialStates[hdr] == RgState::RenderTarget &&
+			compiled.InitialStates[ssao] == RgState::PixelShaderResource &&
+			compiled.InitialStates[ssaoBlur] == RgState::PixelShaderResource &&
+			compiled.InitialStates[depth] == RgState::DepthWrite && compiled.InitialStates[backBuffer] == RgState::Present;
+
+		result.Aliasing = Shares(compiled, graph, hdr, ssao) && Shares(compiled, graph, bloom, ssaoBlur) &&
+			!Shares(compiled, graph, hdr, bloom) && !Shares(compiled, graph, ssao, ssaoBlur) &&
+			compiled.HeapSize == full.SizeBytes + half.SizeBytes &&
+			compiled.UnaliasedSize == full.SizeBytes + 3 * half.SizeBytes &&
+			NoLiveOverlap(graph, compiled, uses);
+	}
+
+	// Two chains declared interleaved: shadowA and shadowB write their own textures, then
+	// lightA and lightB read them.  The scheduler finishes chain A first, so both
+	// textures fit in the same memory.
+	void CheckReorder(Result& result)
+	{
+		RgTextureDesc desc;
+		desc.SizeBytes = 4 * 1024 * 1024;
+		desc.Alignment = 64 * 1024;
+
+		RenderGraph graph;
+		RgResource backBuffer = graph.ImportResource("backBuffer", RgState::Present, RgState::Present);
+		RgResource a = graph.CreateTexture("shadowMapA", desc);
+		RgResource b = graph.CreateTexture("shadowMapB", desc);
+
+		std::vector<std::vector<RgResource>> uses;
+		RgPass shadowA = graph.AddPass("shadowA", nullptr);
+		graph.Write(shadowA, a, RgState::DepthWrite);
+		uses.push_back({ a });
+		RgPass shadowB = graph.AddPass("shadowB", nullptr);
+		graph.Write(shadowB, b, RgState::DepthWrite);
+		uses.push_back({ b });
+		RgPass lightA = graph.AddPass("lightA", nullptr);
+		graph.Read(lightA, a, RgState::PixelShaderResource);
+		graph.Write(lightA, backBuffer, RgState::RenderTarget);
+		uses.push_back({ a, backBuffer });
+		RgPass lightB = graph.AddPass("lightB", nullptr);
+		graph.Read(lightB, b, RgState::PixelShaderResource);
+		graph.Write(lightB, backBuffer, RgState::RenderTarget);
+		uses.push_back({ b, backBuffer });
+
+		RgCompiledGraph compiled;
+		graph.Compile(compiled);
+
+		std::vector<std::string> expectedOrder = { "shadowA", "lightA", "shadowB", "lightB" };
+		result.Order = result.Order && PassOrder(graph, compiled) == expectedOrder;
+		result.Aliasing = result.Aliasing && Shares(compiled, graph, a, b) && compiled.HeapSize == desc.SizeBytes &&
+			NoLiveOverlap(graph, compiled, uses);
+		result.Barriers = result.Barriers && compiled.Passes.size() == 4 &&
+			SameBarriers(graph, "shadowA", compiled.Passes[0].Barriers,
+				{ "alias shadowMapA after last frame's shadowMapB", "shadowMapA PixelShaderResource->DepthWrite" }) &&
+			SameBarriers(graph, "shadowB", compiled.Passes[2].Barriers, { "alias shadowMapB after shadowMapA" }) &&
+			SameBarriers(graph, "reorder final", compiled.FinalBarriers,
+				{ "backBuffer RenderTarget->Present", "shadowMapB PixelShaderResource->DepthWrite" }) &&
+			compiled.InitialStates[a] == RgState::PixelShaderResource && compiled.InitialStates[b] == RgState::DepthWrite;
+	}
+
+	// A pass that only writes a transient is culled, unless it has side effects.
+	void CheckSideEffect(Result& result)
+	{
+		RgTextureDesc desc;
+		desc.SizeBytes = 64 * 1024;
+		desc.Alignment = 64 * 1024;
+
+		RenderGraph graph;
+		RgResource stats = graph.CreateTexture("stats", desc);
+		RgPass readback = graph.AddPass("readback", nullptr);
+		graph.Write(readback, stats, RgState::UnorderedAccess);
+
+		RgCompiledGraph compiled;
+		graph.Compile(compiled);
+		bool culled = compiled.CulledPasses == 1 && compiled.Passes.empty();
+
+		graph.SetSideEffect(readback);
+		graph.Compile(compiled);
+		result.Culling = result.Culling && culled && compiled.CulledPasses == 0 && compiled.Passes.size() == 1 &&
+			compiled.HeapOffsets[stats] == 0;
+	}
+}
+
+int main()
+{
+	Result result;
+	RenderGraph graph;
+	RgCompiledGraph compiled;
+	CheckFrame(result, compiled, graph);
+	CheckReorder(result);
+	CheckSideEffect(result);
+
+	bool verified = result.Culling && result.Order && result.Barriers && result.Aliasing;
+
+	std::printf("{\n");
+	std::printf("  \"order\": [");
+	std::vector<std::string> order = PassOrder(graph, compiled);
+	for (std::size_t i = 0; i < order.size(); ++i)
+		std::printf("%s\"%s\"", i ? ", " : "", order[i].c_str());
+	std::printf("],\n");
+	std::printf("  \"culled_passes\": %u,\n", compiled.CulledPasses);
+	std::printf("  \"barriers\": [");
+	for (std::size_t i = 0; i < compiled.Passes.size(); ++i)
+		std::printf("%s%zu", i ? ", " : "", compiled.Passes[i].Barriers.size());
+	std::printf("],\n");
+	std::printf("  \"final_barriers\": %zu,\n", compiled.FinalBarriers.size());
+	std::printf("  \"heap_bytes\": %llu,\n", (unsigned long long)compiled.HeapSize);
+	std::printf("  \"unaliased_bytes\": %llu,\n", (unsigned long long)compiled.UnaliasedSize);
+	std::printf("  \"culling_ok\": %s,\n", result.Culling ? "true" : "false");
+	std::printf("  \"order_ok\": %s,\n", result.Order ? "true" : "false");
+	std::printf("  \"barriers_ok\": %s,\n", result.Barriers ? "true" : "false");
+	std::printf("  \"aliasing_ok\": %s,\n", result.Aliasing ? "true" : "false");
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+//***************************************************************************************
+// ShaderCacheCheck.cpp
+//
+// Headless checks of the platform-independent half of the shader cache:
+//
+//   includes   editing LightingUtil.hlsl changes the key of Default.hlsl, an include
+//              reached through "dir/../" is hashed once, and a missing include fails
+//   defines    the keys of CrateApp's three permutations differ, as do keys that only
+//              differ in a define's value, the entry point or the compile flags
+//   paths      NormalizePath turns '\\' into '/' and collapses "dir/../"
+//   index      Save/Load round trips, malformed lines are dropped, and Update reports
+//              the key a permutation used to have
+//   timing     hashing Default.hlsl with its includes, computing the three keys and
+//              loading, updating and saving the index: the CPU side of a warm start
+//
+// Reads Shaders/ from the working directory and copies it into --dir for the edits.
+// Prints one JSON object to stdout; the exit code is 1 if a check fails.
+//
+// Usage: ShaderCacheCheck [--dir path] [--repetitions N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -I. Tools/ShaderCacheCheck.cpp Common/FileUtil.cpp
+//       Common/ShaderCacheIndex.cpp -o ShaderCacheCheck
+//***************************************************************************************
+
+#include "../Common/FileUtil.h"
+#include "../Common/ShaderCacheIndex.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	bool ReadFile(const std::string& path, std::string& contents)
+	{
+		std::ifstream fin(path.c_str(), std::ios::binary);
+		if (!fin)
+			return false;
+
+		std::ostringstream ss;
+		ss << fin.rdbuf();
+		contents = ss.str();
+		return true;
+	}
+
+	bool WriteFile(const std::string& path, const std::string& contents)
+	{
+		std::ofstream fout(path.c_str(), std::ios::binary | std::ios::trunc);
+		fout << contents;
+		return (bool)fout;
+	}
+
+	std::uint64_t HashOrZero(const std::string& path, std::vector<std::string>* files = nullptr)
+	{
+		std::uint64_t hash = 0;
+		return ShaderHash::HashSource(path, hash, files) ? hash : 0;
+	}
+
+	// CrateApp's permutations of Default.hlsl.
+	std::vector<ShaderPermutation> Permutations(const std::string& source)
+	{
+		ShaderPermutation vs;
+		vs.SourcePath = source;
+		vs.EntryPoint = "VS";
+		vs.Target = "vs_5_1";
+
+		ShaderPermutation opaque = vs;
+		opaque.EntryPoint = "PS";
+		opaque.Target = "ps_5_1";
+		opaque.Defines.push_back(std::make_pair(std::string("FOG"), std::string("1")));
+
+		ShaderPermutation alphaTest = opaque;
+		alphaTest.Defines.push_back(std::make_pair(std::string("ALPHA_TEST"), std::string("1")));
+
+		std::vector<ShaderPermutation> permutations;
+		permutations.push_back(vs);
+		permutations.push_back(opaque);
+		permutations.push_back(alphaTest);
+		return permutations;
+	}
+
+	bool CheckIncludes(const std::string& dir)
+	{
+		std::string defaultSource, lightingSource;
+		if (!ReadFile("Shaders/Default.hlsl", defaultSource) || !ReadFile("Shaders/LightingUtil.hlsl", lightingSource))
+			return false;
+
+		FileUtil::MakeDirectory(dir);
+		FileUtil::MakeDirectory(dir + "/Sub");
+		std::string defaultPath = dir + "/Default.hlsl";
+		std::string lightingPath = dir + "/LightingUtil.hlsl";
+		if (!WriteFile(defaultPath, defaultSource) || !WriteFile(lightingPath, lightingSource))
+			return false;
+
+		std::vector<std::string> files;
+		std::uint64_t before = HashOrZero(defaultPath, &files);
+		bool ok = before != 0 && before != HashOrZero("Shaders/Default.hlsl") &&
+			files.size() == 2 && files[1] == lightingPath;
+
+		// The copy hashes its own path, so it differs from Shaders/; editing only the
+		// include must change the key of the file that includes it.
+		WriteFile(lightingPath, lightingSource + "\n// edited\n");
+		std::uint64_t edited = HashOrZero(defaultPath);
+		WriteFile(lightingPath, lightingSource);
+		ok = ok && edited != 0 && edited != before && HashOrZero(defaultPath) == before;
+
+		// An include reached directly and through Sub/../ is hashed once.
+		WriteFile(dir + "/Sub/Extra.hlsl", "#include \"../LightingUtil.hlsl\"\n");
+		WriteFile(dir + "/Top.hlsl", "#include \"LightingUtil.hlsl\"\n  #  include \"Sub/Extra.hlsl\"\n");
+		files.clear();
+		ok = ok && HashOrZero(dir + "/Top.hlsl", &files) != 0 && files.size() == 3 &&
+			std::count(files.begin(), files.end(), lightingPath) == 1;
+
+		// A missing include fails the whole hash.
+		WriteFile(dir + "/Broken.hlsl", "#include \"Missing.hlsl\"\n");
+		std::uint64_t hash = 0;
+		ok = ok && !ShaderHash::HashSource(dir + "/Broken.hlsl", hash);
+		return ok;
+	}
+
+	bool CheckDefines()
+	{
+		std::uint64_t source = HashOrZero("Shaders/Default.hlsl");
+		std::vector<ShaderPermutation> permutations = Permutations("Shaders\\Default.hlsl");
+		std::uint64_t vs = ShaderHash::ComputeKey(permutations[0], source);
+		std::uint64_t opaque = ShaderHash::ComputeKey(permutations[1], source);
+		std::uint64_t alphaTest = ShaderHash::ComputeKey(permutations[2], source);
+		bool ok = source != 0 && vs != opaque && opaque != alphaTest && vs != alphaTest &&
+			ShaderHash::ComputeKey(permutations[1], source) == opaque;
+
+		ShaderPermutation p = permutations[1];
+		p.Defines[0].second = "0";
+		ok = ok && ShaderHash::ComputeKey(p, source) != opaque;
+
+		p = permutations[1];
+		p.Defines.clear();
+		ok = ok && ShaderHash::ComputeKey(p, source) != opaque;
+
+		p = permutations[1];
+		p.EntryPoint = "VS";
+		ok = ok && ShaderHash::ComputeKey(p, source) != opaque;
+
+		p = permutations[1];
+		p.CompileFlags = 1;
+		ok = ok && ShaderHash::ComputeKey(p, source) != opaque;
+
+		ok = ok && ShaderHash::ComputeKey(permutations[1], source + 1) != opaque;
+
+		ok = ok && permutations[2].Name() == "Shaders/Default.hlsl|PS|ps_5_1|FOG=1;ALPHA_TEST=1" &&
+			permutations[0].Name() == "Shaders/Default.hlsl|VS|vs_5_1";
+		return ok;
+	}
+
+	bool CheckPaths()
+	{
+		const char* cases[][2] =
+		{
+			{ "Shaders\\Default.hlsl", "Shaders/Default.hlsl" },
+			{ "Shaders/Sub/../LightingUtil.hlsl", "Shaders/LightingUtil.hlsl" },
+			{ "a\\b\\..\\..\\c.hlsl", "c.hlsl" },
+			{ "a/b/c/../../d.hlsl", "a/d.hlsl" },
+			{ "../Shaders/Default.hlsl", "../Shaders/Default.hlsl" },
+			{ "a/../../b.hlsl", "../b.hlsl" },
+		};
+		bool ok = true;
+		for (auto& c : cases)
+		{
+			std::string normalized = ShaderHash::NormalizePath(c[0]);
+			if (normalized != c[1])
+			{
+				std::fprintf(stderr, "NormalizePath(%s) = %s, expected %s\n", c[0], normalized.c_str(), c[1]);
+				ok = false;
+			}
+		}
+		return ok;
+	}
+
+	bool CheckIndex(const std::string& dir)
+	{
+		std::string path = dir + "/index.txt";
+		std::vector<ShaderPermutation> permutations = Permutations("Shaders/Default.hlsl");
+
+		ShaderCacheIndex index;
+		std::uint64_t stale = 0;
+		bool ok = true;
+		for (std::size_t i = 0; i < permutations.size(); ++i)
+			ok = ok && !index.Update(permutations[i].Name(), 0x1111111111111111ull * (i + 1), stale);
+		ok = ok && index.Dirty() && index.Size() == 3 && index.Save(path);
+
+		ShaderCacheIndex loaded;
+		loaded.Load(path);
+		std::uint64_t key = 0;
+		ok = ok && loaded.Size() == 3 && !loaded.Dirty();
+		for (std::size_t i = 0; i < permutations.size(); ++i)
+			ok = ok && loaded.Find(permutations[i].Name(), key) && key == 0x1111111111111111ull * (i + 1);
+
+		// The same key again is not a change; a new one reports the old one as stale.
+		stale = 0;
+		ok = ok && !loaded.Update(permutations[0].Name(), 0x1111111111111111ull, stale) && !loaded.Dirty() && stale == 0;
+		ok = ok && loaded.Update(permutations[0].Name(), 0xabcdef0123456789ull, stale) && loaded.Dirty() &&
+			stale == 0x1111111111111111ull && loaded.Find(permutations[0].Name(), key) && key == 0xabcdef0123456789ull;
+
+		// Only the well-formed lines survive.
+		WriteFile(path,
+			"good|PS|ps_5_1\t00000000000000ff\n"
+			"no tab 00000000000000ff\n"
+			"short\t00ff\n"
+			"long\t00000000000000ff0\n"
+			"nothex\t00000000000000zz\n"
+			"\t00000000000000ff\n"
+			"\n"
+			"tab\tin name\t0000000000000100\n");
+		ShaderCacheIndex malformed;
+		malformed.Load(path);
+		ok = ok && malformed.Size() == 2 && malformed.Find("good|PS|ps_5_1", key) && key == 0xff &&
+			malformed.Find("tab\tin name", key) && key == 0x100;
+
+		// A missing file starts empty.
+		std::remove(path.c_str());
+		malformed.Load(path);
+		ok = ok && malformed.Size() == 0 && !malformed.Dirty();
+		return ok;
+	}
+
+	// Median microseconds of the CPU work a warm start does before reading any blob.
+	double TimeWarmStart(const std::string& dir, int repetitions)
+	{
+		std::string path = dir + "/timing.txt";
+		std::vector<ShaderPermutation> permutations = Permutations("Shaders\\Default.hlsl");
+		std::vector<double> times;
+		for (int r = 0; r < repetitions; ++r)
+		{
+			Clock::time_point start = Clock::now();
+			ShaderCacheIndex index;
+			index.Load(path);
+			std::uint64_t source = HashOrZero(permutations[0].SourcePath);
+			for (const ShaderPermutation& p : permutations)
+			{
+				std::uint64_t stale = 0;
+				index.Update(p.Name(), ShaderHash::ComputeKey(p, source), stale);
+			}
+			if (index.Dirty())
+				index.Save(path);
+			times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+		}
+		std::remove(path.c_str());
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	void RemoveScratch(const std::string& dir)
+	{
+		const char* files[] = { "Default.hlsl", "LightingUtil.hlsl", "Top.hlsl", "Broken.hlsl", "Sub/Extra.hlsl", "index.txt" };
+		for (const char* f : files)
+			std::remove((dir + "/" + f).c_str());
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: ShaderCacheCheck [--dir path] [--repetitions N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string dir = "ShaderCacheCheck.scratch";
+	int repetitions = 200;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--dir") == 0)
+			dir = argv[++i];
+		else if (std::strcmp(argv[i], "--repetitions") == 0)
+			repetitions = std::atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (repetitions <= 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	bool includesOk = CheckIncludes(dir);
+	bool definesOk = CheckDefines();
+	bool pathsOk = CheckPaths();
+	bool indexOk = CheckIndex(dir);
+	double warmUs = TimeWarmStart(dir, repetitions);
+	RemoveScratch(dir);
+
+	bool verified = includesOk && definesOk && pathsOk && indexOk;
+
+	std::printf("{\n");
+	std::printf("  \"includes_ok\": %s,\n", includesOk ? "true" : "false");
+	std::printf("  \"defines_ok\": %s,\n", definesOk ? "true" : "false");
+	std::printf("  \"paths_ok\": %s,\n", pathsOk ? "true" : "false");
+	std::printf("  \"index_ok\": %s,\n", indexOk ? "true" : "false");
+	std::printf("  \"hash_and_index_us\": %.1f,\n", warmUs);
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
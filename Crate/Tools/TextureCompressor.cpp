@@ -0,0 +1,540 @@
+//***************************************************************************************
+// TextureCompressor.cpp
+//
+// Converts the textures of a manifest (the format of Textures/TextureManifest.txt) to
+// block-compressed DDS files with full mip chains, and writes a manifest listing the
+// converted files under the same names.  Uncompressed block textures take 4 bytes per
+// texel; BC1 takes half a byte and BC3/BC7 one.
+//
+// Usage: TextureCompressor <manifest> <output dir> [--alpha bc3|bc7]
+//                          [--format name=bc1|bc3|bc7]... [--threads N] [--min-psnr dB]
+//
+// Each texture with an alpha channel that is not 255 everywhere is encoded with the
+// --alpha format (BC7 by default); every other texture becomes BC1.  --format
+// overrides the choice for one manifest name.  Textures that are already block
+// compressed are copied as they are.
+//
+// BC textures must start at a multiple of 4 texels, so other sizes are resampled to the
+// nearest multiple first; block faces map the whole texture, so the stretch does not
+// show.  Mips are box filtered.  Below the first mip, alpha is rescaled so that as much
+// of each mip passes the shaders' alpha test (alpha >= 0.1) as of the first, which keeps
+// foliage from thinning out with distance.
+//
+// Every written file is read back and decoded, and the PSNR of each texture's first mip
+// and of its whole chain is printed against the filtered source.  The exit code is 1 if
+// anything failed or, with --min-psnr, if a first mip came out worse than that.
+//
+// To use the result, pack it from the Crate directory:
+//   TextureCompressor Textures/TextureManifest.txt Textures/BC
+//   AssetPacker Textures/BC/TextureManifest.txt Textures/Textures.pak --verify
+//
+// Build on Linux from the Crate directory, with a dxgiformat.h on the include path:
+//   g++ -std=c++14 -O2 -pthread -I. -I<dxgiformat.h dir> Tools/TextureCompressor.cpp
+//       Common/BlockCompression.cpp Common/DDSLayout.cpp Common/FileUtil.cpp Common/MappedFile.cpp
+//       -o TextureCompressor
+//***************************************************************************************
+
+#include "../Common/BlockCompression.h"
+#include "../Common/DDSLayout.h"
+#include "../Common/FileUtil.h"
+#include "../Common/MappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+using namespace DirectX;
+
+namespace
+{
+	// DDS header flags the layout code does not need.
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDSD_LINEARSIZE = 0x80000;
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+	const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+
+	// The shaders clip texels with alpha below this.
+	const float AlphaTestReference = 0.1f * 255.0f;
+
+	struct ManifestEntry
+	{
+		std::string Name;
+		std::string Path;
+	};
+
+	bool LoadManifest(const std::string& path, std::vector<ManifestEntry>& entries)
+	{
+		std::ifstream fin(path.c_str());
+		if (!fin)
+			return false;
+
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			std::istringstream fields(line);
+			ManifestEntry entry;
+			if (!(fields >> entry.Name) || entry.Name[0] == '#' || !(fields >> entry.Path))
+				continue;
+			entries.push_back(entry);
+		}
+		return true;
+	}
+
+	bool ParseBlockFormat(const std::string& text, BlockFormat& format)
+	{
+		if (text == "bc1")
+			format = BlockFormat::BC1;
+		else if (text == "bc3")
+			format = BlockFormat::BC3;
+		else if (text == "bc7")
+			format = BlockFormat::BC7;
+		else
+			return false;
+		return true;
+	}
+
+	bool IsBlockCompressed(DXGI_FORMAT format)
+	{
+		return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+			(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+	}
+
+	DXGI_FORMAT DxgiFormat(BlockFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1: return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+		case BlockFormat::BC3: return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+		default:               return srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+		}
+	}
+
+	// The first mip of an 8-bit RGBA/BGRA texture as RGBA.  Formats without alpha read
+	// as opaque.
+	bool ReadSource(const DDSFile& file, const DDSTextureDesc& desc, const DDSLayout& layout,
+		RgbaImage& image, bool& hasAlpha, bool& srgb)
+	{
+		bool bgr = false;
+		hasAlpha = true;
+		srgb = false;
+		switch (desc.Format)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:                                      break;
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB: srgb = true;                    break;
+		case DXGI_FORMAT_B8G8R8A8_UNORM:      bgr = true;                     break;
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB: bgr = true; srgb = true;        break;
+		case DXGI_FORMAT_B8G8R8X8_UNORM:      bgr = true; hasAlpha = false;   break;
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB: bgr = true; hasAlpha = false; srgb = true; break;
+		default:
+			return false;
+		}
+		if (desc.Dimension != DDSDimension::Texture2D || desc.ArraySize != 1 || desc.IsCubeMap)
+			return false;
+
+		const DDSSubresource& src = layout.Subresources[0];
+		image.Width = src.Width;
+		image.Height = src.Height;
+		image.Pixels.resize(src.Width * src.Height * 4);
+		for (std::size_t y = 0; y < src.Height; ++y)
+		{
+			const std::uint8_t* row = file.BitData + src.Offset + y * src.RowPitch;
+			std::uint8_t* dst = &image.Pixels[y * src.Width * 4];
+			for (std::size_t x = 0; x < src.Width; ++x)
+			{
+				dst[x * 4 + 0] = row[x * 4 + (bgr ? 2 : 0)];
+				dst[x * 4 + 1] = row[x * 4 + 1];
+				dst[x * 4 + 2] = row[x * 4 + (bgr ? 0 : 2)];
+				dst[x * 4 + 3] = hasAlpha ? row[x * 4 + 3] : 255;
+			}
+		}
+
+		if (hasAlpha)
+		{
+			hasAlpha = false;
+			for (std::size_t i = 3; i < image.Pixels.size() && !hasAlpha; i += 4)
+				hasAlpha = image.Pixels[i] != 255;
+		}
+		return true;
+	}
+
+	// Bilinear, texel centres to texel centres.
+	RgbaImage Resample(const RgbaImage& src, std::size_t width, std::size_t height)
+	{
+		RgbaImage dst;
+		dst.Width = width;
+		dst.Height = height;
+		dst.Pixels.resize(width * height * 4);
+
+		for (std::size_t y = 0; y < height; ++y)
+		{
+			float fy = (std::max)((y + 0.5f) * src.Height / height - 0.5f, 0.0f);
+			std::size_t y0 = (std::min)((std::size_t)fy, src.Height - 1);
+			std::size_t y1 = (std::min)(y0 + 1, src.Height - 1);
+			float ty = fy - y0;
+			for (std::size_t x = 0; x < width; ++x)
+			{
+				float fx = (std::max)((x + 0.5f) * src.Width / width - 0.5f, 0.0f);
+				std::size_t x0 = (std::min)((std::size_t)fx, src.Width - 1);
+				std::size_t x1 = (std::min)(x0 + 1, src.Width - 1);
+				float tx = fx - x0;
+				for (int c = 0; c < 4; ++c)
+				{
+					float top = src.Pixels[(y0 * src.Width + x0) * 4 + c] * (1 - tx) + src.Pixels[(y0 * src.Width + x1) * 4 + c] * tx;
+					float bottom = src.Pixels[(y1 * src.Width + x0) * 4 + c] * (1 - tx) + src.Pixels[(y1 * src.Width + x1) * 4 + c] * tx;
+					dst.Pixels[(y * width + x) * 4 + c] = (std::uint8_t)(top * (1 - ty) + bottom * ty + 0.5f);
+				}
+			}
+		}
+		return dst;
+	}
+
+	// 2x2 box filter, as AssetPacker --mips: odd edges repeat their last texel.
+	RgbaImage HalfSize(const RgbaImage& src)
+	{
+		RgbaImage dst;
+		dst.Width = (std::max)(src.Width / 2, (std::size_t)1);
+		dst.Height = (std::max)(src.Height / 2, (std::size_t)1);
+		dst.Pixels.resize(dst.Width * dst.Height * 4);
+
+		for (std::size_t y = 0; y < dst.Height; ++y)
+		{
+			const std::uint8_t* row0 = &src.Pixels[(std::min)(2 * y, src.Height - 1) * src.Width * 4];
+			const std::uint8_t* row1 = &src.Pixels[(std::min)(2 * y + 1, src.Height - 1) * src.Width * 4];
+			for (std::size_t x = 0; x < dst.Width; ++x)
+			{
+				std::size_t x0 = (std::min)(2 * x, src.Width - 1) * 4;
+				std::size_t x1 = (std::min)(2 * x + 1, src.Width - 1) * 4;
+				for (std::size_t c = 0; c < 4; ++c)
+					dst.Pixels[(y * dst.Width + x) * 4 + c] = (std::uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+		return dst;
+	}
+
+	float AlphaCoverage(const RgbaImage& image, float scale)
+	{
+		std::size_t passing = 0;
+		for (std::size_t i = 3; i < image.Pixels.size(); i += 4)
+		{
+			if ((std::min)(image.Pixels[i] * scale, 255.0f) >= AlphaTestReference)
+				++passing;
+		}
+		return (float)passing / (image.Width * image.Height);
+	}
+
+	// Scales alpha so the share of texels passing the alpha test matches coverage.
+	void PreserveCoverage(RgbaImage& image, float coverage)
+	{
+		float lo = 0.0f, hi = 4.0f;
+		for (int iteration = 0; iteration < 12; ++iteration)
+		{
+			float mid = 0.5f * (lo + hi);
+			if (AlphaCoverage(image, mid) < coverage)
+				lo = mid;
+			else
+				hi = mid;
+		}
+
+		for (std::size_t i = 3; i < image.Pixels.size(); i += 4)
+			image.Pixels[i] = (std::uint8_t)(std::min)(image.Pixels[i] * hi + 0.5f, 255.0f);
+	}
+
+	std::vector<RgbaImage> BuildMips(RgbaImage top, bool alphaTested)
+	{
+		float coverage = alphaTested ? AlphaCoverage(top, 1.0f) : 0.0f;
+
+		std::vector<RgbaImage> mips;
+		mips.push_back(std::move(top));
+		while (mips.back().Width > 1 || mips.back().Height > 1)
+		{
+			mips.push_back(HalfSize(mips.back()));
+			if (alphaTested)
+				PreserveCoverage(mips.back(), coverage);
+		}
+		return mips;
+	}
+
+	bool WriteDDS(const std::string& path, DXGI_FORMAT format, std::size_t width, std::size_t height,
+		const std::vector<std::vector<std::uint8_t>>& mips)
+	{
+		DDS_HEADER header = {};
+		header.size = sizeof(DDS_HEADER);
+		header.flags = DDSD_CAPS | DDS_HEIGHT | DDS_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+		header.height = (uint32_t)height;
+		header.width = (uint32_t)width;
+		header.pitchOrLinearSize = (uint32_t)mips[0].size();
+		header.mipMapCount = (uint32_t)mips.size();
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		header.ddspf.flags = DDS_FOURCC;
+		header.caps = DDSCAPS_TEXTURE | ((mips.size() > 1) ? (DDSCAPS_COMPLEX | DDSCAPS_MIPMAP) : 0);
+
+		// BC1 and BC3 have FourCCs every reader knows; the rest need the DX10 header.
+		DDS_HEADER_DXT10 dx10 = {};
+		bool extended = false;
+		if (format == DXGI_FORMAT_BC1_UNORM)
+			header.ddspf.fourCC = MAKEFOURCC('D', 'X', 'T', '1');
+		else if (format == DXGI_FORMAT_BC3_UNORM)
+			header.ddspf.fourCC = MAKEFOURCC('D', 'X', 'T', '5');
+		else
+		{
+			header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+			dx10.dxgiFormat = format;
+			dx10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+			dx10.arraySize = 1;
+			extended = true;
+		}
+
+		std::ofstream fout(path.c_str(), std::ios::binary);
+		if (!fout)
+			return false;
+
+		fout.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+		fout.write((const char*)&header, sizeof(header));
+		if (extended)
+			fout.write((const char*)&dx10, sizeof(dx10));
+		for (const auto& mip : mips)
+			fout.write((const char*)mip.data(), mip.size());
+		return (bool)fout;
+	}
+
+	bool CopySource(const MappedFile& source, const std::string& path)
+	{
+		std::ofstream fout(path.c_str(), std::ios::binary);
+		fout.write((const char*)source.Data(), source.Size());
+		return (bool)fout;
+	}
+
+	std::string FileName(const std::string& path)
+	{
+		std::size_t slash = path.find_last_of("/\\");
+		return (slash == std::string::npos) ? path : path.substr(slash + 1);
+	}
+
+	bool MakeDirectory(const std::string& path)
+	{
+		FileUtil::MakeDirectory(path);
+		std::ofstream probe((path + "/.probe").c_str());
+		bool ok = (bool)probe;
+		probe.close();
+		std::remove((path + "/.probe").c_str());
+		return ok;
+	}
+
+	std::string FormatPsnr(double psnr)
+	{
+		if (std::isinf(psnr))
+			return "  exact";
+		char text[16];
+		std::snprintf(text, sizeof(text), "%7.2f", psnr);
+		return text;
+	}
+
+	struct Options
+	{
+		BlockFormat AlphaFormat = BlockFormat::BC7;
+		std::map<std::string, BlockFormat> Overrides;
+		int Threads = 0;
+		double MinPsnr = 0.0;
+	};
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: TextureCompressor <manifest> <output dir> [--alpha bc3|bc7]\n"
+			"                         [--format name=bc1|bc3|bc7]... [--threads N] [--min-psnr dB]\n");
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 3; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			if (i + 1 >= argc)
+				return false;
+			std::string value = argv[++i];
+
+			if (arg == "--alpha")
+			{
+				if (!ParseBlockFormat(value, options.AlphaFormat) || options.AlphaFormat == BlockFormat::BC1)
+					return false;
+			}
+			else if (arg == "--format")
+			{
+				std::size_t equals = value.find('=');
+				BlockFormat format;
+				if (equals == std::string::npos || !ParseBlockFormat(value.substr(equals + 1), format))
+					return false;
+				options.Overrides[value.substr(0, equals)] = format;
+			}
+			else if (arg == "--threads")
+				options.Threads = std::atoi(value.c_str());
+			else if (arg == "--min-psnr")
+				options.MinPsnr = std::atof(value.c_str());
+			else
+				return false;
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (argc < 3 || !ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const std::string manifestPath = argv[1];
+	const std::string outputDir = argv[2];
+
+	std::vector<ManifestEntry> manifest;
+	if (!LoadManifest(manifestPath, manifest))
+	{
+		std::fprintf(stderr, "could not read %s\n", manifestPath.c_str());
+		return 1;
+	}
+	if (!MakeDirectory(outputDir))
+	{
+		std::fprintf(stderr, "could not write to %s\n", outputDir.c_str());
+		return 1;
+	}
+
+	std::ofstream outManifest((outputDir + "/TextureManifest.txt").c_str());
+	outManifest << "# Block-compressed textures written by Tools/TextureCompressor from " << manifestPath << "\n";
+
+	std::printf("%-16s %-9s %-4s %4s %10s %10s %8s %8s %8s %8s\n", "name", "size", "fmt", "mips",
+		"in bytes", "out bytes", "mip0 rgb", "mip0 a", "all rgb", "ms");
+
+	int failures = 0;
+	std::uint64_t totalIn = 0;
+	std::uint64_t totalOut = 0;
+	for (const ManifestEntry& e : manifest)
+	{
+		std::string outPath = outputDir + "/" + FileName(e.Path);
+
+		MappedFile source;
+		DDSFile file;
+		DDSTextureDesc desc;
+		DDSLayout layout;
+		if (!source.Open(e.Path) ||
+			ParseDDSFile(source.Data(), source.Size(), file) != DDSStatus::Ok ||
+			GetDDSTextureDesc(file, desc) != DDSStatus::Ok ||
+			ComputeDDSLayout(desc, file.BitSize, 0, layout) != DDSStatus::Ok)
+		{
+			std::fprintf(stderr, "could not read %s\n", e.Path.c_str());
+			++failures;
+			continue;
+		}
+
+		if (IsBlockCompressed(desc.Format))
+		{
+			if (!CopySource(source, outPath))
+			{
+				std::fprintf(stderr, "could not write %s\n", outPath.c_str());
+				++failures;
+				continue;
+			}
+			std::printf("%-16s %4zux%-4zu copied, already block compressed\n", e.Name.c_str(), desc.Width, desc.Height);
+			outManifest << e.Name << " " << outPath << "\n";
+			totalIn += source.Size();
+			totalOut += source.Size();
+			continue;
+		}
+
+		RgbaImage image;
+		bool hasAlpha = false;
+		bool srgb = false;
+		if (!ReadSource(file, desc, layout, image, hasAlpha, srgb))
+		{
+			std::fprintf(stderr, "%s: format %d is not 8-bit RGBA/BGRA\n", e.Path.c_str(), (int)desc.Format);
+			++failures;
+			continue;
+		}
+
+		BlockFormat format = hasAlpha ? options.AlphaFormat : BlockFormat::BC1;
+		auto over = options.Overrides.find(e.Name);
+		if (over != options.Overrides.end())
+			format = over->second;
+		bool alphaTested = hasAlpha && format != BlockFormat::BC1;
+
+		std::size_t width = (std::max)((image.Width + 2) / 4 * 4, (std::size_t)4);
+		std::size_t height = (std::max)((image.Height + 2) / 4 * 4, (std::size_t)4);
+		if (width != image.Width || height != image.Height)
+			image = Resample(image, width, height);
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<RgbaImage> mips = BuildMips(std::move(image), alphaTested);
+		std::vector<std::vector<std::uint8_t>> compressed;
+		for (const RgbaImage& mip : mips)
+			compressed.push_back(CompressImage(format, mip, options.Threads));
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		if (!WriteDDS(outPath, DxgiFormat(format, srgb), width, height, compressed))
+		{
+			std::fprintf(stderr, "could not write %s\n", outPath.c_str());
+			++failures;
+			continue;
+		}
+
+		// Read the file back as the game would and measure what it decodes to.
+		MappedFile written;
+		DDSFile outFile;
+		DDSTextureDesc outDesc;
+		DDSLayout outLayout;
+		if (!written.Open(outPath) ||
+			ParseDDSFile(written.Data(), written.Size(), outFile) != DDSStatus::Ok ||
+			GetDDSTextureDesc(outFile, outDesc) != DDSStatus::Ok ||
+			ComputeDDSLayout(outDesc, outFile.BitSize, 0, outLayout) != DDSStatus::Ok ||
+			outDesc.Format != DxgiFormat(format, srgb) || outLayout.MipCount != mips.size())
+		{
+			std::fprintf(stderr, "%s does not read back\n", outPath.c_str());
+			++failures;
+			continue;
+		}
+
+		ImageError first;
+		double rgbError = 0.0;
+		double texels = 0.0;
+		for (std::size_t m = 0; m < mips.size(); ++m)
+		{
+			const DDSSubresource& sub = outLayout.Subresources[m];
+			RgbaImage decoded = DecompressImage(format, outFile.BitData + sub.Offset, sub.Width, sub.Height);
+			ImageError error = CompareImages(mips[m], decoded);
+			if (m == 0)
+				first = error;
+			rgbError += error.RgbMse * sub.Width * sub.Height;
+			texels += (double)sub.Width * sub.Height;
+		}
+		double allRgb = PsnrFromMse(rgbError / texels);
+
+		std::printf("%-16s %4zux%-4zu %-4s %4zu %10zu %10zu %8s %8s %8s %8.1f\n", e.Name.c_str(), width, height,
+			BlockFormatName(format), mips.size(), source.Size(), written.Size(), FormatPsnr(first.RgbPsnr).c_str(),
+			(format == BlockFormat::BC1) ? "     -" : FormatPsnr(first.AlphaPsnr).c_str(), FormatPsnr(allRgb).c_str(), ms);
+
+		if (options.MinPsnr > 0.0 && (first.RgbPsnr < options.MinPsnr ||
+			(format != BlockFormat::BC1 && first.AlphaPsnr < options.MinPsnr)))
+		{
+			std::fprintf(stderr, "%s: PSNR below %.2f dB\n", e.Name.c_str(), options.MinPsnr);
+			++failures;
+		}
+
+		outManifest << e.Name << " " << outPath << "\n";
+		totalIn += source.Size();
+		totalOut += written.Size();
+	}
+
+	std::printf("%u textures, %.1f MB in, %.1f MB out with mips, %d failed\n", (unsigned)manifest.size(),
+		totalIn / (1024.0 * 1024.0), totalOut / (1024.0 * 1024.0), failures);
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+//***************************************************************************************
+// WorldCacheBenchmark.cpp
+//
+// Headless benchmark of the generated-world snapshot cache.  Measures the world half
+// of startup both ways:
+//
+//   cold   key, generation, meshing and handing the snapshot to WorldCache::Save,
+//          which is what a first run waits for; the write itself is timed apart
+//   warm   key and WorldCache::Load, checked against the generated world and meshes
+//
+// and checks that a change to any generator parameter changes the key, and that a
+// truncated or altered snapshot is refused rather than loaded.  Prints one JSON object
+// to stdout; the exit code is 1 if a check fails.  The cache directory is emptied of
+// the snapshot before and after the run.
+//
+// Usage: WorldCacheBenchmark [--size N] [--seed N] [--threads N] [--dir path]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/WorldCacheBenchmark.cpp World.cpp
+//       WorldGenerator.cpp ChunkMesher.cpp PerlinNoise.cpp WorldCache.cpp
+//       Common/FileUtil.cpp Common/MappedFile.cpp Common/Profiler.cpp Common/MemoryTracker.cpp
+//       -o WorldCacheBenchmark
+//***************************************************************************************
+
+#include "../World.h"
+#include "../WorldGenerator.h"
+#include "../ChunkMesher.h"
+#include "../WorldCache.h"
+#include "../Common/ParallelFor.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	bool SameWorld(const World& a, const World& b)
+	{
+		if (a.SizeX() != b.SizeX() || a.SizeY() != b.SizeY() || a.SizeZ() != b.SizeZ() || a.MinY() != b.MinY())
+			return false;
+
+		for (int cy = 0; cy < a.ChunksY(); ++cy)
+		{
+			for (int cz = 0; cz < a.ChunksZ(); ++cz)
+			{
+				for (int cx = 0; cx < a.ChunksX(); ++cx)
+				{
+					if (std::memcmp(a.GetChunk(cx, cy, cz).Blocks, b.GetChunk(cx, cy, cz).Blocks, sizeof(Chunk)) != 0)
+						return false;
+				}
+			}
+		}
+		for (int z = 0; z < a.SizeZ(); ++z)
+		{
+			for (int x = 0; x < a.SizeX(); ++x)
+			{
+				if (a.SurfaceHeight(x, z) != b.SurfaceHeight(x, z))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	bool SameMeshes(const std::vector<ChunkMesh>& a, const std::vector<ChunkMesh>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+
+		for (std::size_t i = 0; i < a.size(); ++i)
+		{
+			const ChunkMesh& ma = a[i];
+			const ChunkMesh& mb = b[i];
+			if (ma.ChunkX != mb.ChunkX || ma.ChunkY != mb.ChunkY || ma.ChunkZ != mb.ChunkZ ||
+				std::memcmp(ma.Origin, mb.Origin, sizeof(ma.Origin)) != 0 ||
+				ma.Vertices.size() != mb.Vertices.size() || ma.Indices.size() != mb.Indices.size() ||
+				ma.Submeshes.size() != mb.Submeshes.size() ||
+				std::memcmp(ma.Vertices.data(), mb.Vertices.data(), ma.Vertices.size() * sizeof(ChunkVertex)) != 0 ||
+				std::memcmp(ma.Indices.data(), mb.Indices.data(), ma.Indices.size() * sizeof(std::uint32_t)) != 0)
+			{
+				return false;
+			}
+			for (std::size_t s = 0; s < ma.Submeshes.size(); ++s)
+			{
+				const ChunkSubmesh& sa = ma.Submeshes[s];
+				const ChunkSubmesh& sb = mb.Submeshes[s];
+				if (sa.Block != sb.Block || sa.IndexCount != sb.IndexCount || sa.StartIndex != sb.StartIndex || sa.BaseVertex != sb.BaseVertex)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	std::vector<char> ReadFile(const std::string& path)
+	{
+		std::ifstream fin(path.c_str(), std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+	}
+
+	void WriteFile(const std::string& path, const std::vector<char>& bytes)
+	{
+		std::ofstream fout(path.c_str(), std::ios::binary | std::ios::trunc);
+		fout.write(bytes.data(), bytes.size());
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: WorldCacheBenchmark [--size N] [--seed N] [--threads N] [--dir path]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	WorldGenParams params;
+	params.Seed = 1;
+	int threads = 0;
+	std::string directory = "WorldCacheBenchmark.cache";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--size") == 0)
+			params.Size = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			params.Seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--threads") == 0)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--dir") == 0)
+			directory = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (params.Size <= 0 || threads < 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (threads == 0)
+		threads = DefaultThreadCount();
+
+	WorldCache cache(directory);
+
+	// Cold: nothing cached.
+	Clock::time_point start = Clock::now();
+	std::uint64_t key = WorldCache::ComputeKey(params);
+	double keyMs = MillisecondsSince(start);
+	const std::string path = cache.SnapshotPath(key);
+	std::remove(path.c_str());
+
+	std::unique_ptr<World> world;
+	std::vector<ChunkMesh> meshes;
+	bool coldMissed = !cache.Load(key, world, meshes);
+
+	Clock::time_point genStart = Clock::now();
+	world = WorldGenerator(params).Generate(threads);
+	double generateMs = MillisecondsSince(genStart);
+	Clock::time_point meshStart = Clock::now();
+	meshes = ChunkMesher::BuildAll(*world, threads);
+	double meshMs = MillisecondsSince(meshStart);
+	Clock::time_point saveStart = Clock::now();
+	cache.Save(key, *world, meshes);
+	double saveMs = MillisecondsSince(saveStart);
+	double coldMs = MillisecondsSince(start);
+
+	Clock::time_point writeStart = Clock::now();
+	cache.Flush();
+	double writeMs = MillisecondsSince(writeStart);
+	const std::vector<char> snapshot = ReadFile(path);
+
+	// Warm: the snapshot from the cold run.
+	start = Clock::now();
+	std::uint64_t warmKey = WorldCache::ComputeKey(params);
+	std::unique_ptr<World> loadedWorld;
+	std::vector<ChunkMesh> loadedMeshes;
+	Clock::time_point loadStart = Clock::now();
+	bool warmHit = warmKey == key && cache.Load(warmKey, loadedWorld, loadedMeshes);
+	double loadMs = MillisecondsSince(loadStart);
+	double warmMs = MillisecondsSince(start);
+	bool warmOk = warmHit && SameWorld(*world, *loadedWorld) && SameMeshes(meshes, loadedMeshes);
+
+	// Every parameter is part of the key.
+	WorldGenParams changed[5] = { params, params, params, params, params };
+	changed[0].Size += 1;
+	changed[1].Seed += 1;
+	changed[2].Frequency *= 1.01;
+	changed[3].WaterLevel += 1;
+	changed[4].SeaFloor -= 1;
+	bool keysOk = true;
+	for (const WorldGenParams& p : changed)
+		keysOk = WorldCache::ComputeKey(p) != key && keysOk;
+
+	// Damaged snapshots are refused.
+	std::unique_ptr<World> rejectedWorld;
+	std::vector<ChunkMesh> rejectedMeshes;
+	std::vector<char> damaged(snapshot.begin(), snapshot.begin() + snapshot.size() / 2);
+	WriteFile(path, damaged);
+	bool truncatedRefused = !cache.Load(key, rejectedWorld, rejectedMeshes);
+	damaged = snapshot;
+	damaged[8] ^= 0x01;   // the key
+	WriteFile(path, damaged);
+	bool alteredRefused = !cache.Load(key, rejectedWorld, rejectedMeshes);
+	bool refusedOk = truncatedRefused && alteredRefused && rejectedWorld == nullptr && rejectedMeshes.empty();
+	std::remove(path.c_str());
+
+	std::size_t vertices = 0;
+	for (const ChunkMesh& mesh : meshes)
+		vertices += mesh.Vertices.size();
+
+	bool verified = coldMissed && warmOk && keysOk && refusedOk;
+
+	std::printf("{\n");
+	std::printf("  \"size\": %d,\n", params.Size);
+	std::printf("  \"seed\": %u,\n", (unsigned)params.Seed);
+	std::printf("  \"threads\": %d,\n", threads);
+	std::printf("  \"chunks\": %d,\n", world->ChunkCount());
+	std::printf("  \"meshes\": %zu,\n", meshes.size());
+	std::printf("  \"vertices\": %zu,\n", vertices);
+	std::printf("  \"snapshot_bytes\": %zu,\n", snapshot.size());
+	std::printf("  \"key_ms\": %.3f,\n", keyMs);
+	std::printf("  \"generate_ms\": %.3f,\n", generateMs);
+	std::printf("  \"mesh_ms\": %.3f,\n", meshMs);
+	std::printf("  \"save_ms\": %.3f,\n", saveMs);
+	std::printf("  \"background_write_ms\": %.3f,\n", writeMs);
+	std::printf("  \"cold_ms\": %.3f,\n", coldMs);
+	std::printf("  \"load_ms\": %.3f,\n", loadMs);
+	std::printf("  \"warm_ms\": %.3f,\n", warmMs);
+	std::printf("  \"speedup\": %.1f,\n", coldMs / (warmMs > 0.0 ? warmMs : 1e-9));
+	std::printf("  \"verified\": %s\n", verified ? "true" : "false");
+	std::printf("}\n");
+	return verified ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+//***************************************************************************************
+// WorldGenBenchmark.cpp
+//
+// Headless benchmark of world generation and chunk meshing.  Links only the portable
+// code (World, WorldGenerator, ChunkMesher, PerlinNoise), so it runs without a GPU or
+// Windows.  Prints one JSON object to stdout.
+//
+// Usage: WorldGenBenchmark [--size N] [--seed N] [--threads N] [--trace file.json]
+//
+// --trace records the run with the profiler and writes it as a Chrome trace.
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/WorldGenBenchmark.cpp World.cpp
+//       WorldGenerator.cpp ChunkMesher.cpp PerlinNoise.cpp Common/Profiler.cpp
+//       Common/MemoryTracker.cpp -o WorldGenBenchmark
+//***************************************************************************************
+
+#include "../World.h"
+#include "../WorldGenerator.h"
+#include "../ChunkMesher.h"
+#include "../Common/ParallelFor.h"
+#include "../Common/Profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	unsigned long long PeakMemoryBytes()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+			return 0;
+		return (unsigned long long)counters.PeakWorkingSetSize;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return 0;
+#if defined(__APPLE__)
+		return (unsigned long long)usage.ru_maxrss;
+#else
+		return (unsigned long long)usage.ru_maxrss * 1024ull;   // kilobytes on Linux
+#endif
+#endif
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: WorldGenBenchmark [--size N] [--seed N] [--threads N] [--trace file.json]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	WorldGenParams params;
+	params.Seed = 1;
+	int threads = 0;
+	const char* tracePath = nullptr;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--size") == 0)
+			params.Size = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			params.Seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--threads") == 0)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--trace") == 0)
+			tracePath = argv[++i];
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (params.Size <= 0 || threads < 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (threads == 0)
+		threads = DefaultThreadCount();
+
+	if (tracePath)
+	{
+		Profiler::SetThreadName("Main");
+		Profiler::BeginCapture();
+	}
+
+	WorldGenerator generator(params);
+
+	Clock::time_point start = Clock::now();
+	std::unique_ptr<World> world = generator.Generate(threads);
+	double generateMs = MillisecondsSince(start);
+
+	start = Clock::now();
+	std::vector<ChunkMesh> meshes = ChunkMesher::BuildAll(*world, threads);
+	double meshMs = MillisecondsSince(start);
+
+	if (tracePath)
+	{
+		Profiler::EndCapture();
+		if (!Profiler::WriteChromeTrace(tracePath))
+			std::fprintf(stderr, "could not write %s\n", tracePath);
+	}
+
+	unsigned long long blocks = 0;
+	for (int z = 0; z < world->SizeZ(); ++z)
+	{
+		for (int y = world->MinY(); y < world->MinY() + world->SizeY(); ++y)
+		{
+			for (int x = 0; x < world->SizeX(); ++x)
+			{
+				if (world->Get(x, y, z) != BlockId::Air)
+					++blocks;
+			}
+		}
+	}
+
+	unsigned long long triangles = 0, vertices = 0;
+	for (const ChunkMesh& mesh : meshes)
+	{
+		triangles += mesh.TriangleCount();
+		vertices += mesh.Vertices.size();
+	}
+
+	double totalSeconds = (generateMs + meshMs) / 1000.0;
+	double seconds = (totalSeconds > 0.0) ? totalSeconds : 1e-9;
+
+	std::printf("{\n");
+	std::printf("  \"size\": %d,\n", params.Size);
+	std::printf("  \"seed\": %u,\n", (unsigned)params.Seed);
+	std::printf("  \"threads\": %d,\n", threads);
+	std::printf("  \"generator_version\": %d,\n", WorldGenerator::Version);
+	std::printf("  \"blocks\": %llu,\n", blocks);
+	std::printf("  \"chunks\": %d,\n", world->ChunkCount());
+	std::printf("  \"meshed_chunks\": %llu,\n", (unsigned long long)meshes.size());
+	std::printf("  \"vertices\": %llu,\n", vertices);
+	std::printf("  \"triangles\": %llu,\n", triangles);
+	std::printf("  \"generate_ms\": %.3f,\n", generateMs);
+	std::printf("  \"mesh_ms\": %.3f,\n", meshMs);
+	std::printf("  \"blocks_per_second\": %.0f,\n", blocks / seconds);
+	std::printf("  \"chunks_per_second\": %.1f,\n", world->ChunkCount() / seconds);
+	std::printf("  \"world_memory_bytes\": %llu,\n", (unsigned long long)world->MemoryBytes());
+	std::printf("  \"peak_memory_bytes\": %llu\n", PeakMemoryBytes());
+	std::printf("}\n");
+	return 0;
+}
@@ -0,0 +1,279 @@
+//***************************************************************************************
+// WorldSaveBenchmark.cpp
+//
+// Headless benchmark of the world save format.  Generates a world, then measures:
+//
+//   encode/decode   ChunkCodec alone, and the size of the encoded chunks against the
+//                   4 KB each takes in memory
+//   save            WorldSave::SaveWorld until everything is on disk, and how long the
+//                   caller itself was held up queueing it
+//   load            WorldSave::LoadWorld from a fresh WorldSave, checked block for block
+//   random reads    LoadChunk of chunks picked at random
+//   rewrites        every chunk saved again --rewrites times, which leaves garbage in
+//                   the regions for compaction to reclaim
+//
+// Prints one JSON object to stdout.  The exit code is 1 if the loaded world differs
+// from the generated one.  The save directory is emptied before and after the run.
+//
+// Usage: WorldSaveBenchmark [--size N] [--seed N] [--threads N] [--dir path]
+//                           [--rewrites N]
+//
+// Build on Linux from the Crate directory:
+//   g++ -std=c++14 -O2 -pthread -I. Tools/WorldSaveBenchmark.cpp World.cpp
+//       WorldGenerator.cpp PerlinNoise.cpp ChunkCodec.cpp RegionFile.cpp WorldSave.cpp
+//       BlockJournal.cpp Common/FileUtil.cpp Common/LzCompression.cpp Common/Profiler.cpp
+//       Common/MemoryTracker.cpp -o WorldSaveBenchmark
+//***************************************************************************************
+
+#include "../World.h"
+#include "../WorldGenerator.h"
+#include "../ChunkCodec.h"
+#include "../WorldSave.h"
+#include "../Common/ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double MillisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	double PerSecond(double count, double ms)
+	{
+		return count / ((ms > 0.0) ? ms / 1000.0 : 1e-9);
+	}
+
+	std::uint64_t FileBytes(const std::string& path)
+	{
+		std::ifstream fin(path.c_str(), std::ios::binary | std::ios::ate);
+		return fin ? (std::uint64_t)fin.tellg() : 0;
+	}
+
+	int RegionCount(int chunks)
+	{
+		return (chunks + RegionFile::Size - 1) / RegionFile::Size;
+	}
+
+	// Bytes on disk of every region the world covers, plus world.dat.
+	std::uint64_t SaveBytes(const WorldSave& save, const World& world)
+	{
+		std::uint64_t bytes = FileBytes(save.InfoPath());
+		for (int ry = 0; ry < RegionCount(world.ChunksY()); ++ry)
+		{
+			for (int rz = 0; rz < RegionCount(world.ChunksZ()); ++rz)
+			{
+				for (int rx = 0; rx < RegionCount(world.ChunksX()); ++rx)
+					bytes += FileBytes(save.RegionPath(rx, ry, rz));
+			}
+		}
+		return bytes;
+	}
+
+	void RemoveSave(const WorldSave& save, const World& world)
+	{
+		std::remove(save.InfoPath().c_str());
+		for (int ry = 0; ry < RegionCount(world.ChunksY()); ++ry)
+		{
+			for (int rz = 0; rz < RegionCount(world.ChunksZ()); ++rz)
+			{
+				for (int rx = 0; rx < RegionCount(world.ChunksX()); ++rx)
+					std::remove(save.RegionPath(rx, ry, rz).c_str());
+			}
+		}
+	}
+
+	bool SameChunk(const Chunk& a, const Chunk& b)
+	{
+		return std::memcmp(a.Blocks, b.Blocks, sizeof(a.Blocks)) == 0;
+	}
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr, "usage: WorldSaveBenchmark [--size N] [--seed N] [--threads N] [--dir path] [--rewrites N]\n");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	WorldGenParams params;
+	params.Seed = 1;
+	int threads = 0;
+	int rewrites = 2;
+	std::string directory = "WorldSaveBenchmark.save";
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (i + 1 >= argc)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		if (std::strcmp(argv[i], "--size") == 0)
+			params.Size = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--seed") == 0)
+			params.Seed = (std::uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		else if (std::strcmp(argv[i], "--threads") == 0)
+			threads = std::atoi(argv[++i]);
+		else if (std::strcmp(argv[i], "--dir") == 0)
+			directory = argv[++i];
+		else if (std::strcmp(argv[i], "--rewrites") == 0)
+			rewrites = std::atoi(argv[++i]);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (params.Size <= 0 || threads < 0 || rewrites < 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (threads == 0)
+		threads = DefaultThreadCount();
+
+	std::unique_ptr<World> world = WorldGenerator(params).Generate(threads);
+	const int chunks = world->ChunkCount();
+	const int chunksXZ = world->ChunksX() * world->ChunksZ();
+	auto chunkAt = [&](int i) -> const Chunk&
+	{
+		return world->GetChunk(i % world->ChunksX(), i / chunksXZ, (i / world->ChunksX()) % world->ChunksZ());
+	};
+
+	// The codec on its own, one thread.
+	std::vector<std::vector<std::uint8_t>> encoded(chunks);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < chunks; ++i)
+		ChunkCodec::Encode(chunkAt(i), encoded[i]);
+	double encodeMs = MillisecondsSince(start);
+
+	std::uint64_t encodedBytes = 0;
+	int uniformChunks = 0;
+	for (const auto& e : encoded)
+	{
+		encodedBytes += e.size();
+		uniformChunks += (e[1] == 1) ? 1 : 0;
+	}
+
+	bool codecOk = true;
+	Chunk decoded;
+	start = Clock::now();
+	for (int i = 0; i < chunks; ++i)
+		codecOk = ChunkCodec::Decode(encoded[i].data(), encoded[i].size(), decoded) && codecOk;
+	double decodeMs = MillisecondsSince(start);
+	for (int i = 0; i < chunks && codecOk; ++i)
+		codecOk = ChunkCodec::Decode(encoded[i].data(), encoded[i].size(), decoded) && SameChunk(decoded, chunkAt(i));
+
+	// Save through the writer thread.
+	double queueMs, saveMs;
+	std::uint64_t diskBytes;
+	{
+		WorldSave save(directory);
+		RemoveSave(save, *world);
+
+		start = Clock::now();
+		save.SaveWorld(*world, params.Seed, WorldGenerator::Version);
+		queueMs = MillisecondsSince(start);
+		save.Flush();
+		saveMs = MillisecondsSince(start);
+		diskBytes = SaveBytes(save, *world);
+	}
+
+	// Load into a fresh WorldSave, so nothing is cached.
+	double loadMs, randomMs;
+	bool loadOk = false;
+	const int randomReads = chunks * 4;
+	{
+		WorldSave save(directory);
+		WorldSaveInfo info;
+		start = Clock::now();
+		std::unique_ptr<World> loaded = save.LoadWorld(&info, threads);
+		loadMs = MillisecondsSince(start);
+
+		loadOk = loaded != nullptr && info.Seed == params.Seed && loaded->SizeX() == world->SizeX() &&
+			loaded->SizeY() == world->SizeY() && loaded->SizeZ() == world->SizeZ() && loaded->MinY() == world->MinY();
+		for (int i = 0; i < chunks && loadOk; ++i)
+		{
+			int cx = i % world->ChunksX(), cy = i / chunksXZ, cz = (i / world->ChunksX()) % world->ChunksZ();
+			loadOk = SameChunk(loaded->GetChunk(cx, cy, cz), world->GetChunk(cx, cy, cz));
+		}
+		for (int z = 0; z < world->SizeZ() && loadOk; ++z)
+		{
+			for (int x = 0; x < world->SizeX() && loadOk; ++x)
+				loadOk = loaded->SurfaceHeight(x, z) == world->SurfaceHeight(x, z);
+		}
+
+		std::mt19937 random(params.Seed);
+		std::uniform_int_distribution<int> pick(0, chunks - 1);
+		start = Clock::now();
+		for (int r = 0; r < randomReads; ++r)
+		{
+			int i = pick(random);
+			int cx = i % world->ChunksX(), cy = i / chunksXZ, cz = (i / world->ChunksX()) % world->ChunksZ();
+			loadOk = save.LoadChunk(cx, cy, cz, decoded) && SameChunk(decoded, world->GetChunk(cx, cy, cz)) && loadOk;
+		}
+		randomMs = MillisecondsSince(start);
+	}
+
+	// Rewrites: every chunk changed in one cell and saved again.
+	double rewriteMs = 0.0;
+	std::uint64_t peakBytes = diskBytes, finalBytes = diskBytes, compactions = 0;
+	{
+		WorldSave save(directory);
+		start = Clock::now();
+		for (int pass = 0; pass < rewrites; ++pass)
+		{
+			for (int i = 0; i < chunks; ++i)
+			{
+				Chunk changed = chunkAt(i);
+				changed.Blocks[pass % ChunkVolume] = (changed.Blocks[pass % ChunkVolume] == BlockId::Air) ? BlockId::Stone : BlockId::Air;
+				save.SaveChunk(i % world->ChunksX(), i / chunksXZ, (i / world->ChunksX()) % world->ChunksZ(), changed);
+			}
+			save.Flush();
+			peakBytes = (std::max)(peakBytes, SaveBytes(save, *world));
+		}
+		rewriteMs = MillisecondsSince(start);
+		finalBytes = SaveBytes(save, *world);
+		compactions = save.Stats().Compactions;
+		RemoveSave(save, *world);
+	}
+
+	const double rawBytes = (double)chunks * sizeof(Chunk);
+
+	std::printf("{\n");
+	std::printf("  \"size\": %d,\n", params.Size);
+	std::printf("  \"seed\": %u,\n", (unsigned)params.Seed);
+	std::printf("  \"threads\": %d,\n", threads);
+	std::printf("  \"chunks\": %d,\n", chunks);
+	std::printf("  \"uniform_chunks\": %d,\n", uniformChunks);
+	std::printf("  \"raw_bytes\": %.0f,\n", rawBytes);
+	std::printf("  \"encoded_bytes\": %llu,\n", (unsigned long long)encodedBytes);
+	std::printf("  \"compression_ratio\": %.1f,\n", rawBytes / (encodedBytes > 0 ? encodedBytes : 1));
+	std::printf("  \"disk_bytes\": %llu,\n", (unsigned long long)diskBytes);
+	std::printf("  \"encode_chunks_per_second\": %.0f,\n", PerSecond(chunks, encodeMs));
+	std::printf("  \"decode_chunks_per_second\": %.0f,\n", PerSecond(chunks, decodeMs));
+	std::printf("  \"save_queue_ms\": %.3f,\n", queueMs);
+	std::printf("  \"save_ms\": %.3f,\n", saveMs);
+	std::printf("  \"save_chunks_per_second\": %.0f,\n", PerSecond(chunks, saveMs));
+	std::printf("  \"load_ms\": %.3f,\n", loadMs);
+	std::printf("  \"load_chunks_per_second\": %.0f,\n", PerSecond(chunks, loadMs));
+	std::printf("  \"random_reads_per_second\": %.0f,\n", PerSecond(randomReads, randomMs));
+	std::printf("  \"rewrite_chunks_per_second\": %.0f,\n", PerSecond((double)chunks * rewrites, rewriteMs));
+	std::printf("  \"rewrite_peak_disk_bytes\": %llu,\n", (unsigned long long)peakBytes);
+	std::printf("  \"rewrite_final_disk_bytes\": %llu,\n", (unsigned long long)finalBytes);
+	std::printf("  \"compactions\": %llu,\n", (unsigned long long)compactions);
+	std::printf("  \"verified\": %s\n", (codecOk && loadOk) ? "true" : "false");
+	std::printf("}\n");
+	return (codecOk && loadOk) ? 0 : 1;
+}
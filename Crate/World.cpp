@@ -0,0 +1,46 @@
+#include "World.h"
+
+World::World(int sizeX, int sizeY, int sizeZ, int minY) :
+	mSizeX(sizeX), mSizeY(sizeY), mSizeZ(sizeZ), mMinY(minY)
+{
+	mChunksX = (sizeX + ChunkSize - 1) / ChunkSize;
+	mChunksY = (sizeY + ChunkSize - 1) / ChunkSize;
+	mChunksZ = (sizeZ + ChunkSize - 1) / ChunkSize;
+
+	Chunk empty;
+	for (BlockId& b : empty.Blocks)
+		b = BlockId::Air;
+
+	mChunks.assign(mChunksX * mChunksY * mChunksZ, empty);
+	mHeights.assign(sizeX * sizeZ, minY);
+	mMemory.Reset(MemoryDomain::Cpu, MemoryCategory::World, MemoryBytes());
+}
+
+bool World::Contains(int x, int y, int z)const
+{
+	y -= mMinY;
+	return x >= 0 && x < mSizeX && y >= 0 && y < mSizeY && z >= 0 && z < mSizeZ;
+}
+
+BlockId World::Get(int x, int y, int z)const
+{
+	if (!Contains(x, y, z))
+		return BlockId::Air;
+
+	y -= mMinY;
+	return GetChunk(x / ChunkSize, y / ChunkSize, z / ChunkSize).Get(x % ChunkSize, y % ChunkSize, z % ChunkSize);
+}
+
+void World::Set(int x, int y, int z, BlockId id)
+{
+	if (!Contains(x, y, z))
+		return;
+
+	y -= mMinY;
+	GetChunk(x / ChunkSize, y / ChunkSize, z / ChunkSize).Set(x % ChunkSize, y % ChunkSize, z % ChunkSize, id);
+}
+
+std::uint64_t World::MemoryBytes()const
+{
+	return (std::uint64_t)mChunks.size() * sizeof(Chunk) + mHeights.size() * sizeof(int);
+}
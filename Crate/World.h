@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Common/MemoryTracker.h"
+#include <cstdint>
+#include <vector>
+
+// Every kind of block the world can hold.  Stored as one byte per cell.
+enum class BlockId : std::uint8_t
+{
+	Air = 0,
+	Grass,
+	Sand,
+	Dirt,
+	Stone,
+	Coal,
+	Iron,
+	Diamond,
+	Redstone,
+	Bedrock,
+	Water,
+	Wood,
+	Leaf,
+	LongGrass,
+	FlowerYellow,
+	FlowerRed,
+	SugarCane,
+	Count
+};
+
+// Which PSO a block's faces are drawn with.
+enum class BlockLayer : std::uint8_t
+{
+	None = 0,      // air, never drawn
+	Opaque,
+	AlphaTested,
+	Transparent
+};
+
+// Full cubes, or two crossed quads for plants.
+enum class BlockShape : std::uint8_t
+{
+	None = 0,
+	Cube,
+	Cross
+};
+
+// What the engine knows about a block type at compile time.  Meshing, culling,
+// collision and generation read these by BlockId, so they stay in this table rather
+// than in a data file; how blocks look comes from Textures/Blocks.txt through
+// BlockRegistry.
+struct BlockProperties
+{
+	BlockId Id;
+	const char* Name;
+	BlockLayer Layer;
+	BlockShape Shape;
+	bool Solid;        // stops the player
+	int Light;         // light emitted, 0 to 15
+	float Hardness;    // seconds to break by hand; negative cannot be broken
+};
+
+constexpr BlockProperties gBlockProperties[] =
+{
+	{ BlockId::Air,          "air",          BlockLayer::None,        BlockShape::None,  false, 0,  0.0f },
+	{ BlockId::Grass,        "grass",        BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  0.6f },
+	{ BlockId::Sand,         "sand",         BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  0.5f },
+	{ BlockId::Dirt,         "dirt",         BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  0.5f },
+	{ BlockId::Stone,        "stone",        BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  1.5f },
+	{ BlockId::Coal,         "coal",         BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  3.0f },
+	{ BlockId::Iron,         "iron",         BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  3.0f },
+	{ BlockId::Diamond,      "diamond",      BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  3.0f },
+	{ BlockId::Redstone,     "redstone",     BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  3.0f },
+	{ BlockId::Bedrock,      "bedrock",      BlockLayer::Opaque,      BlockShape::Cube,  true,  0, -1.0f },
+	{ BlockId::Water,        "water",        BlockLayer::Transparent, BlockShape::Cube,  false, 0, -1.0f },
+	{ BlockId::Wood,         "wood",         BlockLayer::Opaque,      BlockShape::Cube,  true,  0,  2.0f },
+	{ BlockId::Leaf,         "leaf",         BlockLayer::AlphaTested, BlockShape::Cube,  true,  0,  0.2f },
+	{ BlockId::LongGrass,    "longGrass",    BlockLayer::AlphaTested, BlockShape::Cross, false, 0,  0.0f },
+	{ BlockId::FlowerYellow, "flowerYellow", BlockLayer::AlphaTested, BlockShape::Cross, false, 0,  0.0f },
+	{ BlockId::FlowerRed,    "flowerRed",    BlockLayer::AlphaTested, BlockShape::Cross, false, 0,  0.0f },
+	{ BlockId::SugarCane,    "sugarCane",    BlockLayer::AlphaTested, BlockShape::Cross, false, 0,  0.0f },
+};
+
+constexpr bool BlockPropertiesInOrder(int i = 0)
+{
+	return i == (int)BlockId::Count || ((int)gBlockProperties[i].Id == i && BlockPropertiesInOrder(i + 1));
+}
+
+static_assert(sizeof(gBlockProperties) / sizeof(gBlockProperties[0]) == (int)BlockId::Count, "one row per BlockId");
+static_assert(BlockPropertiesInOrder(), "gBlockProperties rows must be in BlockId order");
+
+constexpr const BlockProperties& GetBlockProperties(BlockId id) { return gBlockProperties[(int)id]; }
+constexpr BlockLayer GetBlockLayer(BlockId id) { return gBlockProperties[(int)id].Layer; }
+constexpr BlockShape GetBlockShape(BlockId id) { return gBlockProperties[(int)id].Shape; }
+constexpr const char* GetBlockName(BlockId id) { return gBlockProperties[(int)id].Name; }
+constexpr bool IsSolidBlock(BlockId id) { return gBlockProperties[(int)id].Solid; }
+constexpr int GetBlockLight(BlockId id) { return gBlockProperties[(int)id].Light; }
+constexpr float GetBlockHardness(BlockId id) { return gBlockProperties[(int)id].Hardness; }
+
+// True for cubes that completely hide the faces of their neighbours.
+constexpr bool IsOpaqueBlock(BlockId id)
+{
+	return gBlockProperties[(int)id].Layer == BlockLayer::Opaque && gBlockProperties[(int)id].Shape == BlockShape::Cube;
+}
+
+static_assert(IsOpaqueBlock(BlockId::Stone) && !IsOpaqueBlock(BlockId::Leaf) && !IsOpaqueBlock(BlockId::Water),
+	"leaves and water must not cull their neighbours");
+
+const int ChunkSize = 16;
+const int ChunkVolume = ChunkSize * ChunkSize * ChunkSize;
+
+// A 16x16x16 cube of blocks, indexed x fastest, then z, then y.
+struct Chunk
+{
+	BlockId Blocks[ChunkVolume];
+
+	static int Index(int x, int y, int z) { return x + ChunkSize * (z + ChunkSize * y); }
+
+	BlockId Get(int x, int y, int z)const { return Blocks[Index(x, y, z)]; }
+	void Set(int x, int y, int z, BlockId id) { Blocks[Index(x, y, z)] = id; }
+};
+
+// Fixed-size block world made of chunks.  Columns run from 0 to SizeX-1 and 0 to
+// SizeZ-1, heights from MinY to MinY + SizeY - 1; everything outside reads as air.
+class World
+{
+public:
+	World(int sizeX, int sizeY, int sizeZ, int minY);
+
+	int SizeX()const { return mSizeX; }
+	int SizeY()const { return mSizeY; }
+	int SizeZ()const { return mSizeZ; }
+	int MinY()const { return mMinY; }
+
+	int ChunksX()const { return mChunksX; }
+	int ChunksY()const { return mChunksY; }
+	int ChunksZ()const { return mChunksZ; }
+	int ChunkCount()const { return mChunksX * mChunksY * mChunksZ; }
+
+	bool Contains(int x, int y, int z)const;
+
+	BlockId Get(int x, int y, int z)const;
+	void Set(int x, int y, int z, BlockId id);
+
+	Chunk& GetChunk(int cx, int cy, int cz) { return mChunks[ChunkIndex(cx, cy, cz)]; }
+	const Chunk& GetChunk(int cx, int cy, int cz)const { return mChunks[ChunkIndex(cx, cy, cz)]; }
+
+	// Height of the surface block of each column, filled in by the generator.
+	int SurfaceHeight(int x, int z)const { return mHeights[x + z * mSizeX]; }
+	void SetSurfaceHeight(int x, int z, int h) { mHeights[x + z * mSizeX] = h; }
+
+	std::uint64_t MemoryBytes()const;
+
+private:
+	int ChunkIndex(int cx, int cy, int cz)const { return cx + mChunksX * (cz + mChunksZ * cy); }
+
+private:
+	int mSizeX, mSizeY, mSizeZ, mMinY;
+	int mChunksX, mChunksY, mChunksZ;
+
+	std::vector<Chunk> mChunks;
+	std::vector<int> mHeights;
+
+	TrackedMemory mMemory;
+};
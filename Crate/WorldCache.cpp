@@ -0,0 +1,363 @@
+#include "WorldCache.h"
+#include "Common/FileUtil.h"
+#include "Common/Hash.h"
+#include "Common/MappedFile.h"
+#include "Common/Profiler.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const char SnapshotMagic[4] = { 'C', 'R', 'W', 'C' };
+
+	struct Header
+	{
+		char Magic[4];
+		std::uint32_t Version;
+		std::uint64_t Key;
+		std::int32_t SizeX;
+		std::int32_t SizeY;
+		std::int32_t SizeZ;
+		std::int32_t MinY;
+		std::uint32_t ChunkCount;
+		std::uint32_t MeshCount;
+		std::uint64_t HeightsOffset;
+		std::uint64_t ChunksOffset;
+		std::uint64_t MeshesOffset;
+		std::uint64_t FileBytes;
+	};
+
+	struct MeshRecord
+	{
+		std::int32_t ChunkX, ChunkY, ChunkZ;
+		float Origin[3];
+		std::uint32_t VertexCount;
+		std::uint32_t IndexCount;
+		std::uint32_t SubmeshCount;
+		std::uint32_t Reserved;
+		std::uint64_t VertexOffset;
+		std::uint64_t IndexOffset;
+		std::uint64_t SubmeshOffset;
+	};
+
+	const std::uint64_t Alignment = 16;
+
+	std::uint64_t Align(std::uint64_t offset)
+	{
+		return (offset + Alignment - 1) & ~(Alignment - 1);
+	}
+
+	// True if [offset, offset + count * size) lies inside a file of fileBytes.
+	bool InFile(std::uint64_t offset, std::uint64_t count, std::uint64_t size, std::uint64_t fileBytes)
+	{
+		return offset <= fileBytes && count <= (fileBytes - offset) / size;
+	}
+
+	bool IsKeyName(const std::string& name)
+	{
+		return name.size() == 16 && std::all_of(name.begin(), name.end(), [](char c) { return std::isxdigit((unsigned char)c) != 0; });
+	}
+}
+
+WorldCache::WorldCache(const std::string& directory) :
+	mDirectory(directory)
+{
+	FileUtil::MakeDirectory(mDirectory);
+}
+
+WorldCache::~WorldCache()
+{
+	Flush();
+}
+
+std::uint64_t WorldCache::ComputeKey(const WorldGenParams& params)
+{
+	PROFILE_ZONE("WorldCache::ComputeKey");
+
+	std::uint64_t key = Hash::Combine(Hash::FnvOffsetBasis, (std::uint32_t)Version);
+	key = Hash::Combine(key, (int)WorldGenerator::Version);
+	key = Hash::Combine(key, (int)ChunkMesher::Version);
+	key = Hash::Combine(key, (std::uint32_t)sizeof(ChunkVertex));
+	key = Hash::Combine(key, params.Size);
+	key = Hash::Combine(key, params.Seed);
+	key = Hash::Combine(key, params.Frequency);
+	key = Hash::Combine(key, params.WaterLevel);
+	key = Hash::Combine(key, params.SeaFloor);
+
+	// The probe shares every parameter but the size, so it exercises the same terrain,
+	// ores, water, plants and trees code.
+	WorldGenParams probeParams = params;
+	probeParams.Size = ProbeSize;
+	std::unique_ptr<World> probe = WorldGenerator(probeParams).Generate(1);
+	for (int cy = 0; cy < probe->ChunksY(); ++cy)
+	{
+		for (int cz = 0; cz < probe->ChunksZ(); ++cz)
+		{
+			for (int cx = 0; cx < probe->ChunksX(); ++cx)
+				key = Hash::Fnv1a(probe->GetChunk(cx, cy, cz).Blocks, sizeof(Chunk), key);
+		}
+	}
+	for (int z = 0; z < probe->SizeZ(); ++z)
+	{
+		for (int x = 0; x < probe->SizeX(); ++x)
+			key = Hash::Combine(key, probe->SurfaceHeight(x, z));
+	}
+	for (const ChunkMesh& mesh : ChunkMesher::BuildAll(*probe, 1))
+		key = ChunkMesher::HashMesh(mesh, key);
+	return key;
+}
+
+std::string WorldCache::SnapshotPath(std::uint64_t key)const
+{
+	return mDirectory + "/" + Hash::ToHex(key) + ".snapshot";
+}
+
+std::string WorldCache::IndexPath()const
+{
+	return mDirectory + "/index.txt";
+}
+
+bool WorldCache::Load(std::uint64_t key, std::unique_ptr<World>& worldOut, std::vector<ChunkMesh>& meshesOut)
+{
+	PROFILE_ZONE("WorldCache::Load");
+
+	MappedFile file;
+	if (!file.Open(SnapshotPath(key)) || file.Size() < sizeof(Header))
+		return false;
+
+	// Every count and offset is checked against the file before it is used.
+	Header header;
+	std::memcpy(&header, file.Data(), sizeof(header));
+	const std::uint64_t fileBytes = file.Size();
+	if (std::memcmp(header.Magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 || header.Version != Version ||
+		header.Key != key || header.FileBytes != fileBytes ||
+		header.SizeX <= 0 || header.SizeY <= 0 || header.SizeZ <= 0 ||
+		!InFile(header.HeightsOffset, (std::uint64_t)header.SizeX * header.SizeZ, sizeof(std::int32_t), fileBytes) ||
+		!InFile(header.ChunksOffset, header.ChunkCount, sizeof(Chunk), fileBytes) ||
+		!InFile(header.MeshesOffset, header.MeshCount, sizeof(MeshRecord), fileBytes))
+	{
+		return false;
+	}
+
+	std::uint64_t chunksX = (header.SizeX + ChunkSize - 1) / ChunkSize;
+	std::uint64_t chunksY = (header.SizeY + ChunkSize - 1) / ChunkSize;
+	std::uint64_t chunksZ = (header.SizeZ + ChunkSize - 1) / ChunkSize;
+	if (header.ChunkCount != chunksX * chunksY * chunksZ)
+		return false;
+
+	std::vector<ChunkMesh> meshes(header.MeshCount);
+	for (std::uint32_t i = 0; i < header.MeshCount; ++i)
+	{
+		MeshRecord record;
+		std::memcpy(&record, file.Data() + header.MeshesOffset + i * sizeof(MeshRecord), sizeof(record));
+		if (!InFile(record.VertexOffset, record.VertexCount, sizeof(ChunkVertex), fileBytes) ||
+			!InFile(record.IndexOffset, record.IndexCount, sizeof(std::uint32_t), fileBytes) ||
+			!InFile(record.SubmeshOffset, record.SubmeshCount, sizeof(ChunkSubmeshRecord), fileBytes))
+		{
+			return false;
+		}
+
+		ChunkMesh& mesh = meshes[i];
+		mesh.ChunkX = record.ChunkX;
+		mesh.ChunkY = record.ChunkY;
+		mesh.ChunkZ = record.ChunkZ;
+		std::memcpy(mesh.Origin, record.Origin, sizeof(mesh.Origin));
+		mesh.Vertices.resize(record.VertexCount);
+		std::memcpy(mesh.Vertices.data(), file.Data() + record.VertexOffset, record.VertexCount * sizeof(ChunkVertex));
+		mesh.Indices.resize(record.IndexCount);
+		std::memcpy(mesh.Indices.data(), file.Data() + record.IndexOffset, record.IndexCount * sizeof(std::uint32_t));
+
+		mesh.Submeshes.resize(record.SubmeshCount);
+		for (std::uint32_t s = 0; s < record.SubmeshCount; ++s)
+		{
+			ChunkSubmeshRecord sr;
+			std::memcpy(&sr, file.Data() + record.SubmeshOffset + s * sizeof(ChunkSubmeshRecord), sizeof(sr));
+			if (!sr.To(record.VertexCount, record.IndexCount, mesh.Submeshes[s]))
+				return false;
+		}
+	}
+
+	std::unique_ptr<World> world = std::make_unique<World>(header.SizeX, header.SizeY, header.SizeZ, header.MinY);
+	const std::uint8_t* heights = file.Data() + header.HeightsOffset;
+	for (int z = 0; z < header.SizeZ; ++z)
+	{
+		for (int x = 0; x < header.SizeX; ++x)
+		{
+			std::int32_t h;
+			std::memcpy(&h, heights + (x + (std::size_t)z * header.SizeX) * sizeof(h), sizeof(h));
+			world->SetSurfaceHeight(x, z, h);
+		}
+	}
+
+	const std::uint8_t* chunks = file.Data() + header.ChunksOffset;
+	for (int cy = 0; cy < world->ChunksY(); ++cy)
+	{
+		for (int cz = 0; cz < world->ChunksZ(); ++cz)
+		{
+			for (int cx = 0; cx < world->ChunksX(); ++cx, chunks += sizeof(Chunk))
+				std::memcpy(world->GetChunk(cx, cy, cz).Blocks, chunks, sizeof(Chunk));
+		}
+	}
+
+	// A corrupt block id would index past the block tables.
+	for (int cy = 0; cy < world->ChunksY(); ++cy)
+	{
+		for (int cz = 0; cz < world->ChunksZ(); ++cz)
+		{
+			for (int cx = 0; cx < world->ChunksX(); ++cx)
+			{
+				for (BlockId b : world->GetChunk(cx, cy, cz).Blocks)
+				{
+					if (b >= BlockId::Count)
+						return false;
+				}
+			}
+		}
+	}
+
+	file.Close();
+	Touch(key);
+	worldOut = std::move(world);
+	meshesOut = std::move(meshes);
+	return true;
+}
+
+void WorldCache::Save(std::uint64_t key, const World& world, const std::vector<ChunkMesh>& meshes)
+{
+	PROFILE_ZONE("WorldCache::Save");
+
+	Header header = {};
+	std::memcpy(header.Magic, SnapshotMagic, sizeof(SnapshotMagic));
+	header.Version = Version;
+	header.Key = key;
+	header.SizeX = world.SizeX();
+	header.SizeY = world.SizeY();
+	header.SizeZ = world.SizeZ();
+	header.MinY = world.MinY();
+	header.ChunkCount = (std::uint32_t)world.ChunkCount();
+	header.MeshCount = (std::uint32_t)meshes.size();
+	header.HeightsOffset = Align(sizeof(Header));
+	header.ChunksOffset = Align(header.HeightsOffset + (std::uint64_t)world.SizeX() * world.SizeZ() * sizeof(std::int32_t));
+	header.MeshesOffset = Align(header.ChunksOffset + (std::uint64_t)header.ChunkCount * sizeof(Chunk));
+
+	std::vector<MeshRecord> records(meshes.size());
+	std::uint64_t end = Align(header.MeshesOffset + records.size() * sizeof(MeshRecord));
+	for (std::size_t i = 0; i < meshes.size(); ++i)
+	{
+		const ChunkMesh& mesh = meshes[i];
+		MeshRecord& record = records[i];
+		record = MeshRecord();
+		record.ChunkX = mesh.ChunkX;
+		record.ChunkY = mesh.ChunkY;
+		record.ChunkZ = mesh.ChunkZ;
+		std::memcpy(record.Origin, mesh.Origin, sizeof(record.Origin));
+		record.VertexCount = (std::uint32_t)mesh.Vertices.size();
+		record.IndexCount = (std::uint32_t)mesh.Indices.size();
+		record.SubmeshCount = (std::uint32_t)mesh.Submeshes.size();
+		record.VertexOffset = end;
+		end = Align(end + mesh.Vertices.size() * sizeof(ChunkVertex));
+		record.IndexOffset = end;
+		end = Align(end + mesh.Indices.size() * sizeof(std::uint32_t));
+		record.SubmeshOffset = end;
+		end = Align(end + mesh.Submeshes.size() * sizeof(ChunkSubmeshRecord));
+	}
+	header.FileBytes = end;
+
+	std::vector<std::uint8_t> image((std::size_t)end, 0);
+	std::memcpy(image.data(), &header, sizeof(header));
+
+	std::uint8_t* heights = image.data() + header.HeightsOffset;
+	for (int z = 0; z < world.SizeZ(); ++z)
+	{
+		for (int x = 0; x < world.SizeX(); ++x, heights += sizeof(std::int32_t))
+		{
+			std::int32_t h = world.SurfaceHeight(x, z);
+			std::memcpy(heights, &h, sizeof(h));
+		}
+	}
+
+	std::uint8_t* chunks = image.data() + header.ChunksOffset;
+	for (int cy = 0; cy < world.ChunksY(); ++cy)
+	{
+		for (int cz = 0; cz < world.ChunksZ(); ++cz)
+		{
+			for (int cx = 0; cx < world.ChunksX(); ++cx, chunks += sizeof(Chunk))
+				std::memcpy(chunks, world.GetChunk(cx, cy, cz).Blocks, sizeof(Chunk));
+		}
+	}
+
+	if (!records.empty())
+		std::memcpy(image.data() + header.MeshesOffset, records.data(), records.size() * sizeof(MeshRecord));
+	for (std::size_t i = 0; i < meshes.size(); ++i)
+	{
+		const ChunkMesh& mesh = meshes[i];
+		const MeshRecord& record = records[i];
+		if (!mesh.Vertices.empty())
+			std::memcpy(image.data() + record.VertexOffset, mesh.Vertices.data(), mesh.Vertices.size() * sizeof(ChunkVertex));
+		if (!mesh.Indices.empty())
+			std::memcpy(image.data() + record.IndexOffset, mesh.Indices.data(), mesh.Indices.size() * sizeof(std::uint32_t));
+		for (std::size_t s = 0; s < mesh.Submeshes.size(); ++s)
+		{
+			ChunkSubmeshRecord sr = ChunkSubmeshRecord::From(mesh.Submeshes[s]);
+			std::memcpy(image.data() + record.SubmeshOffset + s * sizeof(ChunkSubmeshRecord), &sr, sizeof(sr));
+		}
+	}
+
+	// The copy is done; writing it does not hold up the caller.
+	mWriters.emplace_back([this, key, image = std::move(image)]()
+	{
+		Profiler::SetThreadName("WorldCache");
+		PROFILE_ZONE("WorldCache::Write");
+
+		std::string path = SnapshotPath(key);
+		std::string temp = path + ".tmp";
+		{
+			std::ofstream fout(temp.c_str(), std::ios::binary | std::ios::trunc);
+			fout.write((const char*)image.data(), image.size());
+			if (!fout)
+			{
+				fout.close();
+				std::remove(temp.c_str());
+				return;
+			}
+		}
+		if (FileUtil::RenameOver(temp, path))
+			Touch(key);
+	});
+}
+
+void WorldCache::Flush()
+{
+	for (std::thread& writer : mWriters)
+		writer.join();
+	mWriters.clear();
+}
+
+void WorldCache::Touch(std::uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(mIndexMutex);
+
+	std::string name = Hash::ToHex(key);
+	std::vector<std::string> names(1, name);
+	{
+		std::ifstream fin(IndexPath().c_str());
+		std::string line;
+		while (std::getline(fin, line))
+		{
+			if (IsKeyName(line) && line != name)
+				names.push_back(line);
+		}
+	}
+
+	for (std::size_t i = MaxSnapshots; i < names.size(); ++i)
+		std::remove((mDirectory + "/" + names[i] + ".snapshot").c_str());
+	if (names.size() > (std::size_t)MaxSnapshots)
+		names.resize(MaxSnapshots);
+
+	std::ofstream fout(IndexPath().c_str(), std::ios::trunc);
+	for (const std::string& n : names)
+		fout << n << "\n";
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "World.h"
+#include "WorldGenerator.h"
+#include "ChunkMesher.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Snapshots of generated worlds with their meshes, so a world built before starts
+// without generating or meshing it again.  Each snapshot is one file named after a key
+// covering everything the world and its meshes depend on: the generator parameters,
+// WorldGenerator::Version, ChunkMesher::Version, the vertex layout, and a fingerprint
+// of a small probe world generated and meshed by the running code.  The fingerprint
+// catches generator or mesher changes that forgot to bump their version.
+//
+//   header     "CRWC", Version, key, world size, chunk and mesh counts, offsets
+//   heights    int32 per column
+//   chunks     the blocks of every chunk, in World chunk order
+//   meshes     per mesh: chunk position, origin, and the count and offset of its
+//              vertices, indices and submeshes
+//   arrays     the vertices, indices and submeshes themselves
+//
+// Load maps the file and copies out of the mapping.  Save builds the file image and
+// leaves writing it to a thread of its own; the file is written aside and renamed into
+// place, so a snapshot is either whole or missing.  Only the MaxSnapshots most
+// recently used snapshots are kept.
+class WorldCache
+{
+public:
+	static const std::uint32_t Version = 1;
+	static const int MaxSnapshots = 8;
+
+	// Columns along x and z of the probe world behind the key's fingerprint.
+	static const int ProbeSize = 16;
+
+	// Creates the directory if needed.
+	explicit WorldCache(const std::string& directory = "WorldCache");
+	WorldCache(const WorldCache& rhs) = delete;
+	WorldCache& operator=(const WorldCache& rhs) = delete;
+
+	// Waits for saves still being written.
+	~WorldCache();
+
+	// Generates and meshes the probe world, so it costs a little time.
+	static std::uint64_t ComputeKey(const WorldGenParams& params);
+
+	std::string SnapshotPath(std::uint64_t key)const;
+
+	// False if there is no valid snapshot for the key; world and meshes are then left
+	// as they were.
+	bool Load(std::uint64_t key, std::unique_ptr<World>& world, std::vector<ChunkMesh>& meshes);
+
+	void Save(std::uint64_t key, const World& world, const std::vector<ChunkMesh>& meshes);
+
+	// Waits until every snapshot saved so far is written.
+	void Flush();
+
+private:
+	std::string IndexPath()const;
+
+	// Moves the key to the front of the index and removes the snapshots that fall off
+	// its end.
+	void Touch(std::uint64_t key);
+
+private:
+	std::string mDirectory;
+	std::mutex mIndexMutex;
+	std::vector<std::thread> mWriters;
+};
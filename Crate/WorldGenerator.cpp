@@ -0,0 +1,172 @@
+#include "WorldGenerator.h"
+#include "PerlinNoise.h"
+#include "Common/ParallelFor.h"
+#include "Common/Profiler.h"
+
+namespace
+{
+	// splitmix64.  Each column gets its own generator seeded from (seed, x, z) so the
+	// columns can be generated in any order on any thread.
+	class Random
+	{
+	public:
+		explicit Random(std::uint64_t seed) : mState(seed) {}
+
+		std::uint64_t Next()
+		{
+			std::uint64_t z = (mState += 0x9e3779b97f4a7c15ull);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+			return z ^ (z >> 31);
+		}
+
+		// Uniform in [rangeMin, rangeMax), like CrateApp::RandomNum used to be.
+		double Range(int rangeMin, int rangeMax)
+		{
+			double u = (double)(Next() >> 11) * (1.0 / 9007199254740992.0);
+			return u * (rangeMax - rangeMin) + rangeMin;
+		}
+
+	private:
+		std::uint64_t mState;
+	};
+
+	std::uint64_t ColumnSeed(std::uint32_t seed, int x, int z)
+	{
+		return ((std::uint64_t)seed << 32) ^ ((std::uint64_t)(std::uint32_t)x << 16) ^ (std::uint64_t)(std::uint32_t)z * 0x9e3779b1ull;
+	}
+
+	BlockId ShallowOre(Random& rng)
+	{
+		if (rng.Range(1, 100) > 95)
+			return BlockId::Coal;
+		if (rng.Range(1, 100) > 98)
+			return BlockId::Iron;
+		return BlockId::Stone;
+	}
+
+	BlockId DeepOre(Random& rng)
+	{
+		if (rng.Range(1, 200) > 199)
+			return BlockId::Diamond;
+		if (rng.Range(1, 100) > 99)
+			return BlockId::Redstone;
+		if (rng.Range(1, 100) > 98)
+			return BlockId::Coal;
+		if (rng.Range(1, 100) > 95)
+			return BlockId::Iron;
+		return BlockId::Stone;
+	}
+}
+
+WorldGenerator::WorldGenerator(const WorldGenParams& params) :
+	mParams(params)
+{
+	Random rng(params.Seed);
+	mAmplitude = rng.Range(10, 20);
+	mNoiseSeed = (int)rng.Range(1, 100);
+}
+
+std::unique_ptr<World> WorldGenerator::Generate(int threadCount)const
+{
+	PROFILE_ZONE("WorldGenerator::Generate");
+
+	std::unique_ptr<World> world(new World(mParams.Size, Height, mParams.Size, MinY));
+
+	// Rows only write their own columns.  Trees spill into neighbouring rows, so they
+	// are collected per row and placed afterwards in row order.
+	std::vector<std::vector<Tree>> trees(mParams.Size);
+	ParallelFor(0, mParams.Size, threadCount, [&](int z)
+	{
+		GenerateRow(*world, z, trees[z]);
+	});
+
+	{
+		PROFILE_ZONE("WorldGenerator::PlaceTrees");
+		for (auto& row : trees)
+		{
+			for (const Tree& tree : row)
+				PlaceTree(*world, tree);
+		}
+	}
+
+	return world;
+}
+
+void WorldGenerator::GenerateRow(World& world, int z, std::vector<Tree>& trees)const
+{
+	PROFILE_ZONE("WorldGenerator::GenerateRow");
+
+	PerlinNoise noise(0.0, mParams.Frequency, mAmplitude, 1, mNoiseSeed);
+
+	for (int x = 0; x < mParams.Size; ++x)
+	{
+		Random rng(ColumnSeed(mParams.Seed, x, z));
+		int h = noise.GetHeight(x, z);
+		world.SetSurfaceHeight(x, z, h);
+
+		// Surface block, then layers of dirt, stone with ores and bedrock below it.
+		world.Set(x, h, z, (h > mParams.WaterLevel) ? BlockId::Grass : BlockId::Sand);
+		for (int depth = 1; depth < 28; ++depth)
+		{
+			BlockId block;
+			if (depth <= 5)
+				block = BlockId::Dirt;
+			else if (depth <= 15)
+				block = ShallowOre(rng);
+			else if (depth < 25)
+				block = DeepOre(rng);
+			else
+				block = BlockId::Bedrock;
+
+			world.Set(x, h - depth, z, block);
+		}
+
+		for (int y = mParams.SeaFloor; y <= mParams.WaterLevel; ++y)
+		{
+			if (world.Get(x, y, z) == BlockId::Air)
+				world.Set(x, y, z, BlockId::Water);
+		}
+
+		// Sugar cane on the shore, flowers, long grass or a tree above it.
+		if (h == mParams.WaterLevel)
+		{
+			if (rng.Range(1, 100) > 99)
+			{
+				int caneHeight = (int)rng.Range(1, 4);
+				for (int i = 1; i <= caneHeight; ++i)
+					world.Set(x, h + i, z, BlockId::SugarCane);
+			}
+		}
+		else if (h > mParams.WaterLevel)
+		{
+			if (rng.Range(1, 100) > 99)
+				world.Set(x, h + 1, z, BlockId::FlowerYellow);
+			else if (rng.Range(1, 100) > 99)
+				world.Set(x, h + 1, z, BlockId::FlowerRed);
+			else if (rng.Range(1, 100) > 70)
+				world.Set(x, h + 1, z, BlockId::LongGrass);
+			else if (rng.Range(1, 200) > 199)
+				trees.push_back(Tree{ x, h, z });
+		}
+	}
+}
+
+void WorldGenerator::PlaceTree(World& world, const Tree& tree)const
+{
+	for (int i = 1; i <= 5; ++i)
+		world.Set(tree.X, tree.Y + i, tree.Z, BlockId::Wood);
+
+	// Leaves never replace anything, so overlapping trees keep their trunks.
+	for (int y = 3; y < 7; ++y)
+	{
+		for (int dz = -2; dz <= 2; ++dz)
+		{
+			for (int dx = -2; dx <= 2; ++dx)
+			{
+				if (world.Get(tree.X + dx, tree.Y + y, tree.Z + dz) == BlockId::Air)
+					world.Set(tree.X + dx, tree.Y + y, tree.Z + dz, BlockId::Leaf);
+			}
+		}
+	}
+}
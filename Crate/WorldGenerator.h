@@ -0,0 +1,49 @@
+#pragma once
+
+#include "World.h"
+#include <cstdint>
+#include <memory>
+
+struct WorldGenParams
+{
+	int Size = 100;             // columns along x and z
+	std::uint32_t Seed = 0;     // everything else random is derived from this
+	double Frequency = 0.15;
+	int WaterLevel = -2;        // top of the sea
+	int SeaFloor = -10;         // water fills air from here up to WaterLevel
+};
+
+// Builds the terrain, ores, water, plants and trees of a world.  The result depends only
+// on the parameters, not on the number of threads used.
+class WorldGenerator
+{
+public:
+	// Bump whenever a change makes the same parameters produce a different world.
+	static const int Version = 1;
+
+	// Vertical extent of every generated world.  Terrain reaches at most 20 above and
+	// 47 below zero; trees add 6 on top.
+	static const int MinY = -48;
+	static const int Height = 80;
+
+	explicit WorldGenerator(const WorldGenParams& params);
+
+	const WorldGenParams& Params()const { return mParams; }
+
+	// threadCount 0 uses every hardware thread.
+	std::unique_ptr<World> Generate(int threadCount = 0)const;
+
+private:
+	struct Tree
+	{
+		int X, Y, Z;
+	};
+
+	void GenerateRow(World& world, int z, std::vector<Tree>& trees)const;
+	void PlaceTree(World& world, const Tree& tree)const;
+
+private:
+	WorldGenParams mParams;
+	double mAmplitude;
+	int mNoiseSeed;
+};
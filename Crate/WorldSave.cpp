@@ -0,0 +1,564 @@
+#include "WorldSave.h"
+#include "ChunkCodec.h"
+#include "Common/FileUtil.h"
+#include "Common/LzCompression.h"
+#include "Common/ParallelFor.h"
+#include "Common/Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const char InfoMagic[4] = { 'C', 'R', 'W', 'D' };
+
+	struct InfoHeader
+	{
+		char Magic[4];
+		std::uint32_t Version;
+		std::uint32_t Seed;
+		std::int32_t GeneratorVersion;
+		std::int32_t SizeX;
+		std::int32_t SizeY;
+		std::int32_t SizeZ;
+		std::int32_t MinY;
+		std::uint32_t HeightsBytes;   // LZ compressed, SizeX * SizeZ int32 values follow
+	};
+
+	// Region holding a chunk position, and the chunk's position within it.
+	int RegionCoord(int c)
+	{
+		return (c >= 0) ? c / RegionFile::Size : -((-c + RegionFile::Size - 1) / RegionFile::Size);
+	}
+
+	int LocalCoord(int c)
+	{
+		return c - RegionCoord(c) * RegionFile::Size;
+	}
+
+	// The cast copies CheckpointSeconds; std::chrono::seconds would take it by reference,
+	// which needs a definition of the constant.
+	std::chrono::seconds CheckpointInterval()
+	{
+		return std::chrono::seconds((long long)WorldSave::CheckpointSeconds);
+	}
+
+	void FillAir(Chunk& chunk)
+	{
+		std::fill(std::begin(chunk.Blocks), std::end(chunk.Blocks), BlockId::Air);
+	}
+}
+
+WorldSave::WorldSave(const std::string& directory) :
+	mDirectory(directory)
+{
+	FileUtil::MakeDirectory(mDirectory);
+
+	// Edits a crash left in the journal wait for the first checkpoint like new ones.
+	if (!mJournal.Open(JournalPath(), mEdits))
+		++mStats.FailedWrites;
+	mEditsWritten = mEdits.size();
+	mStats.EditsRecovered = mEdits.size();
+	mCheckpointDue = Clock::now() + CheckpointInterval();
+
+	mWriter = std::thread([this]() { WriterLoop(); });
+}
+
+WorldSave::~WorldSave()
+{
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		mStop = true;
+	}
+	mQueueChanged.notify_all();
+	mWriter.join();
+}
+
+std::string WorldSave::InfoPath()const
+{
+	return mDirectory + "/world.dat";
+}
+
+std::string WorldSave::RegionPath(int rx, int ry, int rz)const
+{
+	return mDirectory + "/r." + std::to_string(rx) + "." + std::to_string(ry) + "." + std::to_string(rz) + ".region";
+}
+
+std::string WorldSave::JournalPath()const
+{
+	return mDirectory + "/edits.journal";
+}
+
+bool WorldSave::ReadInfo(WorldSaveInfo& info)
+{
+	Flush();
+
+	std::ifstream fin(InfoPath().c_str(), std::ios::binary);
+	InfoHeader header;
+	if (!fin.read((char*)&header, sizeof(header)) ||
+		std::memcmp(header.Magic, InfoMagic, sizeof(InfoMagic)) != 0 || header.Version != Version ||
+		header.SizeX <= 0 || header.SizeY <= 0 || header.SizeZ <= 0)
+	{
+		return false;
+	}
+
+	info.Seed = header.Seed;
+	info.GeneratorVersion = header.GeneratorVersion;
+	info.SizeX = header.SizeX;
+	info.SizeY = header.SizeY;
+	info.SizeZ = header.SizeZ;
+	info.MinY = header.MinY;
+	return true;
+}
+
+std::unique_ptr<World> WorldSave::LoadWorld(WorldSaveInfo* infoOut, int threadCount)
+{
+	PROFILE_ZONE("LoadWorld");
+
+	WorldSaveInfo info;
+	if (!ReadInfo(info))
+		return nullptr;
+
+	std::ifstream fin(InfoPath().c_str(), std::ios::binary);
+	InfoHeader header;
+	std::vector<std::uint8_t> packed;
+	if (fin.read((char*)&header, sizeof(header)))
+	{
+		packed.resize(header.HeightsBytes);
+		fin.read((char*)packed.data(), packed.size());
+	}
+
+	std::vector<std::int32_t> heights((std::size_t)info.SizeX * info.SizeZ);
+	if (!fin || !Lz::Decompress(packed.data(), packed.size(), (std::uint8_t*)heights.data(), heights.size() * sizeof(std::int32_t)))
+		return nullptr;
+
+	std::unique_ptr<World> world = std::make_unique<World>(info.SizeX, info.SizeY, info.SizeZ, info.MinY);
+	for (int z = 0; z < info.SizeZ; ++z)
+	{
+		for (int x = 0; x < info.SizeX; ++x)
+			world->SetSurfaceHeight(x, z, heights[x + z * info.SizeX]);
+	}
+
+	// Taken before the regions are read: a checkpoint folding these edits meanwhile
+	// only writes chunks they replay onto unchanged.
+	std::vector<BlockEdit> edits;
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		edits = mEdits;
+	}
+
+	// Region reads are serialized; decoding runs in parallel.
+	std::atomic<bool> failed(false);
+	int chunksXZ = world->ChunksX() * world->ChunksZ();
+	ParallelFor(0, world->ChunkCount(), threadCount, [&](int i)
+	{
+		int cx = i % world->ChunksX();
+		int cz = (i / world->ChunksX()) % world->ChunksZ();
+		int cy = i / chunksXZ;
+		bool saved = false;
+		if (!ReadChunk(cx, cy, cz, world->GetChunk(cx, cy, cz), &saved) && saved)
+			failed = true;
+	});
+
+	if (failed)
+		return nullptr;
+
+	for (const BlockEdit& e : edits)
+	{
+		if (e.ChunkX >= 0 && e.ChunkX < world->ChunksX() && e.ChunkY >= 0 && e.ChunkY < world->ChunksY() &&
+			e.ChunkZ >= 0 && e.ChunkZ < world->ChunksZ())
+		{
+			world->GetChunk(e.ChunkX, e.ChunkY, e.ChunkZ).Blocks[e.Index] = e.New;
+		}
+	}
+
+	if (infoOut != nullptr)
+		*infoOut = info;
+	return world;
+}
+
+bool WorldSave::LoadChunk(int cx, int cy, int cz, Chunk& chunk)
+{
+	Flush();
+
+	// As in LoadWorld, the edits are taken before the region is read.
+	std::vector<BlockEdit> edits;
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		for (const BlockEdit& e : mEdits)
+		{
+			if (e.ChunkX == cx && e.ChunkY == cy && e.ChunkZ == cz)
+				edits.push_back(e);
+		}
+	}
+
+	bool saved = false;
+	bool read = ReadChunk(cx, cy, cz, chunk, &saved);
+	if (saved && !read)
+		return false;
+	if (!read)
+		FillAir(chunk);
+
+	for (const BlockEdit& e : edits)
+		chunk.Blocks[e.Index] = e.New;
+	return read || !edits.empty();
+}
+
+bool WorldSave::ReadChunk(int cx, int cy, int cz, Chunk& chunk, bool* saved)
+{
+	std::vector<std::uint8_t> record;
+	{
+		std::lock_guard<std::mutex> lock(mRegionMutex);
+		RegionFile* region = GetRegion(RegionCoord(cx), RegionCoord(cy), RegionCoord(cz), false);
+		int slot = RegionFile::Slot(LocalCoord(cx), LocalCoord(cy), LocalCoord(cz));
+		if (region == nullptr || !region->Has(slot))
+			return false;
+		if (saved != nullptr)
+			*saved = true;
+		if (!region->Read(slot, record))
+			return false;
+	}
+
+	if (!ChunkCodec::Decode(record.data(), record.size(), chunk))
+		return false;
+
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	++mStats.ChunksRead;
+	return true;
+}
+
+void WorldSave::SaveWorld(const World& world, std::uint32_t seed, int generatorVersion)
+{
+	PROFILE_ZONE("SaveWorld");
+
+	std::vector<std::int32_t> heights((std::size_t)world.SizeX() * world.SizeZ());
+	for (int z = 0; z < world.SizeZ(); ++z)
+	{
+		for (int x = 0; x < world.SizeX(); ++x)
+			heights[x + z * world.SizeX()] = world.SurfaceHeight(x, z);
+	}
+
+	std::vector<std::uint8_t> info(sizeof(InfoHeader));
+	Lz::Compress((const std::uint8_t*)heights.data(), heights.size() * sizeof(std::int32_t), info);
+
+	InfoHeader header = {};
+	std::memcpy(header.Magic, InfoMagic, sizeof(InfoMagic));
+	header.Version = Version;
+	header.Seed = seed;
+	header.GeneratorVersion = generatorVersion;
+	header.SizeX = world.SizeX();
+	header.SizeY = world.SizeY();
+	header.SizeZ = world.SizeZ();
+	header.MinY = world.MinY();
+	header.HeightsBytes = (std::uint32_t)(info.size() - sizeof(InfoHeader));
+	std::memcpy(info.data(), &header, sizeof(header));
+
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		mQueuedInfo.swap(info);
+		mEdits.clear();
+		mEditsWritten = 0;
+		++mEditEpoch;
+		mResetJournal = true;
+	}
+
+	for (int cy = 0; cy < world.ChunksY(); ++cy)
+	{
+		for (int cz = 0; cz < world.ChunksZ(); ++cz)
+		{
+			for (int cx = 0; cx < world.ChunksX(); ++cx)
+				SaveChunk(cx, cy, cz, world.GetChunk(cx, cy, cz));
+		}
+	}
+}
+
+void WorldSave::SaveChunk(int cx, int cy, int cz, const Chunk& chunk)
+{
+	Position position(cx, cy, cz);
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		auto queued = mQueuedChunks.find(position);
+		if (queued != mQueuedChunks.end())
+		{
+			queued->second = chunk;
+		}
+		else
+		{
+			mQueuedChunks.emplace(position, chunk);
+			mQueue.push_back(position);
+		}
+	}
+	mQueueChanged.notify_all();
+}
+
+void WorldSave::SaveEdit(const BlockEdit& edit)
+{
+	{
+		std::lock_guard<std::mutex> lock(mQueueMutex);
+		if (mEdits.empty())
+			mCheckpointDue = Clock::now() + CheckpointInterval();
+		mEdits.push_back(edit);
+		if (mEdits.size() == CheckpointEdits)
+			mCheckpointDue = Clock::now();
+	}
+	mQueueChanged.notify_all();
+}
+
+void WorldSave::Flush()
+{
+	std::unique_lock<std::mutex> lock(mQueueMutex);
+	mQueueChanged.wait(lock, [this]()
+	{
+		return mQueue.empty() && mQueuedInfo.empty() && mEditsWritten == mEdits.size() && !mResetJournal && !mWriting;
+	});
+}
+
+bool WorldSave::Checkpoint()
+{
+	std::unique_lock<std::mutex> lock(mQueueMutex);
+	if (mEdits.empty())
+		return true;
+
+	// A fold already running may have started before the last edits were journaled.
+	std::uint64_t target = mFoldsTried + (mFolding ? 2 : 1);
+	std::uint64_t failed = mStats.FailedCheckpoints;
+	mCheckpointDue = Clock::now();
+	mQueueChanged.notify_all();
+	mQueueChanged.wait(lock, [&]() { return mFoldsTried >= target || mEdits.empty(); });
+	return mStats.FailedCheckpoints == failed;
+}
+
+std::size_t WorldSave::QueuedChunks()
+{
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	return mQueue.size();
+}
+
+std::size_t WorldSave::UncheckpointedEdits()
+{
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	return mEdits.size();
+}
+
+WorldSaveStats WorldSave::Stats()
+{
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	return mStats;
+}
+
+bool WorldSave::CheckpointDue()const
+{
+	// Chunks queued before the edits' checkpoint go to the regions first.
+	return !mEdits.empty() && mEditsWritten == mEdits.size() && !mResetJournal && mQueue.empty() &&
+		Clock::now() >= mCheckpointDue;
+}
+
+void WorldSave::WriterLoop()
+{
+	Profiler::SetThreadName("WorldSave");
+
+	std::unique_lock<std::mutex> lock(mQueueMutex);
+	for (;;)
+	{
+		auto unwritten = [this]()
+		{
+			return mResetJournal || mEditsWritten < mEdits.size() || !mQueue.empty() || !mQueuedInfo.empty();
+		};
+		auto ready = [&]() { return mStop || unwritten() || CheckpointDue(); };
+		Clock::time_point due = mCheckpointDue;
+		if (mEdits.empty())
+			mQueueChanged.wait(lock, ready);
+		else
+			mQueueChanged.wait_until(lock, due, ready);
+		if (!ready())
+			continue;
+		if (mStop && !unwritten())
+			break;   // stopping with nothing left to write; the journal keeps the edits
+
+		// Journal first, so edits are durable as soon as possible.  world.dat goes once
+		// the chunks queued with it are written, so a save cut short does not look
+		// complete, and checkpoints once there is nothing else to do.
+		mWriting = true;
+		auto start = Clock::now();
+		if (mResetJournal)
+		{
+			mResetJournal = false;
+			lock.unlock();
+			bool ok = mJournal.Reset();
+			lock.lock();
+			mStats.FailedWrites += ok ? 0 : 1;
+		}
+		else if (mEditsWritten < mEdits.size())
+		{
+			// Every edit queued so far goes in one frame.
+			std::vector<BlockEdit> edits(mEdits.begin() + mEditsWritten, mEdits.end());
+			std::uint64_t epoch = mEditEpoch;
+			lock.unlock();
+			bool ok = mJournal.Append(edits.data(), edits.size());
+			lock.lock();
+
+			// Edits that failed to reach the journal still fold at the next checkpoint.
+			if (epoch == mEditEpoch)
+				mEditsWritten += edits.size();
+			if (ok)
+				mStats.EditsJournaled += edits.size();
+			else
+				++mStats.FailedWrites;
+		}
+		else if (!mQueue.empty())
+		{
+			Position position = mQueue.front();
+			mQueue.pop_front();
+			Chunk chunk = mQueuedChunks[position];
+			mQueuedChunks.erase(position);
+			lock.unlock();
+			WriteChunk(position, chunk);
+			lock.lock();
+		}
+		else if (!mQueuedInfo.empty())
+		{
+			std::vector<std::uint8_t> info;
+			info.swap(mQueuedInfo);
+			lock.unlock();
+			bool ok = WriteInfo(info);
+			lock.lock();
+			mStats.FailedWrites += ok ? 0 : 1;
+		}
+		else
+		{
+			// Checkpoint.  Edits saved while folding stay for the next one.
+			std::vector<BlockEdit> edits(mEdits);
+			std::uint64_t epoch = mEditEpoch;
+			mFolding = true;
+			lock.unlock();
+			bool ok = FoldEdits(edits) && mJournal.Reset();
+			lock.lock();
+			mFolding = false;
+			mStats.CheckpointMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			++mFoldsTried;
+			if (ok && epoch == mEditEpoch)
+			{
+				mEdits.erase(mEdits.begin(), mEdits.begin() + edits.size());
+				mEditsWritten -= edits.size();
+				++mStats.Checkpoints;
+				mStats.EditsCheckpointed += edits.size();
+			}
+			mStats.FailedCheckpoints += ok ? 0 : 1;
+
+			// A failed checkpoint is retried after the full interval, not on every edit.
+			mCheckpointDue = Clock::now();
+			if (!ok || mEdits.size() < CheckpointEdits)
+				mCheckpointDue += CheckpointInterval();
+		}
+		mStats.WriterMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		mWriting = false;
+		mQueueChanged.notify_all();
+	}
+}
+
+bool WorldSave::WriteChunk(const Position& position, const Chunk& chunk)
+{
+	PROFILE_ZONE("WriteChunk");
+
+	int cx = std::get<0>(position);
+	int cy = std::get<1>(position);
+	int cz = std::get<2>(position);
+
+	std::vector<std::uint8_t> record;
+	ChunkCodec::Encode(chunk, record);
+
+	bool ok;
+	bool compacted = false;
+	{
+		std::lock_guard<std::mutex> lock(mRegionMutex);
+		RegionFile* region = GetRegion(RegionCoord(cx), RegionCoord(cy), RegionCoord(cz), true);
+		int slot = RegionFile::Slot(LocalCoord(cx), LocalCoord(cy), LocalCoord(cz));
+		ok = region != nullptr && region->Write(slot, record.data(), record.size());
+		if (ok && region->WantsCompaction())
+			compacted = region->Compact();
+	}
+
+	std::lock_guard<std::mutex> lock(mQueueMutex);
+	if (ok)
+	{
+		++mStats.ChunksWritten;
+		mStats.EncodedBytes += record.size();
+	}
+	else
+	{
+		++mStats.FailedWrites;
+	}
+	mStats.Compactions += compacted ? 1 : 0;
+	return ok;
+}
+
+bool WorldSave::FoldEdits(const std::vector<BlockEdit>& edits)
+{
+	PROFILE_ZONE("Checkpoint");
+
+	// Each edited chunk is read and written once, with its edits applied in order.
+	std::map<Position, Chunk> chunks;
+	for (const BlockEdit& e : edits)
+	{
+		Position position(e.ChunkX, e.ChunkY, e.ChunkZ);
+		auto found = chunks.find(position);
+		if (found == chunks.end())
+		{
+			found = chunks.emplace(position, Chunk()).first;
+			bool saved = false;
+			if (!ReadChunk(e.ChunkX, e.ChunkY, e.ChunkZ, found->second, &saved))
+			{
+				if (saved)
+					return false;
+				FillAir(found->second);
+			}
+		}
+		found->second.Blocks[e.Index] = e.New;
+	}
+
+	for (const auto& chunk : chunks)
+	{
+		if (!WriteChunk(chunk.first, chunk.second))
+			return false;
+	}
+	return true;
+}
+
+bool WorldSave::WriteInfo(const std::vector<std::uint8_t>& info)
+{
+	// Written aside and renamed over the old one, so world.dat is never half written.
+	std::string path = InfoPath();
+	std::string temp = path + ".tmp";
+	{
+		std::ofstream fout(temp.c_str(), std::ios::binary | std::ios::trunc);
+		if (!fout.write((const char*)info.data(), info.size()))
+			return false;
+	}
+#if defined(_WIN32)
+	std::remove(path.c_str());
+#endif
+	return std::rename(temp.c_str(), path.c_str()) == 0;
+}
+
+RegionFile* WorldSave::GetRegion(int rx, int ry, int rz, bool create)
+{
+	Position position(rx, ry, rz);
+	auto found = mRegions.find(position);
+	if (found != mRegions.end())
+		return found->second.get();
+
+	std::string path = RegionPath(rx, ry, rz);
+	if (!create && !FileUtil::FileExists(path))
+		return nullptr;
+
+	std::unique_ptr<RegionFile> region = std::make_unique<RegionFile>();
+	if (!region->Open(path))
+		return nullptr;
+
+	RegionFile* result = region.get();
+	mRegions.emplace(position, std::move(region));
+	return result;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "World.h"
+#include "RegionFile.h"
+#include "BlockJournal.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// What a save records about its world besides the chunks.
+struct WorldSaveInfo
+{
+	std::uint32_t Seed = 0;
+	int GeneratorVersion = 0;
+	int SizeX = 0;
+	int SizeY = 0;
+	int SizeZ = 0;
+	int MinY = 0;
+};
+
+struct WorldSaveStats
+{
+	std::uint64_t ChunksWritten = 0;
+	std::uint64_t ChunksRead = 0;
+	std::uint64_t EncodedBytes = 0;   // records written, before any compaction
+	std::uint64_t Compactions = 0;
+	std::uint64_t FailedWrites = 0;
+	std::uint64_t EditsJournaled = 0;
+	std::uint64_t EditsRecovered = 0;    // found in the journal when the save was opened
+	std::uint64_t Checkpoints = 0;
+	std::uint64_t EditsCheckpointed = 0;
+	std::uint64_t FailedCheckpoints = 0;
+	double CheckpointMs = 0.0;        // part of WriterMs spent folding edits
+	double WriterMs = 0.0;            // time the writer thread spent encoding and writing
+};
+
+// A world saved to a directory: world.dat holds the WorldSaveInfo and the surface
+// heights, and the chunks live in region files named r.<x>.<y>.<z>.region after the
+// region's position, which is the chunk position divided by RegionFile::Size.
+//
+// Saving never blocks the caller.  SaveWorld and SaveChunk copy what they are given
+// and queue it; a writer thread encodes each chunk with ChunkCodec, appends it to its
+// region and compacts the region once it holds more garbage than live records.  A
+// chunk saved again before the writer got to it is only written once.  Loads wait for
+// everything queued before them to be written.
+//
+// Block edits are not saved by rewriting their chunks.  SaveEdit queues the edit, and
+// the writer appends everything queued as one frame of a BlockJournal, edits.journal,
+// ahead of any chunk.  Once CheckpointEdits edits are journaled, or CheckpointSeconds
+// after the first of them, the writer folds them into the regions, reading, editing
+// and writing each chunk once, and empties the journal.  Loads apply the edits not yet
+// folded on top of the regions, so the journal left by a crash is replayed on the next
+// load and folded by the next checkpoint.  An edit replays as "set the cell to New",
+// so edits folded before a crash and replayed again give the same blocks.
+class WorldSave
+{
+public:
+	static const std::uint32_t Version = 1;
+	static const std::size_t CheckpointEdits = 4096;
+	static const int CheckpointSeconds = 30;
+
+	// Creates the directory if needed.
+	explicit WorldSave(const std::string& directory);
+	WorldSave(const WorldSave& rhs) = delete;
+	WorldSave& operator=(const WorldSave& rhs) = delete;
+
+	// Writes everything still queued first.
+	~WorldSave();
+
+	const std::string& Directory()const { return mDirectory; }
+	std::string InfoPath()const;
+	std::string RegionPath(int rx, int ry, int rz)const;
+	std::string JournalPath()const;
+
+	// False if the directory holds no saved world.
+	bool ReadInfo(WorldSaveInfo& info);
+
+	// A world of the saved size with every saved chunk and edit; chunks never saved are
+	// air.
+	// Returns null if there is no save or a chunk fails to read.  threadCount is as for
+	// ParallelFor.
+	std::unique_ptr<World> LoadWorld(WorldSaveInfo* info = nullptr, int threadCount = 0);
+
+	// False if the chunk was never saved or fails to read.
+	bool LoadChunk(int cx, int cy, int cz, Chunk& chunk);
+
+	// Queues world.dat and every chunk of the world.  Edits journaled for the world
+	// saved before are dropped.
+	void SaveWorld(const World& world, std::uint32_t seed, int generatorVersion);
+	void SaveChunk(int cx, int cy, int cz, const Chunk& chunk);
+	void SaveEdit(const BlockEdit& edit);
+
+	// Waits until everything queued so far is on disk.
+	void Flush();
+
+	// Folds the edits saved so far into the regions without waiting for the next
+	// checkpoint, and waits for it.  Returns false if the checkpoint failed.
+	bool Checkpoint();
+
+	std::size_t QueuedChunks();
+	std::size_t UncheckpointedEdits();
+	WorldSaveStats Stats();
+
+private:
+	typedef std::tuple<int, int, int> Position;
+
+	typedef std::chrono::steady_clock Clock;
+
+	void WriterLoop();
+	bool WriteChunk(const Position& position, const Chunk& chunk);
+	bool WriteInfo(const std::vector<std::uint8_t>& info);
+	bool FoldEdits(const std::vector<BlockEdit>& edits);
+
+	// Needs mQueueMutex.
+	bool CheckpointDue()const;
+
+	// Null if the region does not exist and create is false.  Needs mRegionMutex.
+	RegionFile* GetRegion(int rx, int ry, int rz, bool create);
+
+	// saved, if given, is set when the chunk has a record, readable or not.
+	bool ReadChunk(int cx, int cy, int cz, Chunk& chunk, bool* saved = nullptr);
+
+private:
+	std::string mDirectory;
+
+	std::mutex mRegionMutex;
+	std::map<Position, std::unique_ptr<RegionFile>> mRegions;
+
+	std::mutex mQueueMutex;
+	std::condition_variable mQueueChanged;
+	std::deque<Position> mQueue;
+	std::map<Position, Chunk> mQueuedChunks;
+	std::vector<std::uint8_t> mQueuedInfo;   // world.dat contents, empty if none queued
+	bool mWriting = false;
+	bool mStop = false;
+	WorldSaveStats mStats;
+
+	BlockJournal mJournal;                   // used by the writer thread only
+	std::vector<BlockEdit> mEdits;           // since the last checkpoint, oldest first
+	std::size_t mEditsWritten = 0;           // how many of mEdits are in the journal
+	std::uint64_t mEditEpoch = 0;            // changes when SaveWorld drops mEdits
+	bool mResetJournal = false;
+	bool mFolding = false;
+	std::uint64_t mFoldsTried = 0;
+	Clock::time_point mCheckpointDue;
+
+	std::thread mWriter;
+};